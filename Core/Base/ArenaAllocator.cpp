@@ -0,0 +1,362 @@
+﻿/*********************************************************************
+ *  ArenaAllocator.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "ArenaAllocator.h"
+#include "Core/Utilities/Math/Align.h"
+
+namespace
+{
+	inline bool IsCommandScope(VkSystemAllocationScope InScope)
+	{
+		return InScope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND;
+	}
+
+	inline bool IsPooledScope(VkSystemAllocationScope InScope)
+	{
+		return InScope == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT || InScope == VK_SYSTEM_ALLOCATION_SCOPE_CACHE;
+	}
+}
+
+ArenaAllocator::ArenaAllocator() :
+	m_arenaCurrentChunk (_index_0),
+	m_arenaLiveCount    (_count_0),
+	m_frameResetCount   (_count_0),
+	m_heapLiveBytes     (_count_0)
+{
+	static_assert(sizeof(BlockHeader) <= HeaderSize, "BlockHeader must fit in HeaderSize.");
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+	for (auto& chunk : m_arenaChunks)
+		free(chunk.Data);
+
+	for (auto& pool : m_pools)
+		for (auto& page : pool.Pages)
+			free(page);
+
+	m_arenaChunks.clear();
+}
+
+void ArenaAllocator::NextFrame()
+{
+	std::unique_lock<std::mutex> lock(m_arenaMutex);
+
+	// Command scope memory only lives for the duration of one vulkan command,
+	// so nothing should be alive here. If a command is still in flight on
+	// another thread, keep the arena and try again next frame.
+	if (m_arenaLiveCount != 0)
+		return;
+
+	for (auto& chunk : m_arenaChunks)
+		chunk.Used = 0;
+
+	m_arenaCurrentChunk = _index_0;
+	m_frameResetCount++;
+}
+
+ArenaAllocator::Stats ArenaAllocator::GetStats()
+{
+	Stats stats = {};
+
+	{
+		std::unique_lock<std::mutex> lock(m_arenaMutex);
+		for (auto& chunk : m_arenaChunks)
+			stats.ArenaBytes += chunk.Capacity;
+		stats.ArenaLiveCount  = m_arenaLiveCount;
+		stats.FrameResetCount = m_frameResetCount;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_poolMutex);
+		for (auto& pool : m_pools)
+			stats.PoolBytes += pool.Pages.size() * PoolPageSize;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_heapMutex);
+		stats.HeapLiveBytes = m_heapLiveBytes;
+	}
+
+	return stats;
+}
+
+void* ArenaAllocator::Allocation(usize size, usize alignment, VkSystemAllocationScope allocationScope)
+{
+	if (size == 0)
+		return nullptr;
+
+	if (IsCommandScope(allocationScope) && alignment <= MaxArenaAlignment)
+		return ArenaAllocate(size, alignment);
+
+	if (IsPooledScope(allocationScope))
+		return PoolAllocate(size, alignment);
+
+	return HeapAllocate(size, alignment);
+}
+
+void* ArenaAllocator::Reallocation(void* pOriginal, usize size, usize alignment, VkSystemAllocationScope allocationScope)
+{
+	if (pOriginal == nullptr)
+		return Allocation(size, alignment, allocationScope);
+
+	if (size == 0)
+	{
+		Free(pOriginal);
+		return nullptr;
+	}
+
+	BlockHeader* header = GetHeader(pOriginal);
+
+	if (((usize)pOriginal & (alignment - 1)) == 0 && TryResizeInPlace(header, size))
+		return pOriginal;
+
+	void* memory = Allocation(size, alignment, allocationScope);
+
+	// On failure the original allocation must stay untouched.
+	if (memory == nullptr)
+		return nullptr;
+
+	std::memcpy(memory, pOriginal, std::min(GetUsableSize(header), size));
+	Free(pOriginal);
+
+	return memory;
+}
+
+void ArenaAllocator::Free(void* pMemory)
+{
+	if (pMemory == nullptr)
+		return;
+
+	BlockHeader* header = GetHeader(pMemory);
+
+	switch ((Route)header->Route)
+	{
+	case Route::Arena: ArenaFree(header); break;
+	case Route::Pool:  PoolFree(header);  break;
+	case Route::Heap:  HeapFree(header);  break;
+	default:
+		_log_error("Free an unknown host allocation!", LogSystem::Category::Memory);
+		break;
+	}
+}
+
+void ArenaAllocator::InternalAllocation(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	// Notification only, the driver owns this memory.
+}
+
+void ArenaAllocator::InternalFree(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	// Notification only, the driver owns this memory.
+}
+
+#pragma region Arena
+
+void* ArenaAllocator::ArenaAllocate(usize InSize, usize InAlignment)
+{
+	const usize alignment = std::max(InAlignment, HeaderSize);
+
+	std::unique_lock<std::mutex> lock(m_arenaMutex);
+
+	for (; m_arenaCurrentChunk < m_arenaChunks.size(); ++m_arenaCurrentChunk)
+	{
+		ArenaChunk& chunk = m_arenaChunks[m_arenaCurrentChunk];
+
+		usize begin = (usize)(chunk.Data + chunk.Used);
+		usize user  = Math::AlignUp(begin + HeaderSize, alignment);
+
+		if (user + InSize <= (usize)(chunk.Data + chunk.Capacity))
+		{
+			chunk.Used = (usize)(user + InSize - (usize)chunk.Data);
+			m_arenaLiveCount++;
+
+			return PlaceHeader((uint8*)begin, alignment, InSize, Route::Arena, (uint16)m_arenaCurrentChunk);
+		}
+	}
+
+	// Chunk index has to fit in the header.
+	if (m_arenaChunks.size() >= _numeric_max(uint16))
+	{
+		lock.unlock();
+		return HeapAllocate(InSize, InAlignment);
+	}
+
+	ArenaChunk chunk;
+	chunk.Capacity = std::max(ArenaChunkSize, InSize + HeaderSize + alignment);
+	chunk.Data     = (uint8*)malloc(chunk.Capacity);
+	chunk.Used     = 0;
+
+	if (chunk.Data == nullptr)
+		return nullptr;
+
+	void* memory = PlaceHeader(chunk.Data, alignment, InSize, Route::Arena, (uint16)m_arenaChunks.size());
+	chunk.Used   = (usize)((uint8*)memory + InSize - chunk.Data);
+
+	m_arenaCurrentChunk = m_arenaChunks.size();
+	m_arenaChunks.push_back(chunk);
+	m_arenaLiveCount++;
+
+	return memory;
+}
+
+void ArenaAllocator::ArenaFree(BlockHeader* InHeader)
+{
+	std::unique_lock<std::mutex> lock(m_arenaMutex);
+
+	// Memory itself is reclaimed in bulk by NextFrame().
+	if (m_arenaLiveCount > 0)
+		m_arenaLiveCount--;
+}
+
+#pragma endregion
+
+#pragma region Pool
+
+void* ArenaAllocator::PoolAllocate(usize InSize, usize InAlignment)
+{
+	// Pool blocks are 16 bytes aligned, extra space is reserved for larger alignments.
+	const usize required = InSize + HeaderSize + (InAlignment > HeaderSize ? InAlignment - HeaderSize : 0);
+
+	if (required > MaxPoolClassSize)
+		return HeapAllocate(InSize, InAlignment);
+
+	const usize classIndex = GetPoolClassIndex(required);
+	const usize classSize  = GetPoolClassSize(classIndex);
+
+	std::unique_lock<std::mutex> lock(m_poolMutex);
+
+	SizeClassPool& pool = m_pools[classIndex];
+
+	if (pool.FreeList == nullptr)
+	{
+		uint8* page = (uint8*)malloc(PoolPageSize);
+		if (page == nullptr)
+			return nullptr;
+
+		pool.Pages.push_back(page);
+
+		for (usize offset = PoolPageSize; offset >= classSize; offset -= classSize)
+		{
+			FreeNode* node = (FreeNode*)(page + offset - classSize);
+			node->Next     = pool.FreeList;
+			pool.FreeList  = node;
+		}
+	}
+
+	FreeNode* node = pool.FreeList;
+	pool.FreeList  = node->Next;
+
+	return PlaceHeader((uint8*)node, std::max(InAlignment, HeaderSize), InSize, Route::Pool, (uint16)classIndex);
+}
+
+void ArenaAllocator::PoolFree(BlockHeader* InHeader)
+{
+	// The free node may overlap the header, read it first.
+	const usize classIndex = InHeader->Class;
+	FreeNode*   node       = (FreeNode*)((uint8*)InHeader + HeaderSize - InHeader->Offset);
+
+	std::unique_lock<std::mutex> lock(m_poolMutex);
+
+	SizeClassPool& pool = m_pools[classIndex];
+	node->Next    = pool.FreeList;
+	pool.FreeList = node;
+}
+
+#pragma endregion
+
+#pragma region Heap
+
+void* ArenaAllocator::HeapAllocate(usize InSize, usize InAlignment)
+{
+	const usize alignment = std::max(InAlignment, HeaderSize);
+
+	uint8* raw = (uint8*)malloc(InSize + HeaderSize + alignment);
+	if (raw == nullptr)
+		return nullptr;
+
+	{
+		std::unique_lock<std::mutex> lock(m_heapMutex);
+		m_heapLiveBytes += InSize;
+	}
+
+	return PlaceHeader(raw, alignment, InSize, Route::Heap, _index_0);
+}
+
+void ArenaAllocator::HeapFree(BlockHeader* InHeader)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_heapMutex);
+		m_heapLiveBytes -= (usize)InHeader->Size;
+	}
+
+	free((uint8*)InHeader + HeaderSize - InHeader->Offset);
+}
+
+#pragma endregion
+
+bool ArenaAllocator::TryResizeInPlace(BlockHeader* InHeader, usize InSize)
+{
+	if (InSize <= GetUsableSize(InHeader))
+		return true;
+
+	// The most recent arena allocation can simply grow.
+	if ((Route)InHeader->Route == Route::Arena)
+	{
+		std::unique_lock<std::mutex> lock(m_arenaMutex);
+
+		ArenaChunk& chunk = m_arenaChunks[InHeader->Class];
+		uint8*      user  = (uint8*)InHeader + HeaderSize;
+
+		if (user + InHeader->Size == chunk.Data + chunk.Used && user + InSize <= chunk.Data + chunk.Capacity)
+		{
+			chunk.Used      = (usize)(user + InSize - chunk.Data);
+			InHeader->Size  = InSize;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+usize ArenaAllocator::GetUsableSize(const BlockHeader* InHeader) const
+{
+	if ((Route)InHeader->Route == Route::Pool)
+		return GetPoolClassSize(InHeader->Class) - InHeader->Offset;
+
+	return (usize)InHeader->Size;
+}
+
+ArenaAllocator::BlockHeader* ArenaAllocator::GetHeader(void* InMemory)
+{
+	return (BlockHeader*)((uint8*)InMemory - HeaderSize);
+}
+
+void* ArenaAllocator::PlaceHeader(uint8* InRawBlock, usize InAlignment, uint64 InSize, Route InRoute, uint16 InClass)
+{
+	uint8* user = (uint8*)Math::AlignUp((usize)InRawBlock + HeaderSize, InAlignment);
+
+	BlockHeader* header = GetHeader(user);
+	header->Size   = InSize;
+	header->Offset = (uint32)(user - InRawBlock);
+	header->Route  = (uint16)InRoute;
+	header->Class  = InClass;
+
+	return user;
+}
+
+usize ArenaAllocator::GetPoolClassIndex(usize InSize)
+{
+	usize classIndex = _index_0;
+	while (GetPoolClassSize(classIndex) < InSize)
+		++classIndex;
+
+	return classIndex;
+}
+
+usize ArenaAllocator::GetPoolClassSize(usize InClassIndex)
+{
+	return MinPoolClassSize << InClassIndex;
+}
@@ -0,0 +1,145 @@
+﻿/*********************************************************************
+ *  ArenaAllocator.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Host allocator routing Vulkan requests by VkSystemAllocationScope.
+ *********************************************************************/
+
+#pragma once
+
+#include "BaseAllocator.h"
+#include <mutex>
+
+/**
+ *  COMMAND scope  -> per-frame linear arena, rewound in bulk by NextFrame().
+ *  OBJECT / CACHE -> pooled power-of-two size classes.
+ *  DEVICE / INSTANCE and anything too large for the pools -> long-lived heap.
+ * 
+ *  Every block is prefixed with a small header, so Free() and Reallocation()
+ *  can find their route without the driver passing the scope back.
+ */
+class ArenaAllocator : public BaseAllocator
+{
+
+public:
+
+	ArenaAllocator();
+	virtual ~ArenaAllocator();
+
+	virtual void NextFrame() override;
+
+public:
+
+	struct Stats
+	{
+		usize ArenaBytes;          ///< Bytes reserved by the command arena chunks.
+		usize ArenaLiveCount;      ///< Command scope allocations still alive.
+		usize PoolBytes;           ///< Bytes reserved by the size class pages.
+		usize HeapLiveBytes;       ///< Bytes alive in the long-lived heap.
+		usize FrameResetCount;     ///< How many times the command arena has been rewound.
+	};
+
+	Stats GetStats();
+
+public:
+
+	static constexpr usize MinPoolClassSize   = 16;
+	static constexpr usize MaxPoolClassSize   = 4096;
+	static constexpr usize NumPoolClasses     = 9;            ///< 16, 32, ... , 4096.
+	static constexpr usize PoolPageSize       = 64 * 1024;
+	static constexpr usize ArenaChunkSize     = 256 * 1024;
+	static constexpr usize MaxArenaAlignment  = 256;
+
+private:
+
+	enum class Route : uint32
+	{
+		Arena,
+		Pool,
+		Heap
+	};
+
+	struct BlockHeader
+	{
+		uint64 Size;       ///< Requested size in bytes.
+		uint32 Offset;     ///< Distance from the raw block start to the user pointer.
+		uint16 Route;      ///< Which sub-allocator owns this block.
+		uint16 Class;      ///< Pool class index, or arena chunk index.
+	};
+
+	static constexpr usize HeaderSize = 16;
+
+	struct ArenaChunk
+	{
+		uint8* Data;
+		usize  Capacity;
+		usize  Used;
+	};
+
+	struct FreeNode
+	{
+		FreeNode* Next;
+	};
+
+	struct SizeClassPool
+	{
+		FreeNode*          FreeList = nullptr;
+		std::vector<void*> Pages;
+	};
+
+private:
+
+	virtual void* Allocation(usize size, usize alignment, VkSystemAllocationScope allocationScope) override;
+
+	virtual void* Reallocation(void* pOriginal, usize size, usize alignment, VkSystemAllocationScope allocationScope) override;
+
+	virtual void  Free(void* pMemory) override;
+
+	virtual void  InternalAllocation(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) override;
+
+	virtual void  InternalFree(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) override;
+
+private:
+
+	void* ArenaAllocate(usize InSize, usize InAlignment);
+	void* PoolAllocate(usize InSize, usize InAlignment);
+	void* HeapAllocate(usize InSize, usize InAlignment);
+
+	void  ArenaFree(BlockHeader* InHeader);
+	void  PoolFree(BlockHeader* InHeader);
+	void  HeapFree(BlockHeader* InHeader);
+
+	/**
+	 *  Try to resize the block in place.
+	 * 
+	 *  @return true if the original pointer is still valid for InSize bytes.
+	 */
+	bool  TryResizeInPlace(BlockHeader* InHeader, usize InSize);
+
+	/**
+	 *  How many bytes the block can hold behind its user pointer.
+	 */
+	usize GetUsableSize(const BlockHeader* InHeader) const;
+
+	static BlockHeader* GetHeader(void* InMemory);
+	static void*        PlaceHeader(uint8* InRawBlock, usize InAlignment, uint64 InSize, Route InRoute, uint16 InClass);
+	static usize        GetPoolClassIndex(usize InSize);
+	static usize        GetPoolClassSize(usize InClassIndex);
+
+private:
+
+	// Per-frame linear arena.
+	std::mutex                 m_arenaMutex;
+	std::vector<ArenaChunk>    m_arenaChunks;
+	usize                      m_arenaCurrentChunk;
+	usize                      m_arenaLiveCount;
+	usize                      m_frameResetCount;
+
+	// Pooled size classes.
+	std::mutex                 m_poolMutex;
+	SizeClassPool              m_pools[NumPoolClasses];
+
+	// Long-lived heap.
+	std::mutex                 m_heapMutex;
+	usize                      m_heapLiveBytes;
+};
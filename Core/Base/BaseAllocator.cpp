@@ -25,6 +25,10 @@ VkAllocationCallbacks* BaseAllocator::GetVkAllocator()
 	return &m_allocator;
 }
 
+void BaseAllocator::NextFrame()
+{
+}
+
 #pragma region VKAPI_CALL
 
 void* VKAPI_CALL BaseAllocator::_Allocation(
@@ -25,6 +25,11 @@ public:
 
 	VkAllocationCallbacks* GetVkAllocator();
 
+	/**
+	 *  Called once per frame by the engine loop, transient host memory can be recycled here.
+	 */
+	virtual void NextFrame();
+
 private:
 
 	// Declare the allocator callbacks as static member functions.
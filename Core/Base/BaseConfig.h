@@ -19,9 +19,26 @@ namespace BaseConfig
 		VK_EXT_DEBUG_REPORT_EXTENSION_NAME,
 		VK_EXT_DEBUG_UTILS_EXTENSION_NAME,
 		VK_KHR_DISPLAY_EXTENSION_NAME,
-		VK_KHR_DISPLAY_SWAPCHAIN_EXTENSION_NAME
+		VK_KHR_DISPLAY_SWAPCHAIN_EXTENSION_NAME,
+		VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+		VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME
 	};
 
+	// Host allocator bound to the vulkan allocation callbacks.
+	enum class HostAllocator
+	{
+		System,         ///< Null callbacks, the driver uses the system heap.
+		Arena,          ///< ArenaAllocator, routes requests by allocation scope.
+		ThreadCache     ///< ThreadCacheAllocator, lock-free small allocations for multi-threaded creation.
+	};
+
+	static const HostAllocator DefaultHostAllocator = HostAllocator::Arena;
+
+	// Wrap the host allocator with TrackedAllocator, cheap enough for release builds.
+	static const bool   bTrackHostAllocations      = true;
+	static const uint32 HostAllocationDumpInterval = 3600;   // In frames, 0 only dumps leaks at shutdown.
+
 	static const char* EnableLayers[] =
 	{
 		"VK_LAYER_RENDERDOC_Capture"
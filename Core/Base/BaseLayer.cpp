@@ -6,9 +6,14 @@
 #include "BaseLayer.h"
 #include "BaseConfig.h"
 #include "BaseAllocator.h"
+#include "ArenaAllocator.h"
+#include "ThreadCacheAllocator.h"
+#include "TrackedAllocator.h"
 #include "Core/Engine/Engine.h"
 #include "Core/Platform/Windows/Window.h"
 #include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/PipelinePack.h"
+#include "Core/Render/RenderBase/RenderBaseConfig.h"
 
 string GTestJaonPath;
 
@@ -40,6 +45,34 @@ void BaseLayer::PreInit()
 
 	CachedModulePath();
 
+	// Host allocator has to be bound before the first vulkan object is created.
+	if (m_pAllocator == nullptr)
+	{
+		BaseAllocator* pAllocator = nullptr;
+
+		switch (BaseConfig::DefaultHostAllocator)
+		{
+		case BaseConfig::HostAllocator::Arena:
+			pAllocator = new ArenaAllocator;
+			break;
+		case BaseConfig::HostAllocator::ThreadCache:
+			pAllocator = new ThreadCacheAllocator;
+			break;
+		default:
+			break;
+		}
+
+		if (pAllocator != nullptr && BaseConfig::bTrackHostAllocations)
+		{
+			TrackedAllocator* pTracked = new TrackedAllocator(pAllocator);
+			pTracked->SetDumpInterval(BaseConfig::HostAllocationDumpInterval);
+			pAllocator = pTracked;
+		}
+
+		if (pAllocator != nullptr)
+			SetBaseAllocator(pAllocator);
+	}
+
 	// Global Variable.
 	uint32 numEnableExts   = _array_size(BaseConfig::EnableExtensions);
 	uint32 numEnableLayers = _array_size(BaseConfig::EnableLayers);
@@ -311,7 +344,14 @@ void BaseLayer::PreInit()
 
 		// TODO:
 
-		m_pDevice->CreateGraphicPipelines(GTestJaonPath);
+		// The pack skips the json, it is baked again once the json is newer.
+		const string pipelinePackPath = PathParser::Parse(RenderBaseConfig::Pipeline::PackPath);
+
+		if (!m_pDevice->CreateGraphicPipelinesFromPack(pipelinePackPath))
+		{
+			m_pDevice->CreateGraphicPipelines(GTestJaonPath);
+			PipelinePack::Bake({ GTestJaonPath }, pipelinePackPath);
+		}
 	}
 }
 
@@ -343,7 +383,7 @@ void BaseLayer::CreateSurface(Window* InWindow)
 			win32SurfaceCreateInfo.hinstance = (HINSTANCE)InWindow->GetHinstance();
 			win32SurfaceCreateInfo.hwnd = (HWND)InWindow->GetHwnd();
 
-			_vk_try(vkCreateWin32SurfaceKHR(GetVkInstance(), &win32SurfaceCreateInfo, GetVkAllocator(), m_pSurface.MakeInstance()));
+			_vk_try(vkCreateWin32SurfaceKHR(GetVkInstance(), &win32SurfaceCreateInfo, GetVkAllocator(), m_pSurface.MakeInstance(m_pInstanceContext)));
 		}
 #endif
 	}
@@ -430,7 +470,7 @@ void BaseLayer::CreateSwapChain()
 			else m_swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 		}
 
-		m_pDevice->CreateSwapchainKHR(m_pSwapchainKHR.MakeInstance(), m_swapchainCreateInfo);
+		m_pDevice->CreateSwapchainKHR(m_pSwapchainKHR.MakeInstance(m_pDevice->GetDeviceContext()), m_swapchainCreateInfo);
 
 		uint32 swapchainImageCount = _count_0;
 		m_pDevice->GetSwapchainImagesKHR(*m_pSwapchainKHR, &swapchainImageCount, nullptr);
@@ -503,7 +543,6 @@ void BaseLayer::CachedModulePath()
 void BaseLayer::SetBaseAllocator(BaseAllocator* InAllocator)
 {
 	m_pAllocator = InAllocator;
-	VkSmartPtr_Private::SetBaseAllocator(InAllocator);
 }
 
 void BaseLayer::SafeFreeAllocator()
@@ -517,14 +556,13 @@ void BaseLayer::SafeFreeAllocator()
 
 void BaseLayer::SetVkInstance(const VkInstance& InInstance)
 {
-	m_instance = InInstance;
-	VkSmartPtr_Private::SetVkInstance(InInstance);
+	m_instance         = InInstance;
+	m_pInstanceContext = VkDeviceContext::CreateInstanceContext(InInstance, m_pAllocator);
 }
 
 void BaseLayer::SetVkDevice(const VkDevice& InDevice)
 {
 	m_device = InDevice;
-	VkSmartPtr_Private::SetVkDevice(InDevice);
 }
 
 void BaseLayer::Free()
@@ -556,6 +594,11 @@ LogicalDevice* BaseLayer::GetLogicalDevice() const
 	return m_pDevice;
 }
 
+VkDeviceContext* BaseLayer::GetInstanceContext() const
+{
+	return m_pInstanceContext;
+}
+
 const VkPhysicalDeviceLimits& BaseLayer::GetMainPDLimits() const
 {
 	return m_physicalDevicesProps[m_mainPDIndex].limits;
@@ -566,6 +609,27 @@ const VkPhysicalDeviceProperties& BaseLayer::GetMainPDProps() const
 	return m_physicalDevicesProps[m_mainPDIndex];
 }
 
+const VkPhysicalDeviceMemoryProperties& BaseLayer::GetMainPDMemProps() const
+{
+	return m_physicalDevicesMemProps[m_mainPDIndex];
+}
+
+VkPhysicalDevice BaseLayer::GetMainPD() const
+{
+	return m_physicalDevices[m_mainPDIndex];
+}
+
+bool BaseLayer::IsPDExtensionEnabled(const char* InExtensionName) const
+{
+	for (auto& ext : m_supportPDExts)
+	{
+		if (_is_cstr_equal(ext, InExtensionName))
+			return true;
+	}
+
+	return false;
+}
+
 uint32 BaseLayer::GetHeapIndexFromMemPropFlags(
 	const VkMemoryRequirements& InMemRequirements,
 	VkMemoryPropertyFlags InPreferredFlags,
@@ -66,6 +66,7 @@ protected:
 	VkDevice                                          m_device;
 	BaseAllocator*                                    m_pAllocator;
 	LogicalDevice*                                    m_pDevice;
+	SmartPtr<VkDeviceContext>                         m_pInstanceContext;   // Owns the instance objects, kept alive by every device context.
 
 	int32                                             m_mainPDIndex;
 	int32                                             m_mainQFIndex;
@@ -102,8 +103,13 @@ public:
 	BaseAllocator*                     GetBaseAllocator() const;
 	VkAllocationCallbacks*             GetVkAllocator()   const;
 	LogicalDevice*                     GetLogicalDevice() const;
+	VkDeviceContext*                   GetInstanceContext() const;
 	const VkPhysicalDeviceLimits&      GetMainPDLimits () const;
 	const VkPhysicalDeviceProperties&  GetMainPDProps  () const;
+	const VkPhysicalDeviceMemoryProperties& GetMainPDMemProps() const;
+	VkPhysicalDevice                   GetMainPD       () const;
+
+	bool IsPDExtensionEnabled(const char* InExtensionName) const;
 
 	uint32 GetHeapIndexFromMemPropFlags(
 		const VkMemoryRequirements& InMemRequirements,
@@ -7,11 +7,18 @@
 
 #pragma once
 
+#include <atomic>
 #include <string>
 #include <vector>
 
+#include "Core/Base/ResourceArena.h"
+#include "Core/Utilities/Containers/SlotMap.h"
 #include "Core/Utilities/SmartPtr/SmartPtr.h"
 #include "Core/Utilities/SmartPtr/VkSmartPtr.h"
+#include "Core/Utilities/String/NameTable.h"
+#include "Core/Utilities/String/StringManager.h"
+
+using VkObjectHandle = SlotHandle<VkOwnedObject>;
 
 class IResourceHandler
 {
@@ -25,42 +32,108 @@ public:
     void BindRef(IResourceHandler* InRef) { m_resource.CommonRefs.push_back(InRef); }
 
     /**
-     *  Bind child vulkan smart object reference to current resource/instance.
+     *  Bind child vulkan object to current resource/instance, InRef and its copies no longer destroy it.
      *
      *  @param  InRef  the child vulkan smart object reference.
+     * 
+     *  @return handle for GetVkRef() and UnbindRef().
+     */
+    template<typename T>
+    VkObjectHandle BindRef(VkSmartPtr<T>& InRef) { return m_resource.VkObjects.Insert(InRef.Detach()); }
+
+    /**
+     *  Resolve a child vulkan object.
+     * 
+     *  @return the handle, VK_NULL_HANDLE if InHandle was unbound.
+     */
+    VkObjectHandler GetVkRef(VkObjectHandle InHandle) const
+    {
+        const VkOwnedObject* pObject = m_resource.VkObjects.Get(InHandle);
+        return pObject != nullptr ? pObject->Get() : VK_NULL_HANDLE;
+    }
+
+    /**
+     *  Destroy a child vulkan object before current resource/instance goes.
+     * 
+     *  @return false if InHandle was already unbound.
      */
-    void BindRef(VkSmartPtr<VkObjectHandler> InRef) { m_resource.VkSmartRefs.push_back(InRef); }
+    bool UnbindRef(VkObjectHandle InHandle) { return m_resource.VkObjects.Remove(InHandle); }
 
     /**
-     *  Resolve the name of current resource/instance.
+     *  Resolve the name of current resource/instance, the default name is only
+     *  formatted and interned the first time it is asked for.
      * 
      *  @return the name of current resource/instance.
      */
-    string GetName() { return m_name; }
+    const string& GetName() const
+    {
+        const string* pName = m_pName.load(std::memory_order_acquire);
+
+        if (pName == nullptr)
+        {
+            pName = NameTable::Intern(m_pTypeName != nullptr ? StringUtil::Printf("%_%", *m_pTypeName, m_nameIndex) : string());
+            m_pName.store(pName, std::memory_order_release);
+        }
+
+        return *pName;
+    }
 
     /**
-     *  Set the name of current resource/instance.
+     *  Set the name of current resource/instance, before it is pushed to a resource pool.
      * 
      *  @param  InName  the name of current resource/instance.
      */
-    void SetName(const string& InName) { m_name = InName; }
+    void SetName(const string& InName)
+    {
+        m_pTypeName = nullptr;
+        m_pName.store(NameTable::Intern(InName), std::memory_order_release);
+    }
+
+    /**
+     *  Resolve the arena holding current resource/instance.
+     * 
+     *  @return the arena, nullptr if current resource/instance was created with new.
+     */
+    ResourceArena* GetArena() const { return m_pArena; }
+
+protected:
+
+    /**
+     *  Name current resource/instance "<type>_<index>" without formatting it yet.
+     * 
+     *  @param  InTypeName  the interned type name.
+     *  @param  InIndex     the number of objects of that type created before.
+     */
+    void SetDefaultName(const string* InTypeName, uint32 InIndex)
+    {
+        m_pTypeName = InTypeName;
+        m_nameIndex = InIndex;
+        m_pName.store(nullptr, std::memory_order_relaxed);
+    }
+
+public:
 
     virtual ~IResourceHandler()
     {
         for (auto& ref : m_resource.CommonRefs)
-            if (ref != nullptr) delete ref;
+            if (ref != nullptr && ref->m_pArena == nullptr) delete ref;
     }
 
 private:
 
     friend class ResourcePool;
+    friend class ResourceArena;
+
+    const string*                         m_pTypeName = nullptr;     ///< Interned, nullptr once a name was set.
+    uint32                                m_nameIndex = 0;
+    mutable std::atomic<const string*>    m_pName     { nullptr };   ///< Interned, formatted on first GetName().
 
-    string m_name;
+    ResourceArena* m_pArena = nullptr;    ///< Owner of the storage, it destroys current resource/instance.
 
     struct InternalResource
     {
         std::vector<IResourceHandler*>           CommonRefs;    ///< Cache common resource references.
-        std::vector<VkSmartPtr<VkObjectHandler>> VkSmartRefs;   ///< Cache vulkan smart object references.
+        SlotMap<VkOwnedObject>                   VkObjects;     ///< Child vulkan objects, destroyed after the common references.
 
     }m_resource;
 };
@@ -70,11 +143,15 @@ private:
  * 
  *  @param  type  class type.
  */
-#define _declare_create_interface(type)  public: static type* Create(IResourceHandler* InParent);
+#define _declare_create_interface(type)  public: static type* Create(IResourceHandler* InParent, ResourceArena* InArena = nullptr);
 
 /**
- *  Implement Create(...) interface for specific class type.
+ *  Implement Create(...) interface for specific class type. Without InArena
+ *  the object goes to the arena of InParent if it has one, an object in an
+ *  arena is not bound to its parent, the arena destroys it. An arena out of
+ *  memory falls back to new, the object is bound to its parent then. The
+ *  default name index is atomic, objects made on worker threads get their own.
  * 
  *  @param  type  class type.
  */
-#define _impl_create_interface(type)     namespace { static uint32 type##ID = 0; } type* type::Create(IResourceHandler* InParent) { type* obj = new type; obj->SetName(StringUtil::Printf("%_%", _name_of(type), type##ID++)); if (InParent != nullptr) InParent->BindRef(obj); return obj; }
+#define _impl_create_interface(type)     namespace { static std::atomic<uint32> type##ID(0); } type* type::Create(IResourceHandler* InParent, ResourceArena* InArena) { ResourceArena* pArena = InArena != nullptr ? InArena : (InParent != nullptr ? InParent->GetArena() : nullptr); void* pStorage = pArena != nullptr ? pArena->Allocate<type>() : nullptr; type* obj = pStorage != nullptr ? new (pStorage) type : new type; if (pStorage != nullptr) pArena->Adopt(obj); static const string* pTypeName = NameTable::Intern(_name_of(type)); obj->SetDefaultName(pTypeName, type##ID.fetch_add(1, std::memory_order_relaxed)); if (InParent != nullptr && pStorage == nullptr) InParent->BindRef(obj); return obj; }
@@ -0,0 +1,88 @@
+﻿/*********************************************************************
+ *  ResourceArena.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "ResourceArena.h"
+#include "Core/Base/Interface/IResourceHandler.h"
+#include "Core/Utilities/Math/Align.h"
+
+std::atomic<uint32> ResourceArena::s_typeCount(0);
+
+ResourceArena::ResourceArena(uint32 InObjectsPerPage) :
+	m_objectsPerPage(std::max(InObjectsPerPage, (uint32)_count_1))
+{}
+
+ResourceArena::~ResourceArena()
+{
+	Clear();
+
+	for (auto& pool : m_pools)
+		for (auto& page : pool.Pages)
+			free(page);
+
+	m_pools.clear();
+}
+
+void ResourceArena::Adopt(IResourceHandler* InObject)
+{
+	InObject->m_pArena = this;
+	m_objects.push_back(InObject);
+}
+
+void ResourceArena::Clear()
+{
+	// A parent goes after its children, they may still use it in their destructor.
+	for (auto object = m_objects.rbegin(); object != m_objects.rend(); ++object)
+		(*object)->~IResourceHandler();
+
+	m_objects.clear();
+
+	for (auto& pool : m_pools)
+		pool.Used = _count_0;
+}
+
+uint32 ResourceArena::GetObjectCount() const
+{
+	return (uint32)m_objects.size();
+}
+
+usize ResourceArena::GetReservedBytes() const
+{
+	usize reservedBytes = _count_0;
+
+	for (auto& pool : m_pools)
+		reservedBytes += pool.Pages.size() * (pool.Stride * m_objectsPerPage + pool.Alignment);
+
+	return reservedBytes;
+}
+
+void* ResourceArena::Allocate(uint32 InTypeIndex, usize InSize, usize InAlignment)
+{
+	if (InTypeIndex >= m_pools.size())
+		m_pools.resize(InTypeIndex + 1);
+
+	TypePool& pool = m_pools[InTypeIndex];
+
+	if (pool.Stride == 0)
+	{
+		pool.Stride    = Math::AlignUp(InSize, InAlignment);
+		pool.Alignment = InAlignment;
+	}
+
+	const usize pageIndex   = pool.Used / m_objectsPerPage;
+	const usize objectIndex = pool.Used % m_objectsPerPage;
+
+	if (pageIndex == pool.Pages.size())
+	{
+		void* page = malloc(pool.Stride * m_objectsPerPage + pool.Alignment);
+		if (page == nullptr)
+			return nullptr;
+
+		pool.Pages.push_back(page);
+	}
+
+	pool.Used++;
+
+	return (uint8*)Math::AlignUp((usize)pool.Pages[pageIndex], pool.Alignment) + objectIndex * pool.Stride;
+}
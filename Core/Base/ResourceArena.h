@@ -0,0 +1,94 @@
+﻿/*********************************************************************
+ *  ResourceArena.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Per type pools holding IResourceHandler subtrees, destroyed in bulk.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/TypeDef.h"
+#include <atomic>
+#include <vector>
+
+class IResourceHandler;
+
+/**
+ *  Create(InParent, InArena) places the object in the pool of its type and
+ *  children created under it end up in the same arena, so a whole subtree
+ *  sits in a few contiguous pages. Objects are never deleted one by one,
+ *  they must not be pushed to a resource pool either. Clear() destroys them
+ *  all in reverse creation order, children before their parent, without
+ *  walking the tree. Children created in a constructor come before their
+ *  parent is in the arena, they are bound and deleted by it as usual. Not
+ *  thread safe, a subtree is built by one thread.
+ */
+class ResourceArena
+{
+
+public:
+
+	/**
+	 *  @param  InObjectsPerPage  objects of one type allocated at once.
+	 */
+	explicit ResourceArena(uint32 InObjectsPerPage = DefaultObjectsPerPage);
+	~ResourceArena();
+
+	ResourceArena(const ResourceArena&) = delete;
+	ResourceArena& operator=(const ResourceArena&) = delete;
+
+	/**
+	 *  Storage for one object of type T, to construct with placement new and hand to Adopt().
+	 *  nullptr if a new page could not be allocated.
+	 */
+	template<typename T>
+	void* Allocate() { return Allocate(GetTypeIndex<T>(), sizeof(T), alignof(T)); }
+
+	/**
+	 *  Take over an object constructed in storage from Allocate().
+	 */
+	void Adopt(IResourceHandler* InObject);
+
+	/**
+	 *  Destroy every object, the pages are kept for the next subtree.
+	 */
+	void Clear();
+
+	uint32 GetObjectCount() const;
+
+	/**
+	 *  @return bytes reserved by the pages of every type.
+	 */
+	usize GetReservedBytes() const;
+
+public:
+
+	static constexpr uint32 DefaultObjectsPerPage = 256;
+
+private:
+
+	struct TypePool
+	{
+		usize              Stride     = 0;
+		usize              Alignment  = 0;
+		std::vector<void*> Pages;                   ///< Raw malloc blocks, aligned inside.
+		usize              Used       = 0;          ///< Objects taken across all pages.
+	};
+
+	void* Allocate(uint32 InTypeIndex, usize InSize, usize InAlignment);
+
+	template<typename T>
+	static uint32 GetTypeIndex()
+	{
+		static const uint32 typeIndex = s_typeCount++;
+		return typeIndex;
+	}
+
+private:
+
+	uint32                             m_objectsPerPage;
+	std::vector<TypePool>              m_pools;            ///< Indexed by GetTypeIndex().
+	std::vector<IResourceHandler*>     m_objects;          ///< Creation order.
+
+	static std::atomic<uint32>         s_typeCount;
+};
@@ -5,21 +5,134 @@
 
 #include "ResourcePool.h"
 #include "Interface/IResourceHandler.h"
+#include "Core/Utilities/Log/LogSystem.h"
+#include <atomic>
 #include <mutex>
+#include <unordered_map>
 
 namespace
 {
-    ResourcePool* g_resourcePool;
+    std::atomic<ResourcePool*> g_resourcePool(nullptr);
 
-    std::mutex g_respRead;
-    std::mutex g_respWrite;
+    std::mutex g_respCreate;
 
-    struct InternalResource
+    // The top bits of a handle index select the shard, each thread pushes to its own shard.
+    const uint32 kShardBits  = 4;
+    const uint32 kShardCount = 1u << kShardBits;
+    const uint32 kShardShift = 32 - kShardBits;
+    const uint32 kSlotMask   = (1u << kShardShift) - 1;
+
+    struct alignas(64) Shard
+    {
+        std::mutex                               Mutex;         ///< Only contended by threads that share the shard.
+        SlotMap<IResourceHandler*>               CommonRefs;
+        SlotMap<VkOwnedObject>                   VkObjects;
+
+    }g_shards[kShardCount];
+
+    std::atomic<uint32> g_nextShard(0);
+
+    uint32 GetThreadShardIndex()
+    {
+        thread_local const uint32 shardIndex = g_nextShard.fetch_add(1, std::memory_order_relaxed) % kShardCount;
+        return shardIndex;
+    }
+
+    // A slot index that reaches into the shard bits would name another shard.
+    template<typename T>
+    bool FitsShard(SlotHandle<T> InHandle)
+    {
+        if (InHandle.Index <= kSlotMask)
+            return true;
+
+        _log_error(StringUtil::Printf("ResourcePool: a shard is full, % slots at most!", kSlotMask + 1), LogSystem::Category::Memory);
+        return false;
+    }
+
+    template<typename T>
+    SlotHandle<T> ToPoolHandle(SlotHandle<T> InHandle, uint32 InShardIndex)
+    {
+        InHandle.Index |= InShardIndex << kShardShift;
+        return InHandle;
+    }
+
+    template<typename T>
+    SlotHandle<T> ToShardHandle(SlotHandle<T> InHandle)
+    {
+        InHandle.Index &= kSlotMask;
+        return InHandle;
+    }
+
+    template<typename T>
+    Shard& GetShard(SlotHandle<T> InHandle)
+    {
+        return g_shards[InHandle.Index >> kShardShift];
+    }
+
+    // Default names are indexed by their interned type name and number, set names by themselves.
+    const uint32 kSetName = _numeric_max(uint32);
+
+    struct NameKey
+    {
+        const string* Name;
+        uint32        Index;
+
+        bool operator==(const NameKey& other) const
+        {
+            return Name == other.Name && Index == other.Index;
+        }
+    };
+
+    struct NameKeyHash
+    {
+        usize operator()(const NameKey& InKey) const
+        {
+            return std::hash<const void*>()(InKey.Name) ^ ((usize)InKey.Index * 0x9E3779B97F4A7C15ull);
+        }
+    };
+
+    struct alignas(64) NameShard
+    {
+        std::mutex                                                 Mutex;
+        std::unordered_map<NameKey, ResourceHandle, NameKeyHash>   Handles;
+
+    }g_nameShards[kShardCount];
+
+    NameShard& GetNameShard(const NameKey& InKey)
+    {
+        return g_nameShards[NameKeyHash()(InKey) % kShardCount];
+    }
+
+    ResourceHandle FindHandle(const NameKey& InKey)
+    {
+        NameShard& shard = GetNameShard(InKey);
+
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        auto handle = shard.Handles.find(InKey);
+        return handle != shard.Handles.end() ? handle->second : ResourceHandle();
+    }
+
+    void IndexName(const NameKey& InKey, ResourceHandle InHandle)
     {
-        std::vector<IResourceHandler*>           CommonRefs;
-        std::vector<VkSmartPtr<VkObjectHandler>> VkSmartRefs;
+        NameShard& shard = GetNameShard(InKey);
 
-    }g_resource;
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        shard.Handles[InKey] = InHandle;
+    }
+
+    void UnindexName(const NameKey& InKey, ResourceHandle InHandle)
+    {
+        NameShard& shard = GetNameShard(InKey);
+
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        // The name may have been taken over by a later push.
+        auto handle = shard.Handles.find(InKey);
+        if (handle != shard.Handles.end() && handle->second == InHandle)
+            shard.Handles.erase(handle);
+    }
 
     class ResourcePoolHandler
     {
@@ -27,14 +140,10 @@ namespace
 
         void Free()
         {
-            std::unique_lock<std::mutex> lock_r(g_respRead);
-            std::unique_lock<std::mutex> lock_w(g_respWrite);
-
-            if (g_resourcePool != nullptr)
-            {
-                delete g_resourcePool;
-                g_resourcePool = nullptr;
-            }
+            std::unique_lock<std::mutex> lock(g_respCreate);
+
+            ResourcePool* pResourcePool = g_resourcePool.exchange(nullptr);
+            _safe_delete(pResourcePool);
         }
 
         ~ResourcePoolHandler()
@@ -46,48 +155,226 @@ namespace
 
 ResourcePool::~ResourcePool()
 {
-    for (auto& ref : g_resource.CommonRefs)
-        if (ref != nullptr)
+    ReleaseAll();
+}
+
+ResourcePool* ResourcePool::Get()
+{
+    ResourcePool* pResourcePool = g_resourcePool.load(std::memory_order_acquire);
+    if (pResourcePool != nullptr)
+        return pResourcePool;
+
+    std::unique_lock<std::mutex> lock(g_respCreate);
+
+    pResourcePool = g_resourcePool.load(std::memory_order_relaxed);
+    if (pResourcePool == nullptr)
+    {
+        pResourcePool = new ResourcePool;
+        g_resourcePool.store(pResourcePool, std::memory_order_release);
+    }
+
+    return pResourcePool;
+}
+
+ResourceHandle ResourcePool::Push(IResourceHandler* InRef)
+{
+    const uint32 shardIndex = GetThreadShardIndex();
+    Shard& shard = g_shards[shardIndex];
+
+    ResourceHandle handle;
+    {
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        handle = shard.CommonRefs.Insert(InRef);
+        if (!FitsShard(handle))
         {
-            delete ref;
-            ref = nullptr;
+            shard.CommonRefs.Remove(handle);
+            return ResourceHandle();
         }
+
+        handle = ToPoolHandle(handle, shardIndex);
+    }
+
+    NameKey key;
+    GetNameKey(InRef, key.Name, key.Index);
+    IndexName(key, handle);
+
+    return handle;
 }
 
-ResourcePool*& ResourcePool::Get()
+VkObjectHandle ResourcePool::PushObject(VkOwnedObject&& InObject)
 {
-    std::unique_lock<std::mutex> lock_w(g_respWrite);
+    const uint32 shardIndex = GetThreadShardIndex();
+    Shard& shard = g_shards[shardIndex];
 
-    if (g_resourcePool == nullptr)
-        g_resourcePool = new ResourcePool;
+    std::unique_lock<std::mutex> lock(shard.Mutex);
 
-    return g_resourcePool;
+    VkObjectHandle handle = shard.VkObjects.Insert(std::move(InObject));
+    if (!FitsShard(handle))
+    {
+        shard.VkObjects.Remove(handle);
+        return VkObjectHandle();
+    }
+
+    return ToPoolHandle(handle, shardIndex);
 }
 
-void ResourcePool::Push(IResourceHandler* InRef)
+IResourceHandler* ResourcePool::Get(ResourceHandle InHandle) const
 {
-    std::unique_lock<std::mutex> lock_r(g_respRead);
-    std::unique_lock<std::mutex> lock_w(g_respWrite);
+    Shard& shard = GetShard(InHandle);
+
+    std::unique_lock<std::mutex> lock(shard.Mutex);
 
-    g_resource.CommonRefs.push_back(InRef);
+    IResourceHandler* const* ppRef = shard.CommonRefs.Get(ToShardHandle(InHandle));
+    return ppRef != nullptr ? *ppRef : nullptr;
 }
 
-void ResourcePool::Push(VkSmartPtr<VkObjectHandler> InRef)
+VkObjectHandler ResourcePool::Get(VkObjectHandle InHandle) const
 {
-    std::unique_lock<std::mutex> lock_r(g_respRead);
-    std::unique_lock<std::mutex> lock_w(g_respWrite);
+    Shard& shard = GetShard(InHandle);
 
-    g_resource.VkSmartRefs.push_back(InRef);
+    std::unique_lock<std::mutex> lock(shard.Mutex);
+
+    const VkOwnedObject* pObject = shard.VkObjects.Get(ToShardHandle(InHandle));
+    return pObject != nullptr ? pObject->Get() : VK_NULL_HANDLE;
 }
 
-void LocalResourcePool::Push(IResourceHandler* InRef)
+bool ResourcePool::Release(ResourceHandle InHandle)
 {
-    m_resource.CommonRefs.push_back(InRef);
+    Shard& shard = GetShard(InHandle);
+
+    IResourceHandler* pRef = nullptr;
+    {
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        IResourceHandler** ppRef = shard.CommonRefs.Get(ToShardHandle(InHandle));
+        if (ppRef == nullptr)
+            return false;
+
+        pRef = *ppRef;
+        shard.CommonRefs.Remove(ToShardHandle(InHandle));
+    }
+
+    NameKey key;
+    GetNameKey(pRef, key.Name, key.Index);
+    UnindexName(key, InHandle);
+
+    // The resource may push or release its own children.
+    _safe_delete(pRef);
+
+    return true;
 }
 
-void LocalResourcePool::Push(VkSmartPtr<VkObjectHandler> InRef)
+bool ResourcePool::Release(VkObjectHandle InHandle)
 {
-    m_resource.VkSmartRefs.push_back(InRef);
+    Shard& shard = GetShard(InHandle);
+
+    VkOwnedObject object;
+    {
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        VkOwnedObject* pObject = shard.VkObjects.Get(ToShardHandle(InHandle));
+        if (pObject == nullptr)
+            return false;
+
+        object = std::move(*pObject);
+        shard.VkObjects.Remove(ToShardHandle(InHandle));
+    }
+
+    return true;
+}
+
+void ResourcePool::ReleaseAll()
+{
+    std::vector<IResourceHandler*> refs;
+    std::vector<VkOwnedObject>     objects;
+
+    // Empty the shards first, deleted resources may still release what they pushed.
+    for (auto& shard : g_shards)
+    {
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+
+        refs.insert(refs.end(), shard.CommonRefs.begin(), shard.CommonRefs.end());
+        shard.CommonRefs.Clear();
+
+        for (auto& object : shard.VkObjects)
+            objects.push_back(std::move(object));
+        shard.VkObjects.Clear();
+    }
+
+    for (auto& shard : g_nameShards)
+    {
+        std::unique_lock<std::mutex> lock(shard.Mutex);
+        shard.Handles.clear();
+    }
+
+    for (auto& ref : refs)
+        _safe_delete(ref);
+
+    // Resources first, like IResourceHandler does with its children.
+    objects.clear();
+}
+
+IResourceHandler* ResourcePool::Find(const string& InName) const
+{
+    NameKey key = { NameTable::Find(InName), kSetName };
+
+    // Set names are interned as they are.
+    if (key.Name != nullptr)
+        if (IResourceHandler* pRef = FindByKey(key.Name, key.Index))
+            return pRef;
+
+    // Default names are "<type>_<index>", the type name was interned by Create().
+    const usize separator = InName.rfind('_');
+    const usize digits    = InName.size() - separator - 1;
+
+    if (separator == string::npos || digits == 0 || digits > 10 || InName.find_first_not_of("0123456789", separator + 1) != string::npos)
+        return nullptr;
+
+    const uint64 index = std::strtoull(InName.c_str() + separator + 1, nullptr, 10);
+    if (index >= kSetName)
+        return nullptr;
+
+    key.Name  = NameTable::Find(InName.substr(0, separator));
+    key.Index = (uint32)index;
+
+    return key.Name != nullptr ? FindByKey(key.Name, key.Index) : nullptr;
+}
+
+IResourceHandler* ResourcePool::FindByKey(const string* InName, uint32 InIndex) const
+{
+    const ResourceHandle handle = FindHandle({ InName, InIndex });
+    if (handle.IsNull())
+        return nullptr;
+
+    IResourceHandler* pRef = Get(handle);
+    if (pRef == nullptr)
+        return nullptr;
+
+    // Renamed after it was pushed.
+    NameKey key;
+    GetNameKey(pRef, key.Name, key.Index);
+
+    return key.Name == InName && key.Index == InIndex ? pRef : nullptr;
+}
+
+void ResourcePool::GetNameKey(const IResourceHandler* InRef, const string*& OutName, uint32& OutIndex)
+{
+    if (InRef->m_pTypeName != nullptr)
+    {
+        OutName  = InRef->m_pTypeName;
+        OutIndex = InRef->m_nameIndex;
+    }
+    else
+    {
+        OutName  = &InRef->GetName();
+        OutIndex = kSetName;
+    }
+}
+
+ResourceHandle LocalResourcePool::Push(IResourceHandler* InRef)
+{
+    return m_resource.CommonRefs.Insert(InRef);
 }
 
 void LocalResourcePool::Free()
@@ -98,6 +385,9 @@ void LocalResourcePool::Free()
             delete ref;
             ref = nullptr;
         }
+
+    m_resource.CommonRefs.Clear();
+    m_resource.VkObjects.Clear();
 }
 
 LocalResourcePool::~LocalResourcePool()
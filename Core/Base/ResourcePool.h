@@ -7,10 +7,22 @@
 
 #pragma once
 
+#include "Core/Base/ScratchArena.h"
+#include "Core/Utilities/Containers/SlotMap.h"
 #include "Core/Utilities/SmartPtr/VkSmartPtr.h"
 
 class IResourceHandler;
 
+using ResourceHandle = SlotHandle<IResourceHandler*>;
+using VkObjectHandle = SlotHandle<VkOwnedObject>;
+
+/**
+ *  Resources and vulkan objects live in slot maps, the handles given back by
+ *  Push() stay valid until the matching Release() and go stale after it.
+ *  The slot maps are split in shards and each thread pushes to its own, a
+ *  handle remembers its shard so any thread can release it. Resources are
+ *  also indexed by name when pushed, without formatting default names.
+ */
 class ResourcePool
 {
 private:
@@ -22,27 +34,87 @@ public:
     ~ResourcePool();
 
     /**
-     *  Get or create resouce pool instance.
+     *  Get or create resouce pool instance, without locking once it exists.
      * 
      *  @return resource pool instance.
      */
-    static ResourcePool*& Get();
+    static ResourcePool* Get();
 
     /**
      *  Add a new resource into pool.
      * 
      *  @param  InRef  the resource reference to add.
+     * 
+     *  @return handle of the resource in the pool, a null handle if the shard of the thread is full, InRef stays with the caller then.
      */
-    void Push(IResourceHandler* InRef);
+    ResourceHandle Push(IResourceHandler* InRef);
 
     /**
-     *  Add a new vulkan object smart pointer into pool.
+     *  Add a new vulkan object into pool, InRef and its copies no longer destroy it.
      * 
      *  @param  InRef  the vulkan object to add.
+     * 
+     *  @return handle of the object in the pool, a null handle if the shard of the thread is full, the object is destroyed then.
+     */
+    template<typename T>
+    VkObjectHandle Push(VkSmartPtr<T>& InRef) { return PushObject(InRef.Detach()); }
+
+    /**
+     *  @return the resource, nullptr if it was released.
+     */
+    IResourceHandler* Get(ResourceHandle InHandle) const;
+
+    /**
+     *  @return the vulkan object, VK_NULL_HANDLE if it was released.
+     */
+    VkObjectHandler Get(VkObjectHandle InHandle) const;
+
+    /**
+     *  Find a resource by the name it had when it was pushed, in O(1).
+     * 
+     *  @param  InName  a name given by SetName(), or a default "<type>_<index>" one.
+     * 
+     *  @return the resource, nullptr if no resource in the pool has that name.
+     */
+    IResourceHandler* Find(const string& InName) const;
+
+    /**
+     *  Delete a resource before the pool goes.
+     * 
+     *  @return false if the handle is stale.
+     */
+    bool Release(ResourceHandle InHandle);
+
+    /**
+     *  Destroy a vulkan object before the pool goes.
+     * 
+     *  @return false if the handle is stale.
+     */
+    bool Release(VkObjectHandle InHandle);
+
+    /**
+     *  Delete every resource, then destroy every vulkan object. Shards go one
+     *  after the other, inside a shard the order is the order of Push() as long
+     *  as nothing was released.
+     */
+    void ReleaseAll();
+
+private:
+
+    VkObjectHandle PushObject(VkOwnedObject&& InObject);
+
+    IResourceHandler* FindByKey(const string* InName, uint32 InIndex) const;
+
+    /**
+     *  Default names give their type name and number, set names themselves and _numeric_max(uint32).
      */
-    void Push(VkSmartPtr<VkObjectHandler> InRef);
+    static void GetNameKey(const IResourceHandler* InRef, const string*& OutName, uint32& OutIndex);
 };
 
+/**
+ *  Resources for the length of one creation call, kept in the scratch arena
+ *  of the thread. It has to be destroyed before the enclosing ScratchScope.
+ */
 class LocalResourcePool
 {
 public:
@@ -52,17 +124,18 @@ public:
      *
      *  @param  InRef  the resource reference to add.
      */
-    void Push(IResourceHandler* InRef);
+    ResourceHandle Push(IResourceHandler* InRef);
 
     /**
-     *  Add a new vulkan object smart pointer into pool.
+     *  Add a new vulkan object into pool, InRef and its copies no longer destroy it.
      *
      *  @param  InRef  the vulkan object to add.
      */
-    void Push(VkSmartPtr<VkObjectHandler> InRef);
+    template<typename T>
+    VkObjectHandle Push(VkSmartPtr<T>& InRef) { return m_resource.VkObjects.Insert(InRef.Detach()); }
 
     /**
-     *  Free Current Loacl ResourcePool.
+     *  Free Current Loacl ResourcePool, resources first then vulkan objects.
      */
     void Free();
 
@@ -72,8 +145,8 @@ private:
 
     struct InternalResource
     {
-        std::vector<IResourceHandler*>           CommonRefs;    ///< Cache common resource references.
-        std::vector<VkSmartPtr<VkObjectHandler>> VkSmartRefs;   ///< Cache vulkan smart object references.
+        SlotMap<IResourceHandler*, ScratchAllocator>   CommonRefs;    ///< Cache common resource references.
+        SlotMap<VkOwnedObject, ScratchAllocator>       VkObjects;     ///< Cache vulkan objects.
 
     }m_resource;
 };
@@ -0,0 +1,114 @@
+﻿/*********************************************************************
+ *  ScratchArena.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "ScratchArena.h"
+#include "Core/Utilities/Math/Align.h"
+
+ScratchArena::ScratchArena() :
+	m_currentChunk    (_index_0),
+	m_chunkAllocCount (_count_0)
+{}
+
+ScratchArena::~ScratchArena()
+{
+	for (auto& chunk : m_chunks)
+		free(chunk.Data);
+
+	m_chunks.clear();
+}
+
+ScratchArena& ScratchArena::Get()
+{
+	thread_local ScratchArena arena;
+	return arena;
+}
+
+void* ScratchArena::Allocate(usize InSize, usize InAlignment)
+{
+	if (InSize == 0)
+		return nullptr;
+
+	for (; m_currentChunk < m_chunks.size(); ++m_currentChunk)
+	{
+		Chunk& chunk = m_chunks[m_currentChunk];
+
+		usize user = Math::AlignUp((usize)(chunk.Data + chunk.Used), InAlignment);
+
+		if (user + InSize <= (usize)(chunk.Data + chunk.Capacity))
+		{
+			chunk.Used = (usize)(user + InSize - (usize)chunk.Data);
+
+			return (void*)user;
+		}
+
+		// The next chunk starts empty, a rewind below this one may still need it.
+		if (m_currentChunk + 1 < m_chunks.size())
+			m_chunks[m_currentChunk + 1].Used = 0;
+	}
+
+	Chunk chunk;
+	chunk.Capacity = std::max(ChunkSize, InSize + InAlignment);
+	chunk.Data     = (uint8*)malloc(chunk.Capacity);
+	chunk.Used     = 0;
+
+	if (chunk.Data == nullptr)
+		return nullptr;
+
+	usize user = Math::AlignUp((usize)chunk.Data, InAlignment);
+	chunk.Used = (usize)(user + InSize - (usize)chunk.Data);
+
+	m_currentChunk = m_chunks.size();
+	m_chunks.push_back(chunk);
+	m_chunkAllocCount++;
+
+	return (void*)user;
+}
+
+void ScratchArena::Free(void* InMemory, usize InSize)
+{
+	if (InMemory == nullptr || m_currentChunk >= m_chunks.size())
+		return;
+
+	Chunk& chunk = m_chunks[m_currentChunk];
+
+	if ((uint8*)InMemory + InSize == chunk.Data + chunk.Used)
+		chunk.Used = (usize)((uint8*)InMemory - chunk.Data);
+}
+
+ScratchArena::Marker ScratchArena::GetMarker() const
+{
+	if (m_chunks.empty())
+		return { _index_0, _count_0 };
+
+	return { m_currentChunk, m_chunks[m_currentChunk].Used };
+}
+
+void ScratchArena::Rewind(const Marker& InMarker)
+{
+	if (m_chunks.empty())
+		return;
+
+	m_currentChunk = InMarker.ChunkIndex;
+	m_chunks[m_currentChunk].Used = InMarker.Used;
+}
+
+ScratchArena::Stats ScratchArena::GetStats() const
+{
+	Stats stats = {};
+
+	for (usize chunkIndex = 0; chunkIndex < m_chunks.size(); ++chunkIndex)
+	{
+		stats.ReservedBytes += m_chunks[chunkIndex].Capacity;
+
+		if (chunkIndex < m_currentChunk)
+			stats.UsedBytes += m_chunks[chunkIndex].Capacity;
+		else if (chunkIndex == m_currentChunk)
+			stats.UsedBytes += m_chunks[chunkIndex].Used;
+	}
+
+	stats.ChunkAllocCount = m_chunkAllocCount;
+
+	return stats;
+}
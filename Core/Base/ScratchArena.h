@@ -0,0 +1,151 @@
+﻿/*********************************************************************
+ *  ScratchArena.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Per thread stack allocator for short lived temporaries.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/TypeDef.h"
+#include <unordered_map>
+#include <vector>
+
+/**
+ *  Allocations bump a pointer inside chunks that are kept for the lifetime
+ *  of the thread, so once warmed up temporaries never reach the heap. Memory
+ *  comes back in bulk by rewinding to a marker, Free() only gives back the
+ *  most recent allocation, which lets a growing container reuse its old
+ *  space. Use it through ScratchScope and the scratch containers.
+ */
+class ScratchArena
+{
+
+public:
+
+	struct Marker
+	{
+		usize ChunkIndex;
+		usize Used;
+	};
+
+	struct Stats
+	{
+		usize ReservedBytes;      ///< Bytes held by the chunks.
+		usize UsedBytes;          ///< Bytes below the current top, chunk padding included.
+		usize ChunkAllocCount;    ///< Heap allocations made for chunks, stops growing once warmed up.
+	};
+
+	ScratchArena();
+	~ScratchArena();
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	/**
+	 *  @return the arena of the calling thread.
+	 */
+	static ScratchArena& Get();
+
+	void* Allocate(usize InSize, usize InAlignment);
+
+	/**
+	 *  Give back the most recent allocation, anything else waits for Rewind().
+	 */
+	void Free(void* InMemory, usize InSize);
+
+	Marker GetMarker() const;
+
+	/**
+	 *  Release everything allocated after InMarker, the chunks are kept.
+	 */
+	void Rewind(const Marker& InMarker);
+
+	Stats GetStats() const;
+
+public:
+
+	static constexpr usize ChunkSize = 256 * 1024;
+
+private:
+
+	struct Chunk
+	{
+		uint8* Data;
+		usize  Capacity;
+		usize  Used;
+	};
+
+	std::vector<Chunk> m_chunks;
+	usize              m_currentChunk;
+	usize              m_chunkAllocCount;
+};
+
+/**
+ *  Rewind the scratch arena of the thread when the scope ends. Scratch
+ *  containers created after it have to be gone by then, declare it first.
+ */
+class ScratchScope
+{
+
+public:
+
+	ScratchScope() :
+		m_arena  (ScratchArena::Get()),
+		m_marker (m_arena.GetMarker())
+	{}
+
+	~ScratchScope()
+	{
+		m_arena.Rewind(m_marker);
+	}
+
+	ScratchScope(const ScratchScope&) = delete;
+	ScratchScope& operator=(const ScratchScope&) = delete;
+
+private:
+
+	ScratchArena&        m_arena;
+	ScratchArena::Marker m_marker;
+};
+
+/**
+ *  Standard allocator drawing from the scratch arena of the calling thread.
+ *  It has no state, so containers of containers can be resized without
+ *  passing it along, but a container must stay on the thread that filled it.
+ */
+template<typename T>
+class ScratchAllocator
+{
+
+public:
+
+	using value_type = T;
+
+	ScratchAllocator() = default;
+
+	template<typename U>
+	ScratchAllocator(const ScratchAllocator<U>&) {}
+
+	T* allocate(usize InCount)
+	{
+		return (T*)ScratchArena::Get().Allocate(InCount * sizeof(T), alignof(T));
+	}
+
+	void deallocate(T* InMemory, usize InCount)
+	{
+		ScratchArena::Get().Free(InMemory, InCount * sizeof(T));
+	}
+
+	template<typename U>
+	bool operator==(const ScratchAllocator<U>&) const { return true; }
+
+	template<typename U>
+	bool operator!=(const ScratchAllocator<U>&) const { return false; }
+};
+
+template<typename T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+template<typename TKey, typename TValue>
+using ScratchUnorderedMap = std::unordered_map<TKey, TValue, std::hash<TKey>, std::equal_to<TKey>, ScratchAllocator<std::pair<const TKey, TValue>>>;
@@ -0,0 +1,333 @@
+﻿/*********************************************************************
+ *  ThreadCacheAllocator.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "ThreadCacheAllocator.h"
+#include "Core/Utilities/Math/Align.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	struct ThreadHeapSlot
+	{
+		uint64 AllocatorId;
+		void*  Heap;
+	};
+
+	constexpr usize NumThreadHeapSlots = 4;
+
+	// Most processes only have one host allocator alive, a few slots are enough.
+	thread_local ThreadHeapSlot t_heapSlots[NumThreadHeapSlots] = {};
+
+	std::atomic<uint64> g_nextAllocatorId { 1 };
+
+	inline usize FloorLog2(usize InValue)
+	{
+#if defined(_MSC_VER)
+		unsigned long index = 0;
+#if defined(_WIN64)
+		_BitScanReverse64(&index, InValue);
+#else
+		_BitScanReverse(&index, InValue);
+#endif
+		return (usize)index;
+#else
+		return (usize)(63 - __builtin_clzll((unsigned long long)InValue));
+#endif
+	}
+
+	inline void* FindThreadHeap(uint64 InAllocatorId)
+	{
+		for (auto& slot : t_heapSlots)
+		{
+			if (slot.AllocatorId == InAllocatorId)
+				return slot.Heap;
+		}
+
+		return nullptr;
+	}
+}
+
+ThreadCacheAllocator::ThreadCacheAllocator() :
+	m_id             (g_nextAllocatorId.fetch_add(1)),
+	m_pageBytes      (_count_0),
+	m_largeLiveBytes (_count_0)
+{
+	static_assert(sizeof(BlockHeader) <= HeaderSize, "BlockHeader must fit in HeaderSize.");
+}
+
+ThreadCacheAllocator::~ThreadCacheAllocator()
+{
+	std::unique_lock<std::mutex> lock(m_heapsMutex);
+
+	for (auto& heap : m_heaps)
+	{
+		for (auto& page : heap->Pages)
+			free(page);
+
+		delete heap;
+	}
+
+	m_heaps.clear();
+}
+
+ThreadCacheAllocator::Stats ThreadCacheAllocator::GetStats() const
+{
+	Stats stats = {};
+
+	{
+		std::unique_lock<std::mutex> lock(m_heapsMutex);
+		stats.ThreadHeapCount = m_heaps.size();
+	}
+
+	stats.PageBytes      = m_pageBytes.load(std::memory_order_relaxed);
+	stats.LargeLiveBytes = m_largeLiveBytes.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+void* ThreadCacheAllocator::Allocation(usize size, usize alignment, VkSystemAllocationScope allocationScope)
+{
+	if (size == 0)
+		return nullptr;
+
+	// Class blocks are 16 bytes aligned, extra space is reserved for larger alignments.
+	const usize align    = std::max(alignment, HeaderSize);
+	const usize required = size + HeaderSize + (align - HeaderSize);
+
+	if (required > MaxClassSize)
+		return AllocateLarge(size, align);
+
+	const usize classIndex = GetClassIndex(required);
+	ThreadHeap* heap       = GetThreadHeap();
+
+	uint8* raw = (uint8*)AllocateFromClass(heap, classIndex);
+	if (raw == nullptr)
+		return nullptr;
+
+	void* memory = PlaceHeader(raw, align, (uint32)classIndex);
+	GetHeader(memory)->Owner = heap;
+
+	return memory;
+}
+
+void* ThreadCacheAllocator::Reallocation(void* pOriginal, usize size, usize alignment, VkSystemAllocationScope allocationScope)
+{
+	if (pOriginal == nullptr)
+		return Allocation(size, alignment, allocationScope);
+
+	if (size == 0)
+	{
+		Free(pOriginal);
+		return nullptr;
+	}
+
+	const usize usable = GetUsableSize(GetHeader(pOriginal));
+
+	// Growing inside the class slack or shrinking keeps the block.
+	if (size <= usable && ((usize)pOriginal & (alignment - 1)) == 0)
+		return pOriginal;
+
+	void* memory = Allocation(size, alignment, allocationScope);
+
+	// On failure the original allocation must stay untouched.
+	if (memory == nullptr)
+		return nullptr;
+
+	std::memcpy(memory, pOriginal, std::min(usable, size));
+	Free(pOriginal);
+
+	return memory;
+}
+
+void ThreadCacheAllocator::Free(void* pMemory)
+{
+	if (pMemory == nullptr)
+		return;
+
+	BlockHeader* header = GetHeader(pMemory);
+	uint8*       raw    = (uint8*)pMemory - header->Offset;
+
+	if (header->Class == LargeClass)
+	{
+		m_largeLiveBytes.fetch_sub((usize)header->Size, std::memory_order_relaxed);
+		free(raw);
+		return;
+	}
+
+	// The free node may overlap the header, read it first.
+	ThreadHeap*        owner = header->Owner;
+	SizeClassMagazine& mag   = owner->Magazines[header->Class];
+	FreeNode*          node  = (FreeNode*)raw;
+
+	if (FindThreadHeap(m_id) == owner)
+	{
+		node->Next    = mag.LocalFree;
+		mag.LocalFree = node;
+	}
+	else
+	{
+		// Only the owner drains this list, and it takes the whole list at once, so no ABA.
+		FreeNode* head = mag.RemoteFree.load(std::memory_order_relaxed);
+		do
+		{
+			node->Next = head;
+		} while (!mag.RemoteFree.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+	}
+}
+
+void ThreadCacheAllocator::InternalAllocation(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	// Notification only, the driver owns this memory.
+}
+
+void ThreadCacheAllocator::InternalFree(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	// Notification only, the driver owns this memory.
+}
+
+ThreadCacheAllocator::ThreadHeap* ThreadCacheAllocator::GetThreadHeap()
+{
+	if (void* heap = FindThreadHeap(m_id))
+		return (ThreadHeap*)heap;
+
+	ThreadHeap* heap = AcquireThreadHeap();
+
+	// Prefer an empty slot, otherwise evict by id. An evicted heap is found again by AcquireThreadHeap().
+	ThreadHeapSlot* target = &t_heapSlots[m_id % NumThreadHeapSlots];
+	for (auto& slot : t_heapSlots)
+	{
+		if (slot.Heap == nullptr)
+		{
+			target = &slot;
+			break;
+		}
+	}
+
+	target->AllocatorId = m_id;
+	target->Heap        = heap;
+
+	return heap;
+}
+
+ThreadCacheAllocator::ThreadHeap* ThreadCacheAllocator::AcquireThreadHeap()
+{
+	const std::thread::id threadId = std::this_thread::get_id();
+
+	std::unique_lock<std::mutex> lock(m_heapsMutex);
+
+	for (auto& heap : m_heaps)
+	{
+		if (heap->OwnerThread == threadId)
+			return heap;
+	}
+
+	ThreadHeap* heap  = new ThreadHeap;
+	heap->OwnerThread = threadId;
+	m_heaps.push_back(heap);
+
+	return heap;
+}
+
+void* ThreadCacheAllocator::AllocateFromClass(ThreadHeap* InHeap, usize InClassIndex)
+{
+	SizeClassMagazine& mag = InHeap->Magazines[InClassIndex];
+
+	// Collect everything other threads gave back since the last time.
+	if (mag.LocalFree == nullptr)
+		mag.LocalFree = mag.RemoteFree.exchange(nullptr, std::memory_order_acquire);
+
+	if (FreeNode* node = mag.LocalFree)
+	{
+		mag.LocalFree = node->Next;
+		return node;
+	}
+
+	const usize classSize = GetClassSize(InClassIndex);
+
+	// Carve lazily from the current page, a new page only costs one system allocation.
+	if (mag.BumpBegin == nullptr || (usize)(mag.BumpEnd - mag.BumpBegin) < classSize)
+	{
+		uint8* page = (uint8*)malloc(PageSize);
+		if (page == nullptr)
+			return nullptr;
+
+		InHeap->Pages.push_back(page);
+		m_pageBytes.fetch_add(PageSize, std::memory_order_relaxed);
+
+		mag.BumpBegin = page;
+		mag.BumpEnd   = page + PageSize;
+	}
+
+	void* block    = mag.BumpBegin;
+	mag.BumpBegin += classSize;
+
+	return block;
+}
+
+void* ThreadCacheAllocator::AllocateLarge(usize InSize, usize InAlignment)
+{
+	uint8* raw = (uint8*)malloc(InSize + HeaderSize + InAlignment);
+	if (raw == nullptr)
+		return nullptr;
+
+	m_largeLiveBytes.fetch_add(InSize, std::memory_order_relaxed);
+
+	void* memory = PlaceHeader(raw, InAlignment, LargeClass);
+	GetHeader(memory)->Size = InSize;
+
+	return memory;
+}
+
+usize ThreadCacheAllocator::GetUsableSize(const BlockHeader* InHeader) const
+{
+	if (InHeader->Class == LargeClass)
+		return (usize)InHeader->Size;
+
+	return GetClassSize(InHeader->Class) - InHeader->Offset;
+}
+
+ThreadCacheAllocator::BlockHeader* ThreadCacheAllocator::GetHeader(void* InMemory)
+{
+	return (BlockHeader*)((uint8*)InMemory - HeaderSize);
+}
+
+void* ThreadCacheAllocator::PlaceHeader(uint8* InRawBlock, usize InAlignment, uint32 InClass)
+{
+	uint8* user = (uint8*)Math::AlignUp((usize)InRawBlock + HeaderSize, InAlignment);
+
+	BlockHeader* header = GetHeader(user);
+	header->Offset = (uint32)(user - InRawBlock);
+	header->Class  = InClass;
+
+	return user;
+}
+
+usize ThreadCacheAllocator::GetClassIndex(usize InSize)
+{
+	// 16, 32, 48, 64 are linear.
+	if (InSize <= MinClassSize * NumSubClasses)
+		return InSize == 0 ? _index_0 : (InSize - 1) / MinClassSize;
+
+	// InSize is in (2^fl, 2^(fl + 1)], split in NumSubClasses steps.
+	const usize fl   = FloorLog2(InSize - 1);
+	const usize step = (usize)1 << (fl - 2);
+	const usize sl   = (InSize - ((usize)1 << fl) - 1) / step;
+
+	return NumSubClasses + (fl - 6) * NumSubClasses + sl;
+}
+
+usize ThreadCacheAllocator::GetClassSize(usize InClassIndex)
+{
+	if (InClassIndex < NumSubClasses)
+		return MinClassSize * (InClassIndex + 1);
+
+	const usize fl = 6 + (InClassIndex - NumSubClasses) / NumSubClasses;
+	const usize sl = (InClassIndex - NumSubClasses) % NumSubClasses;
+
+	return ((usize)1 << fl) + (sl + 1) * ((usize)1 << (fl - 2));
+}
@@ -0,0 +1,141 @@
+﻿/*********************************************************************
+ *  ThreadCacheAllocator.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Segregated size class allocator with per-thread magazines.
+ *********************************************************************/
+
+#pragma once
+
+#include "BaseAllocator.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/**
+ *  Size classes are indexed in two levels like TLSF: the first level is the
+ *  power of two of the size, the second level splits it in four linear steps.
+ *  Every thread owns a heap with one magazine (free list) per class, so small
+ *  allocations and frees from the owning thread never take a lock. Blocks
+ *  freed by another thread are pushed onto the owner's lock-free remote list
+ *  and collected the next time the owner runs dry. Large blocks go straight
+ *  to the system heap.
+ * 
+ *  A thread heap lives until the allocator is destroyed, a thread that reuses
+ *  the id of an exited thread adopts its heap.
+ */
+class ThreadCacheAllocator : public BaseAllocator
+{
+
+public:
+
+	ThreadCacheAllocator();
+	virtual ~ThreadCacheAllocator();
+
+public:
+
+	struct Stats
+	{
+		usize ThreadHeapCount;     ///< Threads that have allocated through this allocator.
+		usize PageBytes;           ///< Bytes reserved by size class pages.
+		usize LargeLiveBytes;      ///< Bytes alive in blocks bigger than the largest class.
+	};
+
+	Stats GetStats() const;
+
+public:
+
+	static constexpr usize MinClassSize    = 16;
+	static constexpr usize MaxClassSize    = 32 * 1024;
+	static constexpr usize NumSubClasses   = 4;
+	static constexpr usize NumClasses      = 40;            ///< 16 ... 32K, see GetClassSize().
+	static constexpr usize PageSize        = 64 * 1024;
+
+private:
+
+	struct FreeNode
+	{
+		FreeNode* Next;
+	};
+
+	struct SizeClassMagazine
+	{
+		FreeNode*              LocalFree  = nullptr;   ///< Only touched by the owner thread.
+		std::atomic<FreeNode*> RemoteFree { nullptr }; ///< Pushed by other threads, drained by the owner.
+		uint8*                 BumpBegin  = nullptr;   ///< Uncarved part of the current page.
+		uint8*                 BumpEnd    = nullptr;
+	};
+
+	struct ThreadHeap
+	{
+		SizeClassMagazine  Magazines[NumClasses];
+		std::vector<void*> Pages;
+		std::thread::id    OwnerThread;
+	};
+
+	struct BlockHeader
+	{
+		union
+		{
+			ThreadHeap* Owner;     ///< Owning heap of a size class block.
+			uint64      Size;      ///< Requested size of a large block.
+		};
+		uint32 Offset;             ///< Distance from the raw block start to the user pointer.
+		uint32 Class;              ///< Size class index, or LargeClass.
+	};
+
+	static constexpr usize  HeaderSize = 16;
+	static constexpr uint32 LargeClass = _numeric_max(uint32);
+
+private:
+
+	virtual void* Allocation(usize size, usize alignment, VkSystemAllocationScope allocationScope) override;
+
+	virtual void* Reallocation(void* pOriginal, usize size, usize alignment, VkSystemAllocationScope allocationScope) override;
+
+	virtual void  Free(void* pMemory) override;
+
+	virtual void  InternalAllocation(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) override;
+
+	virtual void  InternalFree(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) override;
+
+private:
+
+	/**
+	 *  Find the heap of the calling thread, creating it on first use.
+	 */
+	ThreadHeap* GetThreadHeap();
+
+	/**
+	 *  Slow path of GetThreadHeap(), takes the registry lock once per thread.
+	 */
+	ThreadHeap* AcquireThreadHeap();
+
+	void* AllocateFromClass(ThreadHeap* InHeap, usize InClassIndex);
+
+	void* AllocateLarge(usize InSize, usize InAlignment);
+
+	usize GetUsableSize(const BlockHeader* InHeader) const;
+
+	static BlockHeader* GetHeader(void* InMemory);
+	static void*        PlaceHeader(uint8* InRawBlock, usize InAlignment, uint32 InClass);
+
+public:
+
+	/**
+	 *  O(1) size to class index mapping, rounding up.
+	 */
+	static usize GetClassIndex(usize InSize);
+
+	static usize GetClassSize(usize InClassIndex);
+
+private:
+
+	const uint64              m_id;              ///< Distinguishes allocator instances in thread local caches.
+
+	mutable std::mutex        m_heapsMutex;      ///< Only taken when a thread creates its heap.
+	std::vector<ThreadHeap*>  m_heaps;
+
+	std::atomic<usize>        m_pageBytes;
+	std::atomic<usize>        m_largeLiveBytes;
+};
@@ -0,0 +1,290 @@
+﻿/*********************************************************************
+ *  TrackedAllocator.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "TrackedAllocator.h"
+#include "Core/Utilities/Math/Align.h"
+
+namespace
+{
+	const char* g_scopeNames[TrackedAllocator::NumScopes] =
+	{
+		"Command",
+		"Object",
+		"Cache",
+		"Device",
+		"Instance"
+	};
+
+	const char* g_internalTypeNames[TrackedAllocator::NumInternalTypes] =
+	{
+		"Executable"
+	};
+
+	inline usize GetHistogramBucket(usize InSize)
+	{
+		usize bucket = _index_0;
+		while ((InSize >>= 1) != 0 && bucket < TrackedAllocator::NumHistogramBuckets - 1)
+			++bucket;
+
+		return bucket;
+	}
+
+	inline double ToKB(uint64 InBytes)
+	{
+		return (double)InBytes / 1024.0;
+	}
+}
+
+TrackedAllocator::TrackedAllocator(BaseAllocator* InAllocator) :
+	m_pInnerAllocator (InAllocator),
+	m_pInnerCallbacks (InAllocator->GetVkAllocator()),
+	m_dumpInterval    (_count_0),
+	m_frameCounter    (_count_0)
+{
+	static_assert(sizeof(BlockHeader) <= HeaderSize, "BlockHeader must fit in HeaderSize.");
+}
+
+TrackedAllocator::~TrackedAllocator()
+{
+	// Whatever is still alive here has been leaked by the driver or the engine.
+	if (GetTotalLiveBytes() != 0)
+		Dump();
+
+	_safe_delete(m_pInnerAllocator);
+}
+
+void TrackedAllocator::NextFrame()
+{
+	m_pInnerAllocator->NextFrame();
+
+	const uint32 interval = m_dumpInterval.load(std::memory_order_relaxed);
+	if (interval != 0 && (m_frameCounter.fetch_add(1, std::memory_order_relaxed) + 1) % interval == 0)
+		Dump();
+}
+
+TrackedAllocator::ScopeStats TrackedAllocator::GetScopeStats(VkSystemAllocationScope InScope) const
+{
+	const AtomicScopeStats& source = m_scopeStats[GetScopeIndex(InScope)];
+
+	ScopeStats stats;
+	stats.LiveBytes    = source.LiveBytes.load(std::memory_order_relaxed);
+	stats.PeakBytes    = source.PeakBytes.load(std::memory_order_relaxed);
+	stats.AllocCount   = source.AllocCount.load(std::memory_order_relaxed);
+	stats.ReallocCount = source.ReallocCount.load(std::memory_order_relaxed);
+	stats.FreeCount    = source.FreeCount.load(std::memory_order_relaxed);
+
+	for (usize i = 0; i < NumHistogramBuckets; ++i)
+		stats.Histogram[i] = source.Histogram[i].load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+TrackedAllocator::InternalStats TrackedAllocator::GetInternalStats(VkInternalAllocationType InType, VkSystemAllocationScope InScope) const
+{
+	const AtomicInternalStats& source = m_internalStats[std::min((usize)InType, NumInternalTypes - 1)][GetScopeIndex(InScope)];
+
+	InternalStats stats;
+	stats.LiveBytes  = source.LiveBytes.load(std::memory_order_relaxed);
+	stats.PeakBytes  = source.PeakBytes.load(std::memory_order_relaxed);
+	stats.AllocCount = source.AllocCount.load(std::memory_order_relaxed);
+	stats.FreeCount  = source.FreeCount.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+uint64 TrackedAllocator::GetTotalLiveBytes() const
+{
+	uint64 total = 0;
+	for (auto& stats : m_scopeStats)
+		total += stats.LiveBytes.load(std::memory_order_relaxed);
+
+	return total;
+}
+
+BaseAllocator* TrackedAllocator::GetInnerAllocator() const
+{
+	return m_pInnerAllocator;
+}
+
+void TrackedAllocator::SetDumpInterval(uint32 InFrames)
+{
+	m_dumpInterval.store(InFrames, std::memory_order_relaxed);
+}
+
+void TrackedAllocator::Dump() const
+{
+	_log_common(StringUtil::Printf("Host memory: % KB live in total.", ToKB(GetTotalLiveBytes())), LogSystem::Category::Memory);
+
+	for (usize scope = 0; scope < NumScopes; ++scope)
+	{
+		ScopeStats stats = GetScopeStats((VkSystemAllocationScope)scope);
+		if (stats.AllocCount == 0)
+			continue;
+
+		_log_common(StringUtil::Printf("Host memory [%]: live % KB, peak % KB, alloc %, realloc %, free %.",
+			g_scopeNames[scope], ToKB(stats.LiveBytes), ToKB(stats.PeakBytes), stats.AllocCount, stats.ReallocCount, stats.FreeCount), LogSystem::Category::Memory);
+
+		string histogram;
+		for (usize i = 0; i < NumHistogramBuckets; ++i)
+		{
+			if (stats.Histogram[i] != 0)
+				histogram += StringUtil::Printf(" [%B]=%", (uint64)1 << i, stats.Histogram[i]);
+		}
+
+		_log_common(StringUtil::Printf("Host memory [%] sizes:%", g_scopeNames[scope], histogram), LogSystem::Category::Memory);
+	}
+
+	for (usize type = 0; type < NumInternalTypes; ++type)
+	{
+		for (usize scope = 0; scope < NumScopes; ++scope)
+		{
+			InternalStats stats = GetInternalStats((VkInternalAllocationType)type, (VkSystemAllocationScope)scope);
+			if (stats.AllocCount == 0)
+				continue;
+
+			_log_common(StringUtil::Printf("Host memory [%/%]: live % KB, peak % KB, alloc %, free %.",
+				g_internalTypeNames[type], g_scopeNames[scope], ToKB(stats.LiveBytes), ToKB(stats.PeakBytes), stats.AllocCount, stats.FreeCount), LogSystem::Category::Memory);
+		}
+	}
+}
+
+void* TrackedAllocator::Allocation(usize size, usize alignment, VkSystemAllocationScope allocationScope)
+{
+	if (size == 0)
+		return nullptr;
+
+	// The header sits right before the user pointer, keep the requested alignment behind it.
+	const usize offset = Math::AlignUp(HeaderSize, std::max(alignment, HeaderSize));
+
+	uint8* raw = (uint8*)m_pInnerCallbacks->pfnAllocation(m_pInnerCallbacks->pUserData, size + offset, std::max(alignment, HeaderSize), allocationScope);
+	if (raw == nullptr)
+		return nullptr;
+
+	uint8*       memory = raw + offset;
+	BlockHeader* header = GetHeader(memory);
+	header->Size   = size;
+	header->Scope  = (uint32)GetScopeIndex(allocationScope);
+	header->Offset = (uint32)offset;
+
+	RecordAdd(allocationScope, size);
+	m_scopeStats[header->Scope].AllocCount.fetch_add(1, std::memory_order_relaxed);
+
+	return memory;
+}
+
+void* TrackedAllocator::Reallocation(void* pOriginal, usize size, usize alignment, VkSystemAllocationScope allocationScope)
+{
+	if (pOriginal == nullptr)
+		return Allocation(size, alignment, allocationScope);
+
+	if (size == 0)
+	{
+		Free(pOriginal);
+		return nullptr;
+	}
+
+	BlockHeader* header = GetHeader(pOriginal);
+
+	const usize                   offset   = header->Offset;
+	const usize                   oldSize  = (usize)header->Size;
+	const VkSystemAllocationScope oldScope = (VkSystemAllocationScope)header->Scope;
+
+	// The inner block has to keep the same offset, otherwise move it by hand.
+	if (Math::AlignUp(HeaderSize, std::max(alignment, HeaderSize)) != offset)
+	{
+		void* memory = Allocation(size, alignment, allocationScope);
+		if (memory == nullptr)
+			return nullptr;
+
+		std::memcpy(memory, pOriginal, std::min(oldSize, size));
+		Free(pOriginal);
+
+		return memory;
+	}
+
+	uint8* raw = (uint8*)m_pInnerCallbacks->pfnReallocation(m_pInnerCallbacks->pUserData, (uint8*)pOriginal - offset, size + offset, std::max(alignment, HeaderSize), allocationScope);
+	if (raw == nullptr)
+		return nullptr;
+
+	uint8* memory = raw + offset;
+	header        = GetHeader(memory);
+	header->Size  = size;
+	header->Scope = (uint32)GetScopeIndex(allocationScope);
+
+	RecordRemove(oldScope, oldSize);
+	RecordAdd(allocationScope, size);
+	m_scopeStats[header->Scope].ReallocCount.fetch_add(1, std::memory_order_relaxed);
+
+	return memory;
+}
+
+void TrackedAllocator::Free(void* pMemory)
+{
+	if (pMemory == nullptr)
+		return;
+
+	BlockHeader* header = GetHeader(pMemory);
+	const auto   scope  = (VkSystemAllocationScope)header->Scope;
+
+	RecordRemove(scope, (usize)header->Size);
+	m_scopeStats[header->Scope].FreeCount.fetch_add(1, std::memory_order_relaxed);
+
+	m_pInnerCallbacks->pfnFree(m_pInnerCallbacks->pUserData, (uint8*)pMemory - header->Offset);
+}
+
+void TrackedAllocator::InternalAllocation(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	AtomicInternalStats& stats = m_internalStats[std::min((usize)allocationType, NumInternalTypes - 1)][GetScopeIndex(allocationScope)];
+
+	const uint64 live = stats.LiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	UpdatePeak(stats.PeakBytes, live);
+	stats.AllocCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (m_pInnerCallbacks->pfnInternalAllocation != nullptr)
+		m_pInnerCallbacks->pfnInternalAllocation(m_pInnerCallbacks->pUserData, size, allocationType, allocationScope);
+}
+
+void TrackedAllocator::InternalFree(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope)
+{
+	AtomicInternalStats& stats = m_internalStats[std::min((usize)allocationType, NumInternalTypes - 1)][GetScopeIndex(allocationScope)];
+
+	stats.LiveBytes.fetch_sub(size, std::memory_order_relaxed);
+	stats.FreeCount.fetch_add(1, std::memory_order_relaxed);
+
+	if (m_pInnerCallbacks->pfnInternalFree != nullptr)
+		m_pInnerCallbacks->pfnInternalFree(m_pInnerCallbacks->pUserData, size, allocationType, allocationScope);
+}
+
+void TrackedAllocator::RecordAdd(VkSystemAllocationScope InScope, usize InSize)
+{
+	AtomicScopeStats& stats = m_scopeStats[GetScopeIndex(InScope)];
+
+	const uint64 live = stats.LiveBytes.fetch_add(InSize, std::memory_order_relaxed) + InSize;
+	UpdatePeak(stats.PeakBytes, live);
+	stats.Histogram[GetHistogramBucket(InSize)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void TrackedAllocator::RecordRemove(VkSystemAllocationScope InScope, usize InSize)
+{
+	m_scopeStats[GetScopeIndex(InScope)].LiveBytes.fetch_sub(InSize, std::memory_order_relaxed);
+}
+
+TrackedAllocator::BlockHeader* TrackedAllocator::GetHeader(void* InMemory)
+{
+	return (BlockHeader*)((uint8*)InMemory - HeaderSize);
+}
+
+usize TrackedAllocator::GetScopeIndex(VkSystemAllocationScope InScope)
+{
+	return std::min((usize)InScope, NumScopes - 1);
+}
+
+void TrackedAllocator::UpdatePeak(std::atomic<uint64>& InPeak, uint64 InValue)
+{
+	uint64 peak = InPeak.load(std::memory_order_relaxed);
+	while (InValue > peak && !InPeak.compare_exchange_weak(peak, InValue, std::memory_order_relaxed))
+	{
+	}
+}
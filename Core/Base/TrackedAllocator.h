@@ -0,0 +1,142 @@
+﻿/*********************************************************************
+ *  TrackedAllocator.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Host allocation telemetry layered on top of any BaseAllocator.
+ *********************************************************************/
+
+#pragma once
+
+#include "BaseAllocator.h"
+#include <atomic>
+
+/**
+ *  Forwards every callback to the wrapped allocator and records, per
+ *  VkSystemAllocationScope, live/peak bytes, alloc/realloc/free counts and a
+ *  log2 size histogram. Internal (driver-owned) allocation notifications are
+ *  recorded per VkInternalAllocationType and scope. All counters are relaxed
+ *  atomics, so tracking can stay enabled in release builds.
+ */
+class TrackedAllocator : public BaseAllocator
+{
+
+public:
+
+	/**
+	 *  @param  InAllocator  the allocator to forward to, owned and deleted by this wrapper.
+	 */
+	TrackedAllocator(BaseAllocator* InAllocator);
+	virtual ~TrackedAllocator();
+
+	virtual void NextFrame() override;
+
+public:
+
+	static constexpr usize NumScopes           = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+	static constexpr usize NumInternalTypes    = VK_INTERNAL_ALLOCATION_TYPE_EXECUTABLE + 1;
+	static constexpr usize NumHistogramBuckets = 32;   ///< Bucket i counts sizes in [2^i, 2^(i+1)).
+
+	struct ScopeStats
+	{
+		uint64 LiveBytes;
+		uint64 PeakBytes;
+		uint64 AllocCount;
+		uint64 ReallocCount;
+		uint64 FreeCount;
+		uint64 Histogram[NumHistogramBuckets];
+	};
+
+	struct InternalStats
+	{
+		uint64 LiveBytes;
+		uint64 PeakBytes;
+		uint64 AllocCount;
+		uint64 FreeCount;
+	};
+
+	/**
+	 *  Snapshot the counters of a scope. Counters are read one by one, so the
+	 *  snapshot may be torn while other threads allocate.
+	 */
+	ScopeStats GetScopeStats(VkSystemAllocationScope InScope) const;
+
+	InternalStats GetInternalStats(VkInternalAllocationType InType, VkSystemAllocationScope InScope) const;
+
+	/**
+	 *  Sum of live bytes over all scopes, internal allocations excluded.
+	 */
+	uint64 GetTotalLiveBytes() const;
+
+	BaseAllocator* GetInnerAllocator() const;
+
+	/**
+	 *  Dump every NextFrame() call count, 0 disables the periodic dump.
+	 */
+	void SetDumpInterval(uint32 InFrames);
+
+	/**
+	 *  Write all non-empty counters to LogSystem.
+	 */
+	void Dump() const;
+
+private:
+
+	struct AtomicScopeStats
+	{
+		std::atomic<uint64> LiveBytes    { 0 };
+		std::atomic<uint64> PeakBytes    { 0 };
+		std::atomic<uint64> AllocCount   { 0 };
+		std::atomic<uint64> ReallocCount { 0 };
+		std::atomic<uint64> FreeCount    { 0 };
+		std::atomic<uint64> Histogram[NumHistogramBuckets] = {};
+	};
+
+	struct AtomicInternalStats
+	{
+		std::atomic<uint64> LiveBytes    { 0 };
+		std::atomic<uint64> PeakBytes    { 0 };
+		std::atomic<uint64> AllocCount   { 0 };
+		std::atomic<uint64> FreeCount    { 0 };
+	};
+
+	struct BlockHeader
+	{
+		uint64 Size;       ///< Requested size in bytes.
+		uint32 Scope;      ///< VkSystemAllocationScope of the request.
+		uint32 Offset;     ///< Distance from the inner block start to the user pointer.
+	};
+
+	static constexpr usize HeaderSize = 16;
+
+private:
+
+	virtual void* Allocation(usize size, usize alignment, VkSystemAllocationScope allocationScope) override;
+
+	virtual void* Reallocation(void* pOriginal, usize size, usize alignment, VkSystemAllocationScope allocationScope) override;
+
+	virtual void  Free(void* pMemory) override;
+
+	virtual void  InternalAllocation(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) override;
+
+	virtual void  InternalFree(usize size, VkInternalAllocationType allocationType, VkSystemAllocationScope allocationScope) override;
+
+private:
+
+	void RecordAdd(VkSystemAllocationScope InScope, usize InSize);
+	void RecordRemove(VkSystemAllocationScope InScope, usize InSize);
+
+	static BlockHeader* GetHeader(void* InMemory);
+	static usize        GetScopeIndex(VkSystemAllocationScope InScope);
+	static void         UpdatePeak(std::atomic<uint64>& InPeak, uint64 InValue);
+
+private:
+
+	BaseAllocator*               m_pInnerAllocator;
+	const VkAllocationCallbacks* m_pInnerCallbacks;
+
+	AtomicScopeStats             m_scopeStats[NumScopes];
+	AtomicInternalStats          m_internalStats[NumInternalTypes][NumScopes];
+
+	std::atomic<uint32>          m_dumpInterval;
+	std::atomic<uint32>          m_frameCounter;
+};
@@ -6,6 +6,10 @@
 #include "Engine.h"
 #include "Core/Base/ResourcePool.h"
 #include "Core/Base/BaseLayer.h"
+#include "Core/Base/BaseAllocator.h"
+#include "Core/Render/RenderBase/CommandQueue.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/Memory/DeviceMemoryAllocator.h"
 #include "Core/Platform/Windows/Window.h"
 #include "Core/Scene/Scene.h"
 #include <mutex>
@@ -111,6 +115,17 @@ void Engine::Tick()
     {
         g_data.pScene->Update(g_data.gameTimer);
         g_data.pScene->Render(g_data.gameTimer);
+
+        // Recycle the transient host allocations of this frame.
+        if (BaseAllocator* pAllocator = g_data.pBaseLayer->GetBaseAllocator())
+            pAllocator->NextFrame();
+
+        // Follow the heap budgets, streaming systems get asked to back off here.
+        g_data.pBaseLayer->GetLogicalDevice()->GetMemAllocator()->Update();
+
+        // Objects released this frame go once the GPU is past everything submitted so far.
+        LogicalDevice* pDevice = g_data.pBaseLayer->GetLogicalDevice();
+        pDevice->GetDeviceContext()->NextFrame(pDevice->GetCommandQueue()->SignalFrameFence());
     });
 }
 
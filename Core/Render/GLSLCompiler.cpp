@@ -4,12 +4,33 @@
  *********************************************************************/
 
 #include "GLSLCompiler.h"
+#include "ShaderCache.h"
 
 _impl_create_interface(GLSLCompiler)
 
 GLSLCompiler::GLSLCompiler()
 {
-	m_pModule = ModuleLoader::Create(this);
+
+}
+
+GLSLCompiler::~GLSLCompiler()
+{
+    FlushSPVData();
+
+    if (m_pCompiler != nullptr)
+        m_pCompiler->Close();
+}
+
+bool GLSLCompiler::LoadModule()
+{
+    if (m_pCompiler != nullptr)
+        return true;
+
+    // Loading failed before.
+    if (m_pModule != nullptr)
+        return false;
+
+    m_pModule = ModuleLoader::Create(this);
 
     if (m_pModule->Load(Path(StringUtil::Printf("Tools/Binaries/GLSLCompiler/%/GLSLCompiler.dll", _platform))))
     {
@@ -21,27 +42,46 @@ GLSLCompiler::GLSLCompiler()
             if (m_pCompiler != nullptr) m_pCompiler->Init();
         }
     }
+
+    return m_pCompiler != nullptr;
 }
 
-GLSLCompiler::~GLSLCompiler()
+bool GLSLCompiler::IsCached(const SPVData* InSPVData) const
 {
-    if (m_pCompiler != nullptr)
+    for (auto& pEntry : m_cachedEntries)
     {
-        for (auto& pSPVData : m_pSPVData)
-        {
-            if (pSPVData != nullptr)
-                m_pCompiler->Free(pSPVData);
-        }
-
-        m_pCompiler->Close();
+        if (&pEntry->Data == InSPVData)
+            return true;
     }
+
+    return false;
 }
 
 void GLSLCompiler::CompileShader(VkShaderStageFlags InStageType, const Path& InShaderPath, const CompileInfo* InCompileInfo)
 {
-    if (m_pCompiler != nullptr)
+    ShaderCache& cache = ShaderCache::Get();
+
+    const uint64 key = cache.ComputeKey(InStageType, InShaderPath, *InCompileInfo);
+
+    if (key != 0)
+    {
+        std::unique_ptr<ShaderCacheEntry> pEntry(new ShaderCacheEntry());
+
+        if (cache.Load(key, *pEntry))
+        {
+            m_pSPVData.push_back(&pEntry->Data);
+            m_cachedEntries.push_back(std::move(pEntry));
+            return;
+        }
+    }
+
+    if (LoadModule())
     {
-        m_pSPVData.push_back(m_pCompiler->CompileFromPath(InStageType, InShaderPath.ToCString(), InCompileInfo));
+        SPVData* pSPVData = m_pCompiler->CompileFromPath(InStageType, InShaderPath.ToCString(), InCompileInfo);
+        m_pSPVData.push_back(pSPVData);
+
+        if (key != 0 && pSPVData != nullptr)
+            cache.Store(key, *pSPVData);
     }
     else
     {
@@ -171,16 +211,15 @@ bool GLSLCompiler::CheckAndParseSPVData(uint32 InMaxDescSets, std::vector<VkPush
 
 void GLSLCompiler::FlushSPVData()
 {
-    if (m_pCompiler != nullptr)
+    // Only a loaded DLL hands out data that is not cached.
+    for (auto& pSPVData : m_pSPVData)
     {
-        for (auto& pSPVData : m_pSPVData)
-        {
-            if (pSPVData != nullptr)
-                m_pCompiler->Free(pSPVData);
-        }
-
-        m_pSPVData.clear();
+        if (pSPVData != nullptr && !IsCached(pSPVData))
+            m_pCompiler->Free(pSPVData);
     }
+
+    m_pSPVData.clear();
+    m_cachedEntries.clear();
 }
 
 bool GLSLCompiler::HasValidSPVData()
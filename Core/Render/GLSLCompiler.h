@@ -10,6 +10,7 @@
 #include "Core/Common.h"
 
 class ModuleLoader;
+struct ShaderCacheEntry;
 
 class GLSLCompiler : public IResourceHandler
 {
@@ -125,10 +126,18 @@ private:
 
     GLSLCompiler();
 
-    ModuleLoader*                                     m_pModule;
+    /**
+     *  The DLL is loaded on the first compile the ShaderCache can not serve.
+     */
+    bool LoadModule();
+
+    bool IsCached(const SPVData* InSPVData) const;
+
+    ModuleLoader*                                     m_pModule    = nullptr;
 
     PFGetGLSLCompilerInterface                        m_pInterface = nullptr;
     GLSLCompilerInterface*                            m_pCompiler  = nullptr;
 
     std::vector<SPVData*>                             m_pSPVData;
+    std::vector<std::unique_ptr<ShaderCacheEntry>>    m_cachedEntries;   ///< Hits in m_pSPVData, the DLL does not free them.
 };
@@ -0,0 +1,137 @@
+﻿/*********************************************************************
+ *  DefragPlanner.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "DefragPlanner.h"
+
+DefragPlanner::DefragPlanner(VkDeviceSize InByteBudget, uint32 InMaxMoves) :
+	m_byteBudget (InByteBudget),
+	m_maxMoves   (InMaxMoves)
+{
+
+}
+
+VkDeviceSize DefragPlanner::Plan(const std::vector<Block>& InBlocks, std::vector<Move>& OutMoves) const
+{
+	OutMoves.clear();
+
+	if (InBlocks.size() < 2)
+		return 0;
+
+	std::vector<MemorySubAllocator::Stats> stats(InBlocks.size());
+	std::vector<uint32>                    order(InBlocks.size());
+
+	for (uint32 blockIndex = 0; blockIndex < (uint32)InBlocks.size(); ++blockIndex)
+	{
+		stats[blockIndex] = InBlocks[blockIndex].pSubAllocator->GetStats();
+		order[blockIndex] = blockIndex;
+	}
+
+	std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b) { return stats[a].ReservedBytes < stats[b].ReservedBytes; });
+
+	// Take the sparsest blocks as sources while the others can still take in what they hold.
+	VkDeviceSize freeBytes = 0;
+	for (auto& blockStats : stats)
+	{
+		if (blockStats.AllocationCount != 0)
+			freeBytes += blockStats.Capacity - blockStats.ReservedBytes;
+	}
+
+	std::vector<bool>   bIsSource(InBlocks.size(), false);
+	std::vector<uint32> sources;
+	VkDeviceSize        sourceBytes = 0;
+
+	for (uint32 i = 0; i + 1 < (uint32)order.size(); ++i)
+	{
+		const MemorySubAllocator::Stats& blockStats = stats[order[i]];
+		if (blockStats.AllocationCount == 0 || InBlocks[order[i]].Items.empty())
+			continue;
+
+		const VkDeviceSize remainingFree = freeBytes - (blockStats.Capacity - blockStats.ReservedBytes);
+		if (sourceBytes + blockStats.ReservedBytes > remainingFree)
+			break;
+
+		sourceBytes += blockStats.ReservedBytes;
+		freeBytes    = remainingFree;
+
+		bIsSource[order[i]] = true;
+		sources.push_back(order[i]);
+	}
+
+	if (sources.empty())
+		return 0;
+
+	// Pack into the fullest blocks first, an empty block is better left for release.
+	std::vector<uint32> destinations;
+	for (auto it = order.rbegin(); it != order.rend(); ++it)
+	{
+		if (!bIsSource[*it] && stats[*it].AllocationCount != 0)
+			destinations.push_back(*it);
+	}
+
+	VkDeviceSize plannedBytes = 0;
+
+	for (auto& sourceIndex : sources)
+	{
+		std::vector<const Item*> items;
+		for (auto& item : InBlocks[sourceIndex].Items)
+			items.push_back(&item);
+
+		// Big items first, they are the hardest to place once the destinations fill up.
+		std::sort(items.begin(), items.end(), [](const Item* a, const Item* b) { return a->Size > b->Size; });
+
+		for (auto& item : items)
+		{
+			if (OutMoves.size() >= m_maxMoves)
+				return plannedBytes;
+
+			if (plannedBytes + item->Size > m_byteBudget)
+				continue;
+
+			for (auto& destIndex : destinations)
+			{
+				VkDeviceSize offset = _offset_0;
+				if (InBlocks[destIndex].pSubAllocator->Allocate(item->Size, item->Alignment, item->Tiling, offset))
+				{
+					Move move;
+					move.Id        = item->Id;
+					move.SrcBlock  = sourceIndex;
+					move.SrcOffset = item->Offset;
+					move.DstBlock  = destIndex;
+					move.DstOffset = offset;
+					move.Size      = item->Size;
+
+					OutMoves.push_back(move);
+					plannedBytes += item->Size;
+					break;
+				}
+			}
+		}
+	}
+
+	return plannedBytes;
+}
+
+DefragPlanner::Report DefragPlanner::Measure(const std::vector<Block>& InBlocks)
+{
+	Report report = {};
+
+	VkDeviceSize largestFreeSum = 0;
+
+	for (auto& block : InBlocks)
+	{
+		MemorySubAllocator::Stats stats = block.pSubAllocator->GetStats();
+		if (stats.AllocationCount == 0)
+			continue;
+
+		report.OccupiedBlockCount++;
+		report.UsedBytes += stats.UsedBytes;
+		report.FreeBytes += stats.Capacity - stats.ReservedBytes;
+		largestFreeSum   += stats.LargestFreeRange;
+	}
+
+	report.Fragmentation = report.FreeBytes == 0 ? 0.0f : 1.0f - (float)((double)largestFreeSum / (double)report.FreeBytes);
+
+	return report;
+}
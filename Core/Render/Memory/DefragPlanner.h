@@ -0,0 +1,78 @@
+﻿/*********************************************************************
+ *  DefragPlanner.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Plans device memory moves that empty sparse blocks.
+ *********************************************************************/
+
+#pragma once
+
+#include "MemorySubAllocator.h"
+
+/**
+ *  Works on sub-allocators only, so it runs against real blocks and against a
+ *  simulated heap alike. Sparse blocks are drained into the fullest blocks
+ *  that still have room, as long as the drained bytes fit in the free space
+ *  of the others. Destination ranges are reserved by Plan(), source ranges
+ *  stay reserved until the caller frees them, once the GPU copies are done,
+ *  so a pass never writes over something it still reads.
+ */
+class DefragPlanner
+{
+
+public:
+
+	struct Item
+	{
+		uint64               Id;          ///< Opaque to the planner, handed back in Move.
+		VkDeviceSize         Offset;
+		VkDeviceSize         Size;
+		VkDeviceSize         Alignment;
+		DeviceResourceTiling Tiling;
+	};
+
+	struct Block
+	{
+		MemorySubAllocator*  pSubAllocator;
+		std::vector<Item>    Items;       ///< Movable allocations only.
+	};
+
+	struct Move
+	{
+		uint64               Id;
+		uint32               SrcBlock;
+		VkDeviceSize         SrcOffset;
+		uint32               DstBlock;
+		VkDeviceSize         DstOffset;
+		VkDeviceSize         Size;
+	};
+
+	struct Report
+	{
+		uint32               OccupiedBlockCount;
+		VkDeviceSize         UsedBytes;
+		VkDeviceSize         FreeBytes;       ///< Free bytes inside occupied blocks.
+		float                Fragmentation;   ///< 1 - sum of largest free ranges / FreeBytes, over occupied blocks.
+	};
+
+	/**
+	 *  @param  InByteBudget  bytes a single Plan() may move.
+	 *  @param  InMaxMoves    moves a single Plan() may produce.
+	 */
+	DefragPlanner(VkDeviceSize InByteBudget, uint32 InMaxMoves);
+
+	/**
+	 *  @param  InBlocks  blocks of one pool, indices are used in OutMoves.
+	 *  @param  OutMoves  planned moves, destinations already allocated.
+	 * 
+	 *  @return bytes planned to move.
+	 */
+	VkDeviceSize Plan(const std::vector<Block>& InBlocks, std::vector<Move>& OutMoves) const;
+
+	static Report Measure(const std::vector<Block>& InBlocks);
+
+private:
+
+	VkDeviceSize m_byteBudget;
+	uint32       m_maxMoves;
+};
@@ -0,0 +1,713 @@
+﻿/*********************************************************************
+ *  DeviceMemoryAllocator.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "DeviceMemoryAllocator.h"
+#include "DefragPlanner.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/CommandList.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/RenderBaseConfig.h"
+
+_impl_create_interface(DeviceMemoryAllocator)
+
+namespace
+{
+	inline VkDeviceSize FloorPow2(VkDeviceSize InValue)
+	{
+		VkDeviceSize pow2 = 1;
+		while ((pow2 << 1) != 0 && (pow2 << 1) <= InValue)
+			pow2 <<= 1;
+
+		return pow2;
+	}
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator() :
+	m_pBaseLayer      (nullptr),
+	m_device          (VK_NULL_HANDLE),
+	m_granularity     (_count_1),
+	m_blockCount      (_count_0),
+	m_dedicatedCount  (_count_0),
+	m_allocationCount (_count_0),
+	m_blockBytes      (_count_0),
+	m_usedBytes       (_count_0)
+{
+	_zero_memory_struct(m_memProps);
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+	if (m_allocationCount != 0)
+		_log_warning(StringUtil::Printf("%: % device allocations are still alive!", _name_of(DeviceMemoryAllocator), m_allocationCount), LogSystem::Category::Memory);
+
+	DefragStats stats = {};
+	RetireMoves(true, stats);
+
+	for (auto& pool : m_pools)
+	{
+		for (uint32 blockIndex = 0; blockIndex < (uint32)pool.Blocks.size(); ++blockIndex)
+			ReleaseBlock(pool, blockIndex);
+	}
+}
+
+void DeviceMemoryAllocator::Init(BaseLayer* InBaseLayer)
+{
+	m_pBaseLayer  = InBaseLayer;
+	m_device      = InBaseLayer->GetLogicalDevice()->GetVkDevice();
+	m_memProps    = InBaseLayer->GetMainPDMemProps();
+	m_granularity = std::max<VkDeviceSize>(InBaseLayer->GetMainPDLimits().bufferImageGranularity, 1);
+
+	m_budget.Init(m_memProps, InBaseLayer->GetMainPD(), InBaseLayer->IsPDExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+
+	m_pools.resize(VK_MAX_MEMORY_TYPES * Pool_Count);
+
+	for (uint32 memTypeIndex = 0; memTypeIndex < VK_MAX_MEMORY_TYPES; ++memTypeIndex)
+	{
+		for (uint32 kind = 0; kind < Pool_Count; ++kind)
+		{
+			MemoryPool& pool     = m_pools[memTypeIndex * Pool_Count + kind];
+			pool.MemoryTypeIndex = memTypeIndex;
+			pool.Kind            = (PoolKind)kind;
+			pool.BlockSize       = memTypeIndex < m_memProps.memoryTypeCount ? GetBlockSize(memTypeIndex, (PoolKind)kind) : 0;
+		}
+	}
+}
+
+DeviceAllocation* DeviceMemoryAllocator::Allocate(const VkMemoryRequirements& InMemRequirements, const AllocationInfo& InInfo)
+{
+	const uint32 memTypeIndex = m_pBaseLayer->GetHeapIndexFromMemPropFlags(InMemRequirements, InInfo.PreferredFlags, InInfo.RequiredFlags);
+	if (memTypeIndex >= m_memProps.memoryTypeCount)
+	{
+		_log_error(StringUtil::Printf("%: No memory type matches type bits %!", _name_of(Allocate), InMemRequirements.memoryTypeBits), LogSystem::Category::Memory);
+		return nullptr;
+	}
+
+	const PoolKind kind      = GetPoolKind(InInfo.Lifetime, InInfo.Tiling);
+	const uint32   poolIndex = memTypeIndex * Pool_Count + kind;
+
+	DeviceAllocation allocation;
+	allocation.MemoryTypeIndex = memTypeIndex;
+	allocation.Size            = InMemRequirements.size;
+	allocation.Buffer          = VK_NULL_HANDLE;
+	allocation.Image           = VK_NULL_HANDLE;
+	allocation.Alignment       = InMemRequirements.alignment;
+	allocation.Tiling          = InInfo.Tiling;
+	allocation.Lifetime        = InInfo.Lifetime;
+	allocation.PoolIndex       = poolIndex;
+
+	const uint32 heapIndex = m_memProps.memoryTypes[memTypeIndex].heapIndex;
+
+	// Give the eviction callbacks a chance before the heap runs out, the allocator lock is not held here.
+	if (m_budget.IsOverWatermark(heapIndex, InMemRequirements.size))
+		m_budget.Evict(heapIndex, InMemRequirements.size);
+
+	DeviceAllocation* pAllocation = AllocateLocked(InMemRequirements, allocation);
+
+	if (pAllocation == nullptr && m_budget.Evict(heapIndex, InMemRequirements.size) != 0)
+		pAllocation = AllocateLocked(InMemRequirements, allocation);
+
+	if (pAllocation == nullptr)
+		_log_error(StringUtil::Printf("%: Out of device memory, type %, size %!", _name_of(Allocate), memTypeIndex, InMemRequirements.size), LogSystem::Category::Memory);
+
+	return pAllocation;
+}
+
+DeviceAllocation* DeviceMemoryAllocator::AllocateLocked(const VkMemoryRequirements& InMemRequirements, const DeviceAllocation& InAllocation)
+{
+	DeviceAllocation allocation = InAllocation;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	MemoryPool& pool = m_pools[allocation.PoolIndex];
+
+	// Big resources would waste most of a block, give them their own memory.
+	bool bSucceeded = InMemRequirements.size > pool.BlockSize / 2 ?
+		AllocateDedicated(allocation.MemoryTypeIndex, InMemRequirements.size, allocation) :
+		AllocateFromPool(pool, InMemRequirements, allocation.Tiling, allocation);
+
+	if (!bSucceeded)
+		return nullptr;
+
+	m_allocationCount++;
+	m_usedBytes += allocation.Size;
+
+	DeviceAllocation* pAllocation = new DeviceAllocation(allocation);
+	LinkToBlock(pAllocation);
+
+	return pAllocation;
+}
+
+DeviceAllocation* DeviceMemoryAllocator::AllocateForBuffer(VkBuffer InBuffer, const AllocationInfo& InInfo)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, InBuffer, &memRequirements);
+
+	AllocationInfo info = InInfo;
+	info.Tiling = DeviceResourceTiling::Linear;
+
+	DeviceAllocation* allocation = Allocate(memRequirements, info);
+	if (allocation != nullptr)
+	{
+		_vk_try(vkBindBufferMemory(m_device, InBuffer, allocation->Memory, allocation->Offset));
+		allocation->Buffer = InBuffer;
+	}
+
+	return allocation;
+}
+
+DeviceAllocation* DeviceMemoryAllocator::AllocateForImage(VkImage InImage, const AllocationInfo& InInfo)
+{
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(m_device, InImage, &memRequirements);
+
+	DeviceAllocation* allocation = Allocate(memRequirements, InInfo);
+	if (allocation != nullptr)
+	{
+		_vk_try(vkBindImageMemory(m_device, InImage, allocation->Memory, allocation->Offset));
+		allocation->Image = InImage;
+	}
+
+	return allocation;
+}
+
+void DeviceMemoryAllocator::Free(DeviceAllocation* InAllocation)
+{
+	if (InAllocation == nullptr)
+		return;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (InAllocation->BlockIndex == InvalidIndex)
+		{
+			FreeDeviceMemory(InAllocation->MemoryTypeIndex, InAllocation->Memory, InAllocation->Size);
+			m_dedicatedCount--;
+		}
+		else
+		{
+			MemoryPool& pool = m_pools[InAllocation->PoolIndex];
+
+			UnlinkFromBlock(InAllocation);
+			pool.Blocks[InAllocation->BlockIndex].pSubAllocator->Free(InAllocation->Offset, InAllocation->Size);
+			TryReleaseEmptyBlock(pool, InAllocation->BlockIndex);
+		}
+
+		m_movableResources.erase(InAllocation);
+
+		m_allocationCount--;
+		m_usedBytes -= InAllocation->Size;
+	}
+
+	delete InAllocation;
+}
+
+DeviceMemoryAllocator::Stats DeviceMemoryAllocator::GetStats() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Stats stats;
+	stats.BlockCount      = m_blockCount;
+	stats.DedicatedCount  = m_dedicatedCount;
+	stats.AllocationCount = m_allocationCount;
+	stats.BlockBytes      = m_blockBytes;
+	stats.UsedBytes       = m_usedBytes;
+
+	return stats;
+}
+
+MemoryBudget* DeviceMemoryAllocator::GetBudget()
+{
+	return &m_budget;
+}
+
+void DeviceMemoryAllocator::Update()
+{
+	m_budget.Refresh();
+	m_budget.EvictOverWatermark();
+}
+
+bool DeviceMemoryAllocator::AllocateFromPool(MemoryPool& InPool, const VkMemoryRequirements& InMemRequirements, DeviceResourceTiling InTiling, DeviceAllocation& OutAllocation)
+{
+	const VkDeviceSize alignment = InMemRequirements.alignment;
+
+	VkDeviceSize offset = _offset_0;
+
+	for (uint32 blockIndex = 0; blockIndex < (uint32)InPool.Blocks.size(); ++blockIndex)
+	{
+		MemoryBlock& block = InPool.Blocks[blockIndex];
+
+		if (block.Memory != VK_NULL_HANDLE && block.pSubAllocator->Allocate(InMemRequirements.size, alignment, InTiling, offset))
+		{
+			OutAllocation.Memory     = block.Memory;
+			OutAllocation.Offset     = offset;
+			OutAllocation.BlockIndex = blockIndex;
+			OutAllocation.pMapped    = block.pMapped != nullptr ? (uint8*)block.pMapped + offset : nullptr;
+			return true;
+		}
+	}
+
+	uint32 blockIndex = InvalidIndex;
+	if (!CreateBlock(InPool, blockIndex))
+		return false;
+
+	MemoryBlock& block = InPool.Blocks[blockIndex];
+	if (!block.pSubAllocator->Allocate(InMemRequirements.size, alignment, InTiling, offset))
+		return false;
+
+	OutAllocation.Memory     = block.Memory;
+	OutAllocation.Offset     = offset;
+	OutAllocation.BlockIndex = blockIndex;
+	OutAllocation.pMapped    = block.pMapped != nullptr ? (uint8*)block.pMapped + offset : nullptr;
+
+	return true;
+}
+
+bool DeviceMemoryAllocator::AllocateDedicated(uint32 InMemTypeIndex, VkDeviceSize InSize, DeviceAllocation& OutAllocation)
+{
+	VkDeviceMemory memory  = VK_NULL_HANDLE;
+	void*          pMapped = nullptr;
+
+	if (!AllocateDeviceMemory(InMemTypeIndex, InSize, memory, pMapped))
+		return false;
+
+	OutAllocation.Memory     = memory;
+	OutAllocation.Offset     = _offset_0;
+	OutAllocation.BlockIndex = InvalidIndex;
+	OutAllocation.pMapped    = pMapped;
+
+	m_dedicatedCount++;
+
+	return true;
+}
+
+bool DeviceMemoryAllocator::CreateBlock(MemoryPool& InPool, uint32& OutBlockIndex)
+{
+	MemoryBlock block;
+	block.Memory  = VK_NULL_HANDLE;
+	block.pMapped = nullptr;
+
+	if (!AllocateDeviceMemory(InPool.MemoryTypeIndex, InPool.BlockSize, block.Memory, block.pMapped))
+		return false;
+
+	if (InPool.Kind == Pool_Transient)
+		block.pSubAllocator = new LinearSubAllocator(InPool.BlockSize, m_granularity);
+	else
+		block.pSubAllocator = new BuddySubAllocator(InPool.BlockSize, RenderBaseConfig::Memory::MinBuddyRangeSize);
+
+	// Reuse the slot of a released block first.
+	for (uint32 blockIndex = 0; blockIndex < (uint32)InPool.Blocks.size(); ++blockIndex)
+	{
+		if (InPool.Blocks[blockIndex].Memory == VK_NULL_HANDLE)
+		{
+			InPool.Blocks[blockIndex] = block;
+			OutBlockIndex = blockIndex;
+			m_blockCount++;
+			return true;
+		}
+	}
+
+	OutBlockIndex = (uint32)InPool.Blocks.size();
+	InPool.Blocks.push_back(block);
+	m_blockCount++;
+
+	return true;
+}
+
+bool DeviceMemoryAllocator::TryReleaseEmptyBlock(MemoryPool& InPool, uint32 InBlockIndex)
+{
+	if (!InPool.Blocks[InBlockIndex].pSubAllocator->IsEmpty())
+		return false;
+
+	// Keep one empty block around, so a resource recreated every frame does not hit the driver.
+	for (uint32 blockIndex = 0; blockIndex < (uint32)InPool.Blocks.size(); ++blockIndex)
+	{
+		if (blockIndex != InBlockIndex && InPool.Blocks[blockIndex].Memory != VK_NULL_HANDLE)
+		{
+			ReleaseBlock(InPool, InBlockIndex);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void DeviceMemoryAllocator::LinkToBlock(DeviceAllocation* InAllocation)
+{
+	if (InAllocation->BlockIndex == InvalidIndex)
+	{
+		InAllocation->SlotIndex = InvalidIndex;
+		return;
+	}
+
+	auto& allocations = m_pools[InAllocation->PoolIndex].Blocks[InAllocation->BlockIndex].Allocations;
+
+	InAllocation->SlotIndex = (uint32)allocations.size();
+	allocations.push_back(InAllocation);
+}
+
+void DeviceMemoryAllocator::UnlinkFromBlock(DeviceAllocation* InAllocation)
+{
+	if (InAllocation->BlockIndex == InvalidIndex)
+		return;
+
+	auto& allocations = m_pools[InAllocation->PoolIndex].Blocks[InAllocation->BlockIndex].Allocations;
+
+	allocations[InAllocation->SlotIndex]            = allocations.back();
+	allocations[InAllocation->SlotIndex]->SlotIndex = InAllocation->SlotIndex;
+	allocations.pop_back();
+
+	InAllocation->SlotIndex = InvalidIndex;
+}
+
+void DeviceMemoryAllocator::ReleaseBlock(MemoryPool& InPool, uint32 InBlockIndex)
+{
+	MemoryBlock& block = InPool.Blocks[InBlockIndex];
+	if (block.Memory == VK_NULL_HANDLE)
+		return;
+
+	FreeDeviceMemory(InPool.MemoryTypeIndex, block.Memory, block.pSubAllocator->GetCapacity());
+	_safe_delete(block.pSubAllocator);
+
+	block.Memory  = VK_NULL_HANDLE;
+	block.pMapped = nullptr;
+	block.Allocations.clear();
+
+	m_blockCount--;
+}
+
+bool DeviceMemoryAllocator::AllocateDeviceMemory(uint32 InMemTypeIndex, VkDeviceSize InSize, VkDeviceMemory& OutMemory, void*& OutMapped)
+{
+	VkMemoryAllocateInfo memAllocInfo = {};
+	memAllocInfo.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memAllocInfo.pNext           = nullptr;
+	memAllocInfo.allocationSize  = InSize;
+	memAllocInfo.memoryTypeIndex = InMemTypeIndex;
+
+	if (vkAllocateMemory(m_device, &memAllocInfo, m_pBaseLayer->GetVkAllocator(), &OutMemory) != VK_SUCCESS)
+	{
+		OutMemory = VK_NULL_HANDLE;
+		return false;
+	}
+
+	OutMapped = nullptr;
+	if (m_memProps.memoryTypes[InMemTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		_vk_try(vkMapMemory(m_device, OutMemory, _offset_0, VK_WHOLE_SIZE, _flag_none, &OutMapped));
+
+	m_blockBytes += InSize;
+	m_budget.RecordAllocation(m_memProps.memoryTypes[InMemTypeIndex].heapIndex, InSize);
+
+	return true;
+}
+
+void DeviceMemoryAllocator::FreeDeviceMemory(uint32 InMemTypeIndex, VkDeviceMemory InMemory, VkDeviceSize InSize)
+{
+	// Freeing implicitly unmaps.
+	vkFreeMemory(m_device, InMemory, m_pBaseLayer->GetVkAllocator());
+
+	m_blockBytes -= InSize;
+	m_budget.RecordFree(m_memProps.memoryTypes[InMemTypeIndex].heapIndex, InSize);
+}
+
+VkDeviceSize DeviceMemoryAllocator::GetBlockSize(uint32 InMemTypeIndex, PoolKind InKind) const
+{
+	const VkDeviceSize heapSize  = m_memProps.memoryHeaps[m_memProps.memoryTypes[InMemTypeIndex].heapIndex].size;
+	const VkDeviceSize blockSize = InKind == Pool_Transient ? RenderBaseConfig::Memory::TransientBlockSize : RenderBaseConfig::Memory::PersistentBlockSize;
+
+	// Small heaps such as the 256MB BAR window would be used up by a handful of blocks.
+	const VkDeviceSize heapLimit = FloorPow2(heapSize / RenderBaseConfig::Memory::HeapBlockFraction);
+
+	return std::max(std::min(blockSize, heapLimit), RenderBaseConfig::Memory::MinBlockSize);
+}
+
+DeviceMemoryAllocator::PoolKind DeviceMemoryAllocator::GetPoolKind(DeviceMemoryLifetime InLifetime, DeviceResourceTiling InTiling)
+{
+	if (InLifetime == DeviceMemoryLifetime::Transient)
+		return Pool_Transient;
+
+	return InTiling == DeviceResourceTiling::Linear ? Pool_PersistentLinear : Pool_PersistentOptimal;
+}
+
+#pragma region Defragmentation
+
+void DeviceMemoryAllocator::RegisterMovableBuffer(DeviceAllocation* InAllocation, const VkBufferCreateInfo& InCreateInfo)
+{
+	if (InAllocation->BlockIndex == InvalidIndex || InCreateInfo.sharingMode != VK_SHARING_MODE_EXCLUSIVE)
+		return;
+
+	if ((InCreateInfo.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) == 0)
+	{
+		_log_warning(StringUtil::Printf("%: buffer without VK_BUFFER_USAGE_TRANSFER_SRC_BIT can not be copied out, it stays in place!", _name_of(RegisterMovableBuffer)), LogSystem::Category::Memory);
+		return;
+	}
+
+	MovableResource resource = {};
+	resource.BufferInfo                       = InCreateInfo;
+	resource.BufferInfo.pNext                 = nullptr;
+	resource.BufferInfo.queueFamilyIndexCount = _count_0;
+	resource.BufferInfo.pQueueFamilyIndices   = nullptr;
+
+	// The replacement is the source of the next move.
+	resource.BufferInfo.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_movableResources[InAllocation] = resource;
+}
+
+void DeviceMemoryAllocator::RegisterMovableImage(DeviceAllocation* InAllocation, const VkImageCreateInfo& InCreateInfo, VkImageLayout InIdleLayout, VkImageAspectFlags InAspectMask)
+{
+	if (InAllocation->BlockIndex == InvalidIndex || InCreateInfo.sharingMode != VK_SHARING_MODE_EXCLUSIVE)
+		return;
+
+	if ((InCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) == 0)
+	{
+		_log_warning(StringUtil::Printf("%: image without VK_IMAGE_USAGE_TRANSFER_SRC_BIT can not be copied out, it stays in place!", _name_of(RegisterMovableImage)), LogSystem::Category::Memory);
+		return;
+	}
+
+	MovableResource resource = {};
+	resource.ImageInfo                       = InCreateInfo;
+	resource.ImageInfo.pNext                 = nullptr;
+	resource.ImageInfo.queueFamilyIndexCount = _count_0;
+	resource.ImageInfo.pQueueFamilyIndices   = nullptr;
+	resource.ImageInfo.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+	resource.ImageInfo.usage                |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	resource.IdleLayout                      = InIdleLayout;
+	resource.AspectMask                      = InAspectMask;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_movableResources[InAllocation] = resource;
+}
+
+void DeviceMemoryAllocator::SetMoveCallback(const MoveCallback& InCallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_moveCallback = InCallback;
+}
+
+DeviceMemoryAllocator::DefragStats DeviceMemoryAllocator::Defragment(CommandList* InCmdList, VkFence InFence, VkDeviceSize InByteBudget, uint32 InMaxMoves)
+{
+	DefragStats                    stats = {};
+	std::vector<DeviceAllocation*> moved;
+	MoveCallback                   callback;
+
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		RetireMoves(false, stats);
+
+		if (InFence == VK_NULL_HANDLE)
+			_log_error(StringUtil::Printf("%: No fence given, moved ranges are never reused!", _name_of(Defragment)), LogSystem::Category::Memory);
+
+		// Make earlier writes visible to the copies.
+		VkMemoryBarrier memBarrier = {};
+		memBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		memBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		bool bBarrierRecorded    = false;
+
+		for (uint32 poolIndex = 0; poolIndex < (uint32)m_pools.size(); ++poolIndex)
+		{
+			MemoryPool& pool = m_pools[poolIndex];
+
+			// Linear blocks rewind by themselves.
+			if (pool.Kind == Pool_Transient || pool.Blocks.size() < 2)
+				continue;
+
+			if (stats.MoveCount >= InMaxMoves || stats.MovedBytes >= InByteBudget)
+				break;
+
+			std::vector<DefragPlanner::Block> blocks;
+			std::vector<uint32>               blockIndices;
+
+			for (uint32 blockIndex = 0; blockIndex < (uint32)pool.Blocks.size(); ++blockIndex)
+			{
+				MemoryBlock& block = pool.Blocks[blockIndex];
+				if (block.Memory == VK_NULL_HANDLE)
+					continue;
+
+				DefragPlanner::Block plannerBlock;
+				plannerBlock.pSubAllocator = block.pSubAllocator;
+
+				for (auto& allocation : block.Allocations)
+				{
+					if (m_movableResources.find(allocation) == m_movableResources.end())
+						continue;
+
+					DefragPlanner::Item item;
+					item.Id        = (uint64)allocation;
+					item.Offset    = allocation->Offset;
+					item.Size      = allocation->Size;
+					item.Alignment = allocation->Alignment;
+					item.Tiling    = allocation->Tiling;
+					plannerBlock.Items.push_back(item);
+				}
+
+				blocks.push_back(plannerBlock);
+				blockIndices.push_back(blockIndex);
+			}
+
+			DefragPlanner planner(InByteBudget - stats.MovedBytes, InMaxMoves - stats.MoveCount);
+
+			std::vector<DefragPlanner::Move> moves;
+			stats.MovedBytes += planner.Plan(blocks, moves);
+
+			if (!moves.empty() && !bBarrierRecorded)
+			{
+				InCmdList->MemoryBarrier(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, memBarrier);
+				bBarrierRecorded = true;
+			}
+
+			for (auto& move : moves)
+			{
+				DeviceAllocation* allocation = (DeviceAllocation*)move.Id;
+				RecordMove(InCmdList, InFence, allocation, m_movableResources[allocation], blockIndices[move.DstBlock], move.DstOffset);
+
+				moved.push_back(allocation);
+				stats.MoveCount++;
+			}
+		}
+
+		if (bBarrierRecorded)
+		{
+			memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			InCmdList->MemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, memBarrier);
+		}
+
+		callback = m_moveCallback;
+	}
+
+	if (callback)
+	{
+		for (auto& allocation : moved)
+			callback(allocation);
+	}
+
+	return stats;
+}
+
+void DeviceMemoryAllocator::RecordMove(CommandList* InCmdList, VkFence InFence, DeviceAllocation* InAllocation, const MovableResource& InResource, uint32 InDstBlock, VkDeviceSize InDstOffset)
+{
+	MemoryPool&  pool     = m_pools[InAllocation->PoolIndex];
+	MemoryBlock& dstBlock = pool.Blocks[InDstBlock];
+
+	// The old range stays reserved until the copy has certainly finished.
+	RetiredRange retired;
+	retired.Fence      = InFence;
+	retired.PoolIndex  = InAllocation->PoolIndex;
+	retired.BlockIndex = InAllocation->BlockIndex;
+	retired.Offset     = InAllocation->Offset;
+	retired.Size       = InAllocation->Size;
+	retired.Buffer     = InAllocation->Buffer;
+	retired.Image      = InAllocation->Image;
+	m_retiredRanges.push_back(retired);
+
+	if (InAllocation->Buffer != VK_NULL_HANDLE)
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		_vk_try(vkCreateBuffer(m_device, &InResource.BufferInfo, m_pBaseLayer->GetVkAllocator(), &buffer));
+		_vk_try(vkBindBufferMemory(m_device, buffer, dstBlock.Memory, InDstOffset));
+
+		VkBufferCopy region = {};
+		region.srcOffset = _offset_0;
+		region.dstOffset = _offset_0;
+		region.size      = InResource.BufferInfo.size;
+
+		InCmdList->CopyBuffer(InAllocation->Buffer, buffer, _count_1, &region);
+		InAllocation->Buffer = buffer;
+	}
+	else if (InAllocation->Image != VK_NULL_HANDLE)
+	{
+		VkImage image = VK_NULL_HANDLE;
+		_vk_try(vkCreateImage(m_device, &InResource.ImageInfo, m_pBaseLayer->GetVkAllocator(), &image));
+		_vk_try(vkBindImageMemory(m_device, image, dstBlock.Memory, InDstOffset));
+
+		const VkImageSubresourceRange subresRange = { InResource.AspectMask, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+
+		CommandList::ImageBarrierDesc barrier;
+		barrier.SrcStageMask     = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		barrier.DstStageMask     = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		barrier.SrcAccessMask    = VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.DstAccessMask    = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.OldLayout        = InResource.IdleLayout;
+		barrier.NewLayout        = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.Image            = InAllocation->Image;
+		barrier.SubresourceRange = subresRange;
+		InCmdList->ImageBarrier(barrier);
+
+		barrier.SrcAccessMask    = _flag_none;
+		barrier.DstAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.OldLayout        = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.NewLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.Image            = image;
+		InCmdList->ImageBarrier(barrier);
+
+		std::vector<VkImageCopy> regions(InResource.ImageInfo.mipLevels);
+		for (uint32 mip = 0; mip < InResource.ImageInfo.mipLevels; ++mip)
+		{
+			VkImageCopy& region = regions[mip];
+			region.srcSubresource = { InResource.AspectMask, mip, 0, InResource.ImageInfo.arrayLayers };
+			region.srcOffset      = { 0, 0, 0 };
+			region.dstSubresource = region.srcSubresource;
+			region.dstOffset      = { 0, 0, 0 };
+			region.extent.width   = std::max(InResource.ImageInfo.extent.width  >> mip, 1u);
+			region.extent.height  = std::max(InResource.ImageInfo.extent.height >> mip, 1u);
+			region.extent.depth   = std::max(InResource.ImageInfo.extent.depth  >> mip, 1u);
+		}
+
+		InCmdList->CopyImage(InAllocation->Image, image, (uint32)regions.size(), regions.data());
+
+		barrier.SrcStageMask     = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		barrier.DstStageMask     = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		barrier.SrcAccessMask    = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.DstAccessMask    = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		barrier.OldLayout        = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.NewLayout        = InResource.IdleLayout;
+		InCmdList->ImageBarrier(barrier);
+
+		InAllocation->Image = image;
+	}
+
+	UnlinkFromBlock(InAllocation);
+
+	InAllocation->Memory     = dstBlock.Memory;
+	InAllocation->Offset     = InDstOffset;
+	InAllocation->BlockIndex = InDstBlock;
+	InAllocation->pMapped    = dstBlock.pMapped != nullptr ? (uint8*)dstBlock.pMapped + InDstOffset : nullptr;
+
+	LinkToBlock(InAllocation);
+}
+
+void DeviceMemoryAllocator::RetireMoves(bool InForce, DefragStats& OutStats)
+{
+	for (usize i = 0; i < m_retiredRanges.size();)
+	{
+		RetiredRange& retired = m_retiredRanges[i];
+
+		// Without a fence the copy is never known to be done, only the shutdown frees it.
+		if (!InForce && (retired.Fence == VK_NULL_HANDLE || vkGetFenceStatus(m_device, retired.Fence) != VK_SUCCESS))
+		{
+			++i;
+			continue;
+		}
+
+		if (retired.Buffer != VK_NULL_HANDLE)
+			vkDestroyBuffer(m_device, retired.Buffer, m_pBaseLayer->GetVkAllocator());
+		if (retired.Image != VK_NULL_HANDLE)
+			vkDestroyImage(m_device, retired.Image, m_pBaseLayer->GetVkAllocator());
+
+		MemoryPool& pool = m_pools[retired.PoolIndex];
+		pool.Blocks[retired.BlockIndex].pSubAllocator->Free(retired.Offset, retired.Size);
+
+		OutStats.RetiredMoveCount++;
+		if (!InForce && TryReleaseEmptyBlock(pool, retired.BlockIndex))
+			OutStats.ReleasedBlockCount++;
+
+		m_retiredRanges[i] = m_retiredRanges.back();
+		m_retiredRanges.pop_back();
+	}
+}
+
+#pragma endregion
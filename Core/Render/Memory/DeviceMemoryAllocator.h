@@ -0,0 +1,269 @@
+﻿/*********************************************************************
+ *  DeviceMemoryAllocator.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Sub-allocates buffers and images from large VkDeviceMemory blocks.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include "MemorySubAllocator.h"
+#include "MemoryBudget.h"
+#include <functional>
+#include <mutex>
+
+class BaseLayer;
+class CommandList;
+
+enum class DeviceMemoryLifetime : uint8
+{
+	Persistent,    ///< Lives for many frames, served by buddy blocks.
+	Transient      ///< Lives for about a frame, served by linear blocks.
+};
+
+/**
+ *  A range of device memory. The pointer stays valid until it is passed to
+ *  DeviceMemoryAllocator::Free(), only the allocator writes to it.
+ */
+struct DeviceAllocation
+{
+	VkDeviceMemory       Memory;
+	VkDeviceSize         Offset;
+	VkDeviceSize         Size;
+	uint32               MemoryTypeIndex;
+	void*                pMapped;        ///< Host address of Offset, nullptr if the memory type is not host visible.
+
+	VkBuffer             Buffer;         ///< Resource bound by AllocateForBuffer(), replaced when defragmentation moves it.
+	VkImage              Image;          ///< Resource bound by AllocateForImage(), replaced when defragmentation moves it.
+
+	VkDeviceSize         Alignment;
+	DeviceResourceTiling Tiling;
+	DeviceMemoryLifetime Lifetime;
+	uint32               PoolIndex;
+	uint32               BlockIndex;     ///< InvalidIndex for a dedicated allocation.
+	uint32               SlotIndex;      ///< Position in the block allocation list.
+};
+
+/**
+ *  Memory types are chosen with BaseLayer::GetHeapIndexFromMemPropFlags().
+ *  Every memory type owns a transient pool and one persistent pool per
+ *  tiling, so buddy blocks never mix tilings and bufferImageGranularity only
+ *  has to be handled by the linear blocks. Requests bigger than half a block
+ *  get a dedicated VkDeviceMemory. Host visible blocks stay mapped.
+ */
+class DeviceMemoryAllocator : public IResourceHandler
+{
+	_declare_create_interface(DeviceMemoryAllocator)
+
+protected:
+
+	DeviceMemoryAllocator();
+
+public:
+
+	virtual ~DeviceMemoryAllocator();
+
+	void Init(BaseLayer* InBaseLayer);
+
+public:
+
+	struct AllocationInfo
+	{
+		VkMemoryPropertyFlags PreferredFlags;
+		VkMemoryPropertyFlags RequiredFlags;
+		DeviceMemoryLifetime  Lifetime;
+		DeviceResourceTiling  Tiling;
+	};
+
+	struct Stats
+	{
+		uint32       BlockCount;
+		uint32       DedicatedCount;
+		uint32       AllocationCount;
+		VkDeviceSize BlockBytes;          ///< Bytes held in VkDeviceMemory objects, dedicated ones included.
+		VkDeviceSize UsedBytes;           ///< Bytes requested by live allocations.
+	};
+
+	/**
+	 *  @return nullptr if no memory type matches or the device is out of memory.
+	 */
+	DeviceAllocation* Allocate(const VkMemoryRequirements& InMemRequirements, const AllocationInfo& InInfo);
+
+	/**
+	 *  Allocate for the buffer and bind it, the tiling is always linear.
+	 */
+	DeviceAllocation* AllocateForBuffer(VkBuffer InBuffer, const AllocationInfo& InInfo);
+
+	/**
+	 *  Allocate for the image and bind it, InInfo.Tiling has to match the image tiling.
+	 */
+	DeviceAllocation* AllocateForImage(VkImage InImage, const AllocationInfo& InInfo);
+
+	void Free(DeviceAllocation* InAllocation);
+
+	Stats GetStats() const;
+
+	/**
+	 *  Every VkDeviceMemory of the allocator is recorded here, register eviction callbacks on it.
+	 */
+	MemoryBudget* GetBudget();
+
+	/**
+	 *  Refresh the heap budgets and evict on heaps over the watermark, once per frame.
+	 */
+	void Update();
+
+public:
+
+	struct DefragStats
+	{
+		uint32       MoveCount;
+		VkDeviceSize MovedBytes;
+		uint32       RetiredMoveCount;    ///< Moves of earlier passes whose old range was given back.
+		uint32       ReleasedBlockCount;
+	};
+
+	/**
+	 *  Called with every allocation moved by Defragment(), once the allocator lock
+	 *  is released. Descriptors that reference the old Buffer/Image have to be
+	 *  rewritten here.
+	 */
+	using MoveCallback = std::function<void(DeviceAllocation*)>;
+
+	/**
+	 *  Let Defragment() move the allocation, the buffer is recreated from InCreateInfo.
+	 *  Only exclusive sharing is supported, pNext is dropped. The replaced buffer
+	 *  is destroyed by the allocator, the caller keeps owning InAllocation->Buffer.
+	 *  The buffer is the source of its first move, a usage without
+	 *  VK_BUFFER_USAGE_TRANSFER_SRC_BIT is refused.
+	 */
+	void RegisterMovableBuffer(DeviceAllocation* InAllocation, const VkBufferCreateInfo& InCreateInfo);
+
+	/**
+	 *  Let Defragment() move the allocation, the image is recreated from InCreateInfo.
+	 *  The image is the source of its first move, a usage without
+	 *  VK_IMAGE_USAGE_TRANSFER_SRC_BIT is refused.
+	 * 
+	 *  @param  InIdleLayout  layout the image is in between frames, it is left in that layout after the copy.
+	 *  @param  InAspectMask  aspects copied for every mip level.
+	 */
+	void RegisterMovableImage(DeviceAllocation* InAllocation, const VkImageCreateInfo& InCreateInfo, VkImageLayout InIdleLayout, VkImageAspectFlags InAspectMask);
+
+	void SetMoveCallback(const MoveCallback& InCallback);
+
+	/**
+	 *  One incremental pass, call it once per frame on a command list that is
+	 *  submitted before any other use of the resources this frame. Allocations
+	 *  are remapped right away, the old ranges are kept until InFence signals.
+	 * 
+	 *  @param  InCmdList     command list the copies are recorded to.
+	 *  @param  InFence       fence signaled by the submission of InCmdList, alive until the moves retire.
+	 *  @param  InByteBudget  bytes moved at most.
+	 *  @param  InMaxMoves    moves recorded at most.
+	 */
+	DefragStats Defragment(CommandList* InCmdList, VkFence InFence, VkDeviceSize InByteBudget, uint32 InMaxMoves);
+
+public:
+
+	static constexpr uint32 InvalidIndex = _numeric_max(uint32);
+
+protected:
+
+	enum PoolKind : uint32
+	{
+		Pool_Transient,
+		Pool_PersistentLinear,
+		Pool_PersistentOptimal,
+		Pool_Count
+	};
+
+	struct MemoryBlock
+	{
+		VkDeviceMemory                 Memory;
+		void*                          pMapped;
+		MemorySubAllocator*            pSubAllocator;
+		std::vector<DeviceAllocation*> Allocations;
+	};
+
+	struct MemoryPool
+	{
+		uint32                   MemoryTypeIndex;
+		PoolKind                 Kind;
+		VkDeviceSize             BlockSize;
+		std::vector<MemoryBlock> Blocks;       ///< Released blocks keep their slot so BlockIndex stays valid.
+	};
+
+	struct MovableResource
+	{
+		VkBufferCreateInfo BufferInfo;
+		VkImageCreateInfo  ImageInfo;
+		VkImageLayout      IdleLayout;
+		VkImageAspectFlags AspectMask;
+	};
+
+	struct RetiredRange
+	{
+		VkFence            Fence;             ///< Signaled once the copy out of the range is done.
+		uint32             PoolIndex;
+		uint32             BlockIndex;
+		VkDeviceSize       Offset;
+		VkDeviceSize       Size;
+		VkBuffer           Buffer;
+		VkImage            Image;
+	};
+
+protected:
+
+	bool AllocateFromPool(MemoryPool& InPool, const VkMemoryRequirements& InMemRequirements, DeviceResourceTiling InTiling, DeviceAllocation& OutAllocation);
+
+	bool AllocateDedicated(uint32 InMemTypeIndex, VkDeviceSize InSize, DeviceAllocation& OutAllocation);
+
+	bool CreateBlock(MemoryPool& InPool, uint32& OutBlockIndex);
+
+	void ReleaseBlock(MemoryPool& InPool, uint32 InBlockIndex);
+
+	/**
+	 *  Release the block if it is empty and the pool has another one.
+	 */
+	bool TryReleaseEmptyBlock(MemoryPool& InPool, uint32 InBlockIndex);
+
+	void LinkToBlock(DeviceAllocation* InAllocation);
+
+	void UnlinkFromBlock(DeviceAllocation* InAllocation);
+
+	void RecordMove(CommandList* InCmdList, VkFence InFence, DeviceAllocation* InAllocation, const MovableResource& InResource, uint32 InDstBlock, VkDeviceSize InDstOffset);
+
+	void RetireMoves(bool InForce, DefragStats& OutStats);
+
+	bool AllocateDeviceMemory(uint32 InMemTypeIndex, VkDeviceSize InSize, VkDeviceMemory& OutMemory, void*& OutMapped);
+
+	void FreeDeviceMemory(uint32 InMemTypeIndex, VkDeviceMemory InMemory, VkDeviceSize InSize);
+
+	DeviceAllocation* AllocateLocked(const VkMemoryRequirements& InMemRequirements, const DeviceAllocation& InAllocation);
+
+	VkDeviceSize GetBlockSize(uint32 InMemTypeIndex, PoolKind InKind) const;
+
+	static PoolKind GetPoolKind(DeviceMemoryLifetime InLifetime, DeviceResourceTiling InTiling);
+
+protected:
+
+	BaseLayer*                       m_pBaseLayer;
+	VkDevice                         m_device;
+	VkPhysicalDeviceMemoryProperties m_memProps;
+	VkDeviceSize                     m_granularity;
+
+	mutable std::mutex               m_mutex;
+	std::vector<MemoryPool>          m_pools;             ///< Indexed by memory type index * Pool_Count + PoolKind.
+
+	std::unordered_map<DeviceAllocation*, MovableResource> m_movableResources;
+	std::vector<RetiredRange>        m_retiredRanges;
+	MoveCallback                     m_moveCallback;
+	MemoryBudget                     m_budget;
+
+	uint32                           m_blockCount;
+	uint32                           m_dedicatedCount;
+	uint32                           m_allocationCount;
+	VkDeviceSize                     m_blockBytes;
+	VkDeviceSize                     m_usedBytes;
+};
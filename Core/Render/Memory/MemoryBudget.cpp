@@ -0,0 +1,200 @@
+﻿/*********************************************************************
+ *  MemoryBudget.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "MemoryBudget.h"
+#include "Core/Render/RenderBase/RenderBaseConfig.h"
+
+MemoryBudget::MemoryBudget() :
+	m_physicalDevice (VK_NULL_HANDLE),
+	m_bUseBudgetExt  (false),
+	m_heapCount      (_count_0),
+	m_watermark      (RenderBaseConfig::Memory::BudgetWatermark),
+	m_nextCallbackId (_count_1),
+	m_bEvicting      (false)
+{
+	for (uint32 heapIndex = 0; heapIndex < VK_MAX_MEMORY_HEAPS; ++heapIndex)
+	{
+		m_heapSizes[heapIndex]        = _count_0;
+		m_driverBudgets[heapIndex]    = _count_0;
+		m_driverUsages[heapIndex]     = _count_0;
+		m_allocatedAtQuery[heapIndex] = _count_0;
+		m_allocatedBytes[heapIndex]   = _count_0;
+	}
+}
+
+void MemoryBudget::Init(const VkPhysicalDeviceMemoryProperties& InMemProps, VkPhysicalDevice InPhysicalDevice, bool InUseBudgetExt)
+{
+	m_physicalDevice = InPhysicalDevice;
+	m_bUseBudgetExt  = InUseBudgetExt && InPhysicalDevice != VK_NULL_HANDLE;
+	m_heapCount      = InMemProps.memoryHeapCount;
+
+	for (uint32 heapIndex = 0; heapIndex < m_heapCount; ++heapIndex)
+	{
+		m_heapSizes[heapIndex]     = InMemProps.memoryHeaps[heapIndex].size;
+		m_driverBudgets[heapIndex] = (VkDeviceSize)((double)m_heapSizes[heapIndex] * RenderBaseConfig::Memory::FallbackBudgetRatio);
+	}
+
+	if (!m_bUseBudgetExt)
+		_log_common(StringUtil::Printf("%: VK_EXT_memory_budget is not available, budgets are % of the heap sizes.", _name_of(MemoryBudget), RenderBaseConfig::Memory::FallbackBudgetRatio), LogSystem::Category::Memory);
+
+	Refresh();
+}
+
+void MemoryBudget::Refresh()
+{
+	if (!m_bUseBudgetExt)
+		return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+	budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memProps = {};
+	memProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memProps.pNext = &budgetProps;
+
+	vkGetPhysicalDeviceMemoryProperties2(m_physicalDevice, &memProps);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	for (uint32 heapIndex = 0; heapIndex < m_heapCount; ++heapIndex)
+	{
+		// Some drivers leave the budget at 0 for heaps they do not track.
+		const VkDeviceSize budget = budgetProps.heapBudget[heapIndex];
+
+		m_driverBudgets[heapIndex]    = budget != 0 ? std::min(budget, m_heapSizes[heapIndex]) :
+			(VkDeviceSize)((double)m_heapSizes[heapIndex] * RenderBaseConfig::Memory::FallbackBudgetRatio);
+		m_driverUsages[heapIndex]     = budgetProps.heapUsage[heapIndex];
+		m_allocatedAtQuery[heapIndex] = m_allocatedBytes[heapIndex].load();
+	}
+}
+
+void MemoryBudget::RecordAllocation(uint32 InHeapIndex, VkDeviceSize InSize)
+{
+	m_allocatedBytes[InHeapIndex] += InSize;
+}
+
+void MemoryBudget::RecordFree(uint32 InHeapIndex, VkDeviceSize InSize)
+{
+	m_allocatedBytes[InHeapIndex] -= InSize;
+}
+
+void MemoryBudget::SetWatermark(float InFraction)
+{
+	m_watermark = std::min(std::max(InFraction, 0.0f), 1.0f);
+}
+
+bool MemoryBudget::IsOverWatermark(uint32 InHeapIndex, VkDeviceSize InExtraBytes) const
+{
+	return (double)(GetUsage(InHeapIndex) + InExtraBytes) > (double)GetBudget(InHeapIndex) * m_watermark;
+}
+
+MemoryBudget::HeapBudget MemoryBudget::GetHeapBudget(uint32 InHeapIndex) const
+{
+	HeapBudget budget;
+	budget.Size           = m_heapSizes[InHeapIndex];
+	budget.Budget         = GetBudget(InHeapIndex);
+	budget.Usage          = GetUsage(InHeapIndex);
+	budget.AllocatedBytes = m_allocatedBytes[InHeapIndex].load();
+
+	return budget;
+}
+
+uint32 MemoryBudget::GetHeapCount() const
+{
+	return m_heapCount;
+}
+
+bool MemoryBudget::IsUsingBudgetExt() const
+{
+	return m_bUseBudgetExt;
+}
+
+uint32 MemoryBudget::AddEvictionCallback(int32 InPriority, const EvictionCallback& InCallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Callback callback;
+	callback.Id       = m_nextCallbackId++;
+	callback.Priority = InPriority;
+	callback.Function = InCallback;
+
+	// Equal priorities keep their registration order.
+	auto position = std::upper_bound(m_callbacks.begin(), m_callbacks.end(), InPriority,
+		[](int32 priority, const Callback& other) { return priority < other.Priority; });
+
+	m_callbacks.insert(position, callback);
+
+	return callback.Id;
+}
+
+void MemoryBudget::RemoveEvictionCallback(uint32 InCallbackId)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_callbacks.erase(std::remove_if(m_callbacks.begin(), m_callbacks.end(),
+		[InCallbackId](const Callback& callback) { return callback.Id == InCallbackId; }), m_callbacks.end());
+}
+
+VkDeviceSize MemoryBudget::Evict(uint32 InHeapIndex, VkDeviceSize InExtraBytes)
+{
+	// Callbacks free through the allocator, which may end up here again.
+	if (m_bEvicting.exchange(true))
+		return 0;
+
+	std::vector<Callback> callbacks;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		callbacks = m_callbacks;
+	}
+
+	VkDeviceSize freedBytes = _count_0;
+
+	for (auto& callback : callbacks)
+	{
+		if (!IsOverWatermark(InHeapIndex, InExtraBytes))
+			break;
+
+		const VkDeviceSize limit = (VkDeviceSize)((double)GetBudget(InHeapIndex) * m_watermark);
+		const VkDeviceSize usage = GetUsage(InHeapIndex) + InExtraBytes;
+
+		freedBytes += callback.Function(InHeapIndex, usage - std::min(usage, limit));
+	}
+
+	m_bEvicting = false;
+
+	return freedBytes;
+}
+
+void MemoryBudget::EvictOverWatermark()
+{
+	for (uint32 heapIndex = 0; heapIndex < m_heapCount; ++heapIndex)
+	{
+		if (IsOverWatermark(heapIndex))
+			Evict(heapIndex);
+	}
+}
+
+VkDeviceSize MemoryBudget::GetUsage(uint32 InHeapIndex) const
+{
+	const VkDeviceSize allocated = m_allocatedBytes[InHeapIndex].load();
+
+	if (!m_bUseBudgetExt)
+		return allocated;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	// The driver numbers are as old as the last Refresh(), add what changed since.
+	const VkDeviceSize usage = m_driverUsages[InHeapIndex];
+	const VkDeviceSize since = m_allocatedAtQuery[InHeapIndex];
+
+	return allocated >= since ? usage + (allocated - since) : usage - std::min(usage, since - allocated);
+}
+
+VkDeviceSize MemoryBudget::GetBudget(uint32 InHeapIndex) const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	return m_driverBudgets[InHeapIndex];
+}
@@ -0,0 +1,127 @@
+﻿/*********************************************************************
+ *  MemoryBudget.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Tracks device memory usage per heap against its budget.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+/**
+ *  Every VkDeviceMemory allocated by the engine is recorded against its heap.
+ *  With VK_EXT_memory_budget the driver numbers are taken at Refresh() and
+ *  the bytes allocated since then are added on top, without it the budget is
+ *  RenderBaseConfig::Memory::FallbackBudgetRatio of the heap size and only
+ *  the engine allocations count. Once a heap goes over the watermark the
+ *  eviction callbacks are called, lowest priority value first, until it is
+ *  back under.
+ */
+class MemoryBudget
+{
+
+public:
+
+	struct HeapBudget
+	{
+		VkDeviceSize Size;
+		VkDeviceSize Budget;           ///< Bytes the process can use before the driver starts to struggle.
+		VkDeviceSize Usage;            ///< Estimated bytes in use by the process.
+		VkDeviceSize AllocatedBytes;   ///< Bytes allocated through RecordAllocation().
+	};
+
+	/**
+	 *  @param  InHeapIndex     heap over the watermark.
+	 *  @param  InBytesToFree   bytes needed to get back under the watermark.
+	 * 
+	 *  @return bytes actually freed, 0 if the callback had nothing to give back.
+	 */
+	using EvictionCallback = std::function<VkDeviceSize(uint32 InHeapIndex, VkDeviceSize InBytesToFree)>;
+
+	MemoryBudget();
+
+	/**
+	 *  @param  InMemProps        memory properties of the device.
+	 *  @param  InPhysicalDevice  device queried by Refresh(), only used with InUseBudgetExt.
+	 *  @param  InUseBudgetExt    VK_EXT_memory_budget is enabled on the device.
+	 */
+	void Init(const VkPhysicalDeviceMemoryProperties& InMemProps, VkPhysicalDevice InPhysicalDevice, bool InUseBudgetExt);
+
+	/**
+	 *  Query the driver budget again, about once per frame.
+	 */
+	void Refresh();
+
+	void RecordAllocation(uint32 InHeapIndex, VkDeviceSize InSize);
+	void RecordFree(uint32 InHeapIndex, VkDeviceSize InSize);
+
+	/**
+	 *  @param  InFraction  part of the budget, usage above it triggers the eviction callbacks.
+	 */
+	void SetWatermark(float InFraction);
+
+	bool IsOverWatermark(uint32 InHeapIndex, VkDeviceSize InExtraBytes = 0) const;
+
+	HeapBudget GetHeapBudget(uint32 InHeapIndex) const;
+
+	uint32 GetHeapCount() const;
+
+	bool IsUsingBudgetExt() const;
+
+	/**
+	 *  @param  InPriority  callbacks with a lower value are asked first, cheap caches should come before streamed assets.
+	 * 
+	 *  @return id for RemoveEvictionCallback().
+	 */
+	uint32 AddEvictionCallback(int32 InPriority, const EvictionCallback& InCallback);
+
+	void RemoveEvictionCallback(uint32 InCallbackId);
+
+	/**
+	 *  Ask the callbacks for memory until the heap has room for InExtraBytes under
+	 *  the watermark. Must not be called with a lock the callbacks take, calls
+	 *  made while another eviction runs, from a callback or not, return 0.
+	 * 
+	 *  @return bytes freed by the callbacks.
+	 */
+	VkDeviceSize Evict(uint32 InHeapIndex, VkDeviceSize InExtraBytes = 0);
+
+	/**
+	 *  Evict on every heap that is over the watermark.
+	 */
+	void EvictOverWatermark();
+
+private:
+
+	struct Callback
+	{
+		uint32           Id;
+		int32            Priority;
+		EvictionCallback Function;
+	};
+
+	VkDeviceSize GetUsage(uint32 InHeapIndex) const;
+	VkDeviceSize GetBudget(uint32 InHeapIndex) const;
+
+private:
+
+	VkPhysicalDevice                         m_physicalDevice;
+	bool                                     m_bUseBudgetExt;
+	uint32                                   m_heapCount;
+	float                                    m_watermark;
+
+	VkDeviceSize                             m_heapSizes       [VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize                             m_driverBudgets   [VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize                             m_driverUsages    [VK_MAX_MEMORY_HEAPS];
+	VkDeviceSize                             m_allocatedAtQuery[VK_MAX_MEMORY_HEAPS];   ///< AllocatedBytes when the driver was last queried.
+	std::atomic<VkDeviceSize>                m_allocatedBytes  [VK_MAX_MEMORY_HEAPS];
+
+	mutable std::mutex                       m_mutex;
+	std::vector<Callback>                    m_callbacks;       ///< Sorted by priority.
+	uint32                                   m_nextCallbackId;
+	std::atomic<bool>                        m_bEvicting;
+};
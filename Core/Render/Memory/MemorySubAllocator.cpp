@@ -0,0 +1,255 @@
+﻿/*********************************************************************
+ *  MemorySubAllocator.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "MemorySubAllocator.h"
+#include "Core/Utilities/Math/Align.h"
+
+namespace
+{
+	inline VkDeviceSize AlignDown(VkDeviceSize InValue, VkDeviceSize InAlignment)
+	{
+		return InValue & ~(InAlignment - 1);
+	}
+
+	inline uint32 CeilLog2(VkDeviceSize InValue)
+	{
+		uint32 log2 = 0;
+		while (((VkDeviceSize)1 << log2) < InValue)
+			++log2;
+
+		return log2;
+	}
+}
+
+#pragma region MemorySubAllocator
+
+MemorySubAllocator::MemorySubAllocator(VkDeviceSize InCapacity) :
+	m_capacity        (InCapacity),
+	m_usedBytes       (_count_0),
+	m_allocationCount (_count_0)
+{
+
+}
+
+MemorySubAllocator::~MemorySubAllocator()
+{
+
+}
+
+VkDeviceSize MemorySubAllocator::GetCapacity() const
+{
+	return m_capacity;
+}
+
+bool MemorySubAllocator::IsEmpty() const
+{
+	return m_allocationCount == 0;
+}
+
+float MemorySubAllocator::GetFragmentation(const Stats& InStats)
+{
+	const VkDeviceSize freeBytes = InStats.Capacity - InStats.ReservedBytes;
+	if (freeBytes == 0)
+		return 0.0f;
+
+	return 1.0f - (float)((double)InStats.LargestFreeRange / (double)freeBytes);
+}
+
+#pragma endregion
+
+#pragma region LinearSubAllocator
+
+LinearSubAllocator::LinearSubAllocator(VkDeviceSize InCapacity, VkDeviceSize InGranularity) :
+	MemorySubAllocator (InCapacity),
+	m_granularity      (std::max<VkDeviceSize>(InGranularity, 1)),
+	m_head             (_offset_0),
+	m_lastTiling       (DeviceResourceTiling::Linear)
+{
+
+}
+
+LinearSubAllocator::~LinearSubAllocator()
+{
+
+}
+
+bool LinearSubAllocator::Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, DeviceResourceTiling InTiling, VkDeviceSize& OutOffset)
+{
+	VkDeviceSize offset = Math::AlignUp(m_head, std::max<VkDeviceSize>(InAlignment, 1));
+
+	// A page shared with a resource of the other tiling would alias, skip to the next one.
+	if (m_head != 0 && InTiling != m_lastTiling && AlignDown(m_head - 1, m_granularity) == AlignDown(offset, m_granularity))
+		offset = Math::AlignUp(offset, m_granularity);
+
+	if (offset + InSize > m_capacity)
+		return false;
+
+	m_head       = offset + InSize;
+	m_lastTiling = InTiling;
+	m_usedBytes += InSize;
+	m_allocationCount++;
+
+	OutOffset = offset;
+	return true;
+}
+
+void LinearSubAllocator::Free(VkDeviceSize InOffset, VkDeviceSize InSize)
+{
+	m_usedBytes -= InSize;
+
+	if (--m_allocationCount == 0)
+		Reset();
+}
+
+void LinearSubAllocator::Reset()
+{
+	m_head            = _offset_0;
+	m_usedBytes       = _count_0;
+	m_allocationCount = _count_0;
+	m_lastTiling      = DeviceResourceTiling::Linear;
+}
+
+MemorySubAllocator::Stats LinearSubAllocator::GetStats() const
+{
+	Stats stats;
+	stats.Capacity         = m_capacity;
+	stats.UsedBytes        = m_usedBytes;
+	stats.ReservedBytes    = m_head;
+	stats.LargestFreeRange = m_capacity - m_head;
+	stats.AllocationCount  = m_allocationCount;
+
+	return stats;
+}
+
+#pragma endregion
+
+#pragma region BuddySubAllocator
+
+BuddySubAllocator::BuddySubAllocator(VkDeviceSize InCapacity, VkDeviceSize InMinBlockSize) :
+	MemorySubAllocator (InCapacity),
+	m_minBlockSize     (InMinBlockSize),
+	m_maxOrder         (CeilLog2(InCapacity / InMinBlockSize)),
+	m_reservedBytes    (_count_0)
+{
+	assert((InCapacity & (InCapacity - 1)) == 0 && (InMinBlockSize & (InMinBlockSize - 1)) == 0 && InCapacity >= InMinBlockSize);
+
+	m_freeRanges.resize(m_maxOrder + 1);
+	m_freeRanges[m_maxOrder].insert(_offset_0);
+}
+
+BuddySubAllocator::~BuddySubAllocator()
+{
+
+}
+
+bool BuddySubAllocator::Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, DeviceResourceTiling InTiling, VkDeviceSize& OutOffset)
+{
+	// Ranges are aligned to their own size, rounding up to the alignment is enough.
+	const VkDeviceSize required = std::max(std::max(InSize, InAlignment), m_minBlockSize);
+	const uint32       order    = CeilLog2(required / m_minBlockSize + (required % m_minBlockSize != 0 ? 1 : 0));
+
+	if (order > m_maxOrder)
+		return false;
+
+	uint32 found = order;
+	while (found <= m_maxOrder && m_freeRanges[found].empty())
+		++found;
+
+	if (found > m_maxOrder)
+		return false;
+
+	VkDeviceSize offset = *m_freeRanges[found].begin();
+	m_freeRanges[found].erase(m_freeRanges[found].begin());
+
+	// Split down, the upper halves stay free.
+	while (found > order)
+	{
+		--found;
+		m_freeRanges[found].insert(offset + GetOrderSize(found));
+	}
+
+	m_liveOrders[offset] = (uint8)order;
+	m_reservedBytes     += GetOrderSize(order);
+	m_usedBytes         += InSize;
+	m_allocationCount++;
+
+	OutOffset = offset;
+	return true;
+}
+
+void BuddySubAllocator::Free(VkDeviceSize InOffset, VkDeviceSize InSize)
+{
+	auto found = m_liveOrders.find(InOffset);
+	if (found == m_liveOrders.end())
+	{
+		_log_error(StringUtil::Printf("%: Free an unknown range at offset %!", _name_of(BuddySubAllocator), InOffset), LogSystem::Category::Memory);
+		return;
+	}
+
+	uint32       order  = found->second;
+	VkDeviceSize offset = InOffset;
+	m_liveOrders.erase(found);
+
+	m_reservedBytes -= GetOrderSize(order);
+	m_usedBytes     -= InSize;
+	m_allocationCount--;
+
+	// Merge with the buddy as long as it is free as a whole.
+	while (order < m_maxOrder)
+	{
+		const VkDeviceSize buddy = offset ^ GetOrderSize(order);
+
+		auto buddyFound = m_freeRanges[order].find(buddy);
+		if (buddyFound == m_freeRanges[order].end())
+			break;
+
+		m_freeRanges[order].erase(buddyFound);
+		offset = std::min(offset, buddy);
+		++order;
+	}
+
+	m_freeRanges[order].insert(offset);
+}
+
+void BuddySubAllocator::Reset()
+{
+	for (auto& ranges : m_freeRanges)
+		ranges.clear();
+
+	m_freeRanges[m_maxOrder].insert(_offset_0);
+	m_liveOrders.clear();
+
+	m_reservedBytes   = _count_0;
+	m_usedBytes       = _count_0;
+	m_allocationCount = _count_0;
+}
+
+MemorySubAllocator::Stats BuddySubAllocator::GetStats() const
+{
+	Stats stats;
+	stats.Capacity         = m_capacity;
+	stats.UsedBytes        = m_usedBytes;
+	stats.ReservedBytes    = m_reservedBytes;
+	stats.LargestFreeRange = 0;
+	stats.AllocationCount  = m_allocationCount;
+
+	for (uint32 order = m_maxOrder + 1; order-- > 0;)
+	{
+		if (!m_freeRanges[order].empty())
+		{
+			stats.LargestFreeRange = GetOrderSize(order);
+			break;
+		}
+	}
+
+	return stats;
+}
+
+VkDeviceSize BuddySubAllocator::GetOrderSize(uint32 InOrder) const
+{
+	return m_minBlockSize << InOrder;
+}
+
+#pragma endregion
@@ -0,0 +1,148 @@
+﻿/*********************************************************************
+ *  MemorySubAllocator.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Offset based sub-allocation strategies for device memory blocks.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include <set>
+
+/**
+ *  Buffers and linear images may not share a bufferImageGranularity page
+ *  with optimal images.
+ */
+enum class DeviceResourceTiling : uint8
+{
+	Linear,    ///< Buffers and VK_IMAGE_TILING_LINEAR images.
+	Optimal    ///< VK_IMAGE_TILING_OPTIMAL images.
+};
+
+/**
+ *  Hands out [offset, offset + size) ranges of a block without touching any
+ *  vulkan object, so the same code runs against a real VkDeviceMemory and
+ *  against a mock heap in benchmarks. Not thread safe, the owner locks.
+ */
+class MemorySubAllocator
+{
+
+public:
+
+	struct Stats
+	{
+		VkDeviceSize Capacity;
+		VkDeviceSize UsedBytes;          ///< Bytes requested by live allocations.
+		VkDeviceSize ReservedBytes;      ///< Bytes taken from the block, padding and rounding included.
+		VkDeviceSize LargestFreeRange;   ///< Biggest request that is guaranteed to succeed.
+		uint32       AllocationCount;
+	};
+
+	MemorySubAllocator(VkDeviceSize InCapacity);
+	virtual ~MemorySubAllocator();
+
+	/**
+	 *  @param  InSize       size in bytes.
+	 *  @param  InAlignment  power of two alignment of the offset.
+	 *  @param  InTiling     tiling of the resource that will be bound.
+	 *  @param  OutOffset    offset in the block on success.
+	 * 
+	 *  @return false if the block has no room left.
+	 */
+	virtual bool Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, DeviceResourceTiling InTiling, VkDeviceSize& OutOffset) = 0;
+
+	/**
+	 *  @param  InOffset  offset returned by Allocate().
+	 *  @param  InSize    size passed to Allocate().
+	 */
+	virtual void Free(VkDeviceSize InOffset, VkDeviceSize InSize) = 0;
+
+	/**
+	 *  Drop every allocation at once.
+	 */
+	virtual void Reset() = 0;
+
+	virtual Stats GetStats() const = 0;
+
+	VkDeviceSize GetCapacity() const;
+
+	bool IsEmpty() const;
+
+	/**
+	 *  1 - largest free range / total free bytes, 0 means all free memory is contiguous.
+	 */
+	static float GetFragmentation(const Stats& InStats);
+
+protected:
+
+	VkDeviceSize m_capacity;
+	VkDeviceSize m_usedBytes;
+	uint32       m_allocationCount;
+};
+
+/**
+ *  Bump allocator for transient resources. Freed ranges are not reused one by
+ *  one, the whole block rewinds as soon as its last allocation is released.
+ *  Neighbours of different tiling are pushed apart to the granularity.
+ */
+class LinearSubAllocator : public MemorySubAllocator
+{
+
+public:
+
+	/**
+	 *  @param  InCapacity     block size in bytes.
+	 *  @param  InGranularity  VkPhysicalDeviceLimits::bufferImageGranularity.
+	 */
+	LinearSubAllocator(VkDeviceSize InCapacity, VkDeviceSize InGranularity);
+	virtual ~LinearSubAllocator();
+
+	virtual bool  Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, DeviceResourceTiling InTiling, VkDeviceSize& OutOffset) override;
+	virtual void  Free(VkDeviceSize InOffset, VkDeviceSize InSize) override;
+	virtual void  Reset() override;
+	virtual Stats GetStats() const override;
+
+private:
+
+	VkDeviceSize         m_granularity;
+	VkDeviceSize         m_head;         ///< End of the last allocation.
+	DeviceResourceTiling m_lastTiling;
+};
+
+/**
+ *  Binary buddy allocator for long lived resources. Every range is a power of
+ *  two aligned to its own size, so alignment comes for free and freeing merges
+ *  neighbours in O(log n). Tiling is not tracked, the owner keeps one block
+ *  per tiling.
+ */
+class BuddySubAllocator : public MemorySubAllocator
+{
+
+public:
+
+	/**
+	 *  @param  InCapacity      block size in bytes, a power of two.
+	 *  @param  InMinBlockSize  smallest range handed out, a power of two.
+	 */
+	BuddySubAllocator(VkDeviceSize InCapacity, VkDeviceSize InMinBlockSize);
+	virtual ~BuddySubAllocator();
+
+	virtual bool  Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, DeviceResourceTiling InTiling, VkDeviceSize& OutOffset) override;
+	virtual void  Free(VkDeviceSize InOffset, VkDeviceSize InSize) override;
+	virtual void  Reset() override;
+	virtual Stats GetStats() const override;
+
+private:
+
+	VkDeviceSize GetOrderSize(uint32 InOrder) const;
+
+private:
+
+	VkDeviceSize                            m_minBlockSize;
+	uint32                                  m_maxOrder;
+	VkDeviceSize                            m_reservedBytes;
+
+	std::vector<std::set<VkDeviceSize>>     m_freeRanges;    ///< Free offsets per order, lowest address first.
+	std::unordered_map<VkDeviceSize, uint8> m_liveOrders;    ///< Offset to order of live ranges.
+};
@@ -0,0 +1,193 @@
+﻿/*********************************************************************
+ *  StagingRing.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "StagingRing.h"
+#include "Core/Utilities/Math/Align.h"
+
+#pragma region StagingRing
+
+StagingRing::StagingRing(VkDeviceSize InCapacity) :
+	m_capacity  (InCapacity),
+	m_head      (_offset_0),
+	m_tail      (_offset_0),
+	m_usedBytes (_count_0),
+	m_openBytes (_count_0)
+{
+
+}
+
+bool StagingRing::Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, VkDeviceSize& OutOffset)
+{
+	if (InSize == 0 || InSize > m_capacity)
+		return false;
+
+	// Head and tail meet on a full ring as well as on an empty one.
+	if (m_usedBytes != 0 && m_head == m_tail)
+		return false;
+
+	VkDeviceSize offset = Math::AlignUp(m_head, std::max<VkDeviceSize>(InAlignment, 1));
+	VkDeviceSize bytes  = _count_0;
+
+	if (m_head >= m_tail)
+	{
+		if (offset + InSize <= m_capacity)
+		{
+			bytes = offset + InSize - m_head;
+		}
+		else if (InSize <= m_tail || m_usedBytes == 0)
+		{
+			// Wrap around, the skipped end of the ring is retired with this ticket.
+			offset = _offset_0;
+			bytes  = m_capacity - m_head + InSize;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		if (offset + InSize > m_tail)
+			return false;
+
+		bytes = offset + InSize - m_head;
+	}
+
+	m_head       = offset + InSize == m_capacity ? _offset_0 : offset + InSize;
+	m_usedBytes += bytes;
+	m_openBytes += bytes;
+
+	OutOffset = offset;
+	return true;
+}
+
+void StagingRing::Submit(uint64 InTicket)
+{
+	if (m_openBytes == 0)
+		return;
+
+	assert(m_spans.empty() || m_spans.back().Ticket < InTicket);
+
+	m_spans.push_back({ InTicket, m_head, m_openBytes });
+	m_openBytes = _count_0;
+}
+
+void StagingRing::Retire(uint64 InCompletedTicket)
+{
+	while (!m_spans.empty() && m_spans.front().Ticket <= InCompletedTicket)
+	{
+		m_tail       = m_spans.front().End;
+		m_usedBytes -= m_spans.front().Bytes;
+		m_spans.pop_front();
+	}
+
+	// Start over from the front while nothing is in use, big requests then never need to wrap.
+	if (m_usedBytes == 0)
+	{
+		m_head = _offset_0;
+		m_tail = _offset_0;
+	}
+}
+
+VkDeviceSize StagingRing::GetLargestFreeRange() const
+{
+	if (m_usedBytes == 0)
+		return m_capacity;
+
+	if (m_head == m_tail)
+		return 0;
+
+	if (m_head > m_tail)
+		return std::max(m_capacity - m_head, m_tail);
+
+	return m_tail - m_head;
+}
+
+VkDeviceSize StagingRing::GetCapacity() const
+{
+	return m_capacity;
+}
+
+VkDeviceSize StagingRing::GetUsedBytes() const
+{
+	return m_usedBytes;
+}
+
+#pragma endregion
+
+#pragma region CopyBatch
+
+bool CopyBatch::Add(VkBuffer InDstBuffer, VkDeviceSize InSrcOffset, VkDeviceSize InDstOffset, VkDeviceSize InSize)
+{
+	if (InSize == 0)
+		return true;
+
+	auto found = m_destinationIndices.find(InDstBuffer);
+	if (found == m_destinationIndices.end())
+	{
+		found = m_destinationIndices.emplace(InDstBuffer, (uint32)m_destinations.size()).first;
+
+		m_destinations.emplace_back();
+		m_destinations.back().Buffer = InDstBuffer;
+	}
+
+	Destination& destination = m_destinations[found->second];
+
+	// Overlapping destination regions of one command land in no defined order.
+	auto next = destination.Ranges.lower_bound(InDstOffset);
+	if (next != destination.Ranges.end() && next->first < InDstOffset + InSize)
+		return false;
+
+	if (next != destination.Ranges.begin() && std::prev(next)->second > InDstOffset)
+		return false;
+
+	if (!destination.Regions.empty())
+	{
+		VkBufferCopy& last = destination.Regions.back();
+		if (last.srcOffset + last.size == InSrcOffset && last.dstOffset + last.size == InDstOffset)
+		{
+			last.size += InSize;
+			destination.Ranges[last.dstOffset] = last.dstOffset + last.size;
+			return true;
+		}
+	}
+
+	VkBufferCopy region;
+	region.srcOffset = InSrcOffset;
+	region.dstOffset = InDstOffset;
+	region.size      = InSize;
+
+	destination.Regions.push_back(region);
+	destination.Ranges[InDstOffset] = InDstOffset + InSize;
+
+	return true;
+}
+
+void CopyBatch::Clear()
+{
+	m_destinations.clear();
+	m_destinationIndices.clear();
+}
+
+bool CopyBatch::IsEmpty() const
+{
+	return m_destinations.empty();
+}
+
+uint32 CopyBatch::GetRegionCount() const
+{
+	uint32 count = _count_0;
+	for (auto& destination : m_destinations)
+		count += (uint32)destination.Regions.size();
+
+	return count;
+}
+
+const std::vector<CopyBatch::Destination>& CopyBatch::GetDestinations() const
+{
+	return m_destinations;
+}
+
+#pragma endregion
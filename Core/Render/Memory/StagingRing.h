@@ -0,0 +1,107 @@
+﻿/*********************************************************************
+ *  StagingRing.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Ring allocator and copy coalescing behind the upload manager.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include <deque>
+#include <map>
+
+/**
+ *  Hands out ranges of a staging buffer in submission order. Ranges allocated
+ *  between two Submit() calls share a ticket, Retire() gives back every range
+ *  whose ticket the GPU is done with. Only offsets are managed, the owner maps
+ *  tickets to fences.
+ */
+class StagingRing
+{
+
+public:
+
+	StagingRing(VkDeviceSize InCapacity);
+
+	/**
+	 *  @param  InSize       size in bytes, not bigger than the capacity.
+	 *  @param  InAlignment  power of two alignment of the offset.
+	 *  @param  OutOffset    offset in the ring on success.
+	 * 
+	 *  @return false if the ring has no contiguous room until something retires.
+	 */
+	bool Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, VkDeviceSize& OutOffset);
+
+	/**
+	 *  Close the ranges allocated since the last call under InTicket. Tickets have to grow.
+	 */
+	void Submit(uint64 InTicket);
+
+	/**
+	 *  Give back the ranges of every ticket up to InCompletedTicket.
+	 */
+	void Retire(uint64 InCompletedTicket);
+
+	/**
+	 *  Largest request that would succeed right now with a 1 byte alignment.
+	 */
+	VkDeviceSize GetLargestFreeRange() const;
+
+	VkDeviceSize GetCapacity() const;
+	VkDeviceSize GetUsedBytes() const;
+
+private:
+
+	struct Span
+	{
+		uint64       Ticket;
+		VkDeviceSize End;       ///< Head position when the ticket was submitted.
+		VkDeviceSize Bytes;     ///< Bytes of the ticket, wrap padding included.
+	};
+
+	VkDeviceSize     m_capacity;
+	VkDeviceSize     m_head;           ///< Next free byte.
+	VkDeviceSize     m_tail;           ///< Oldest byte still in use.
+	VkDeviceSize     m_usedBytes;
+	VkDeviceSize     m_openBytes;      ///< Allocated since the last Submit().
+
+	std::deque<Span> m_spans;
+};
+
+/**
+ *  Collects buffer copies out of one staging buffer and merges them into as few
+ *  regions as possible, one vkCmdCopyBuffer per destination buffer. Destination
+ *  regions of a single command may not overlap, Add() refuses such a copy and
+ *  the caller starts a new batch after a barrier.
+ */
+class CopyBatch
+{
+
+public:
+
+	struct Destination
+	{
+		VkBuffer                               Buffer;
+		std::vector<VkBufferCopy>              Regions;
+		std::map<VkDeviceSize, VkDeviceSize>   Ranges;    ///< Written destination ranges, begin to end.
+	};
+
+	/**
+	 *  @return false if the destination range overlaps a copy already in the batch.
+	 */
+	bool Add(VkBuffer InDstBuffer, VkDeviceSize InSrcOffset, VkDeviceSize InDstOffset, VkDeviceSize InSize);
+
+	void Clear();
+
+	bool IsEmpty() const;
+
+	uint32 GetRegionCount() const;
+
+	const std::vector<Destination>& GetDestinations() const;
+
+private:
+
+	std::vector<Destination>             m_destinations;
+	std::unordered_map<VkBuffer, uint32> m_destinationIndices;
+};
@@ -0,0 +1,316 @@
+﻿/*********************************************************************
+ *  UploadManager.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "UploadManager.h"
+#include "DeviceMemoryAllocator.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/CommandList.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/RenderBaseConfig.h"
+
+_impl_create_interface(UploadManager)
+
+UploadManager::UploadManager() :
+	m_pBaseLayer         (nullptr),
+	m_device             (VK_NULL_HANDLE),
+	m_stagingBuffer      (VK_NULL_HANDLE),
+	m_pStagingAllocation (nullptr),
+	m_pMapped            (nullptr),
+	m_ring               (RenderBaseConfig::Upload::StagingRingSize),
+	m_ticket             (_count_1),
+	m_frameBytes         (_count_0)
+{
+
+}
+
+UploadManager::~UploadManager()
+{
+	if (!m_pendingUploads.empty())
+		_log_warning(StringUtil::Printf("%: % uploads were never flushed!", _name_of(UploadManager), m_pendingUploads.size()), LogSystem::Category::Memory);
+
+	if (m_stagingBuffer != VK_NULL_HANDLE)
+	{
+		vkDestroyBuffer(m_device, m_stagingBuffer, m_pBaseLayer->GetVkAllocator());
+		m_pBaseLayer->GetLogicalDevice()->GetMemAllocator()->Free(m_pStagingAllocation);
+	}
+}
+
+void UploadManager::Init(BaseLayer* InBaseLayer)
+{
+	m_pBaseLayer = InBaseLayer;
+	m_device     = InBaseLayer->GetLogicalDevice()->GetVkDevice();
+}
+
+void UploadManager::UploadBuffer(VkBuffer InDstBuffer, VkDeviceSize InDstOffset, const void* InData, VkDeviceSize InSize)
+{
+	if (InSize == 0)
+		return;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (!CreateStagingBuffer())
+		return;
+
+	const uint8* data = (const uint8*)InData;
+
+	// Staging ahead of older pending uploads would reorder writes to the same range.
+	VkDeviceSize staged = m_pendingUploads.empty() ? StageBuffer(InDstBuffer, InDstOffset, data, InSize) : 0;
+	if (staged == InSize)
+		return;
+
+	PendingUpload upload;
+	upload.DstBuffer   = InDstBuffer;
+	upload.DstImage    = VK_NULL_HANDLE;
+	upload.DstOffset   = InDstOffset + staged;
+	upload.StagedBytes = _count_0;
+	upload.Data.assign(data + staged, data + InSize);
+	_zero_memory_struct(upload.ImageRegion);
+
+	m_pendingUploads.push_back(std::move(upload));
+}
+
+void UploadManager::UploadImage(VkImage InDstImage, const VkBufferImageCopy& InRegion, const void* InData, VkDeviceSize InSize)
+{
+	if (InSize == 0)
+		return;
+
+	if (InSize > m_ring.GetCapacity() - RenderBaseConfig::Upload::CopyAlignment)
+	{
+		_log_error(StringUtil::Printf("%: Image upload of % bytes does not fit in the staging ring!", _name_of(UploadImage), InSize), LogSystem::Category::Memory);
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (!CreateStagingBuffer())
+		return;
+
+	const uint8* data = (const uint8*)InData;
+
+	if (m_pendingUploads.empty() && StageImage(InDstImage, InRegion, data, InSize))
+		return;
+
+	PendingUpload upload;
+	upload.DstBuffer   = VK_NULL_HANDLE;
+	upload.DstImage    = InDstImage;
+	upload.DstOffset   = _offset_0;
+	upload.ImageRegion = InRegion;
+	upload.StagedBytes = _count_0;
+	upload.Data.assign(data, data + InSize);
+
+	m_pendingUploads.push_back(std::move(upload));
+}
+
+UploadManager::FlushStats UploadManager::Flush(CommandList* InCmdList, VkFence InFence)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	FlushStats stats = {};
+
+	RetireCompletedFlushes();
+
+	while (!m_pendingUploads.empty())
+	{
+		PendingUpload& upload = m_pendingUploads.front();
+
+		if (upload.DstImage != VK_NULL_HANDLE)
+		{
+			if (!StageImage(upload.DstImage, upload.ImageRegion, upload.Data.data(), (VkDeviceSize)upload.Data.size()))
+				break;
+		}
+		else
+		{
+			const VkDeviceSize size = (VkDeviceSize)upload.Data.size();
+
+			upload.StagedBytes += StageBuffer(upload.DstBuffer, upload.DstOffset + upload.StagedBytes, upload.Data.data() + upload.StagedBytes, size - upload.StagedBytes);
+			if (upload.StagedBytes < size)
+				break;
+		}
+
+		m_pendingUploads.pop_front();
+	}
+
+	for (auto& upload : m_pendingUploads)
+		stats.PendingBytes += (VkDeviceSize)upload.Data.size() - upload.StagedBytes;
+
+	if (m_frameBytes == 0)
+		return stats;
+
+	VkMemoryBarrier memBarrier;
+	memBarrier.sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memBarrier.pNext         = nullptr;
+	memBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	for (uint32 batchIndex = 0; batchIndex < (uint32)m_batches.size(); ++batchIndex)
+	{
+		// Later writes to the same range have to land last.
+		if (batchIndex != 0)
+			InCmdList->MemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, memBarrier);
+
+		for (auto& destination : m_batches[batchIndex].GetDestinations())
+		{
+			InCmdList->CopyBuffer(m_stagingBuffer, destination.Buffer, (uint32)destination.Regions.size(), destination.Regions.data());
+
+			stats.CopyCommandCount++;
+			stats.RegionCount += (uint32)destination.Regions.size();
+		}
+	}
+
+	// Consecutive regions of the same image go out in one command.
+	std::vector<VkBufferImageCopy> imageRegions;
+	for (uint32 copyIndex = 0; copyIndex < (uint32)m_imageCopies.size(); ++copyIndex)
+	{
+		imageRegions.push_back(m_imageCopies[copyIndex].Region);
+
+		if (copyIndex + 1 == (uint32)m_imageCopies.size() || m_imageCopies[copyIndex + 1].DstImage != m_imageCopies[copyIndex].DstImage)
+		{
+			InCmdList->CopyBufferToImage(m_stagingBuffer, m_imageCopies[copyIndex].DstImage, (uint32)imageRegions.size(), imageRegions.data());
+
+			stats.CopyCommandCount++;
+			stats.RegionCount += (uint32)imageRegions.size();
+			imageRegions.clear();
+		}
+	}
+
+	memBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	InCmdList->MemoryBarrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, memBarrier);
+
+	if (InFence == VK_NULL_HANDLE)
+		_log_error(StringUtil::Printf("%: No fence given, staging ranges are never reused!", _name_of(Flush)), LogSystem::Category::Memory);
+
+	m_ring.Submit(m_ticket);
+	m_inFlightFlushes.push_back({ m_ticket, InFence });
+	m_ticket++;
+
+	stats.StagedBytes = m_frameBytes;
+
+	m_batches.clear();
+	m_imageCopies.clear();
+	m_frameBytes = _count_0;
+
+	return stats;
+}
+
+bool UploadManager::HasPendingUploads() const
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	return !m_pendingUploads.empty() || m_frameBytes != 0;
+}
+
+bool UploadManager::CreateStagingBuffer()
+{
+	if (m_stagingBuffer != VK_NULL_HANDLE)
+		return true;
+
+	VkBufferCreateInfo bufferInfo;
+	_zero_memory_struct(bufferInfo);
+	bufferInfo.sType       = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size        = m_ring.GetCapacity();
+	bufferInfo.usage       = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	_vk_try(vkCreateBuffer(m_device, &bufferInfo, m_pBaseLayer->GetVkAllocator(), &m_stagingBuffer));
+
+	// Coherent memory, host writes are made visible by the queue submission.
+	DeviceMemoryAllocator::AllocationInfo allocInfo;
+	allocInfo.PreferredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.RequiredFlags  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.Lifetime       = DeviceMemoryLifetime::Persistent;
+	allocInfo.Tiling         = DeviceResourceTiling::Linear;
+
+	m_pStagingAllocation = m_pBaseLayer->GetLogicalDevice()->GetMemAllocator()->AllocateForBuffer(m_stagingBuffer, allocInfo);
+	if (m_pStagingAllocation == nullptr || m_pStagingAllocation->pMapped == nullptr)
+	{
+		_log_error(StringUtil::Printf("%: No host visible memory for the staging buffer!", _name_of(CreateStagingBuffer)), LogSystem::Category::Memory);
+
+		m_pBaseLayer->GetLogicalDevice()->GetMemAllocator()->Free(m_pStagingAllocation);
+		vkDestroyBuffer(m_device, m_stagingBuffer, m_pBaseLayer->GetVkAllocator());
+
+		m_pStagingAllocation = nullptr;
+		m_stagingBuffer      = VK_NULL_HANDLE;
+		return false;
+	}
+
+	m_pMapped = (uint8*)m_pStagingAllocation->pMapped;
+	return true;
+}
+
+VkDeviceSize UploadManager::StageBuffer(VkBuffer InDstBuffer, VkDeviceSize InDstOffset, const uint8* InData, VkDeviceSize InSize)
+{
+	const VkDeviceSize alignment = RenderBaseConfig::Upload::CopyAlignment;
+
+	VkDeviceSize staged = _count_0;
+
+	while (staged < InSize && m_frameBytes < RenderBaseConfig::Upload::FrameBudget)
+	{
+		// The largest free range may lose up to an alignment to the offset rounding.
+		const VkDeviceSize largest = m_ring.GetLargestFreeRange();
+		const VkDeviceSize room    = largest > alignment ? largest - alignment : 0;
+
+		VkDeviceSize chunk = std::min(InSize - staged, RenderBaseConfig::Upload::FrameBudget - m_frameBytes);
+		chunk = std::min(chunk, room);
+
+		if (chunk < std::min(InSize - staged, RenderBaseConfig::Upload::MinChunkSize))
+			break;
+
+		VkDeviceSize offset = _offset_0;
+		if (!m_ring.Allocate(chunk, alignment, offset))
+			break;
+
+		memcpy(m_pMapped + offset, InData + staged, (usize)chunk);
+
+		if (m_batches.empty() || !m_batches.back().Add(InDstBuffer, offset, InDstOffset + staged, chunk))
+		{
+			m_batches.emplace_back();
+			m_batches.back().Add(InDstBuffer, offset, InDstOffset + staged, chunk);
+		}
+
+		staged       += chunk;
+		m_frameBytes += chunk;
+	}
+
+	return staged;
+}
+
+bool UploadManager::StageImage(VkImage InDstImage, const VkBufferImageCopy& InRegion, const uint8* InData, VkDeviceSize InSize)
+{
+	// An image bigger than the budget still goes out alone, it would wait forever otherwise.
+	if (m_frameBytes != 0 && m_frameBytes + InSize > RenderBaseConfig::Upload::FrameBudget)
+		return false;
+
+	VkDeviceSize offset = _offset_0;
+	if (!m_ring.Allocate(InSize, RenderBaseConfig::Upload::CopyAlignment, offset))
+		return false;
+
+	memcpy(m_pMapped + offset, InData, (usize)InSize);
+
+	ImageCopy copy;
+	copy.DstImage            = InDstImage;
+	copy.Region              = InRegion;
+	copy.Region.bufferOffset = offset;
+
+	m_imageCopies.push_back(copy);
+	m_frameBytes += InSize;
+
+	return true;
+}
+
+void UploadManager::RetireCompletedFlushes()
+{
+	uint64 completedTicket = _count_0;
+
+	// Flushes complete in submission order, the first pending fence ends the scan.
+	while (!m_inFlightFlushes.empty() && m_inFlightFlushes.front().Fence != VK_NULL_HANDLE &&
+		vkGetFenceStatus(m_device, m_inFlightFlushes.front().Fence) == VK_SUCCESS)
+	{
+		completedTicket = m_inFlightFlushes.front().Ticket;
+		m_inFlightFlushes.pop_front();
+	}
+
+	if (completedTicket != 0)
+		m_ring.Retire(completedTicket);
+}
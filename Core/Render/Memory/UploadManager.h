@@ -0,0 +1,134 @@
+﻿/*********************************************************************
+ *  UploadManager.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Streams host data to buffers and images through a staging ring.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include "StagingRing.h"
+#include <mutex>
+
+class BaseLayer;
+class CommandList;
+struct DeviceAllocation;
+
+/**
+ *  Host data is written into a persistently mapped staging buffer right
+ *  away when the frame budget allows it, otherwise it is copied aside and
+ *  staged by later Flush() calls. Flush() records one vkCmdCopyBuffer per
+ *  destination buffer with every region of the frame, ranges of the ring are
+ *  given back once the fence passed to Flush() signals. Uploads bigger than
+ *  RenderBaseConfig::Upload::FrameBudget are split across frames.
+ */
+class UploadManager : public IResourceHandler
+{
+	_declare_create_interface(UploadManager)
+
+protected:
+
+	UploadManager();
+
+public:
+
+	virtual ~UploadManager();
+
+	void Init(BaseLayer* InBaseLayer);
+
+public:
+
+	struct FlushStats
+	{
+		VkDeviceSize StagedBytes;          ///< Bytes copied by the recorded commands.
+		VkDeviceSize PendingBytes;         ///< Bytes left for later frames.
+		uint32       CopyCommandCount;
+		uint32       RegionCount;
+	};
+
+	/**
+	 *  Write InData to the buffer with the next Flush(), or the ones after it if the budget is used up.
+	 * 
+	 *  @param  InDstBuffer  buffer created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+	 *  @param  InDstOffset  byte offset in the buffer.
+	 *  @param  InData       data, copied before returning.
+	 *  @param  InSize       size in bytes.
+	 */
+	void UploadBuffer(VkBuffer InDstBuffer, VkDeviceSize InDstOffset, const void* InData, VkDeviceSize InSize);
+
+	/**
+	 *  Write InData to the image region, the image has to be in
+	 *  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL when the command list executes.
+	 *  An image upload is never split, it has to fit in the staging ring.
+	 * 
+	 *  @param  InRegion  copy region, bufferOffset is ignored and bufferRowLength/bufferImageHeight describe InData.
+	 *  @param  InData    tightly packed texels unless InRegion says otherwise, copied before returning.
+	 *  @param  InSize    size in bytes.
+	 */
+	void UploadImage(VkImage InDstImage, const VkBufferImageCopy& InRegion, const void* InData, VkDeviceSize InSize);
+
+	/**
+	 *  Record the staged copies, followed by a barrier that makes them visible to every later command.
+	 * 
+	 *  @param  InCmdList  command list submitted before any use of the uploaded data.
+	 *  @param  InFence    fence signaled by the submission of InCmdList.
+	 */
+	FlushStats Flush(CommandList* InCmdList, VkFence InFence);
+
+	bool HasPendingUploads() const;
+
+protected:
+
+	struct PendingUpload
+	{
+		VkBuffer                 DstBuffer;
+		VkImage                  DstImage;
+		VkDeviceSize             DstOffset;
+		VkBufferImageCopy        ImageRegion;
+		std::vector<uint8>       Data;
+		VkDeviceSize             StagedBytes;
+	};
+
+	struct InFlightFlush
+	{
+		uint64                   Ticket;
+		VkFence                  Fence;
+	};
+
+	struct ImageCopy
+	{
+		VkImage                  DstImage;
+		VkBufferImageCopy        Region;
+	};
+
+	bool CreateStagingBuffer();
+
+	/**
+	 *  @return bytes staged, as many as the budget and the ring allow.
+	 */
+	VkDeviceSize StageBuffer(VkBuffer InDstBuffer, VkDeviceSize InDstOffset, const uint8* InData, VkDeviceSize InSize);
+
+	bool StageImage(VkImage InDstImage, const VkBufferImageCopy& InRegion, const uint8* InData, VkDeviceSize InSize);
+
+	void RetireCompletedFlushes();
+
+protected:
+
+	BaseLayer*                   m_pBaseLayer;
+	VkDevice                     m_device;
+
+	VkBuffer                     m_stagingBuffer;
+	DeviceAllocation*            m_pStagingAllocation;
+	uint8*                       m_pMapped;
+
+	mutable std::mutex           m_mutex;
+	StagingRing                  m_ring;
+	uint64                       m_ticket;
+	VkDeviceSize                 m_frameBytes;        ///< Bytes staged since the last Flush().
+
+	std::vector<CopyBatch>       m_batches;           ///< A new batch starts where a copy overlaps an earlier one.
+	std::vector<ImageCopy>       m_imageCopies;
+	std::deque<PendingUpload>    m_pendingUploads;
+	std::deque<InFlightFlush>    m_inFlightFlushes;
+};
@@ -5,11 +5,16 @@
 
 #include "CommandQueue.h"
 #include "CommandList.h"
+#include "LogicalDevice.h"
+#include "Core/Base/BaseConfig.h"
+#include "Core/Base/BaseLayer.h"
 
 _impl_create_interface(CommandQueue)
 
 CommandQueue::CommandQueue() : 
-	m_queue (VK_NULL_HANDLE)
+	m_queue           (VK_NULL_HANDLE),
+	m_pBaseLayer      (nullptr),
+	m_frameFenceIndex (_index_0)
 {
 
 }
@@ -24,6 +29,12 @@ CommandQueue& CommandQueue::operator=(const VkQueue& InQueue)
 	return *this;
 }
 
+void CommandQueue::Init(BaseLayer* InBaseLayer)
+{
+	m_pBaseLayer = InBaseLayer;
+	m_frameFences.resize(BaseConfig::DefaultSwapchainCreateInfo.frameCount);
+}
+
 CommandQueue::operator VkQueue()
 {
 	return m_queue;
@@ -56,6 +67,36 @@ void CommandQueue::Flush()
 	_vk_try(vkQueueWaitIdle(m_queue));
 }
 
+VkFence CommandQueue::SignalFrameFence()
+{
+	if (m_queue == VK_NULL_HANDLE)
+		return VK_NULL_HANDLE;
+
+	LogicalDevice* pDevice = m_pBaseLayer->GetLogicalDevice();
+	VkSmartPtr<VkFence>& pFence = m_frameFences[m_frameFenceIndex];
+
+	if (!pFence.IsValid())
+	{
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		_vk_try(vkCreateFence(pDevice->GetVkDevice(), &fenceCreateInfo, pDevice->GetVkAllocator(), pFence.MakeInstance(pDevice->GetDeviceContext())));
+	}
+	else
+	{
+		// The bucket closed with this fence frameCount frames ago is looked at before it is reused.
+		_vk_try(vkWaitForFences(pDevice->GetVkDevice(), _count_1, pFence, VK_TRUE, UINT64_MAX));
+		_vk_try(vkResetFences(pDevice->GetVkDevice(), _count_1, pFence));
+	}
+
+	// An empty submission signals after all the ones before it on the queue.
+	_vk_try(vkQueueSubmit(m_queue, _count_0, nullptr, *pFence));
+
+	m_frameFenceIndex = (m_frameFenceIndex + 1) % (uint32)m_frameFences.size();
+
+	return *pFence;
+}
+
 void CommandQueue::Present(const VkPresentInfoKHR& InPresentInfo)
 {
 	_vk_try(vkQueuePresentKHR(m_queue, &InPresentInfo));
@@ -9,6 +9,7 @@
 
 #include "Core/Common.h"
 
+class BaseLayer;
 class CommandList;
 
 class CommandQueue : public IResourceHandler
@@ -19,6 +20,10 @@ protected:
 
 	VkQueue m_queue;
 
+	BaseLayer*                          m_pBaseLayer;
+	std::vector<VkSmartPtr<VkFence>>    m_frameFences;      ///< One per frame resource, in step with the destroy buckets of the VkDeviceContext.
+	uint32                              m_frameFenceIndex;
+
 	CommandQueue();
 
 public:
@@ -26,6 +31,8 @@ public:
 	virtual ~CommandQueue();
 	CommandQueue& operator=(const VkQueue& InQueue);
 
+	void Init(BaseLayer* InBaseLayer);
+
 public:
 
 	operator VkQueue();
@@ -38,6 +45,14 @@ public:
 	void Execute(const CommandList* InCmdList);
 	void Flush();
 
+	/**
+	 *  Close the frame, the fence returned signals once everything submitted to the queue so far is done.
+	 *  Waits for the fence of the frame that used the slot before, at most frameCount frames ago.
+	 * 
+	 *  @return the fence for VkDeviceContext::NextFrame(), VK_NULL_HANDLE while the queue is not set.
+	 */
+	VkFence SignalFrameFence();
+
 	// It needs to be supplemented...
 	void Present(const VkPresentInfoKHR& InPresentInfo);
 };
\ No newline at end of file
@@ -5,18 +5,166 @@
 
 #include "Core/Base/BaseLayer.h"
 #include "Core/Base/ResourcePool.h"
+#include "Core/Base/ScratchArena.h"
 #include "Core/Base/BaseAllocator.h"
 #include "Core/Platform/Windows/Window.h"
+#include "Core/Utilities/Math/Hash.h"
 #include "Core/Render/GLSLCompiler.h"
+#include "Core/Render/ShaderCache.h"
+#include "Core/Render/Memory/DeviceMemoryAllocator.h"
+#include "Core/Render/Memory/UploadManager.h"
 #include "LogicalDevice.h"
+#include "PipelineCacheManager.h"
+#include "SamplerCache.h"
+#include "PipelineRequestQueue.h"
+#include "PipelinePack.h"
 #include "RenderBaseConfig.h"
 #include "CommandQueue.h"
 #include "Core/Engine/Engine.h"
+#include <atomic>
+#include <thread>
+#include <filesystem>
 
 #include "LogicalDevice.inl"
 
 _impl_create_interface(LogicalDevice)
 
+namespace
+{
+	uint32 GetStageCount(const VkGraphicsPipelineCreateInfo& InCreateInfo)
+	{
+		return InCreateInfo.stageCount;
+	}
+
+	uint32 GetStageCount(const VkComputePipelineCreateInfo&)
+	{
+		return _count_1;
+	}
+
+	/**
+	 *  Every value of a render pass create info field by field, pointers and padding left out.
+	 *  Used as the key itself, equal keys are equal render passes.
+	 */
+	string MakeRenderPassKey(const VkRenderPassCreateInfo& InCreateInfo)
+	{
+		string key;
+
+		auto append = [&key](uint32 InValue)
+		{
+			key.append((const char*)&InValue, sizeof(uint32));
+		};
+
+		auto appendRefs = [&append](const VkAttachmentReference* InRefs, uint32 InCount)
+		{
+			append(InRefs != nullptr ? InCount : _count_0);
+
+			for (uint32 i = 0; InRefs != nullptr && i < InCount; i++)
+			{
+				append(InRefs[i].attachment);
+				append((uint32)InRefs[i].layout);
+			}
+		};
+
+		append(InCreateInfo.flags);
+
+		append(InCreateInfo.attachmentCount);
+		for (uint32 i = 0; i < InCreateInfo.attachmentCount; i++)
+		{
+			const VkAttachmentDescription& attachment = InCreateInfo.pAttachments[i];
+
+			append(attachment.flags);
+			append((uint32)attachment.format);
+			append((uint32)attachment.samples);
+			append((uint32)attachment.loadOp);
+			append((uint32)attachment.storeOp);
+			append((uint32)attachment.stencilLoadOp);
+			append((uint32)attachment.stencilStoreOp);
+			append((uint32)attachment.initialLayout);
+			append((uint32)attachment.finalLayout);
+		}
+
+		append(InCreateInfo.subpassCount);
+		for (uint32 i = 0; i < InCreateInfo.subpassCount; i++)
+		{
+			const VkSubpassDescription& subpass = InCreateInfo.pSubpasses[i];
+
+			append(subpass.flags);
+			append((uint32)subpass.pipelineBindPoint);
+
+			appendRefs(subpass.pInputAttachments,       subpass.inputAttachmentCount);
+			appendRefs(subpass.pColorAttachments,       subpass.colorAttachmentCount);
+			appendRefs(subpass.pResolveAttachments,     subpass.colorAttachmentCount);
+			appendRefs(subpass.pDepthStencilAttachment, _count_1);
+
+			append(subpass.pPreserveAttachments != nullptr ? subpass.preserveAttachmentCount : _count_0);
+			for (uint32 j = 0; subpass.pPreserveAttachments != nullptr && j < subpass.preserveAttachmentCount; j++)
+				append(subpass.pPreserveAttachments[j]);
+		}
+
+		append(InCreateInfo.dependencyCount);
+		for (uint32 i = 0; i < InCreateInfo.dependencyCount; i++)
+		{
+			const VkSubpassDependency& dependency = InCreateInfo.pDependencies[i];
+
+			append(dependency.srcSubpass);
+			append(dependency.dstSubpass);
+			append(dependency.srcStageMask);
+			append(dependency.dstStageMask);
+			append(dependency.srcAccessMask);
+			append(dependency.dstAccessMask);
+			append(dependency.dependencyFlags);
+		}
+
+		return key;
+	}
+
+	template<typename T>
+	void AppendKey(string& OutKey, T InValue)
+	{
+		OutKey.append((const char*)&InValue, sizeof(T));
+	}
+
+	/**
+	 *  Copies of the create infos with creation feedback in front of their pNext chains.
+	 */
+	template<typename TCreateInfo>
+	struct FeedbackChain
+	{
+		ScratchVector<TCreateInfo>                             CreateInfos;
+		ScratchVector<VkPipelineCreationFeedbackCreateInfoEXT> FeedbackInfos;
+		ScratchVector<VkPipelineCreationFeedbackEXT>           Feedbacks;
+		ScratchVector<VkPipelineCreationFeedbackEXT>           StageFeedbacks;
+
+		FeedbackChain(const TCreateInfo* InCreateInfos, uint32 InCount) :
+			CreateInfos   (InCreateInfos, InCreateInfos + InCount),
+			FeedbackInfos (InCount),
+			Feedbacks     (InCount)
+		{
+			uint32 stageCount = _count_0;
+			for (auto& createInfo : CreateInfos)
+				stageCount += GetStageCount(createInfo);
+
+			// Drivers before 1.3 want one stage feedback per stage, not none.
+			StageFeedbacks.resize(stageCount);
+
+			VkPipelineCreationFeedbackEXT* pStageFeedbacks = StageFeedbacks.data();
+
+			for (uint32 i = 0; i < InCount; ++i)
+			{
+				VkPipelineCreationFeedbackCreateInfoEXT& feedbackInfo = FeedbackInfos[i];
+				feedbackInfo.sType                              = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT;
+				feedbackInfo.pNext                              = CreateInfos[i].pNext;
+				feedbackInfo.pPipelineCreationFeedback          = &Feedbacks[i];
+				feedbackInfo.pipelineStageCreationFeedbackCount = GetStageCount(CreateInfos[i]);
+				feedbackInfo.pPipelineStageCreationFeedbacks    = pStageFeedbacks;
+
+				pStageFeedbacks     += feedbackInfo.pipelineStageCreationFeedbackCount;
+				CreateInfos[i].pNext = &feedbackInfo;
+			}
+		}
+	};
+}
+
 LogicalDevice::LogicalDevice() : 
 	m_device     (VK_NULL_HANDLE),
 	m_pBaseLayer (nullptr),
@@ -24,6 +172,29 @@ LogicalDevice::LogicalDevice() :
 {
 	m_pCompiler = GLSLCompiler::Create(this);
 	m_pCmdQueue = CommandQueue::Create(this);
+
+	m_pPipelineCacheManager = PipelineCacheManager::Create(this);
+	m_pSamplerCache         = SamplerCache::Create(this);
+	m_pPipelineRequestQueue = PipelineRequestQueue::Create(this);
+
+	m_renderPassParseCount        = _count_0;
+	m_renderPassCreateCount       = _count_0;
+	m_renderPassPathHitCount      = _count_0;
+	m_renderPassStructureHitCount = _count_0;
+
+	m_descSetLayoutCreateCount    = _count_0;
+	m_descSetLayoutHitCount       = _count_0;
+	m_pipelineLayoutCreateCount   = _count_0;
+	m_pipelineLayoutHitCount      = _count_0;
+
+	m_maxPipelineVariantCount     = RenderBaseConfig::Pipeline::MaxVariantCount;
+	m_pipelineVariantCreateCount  = _count_0;
+	m_pipelineVariantHitCount     = _count_0;
+	m_pipelineVariantEvictCount   = _count_0;
+
+	// Children are deleted in creation order, the staging memory goes back to a live allocator.
+	m_pUploadManager = UploadManager::Create(this);
+	m_pMemAllocator  = DeviceMemoryAllocator::Create(this);
 }
 
 VkAllocationCallbacks* LogicalDevice::GetVkAllocator() const
@@ -39,7 +210,44 @@ LogicalDevice& LogicalDevice::operator=(const VkDevice& InDevice)
 
 LogicalDevice::~LogicalDevice()
 {
+	// Workers build with the members below, they stop first.
+	m_pPipelineRequestQueue->Shutdown();
+
+	// Saved while m_pContext still holds the device.
+	const bool bPipelineCacheSaved = m_pPipelineCacheManager->Save();
+
+	const PipelineCacheManager::Stats pipelineCacheStats = m_pPipelineCacheManager->GetStats();
+	const uint64 trackedCount = pipelineCacheStats.PipelineCount - pipelineCacheStats.UntrackedCount;
+
+	_log_common(StringUtil::Printf("%: hit rate %, % of % tracked pipelines, % untracked, % KB loaded, %.", _name_of(PipelineCacheManager),
+		trackedCount != 0 ? (double)pipelineCacheStats.HitCount / trackedCount : 0.0, pipelineCacheStats.HitCount, trackedCount, pipelineCacheStats.UntrackedCount,
+		pipelineCacheStats.LoadedBytes / 1024, bPipelineCacheSaved ? StringUtil::Printf("% KB saved", pipelineCacheStats.SavedBytes / 1024) : string("unchanged, not saved")), LogSystem::Category::LogicalDevice);
+
+	const ShaderCache::Stats shaderCacheStats = ShaderCache::Get().GetStats();
+
+	_log_common(StringUtil::Printf("%: % hits, % misses, % stores, % evictions, % KB on disk.", _name_of(ShaderCache), shaderCacheStats.HitCount,
+		shaderCacheStats.MissCount, shaderCacheStats.StoreCount, shaderCacheStats.EvictionCount, shaderCacheStats.TotalBytes / 1024), LogSystem::Category::GLSLCompiler);
 
+	_log_common(StringUtil::Printf("Render passes: % parsed, % created, % path hits, % shared by structure.", m_renderPassParseCount,
+		m_renderPassCreateCount, m_renderPassPathHitCount, m_renderPassStructureHitCount), LogSystem::Category::RenderPass);
+
+	_log_common(StringUtil::Printf("Layouts: % set layouts created, % shared, % pipeline layouts created, % shared.", m_descSetLayoutCreateCount,
+		m_descSetLayoutHitCount, m_pipelineLayoutCreateCount, m_pipelineLayoutHitCount), LogSystem::Category::LogicalDevice);
+
+	const SamplerCache::Stats samplerStats = m_pSamplerCache->GetStats();
+
+	_log_common(StringUtil::Printf("%: % of % samplers live, % created, % shared.", _name_of(SamplerCache), samplerStats.LiveCount,
+		samplerStats.MaxCount, samplerStats.CreateCount, samplerStats.HitCount), LogSystem::Category::LogicalDevice);
+
+	const PipelineVariantStats variantStats = this->GetPipelineVariantStats();
+
+	_log_common(StringUtil::Printf("Pipeline variants: % of % live, % created, % hits, % evicted.", variantStats.LiveCount,
+		variantStats.MaxCount, variantStats.CreateCount, variantStats.HitCount, variantStats.EvictCount), LogSystem::Category::LogicalDevice);
+
+	const PipelineRequestQueue::Stats requestStats = m_pPipelineRequestQueue->GetStats();
+
+	_log_common(StringUtil::Printf("%: % requests, % built, % promoted, % failed, % dropped.", _name_of(PipelineRequestQueue), requestStats.RequestCount,
+		requestStats.BuildCount, requestStats.PromoteCount, requestStats.FailCount, requestStats.QueuedCount), LogSystem::Category::LogicalDevice);
 }
 
 LogicalDevice::operator VkDevice() const
@@ -66,6 +274,14 @@ void LogicalDevice::Init(BaseLayer* InBaseLayer)
 {
 	m_pBaseLayer = InBaseLayer;
 	m_pAllocator = InBaseLayer->GetBaseAllocator();
+	m_pContext   = VkDeviceContext::CreateDeviceContext(InBaseLayer->GetInstanceContext(), m_device);
+
+	m_pCmdQueue->Init(InBaseLayer);
+	m_pMemAllocator->Init(InBaseLayer);
+	m_pUploadManager->Init(InBaseLayer);
+	m_pPipelineCacheManager->Init(InBaseLayer);
+	m_pSamplerCache->Init(InBaseLayer);
+	m_pPipelineRequestQueue->Init(InBaseLayer);
 }
 
 bool LogicalDevice::IsNoneAllocator() const
@@ -83,6 +299,84 @@ CommandQueue* LogicalDevice::GetCommandQueue()
 	return m_pCmdQueue;
 }
 
+DeviceMemoryAllocator* LogicalDevice::GetMemAllocator()
+{
+	return m_pMemAllocator;
+}
+
+UploadManager* LogicalDevice::GetUploadManager()
+{
+	return m_pUploadManager;
+}
+
+PipelineCacheManager* LogicalDevice::GetPipelineCacheManager()
+{
+	return m_pPipelineCacheManager;
+}
+
+SamplerCache* LogicalDevice::GetSamplerCache()
+{
+	return m_pSamplerCache;
+}
+
+PipelineRequestQueue* LogicalDevice::GetPipelineRequestQueue()
+{
+	return m_pPipelineRequestQueue;
+}
+
+VkDeviceContext* LogicalDevice::GetDeviceContext() const
+{
+	return m_pContext;
+}
+
+LogicalDevice::LayoutStats LogicalDevice::GetLayoutStats()
+{
+	std::unique_lock<std::mutex> lock(m_layoutMutex);
+
+	LayoutStats stats;
+	stats.SetLayoutCreateCount      = m_descSetLayoutCreateCount;
+	stats.SetLayoutHitCount         = m_descSetLayoutHitCount;
+	stats.PipelineLayoutCreateCount = m_pipelineLayoutCreateCount;
+	stats.PipelineLayoutHitCount    = m_pipelineLayoutHitCount;
+
+	return stats;
+}
+
+LogicalDevice::PipelineVariantStats LogicalDevice::GetPipelineVariantStats()
+{
+	std::unique_lock<std::mutex> lock(m_variantMutex);
+
+	PipelineVariantStats stats;
+	stats.LiveCount   = (uint32)m_pipelineVariants.size();
+	stats.MaxCount    = m_maxPipelineVariantCount;
+	stats.CreateCount = m_pipelineVariantCreateCount;
+	stats.HitCount    = m_pipelineVariantHitCount;
+	stats.EvictCount  = m_pipelineVariantEvictCount;
+
+	return stats;
+}
+
+void LogicalDevice::SetMaxPipelineVariantCount(uint32 InCount)
+{
+	std::unique_lock<std::mutex> lock(m_variantMutex);
+
+	m_maxPipelineVariantCount = InCount;
+	this->TrimPipelineVariants();
+}
+
+LogicalDevice::RenderPassStats LogicalDevice::GetRenderPassStats() const
+{
+	std::unique_lock<std::mutex> lock(m_renderPassMutex);
+
+	RenderPassStats stats;
+	stats.ParseCount        = m_renderPassParseCount;
+	stats.CreateCount       = m_renderPassCreateCount;
+	stats.PathHitCount      = m_renderPassPathHitCount;
+	stats.StructureHitCount = m_renderPassStructureHitCount;
+
+	return stats;
+}
+
 void LogicalDevice::SetViewport(VkViewport& OutViewport, VkRect2D& OutScissor, uint32 InWidth, uint32 InHeight)
 {
 	OutViewport.x = 0.0f;
@@ -117,6 +411,8 @@ uint32 LogicalDevice::GetSwapchainNextImageKHR(VkSwapchainKHR InSwapchain, uint6
 
 VkRenderPass LogicalDevice::GetRenderPass(const string& InName)
 {
+	std::unique_lock<std::mutex> lock(m_renderPassMutex);
+
 	auto found = m_renderPassNamePtrMap.find(InName);
 	if (found != m_renderPassNamePtrMap.end())
 		return *((*found).second);
@@ -129,21 +425,336 @@ VkRenderPass LogicalDevice::GetRenderPass(const string& InName)
 
 VkPipeline LogicalDevice::GetPipeline(const string& InName)
 {
+	VkPipeline pipeline = this->FindPipeline(InName);
+	if (pipeline == VK_NULL_HANDLE)
+		_log_warning(StringUtil::Printf("%: Specified pipeline name(%) is not exit!", _name_of(GetPipeline), InName), LogSystem::Category::LogicalDevice);
+
+	return pipeline;
+}
+
+VkPipeline LogicalDevice::FindPipeline(const string& InName)
+{
+	std::unique_lock<std::mutex> lock(m_pipelineMutex);
+
 	auto found = m_pipelineNamePtrMap.find(InName);
-	if (found != m_pipelineNamePtrMap.end())
-		return *((*found).second);
-	else
+	return found != m_pipelineNamePtrMap.end() ? *((*found).second) : VK_NULL_HANDLE;
+}
+
+void LogicalDevice::RegisterPipeline(const string& InName, VkPipeline InPipeline)
+{
+	_declare_vk_smart_ptr(VkPipeline, pPipeline);
+	*pPipeline.MakeInstance(m_pContext) = InPipeline;
+
+	std::unique_lock<std::mutex> lock(m_pipelineMutex);
+	m_pipelineNamePtrMap.emplace(InName, pPipeline);
+}
+
+VkPipeline LogicalDevice::GetPipeline(const string& InName, const std::vector<uint32>& InConstants)
+{
+	string key = InName;
+	key.push_back('\0');
+
+	for (uint32 constant : InConstants)
+		AppendKey(key, constant);
+
+	const VkPipeline basePipeline = this->FindPipeline(InName);
+
+	const PipelineVariantInfo* pInfo;
 	{
-		_log_warning(StringUtil::Printf("%: Specified pipeline name(%) is not exit!", _name_of(GetPipeline), InName), LogSystem::Category::LogicalDevice);
-		return VK_NULL_HANDLE;
+		std::unique_lock<std::mutex> lock(m_variantMutex);
+
+		auto foundVariant = m_pipelineVariantKeyMap.find(key);
+		if (foundVariant != m_pipelineVariantKeyMap.end())
+		{
+			// To the front, the iterators in the map stay valid.
+			m_pipelineVariants.splice(m_pipelineVariants.begin(), m_pipelineVariants, (*foundVariant).second);
+			m_pipelineVariantHitCount++;
+
+			return *(*(*foundVariant).second).Pipeline;
+		}
+
+		auto foundInfo = m_pipelineVariantInfoMap.find(InName);
+		if (basePipeline == VK_NULL_HANDLE || foundInfo == m_pipelineVariantInfoMap.end() || (*foundInfo).second->ConstantIDs.size() != InConstants.size())
+		{
+			_log_warning(StringUtil::Printf("%: pipeline(%) has no variants of % constants, the pipeline itself is used!", _name_of(GetPipeline), InName, InConstants.size()), LogSystem::Category::LogicalDevice);
+			return basePipeline;
+		}
+
+		// Infos are never erased nor changed, the create below runs without the lock.
+		pInfo = (*foundInfo).second.get();
+	}
+
+	// A derivative of the base with the variable constants replaced, never registered by name.
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	{
+		ScratchScope scratch;
+
+		ScratchVector<VkPipelineShaderStageCreateInfo> stages(pInfo->Stages.begin(), pInfo->Stages.end());
+		ScratchVector<VkSpecializationInfo>            specInfos(stages.size());
+		ScratchVector<ScratchVector<uint8>>            specData(stages.size());
+
+		for (uint32 i = 0; i < (uint32)stages.size(); i++)
+		{
+			if (stages[i].pSpecializationInfo == nullptr)
+				continue;
+
+			const VkSpecializationInfo& baseSpecInfo = *stages[i].pSpecializationInfo;
+			const uint8*                pBaseData    = static_cast<const uint8*>(baseSpecInfo.pData);
+
+			specData[i].assign(pBaseData, pBaseData + baseSpecInfo.dataSize);
+
+			for (uint32 j = 0; j < baseSpecInfo.mapEntryCount; j++)
+			{
+				const VkSpecializationMapEntry& entry = baseSpecInfo.pMapEntries[j];
+
+				for (uint32 k = 0; k < (uint32)pInfo->ConstantIDs.size(); k++)
+				{
+					if (pInfo->ConstantIDs[k] == entry.constantID)
+						std::memcpy(specData[i].data() + entry.offset, &InConstants[k], std::min<usize>(entry.size, sizeof(uint32)));
+				}
+			}
+
+			specInfos[i]       = baseSpecInfo;
+			specInfos[i].pData = specData[i].data();
+
+			stages[i].pSpecializationInfo = &specInfos[i];
+		}
+
+		VkGraphicsPipelineCreateInfo createInfo = pInfo->CreateInfo;
+		createInfo.flags              = (createInfo.flags & ~VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT) | VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+		createInfo.pStages            = stages.data();
+		createInfo.basePipelineHandle = basePipeline;
+		createInfo.basePipelineIndex  = -1;
+
+		this->CreateGraphicPipelines(&pipeline, &createInfo, _count_1, m_pPipelineCacheManager->GetPipelineCache());
+	}
+
+	PipelineVariant variant;
+	variant.Key = key;
+	*variant.Pipeline.MakeInstance(m_pContext) = pipeline;
+
+	std::unique_lock<std::mutex> lock(m_variantMutex);
+
+	// Another thread built the same values meanwhile, its variant stays and ours goes to the destroy queue.
+	auto foundVariant = m_pipelineVariantKeyMap.find(key);
+	if (foundVariant != m_pipelineVariantKeyMap.end())
+	{
+		m_pipelineVariants.splice(m_pipelineVariants.begin(), m_pipelineVariants, (*foundVariant).second);
+		m_pipelineVariantHitCount++;
+
+		return *(*(*foundVariant).second).Pipeline;
+	}
+
+	m_pipelineVariants.push_front(variant);
+	m_pipelineVariantKeyMap.emplace(key, m_pipelineVariants.begin());
+	m_pipelineVariantCreateCount++;
+
+	this->TrimPipelineVariants();
+
+	return pipeline;
+}
+
+void LogicalDevice::RegisterPipelineVariantInfo(const string& InName, const Json::Value& InGraphicInfo, const VkGraphicsPipelineCreateInfo& InCreateInfo, const VkSmartPtr<VkShaderModule>* InShaderModules)
+{
+	const Json::Value& variableIDs = InGraphicInfo[_text_mapper(vk_variable_specialization_constants)];
+
+	const bool   bIsArray = variableIDs.isArray();
+	const uint32 numID    = bIsArray ? variableIDs.size() : _count_1;
+
+	std::unique_ptr<PipelineVariantInfo> pVariantInfo(new PipelineVariantInfo());
+
+	for (uint32 i = 0; i < numID; i++)
+	{
+		const uint32 constantID = JsonParser::GetUInt32(bIsArray ? variableIDs[i] : variableIDs);
+
+		bool bDeclared = false;
+		for (uint32 j = 0; j < InCreateInfo.stageCount; j++)
+		{
+			const VkSpecializationInfo* pSpecInfo = InCreateInfo.pStages[j].pSpecializationInfo;
+
+			for (uint32 k = 0; pSpecInfo != nullptr && k < pSpecInfo->mapEntryCount; k++)
+				bDeclared |= pSpecInfo->pMapEntries[k].constantID == constantID;
+		}
+
+		if (!bDeclared)
+		{
+			_log_warning(StringUtil::Printf("json file: pipeline \"%\" has no specialization constant %, its variants are ignored!", InName, constantID), LogSystem::Category::JsonParser);
+			return;
+		}
+
+		pVariantInfo->ConstantIDs.push_back(constantID);
+	}
+
+	pVariantInfo->Assign(InCreateInfo, InShaderModules);
+
+	std::unique_lock<std::mutex> lock(m_variantMutex);
+	m_pipelineVariantInfoMap.emplace(InName, std::move(pVariantInfo));
+}
+
+void LogicalDevice::PipelineVariantInfo::Assign(const VkGraphicsPipelineCreateInfo& InCreateInfo, const VkSmartPtr<VkShaderModule>* InShaderModules)
+{
+	CreateInfo       = InCreateInfo;
+	CreateInfo.pNext = nullptr;
+
+	// Stages.
+	Stages.assign(InCreateInfo.pStages, InCreateInfo.pStages + InCreateInfo.stageCount);
+	ShaderModules.assign(InShaderModules, InShaderModules + InCreateInfo.stageCount);
+	Entrypoints.resize(InCreateInfo.stageCount);
+	SpecInfos.resize(InCreateInfo.stageCount);
+	SpecMaps.resize(InCreateInfo.stageCount);
+	SpecData.resize(InCreateInfo.stageCount);
+
+	for (uint32 i = 0; i < InCreateInfo.stageCount; i++)
+	{
+		Entrypoints[i] = InCreateInfo.pStages[i].pName;
+
+		Stages[i].pNext = nullptr;
+		Stages[i].pName = Entrypoints[i].c_str();
+
+		const VkSpecializationInfo* pSpecInfo = InCreateInfo.pStages[i].pSpecializationInfo;
+		if (pSpecInfo == nullptr)
+			continue;
+
+		SpecMaps[i].assign(pSpecInfo->pMapEntries, pSpecInfo->pMapEntries + pSpecInfo->mapEntryCount);
+		SpecData[i].assign(static_cast<const uint8*>(pSpecInfo->pData), static_cast<const uint8*>(pSpecInfo->pData) + pSpecInfo->dataSize);
+
+		SpecInfos[i]             = *pSpecInfo;
+		SpecInfos[i].pMapEntries = SpecMaps[i].data();
+		SpecInfos[i].pData       = SpecData[i].data();
+
+		Stages[i].pSpecializationInfo = &SpecInfos[i];
+	}
+
+	CreateInfo.pStages = Stages.data();
+
+	// Vertex Input State.
+	if (InCreateInfo.pVertexInputState != nullptr)
+	{
+		const VkPipelineVertexInputStateCreateInfo& state = *InCreateInfo.pVertexInputState;
+
+		VertexBindings.assign(state.pVertexBindingDescriptions, state.pVertexBindingDescriptions + state.vertexBindingDescriptionCount);
+		VertexAttributes.assign(state.pVertexAttributeDescriptions, state.pVertexAttributeDescriptions + state.vertexAttributeDescriptionCount);
+
+		VertexInputState                              = state;
+		VertexInputState.pNext                        = nullptr;
+		VertexInputState.pVertexBindingDescriptions   = VertexBindings.data();
+		VertexInputState.pVertexAttributeDescriptions = VertexAttributes.data();
+
+		CreateInfo.pVertexInputState = &VertexInputState;
+	}
+
+	// IA and Tessellation State.
+	if (InCreateInfo.pInputAssemblyState != nullptr)
+	{
+		InputAssemblyState       = *InCreateInfo.pInputAssemblyState;
+		InputAssemblyState.pNext = nullptr;
+
+		CreateInfo.pInputAssemblyState = &InputAssemblyState;
+	}
+
+	if (InCreateInfo.pTessellationState != nullptr)
+	{
+		TessellationState       = *InCreateInfo.pTessellationState;
+		TessellationState.pNext = nullptr;
+
+		CreateInfo.pTessellationState = &TessellationState;
+	}
+
+	// Viewport State.
+	if (InCreateInfo.pViewportState != nullptr)
+	{
+		const VkPipelineViewportStateCreateInfo& state = *InCreateInfo.pViewportState;
+
+		if (state.pViewports != nullptr)
+			Viewports.assign(state.pViewports, state.pViewports + state.viewportCount);
+		if (state.pScissors != nullptr)
+			Scissors.assign(state.pScissors, state.pScissors + state.scissorCount);
+
+		ViewportState            = state;
+		ViewportState.pNext      = nullptr;
+		ViewportState.pViewports = state.pViewports != nullptr ? Viewports.data() : nullptr;
+		ViewportState.pScissors  = state.pScissors  != nullptr ? Scissors.data()  : nullptr;
+
+		CreateInfo.pViewportState = &ViewportState;
+	}
+
+	// RS, Multisample and Depth Stencil State.
+	if (InCreateInfo.pRasterizationState != nullptr)
+	{
+		RasterizationState       = *InCreateInfo.pRasterizationState;
+		RasterizationState.pNext = nullptr;
+
+		CreateInfo.pRasterizationState = &RasterizationState;
+	}
+
+	if (InCreateInfo.pMultisampleState != nullptr)
+	{
+		const VkPipelineMultisampleStateCreateInfo& state = *InCreateInfo.pMultisampleState;
+
+		// One mask word per 32 samples.
+		if (state.pSampleMask != nullptr)
+			SampleMasks.assign(state.pSampleMask, state.pSampleMask + ((uint32)state.rasterizationSamples + 31) / 32);
+
+		MultisampleState             = state;
+		MultisampleState.pNext       = nullptr;
+		MultisampleState.pSampleMask = state.pSampleMask != nullptr ? SampleMasks.data() : nullptr;
+
+		CreateInfo.pMultisampleState = &MultisampleState;
+	}
+
+	if (InCreateInfo.pDepthStencilState != nullptr)
+	{
+		DepthStencilState       = *InCreateInfo.pDepthStencilState;
+		DepthStencilState.pNext = nullptr;
+
+		CreateInfo.pDepthStencilState = &DepthStencilState;
+	}
+
+	// Color Blend State.
+	if (InCreateInfo.pColorBlendState != nullptr)
+	{
+		const VkPipelineColorBlendStateCreateInfo& state = *InCreateInfo.pColorBlendState;
+
+		BlendAttachments.assign(state.pAttachments, state.pAttachments + state.attachmentCount);
+
+		ColorBlendState              = state;
+		ColorBlendState.pNext        = nullptr;
+		ColorBlendState.pAttachments = BlendAttachments.data();
+
+		CreateInfo.pColorBlendState = &ColorBlendState;
+	}
+
+	// Dynamic State.
+	if (InCreateInfo.pDynamicState != nullptr)
+	{
+		const VkPipelineDynamicStateCreateInfo& state = *InCreateInfo.pDynamicState;
+
+		DynamicStates.assign(state.pDynamicStates, state.pDynamicStates + state.dynamicStateCount);
+
+		DynamicState                = state;
+		DynamicState.pNext          = nullptr;
+		DynamicState.pDynamicStates = DynamicStates.data();
+
+		CreateInfo.pDynamicState = &DynamicState;
+	}
+}
+
+void LogicalDevice::TrimPipelineVariants()
+{
+	while ((uint32)m_pipelineVariants.size() > m_maxPipelineVariantCount)
+	{
+		// Released into the destroy queue, frames in flight may still draw with it.
+		m_pipelineVariantKeyMap.erase(m_pipelineVariants.back().Key);
+		m_pipelineVariants.pop_back();
+		m_pipelineVariantEvictCount++;
 	}
 }
 
 void LogicalDevice::CreateCommandPool(const VkCommandPoolCreateInfo& InCreateInfo)
 {
-	_vk_try(vkCreateCommandPool(m_device, &InCreateInfo, GetVkAllocator(), m_pCmdPool.MakeInstance()));
+	_vk_try(vkCreateCommandPool(m_device, &InCreateInfo, GetVkAllocator(), m_pCmdPool.MakeInstance(m_pContext)));
 
-	this->BindRef(VkCast<VkCommandPool>(m_pCmdPool));
+	this->BindRef(m_pCmdPool);
 }
 
 void LogicalDevice::CreateCommandPool(uint32 InQueueFamilyIndex, VkCommandPoolCreateFlags InFlags /*= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT*/)
@@ -153,9 +764,9 @@ void LogicalDevice::CreateCommandPool(uint32 InQueueFamilyIndex, VkCommandPoolCr
 	cmdPoolCreateInfo.flags = InFlags;
 	cmdPoolCreateInfo.queueFamilyIndex = InQueueFamilyIndex;
 
-	_vk_try(vkCreateCommandPool(m_device, &cmdPoolCreateInfo, GetVkAllocator(), m_pCmdPool.MakeInstance()));
+	_vk_try(vkCreateCommandPool(m_device, &cmdPoolCreateInfo, GetVkAllocator(), m_pCmdPool.MakeInstance(m_pContext)));
 
-	this->BindRef(VkCast<VkCommandPool>(m_pCmdPool));
+	this->BindRef(m_pCmdPool);
 }
 
 void LogicalDevice::CreateSwapchainKHR(VkSwapchainKHR* OutSwapchain, const VkSwapchainCreateInfoKHR& InCreateInfo)
@@ -179,13 +790,19 @@ void LogicalDevice::CreateShaderModule(VkShaderModule* OutShaderModule, const ui
 }
 
 void LogicalDevice::CreateShaderModule(VkShaderModule* OutShaderModule, const Path& InShaderPath, const char* InEntrypoint /*= "main"*/, VkShaderStageFlags* OutShaderStage /*= nullptr*/)
+{
+	if (!this->CreateShaderModule(OutShaderModule, m_pCompiler, InShaderPath, InEntrypoint, OutShaderStage))
+		Engine::Get()->RequireExit(1);
+}
+
+bool LogicalDevice::CreateShaderModule(VkShaderModule* OutShaderModule, GLSLCompiler* InCompiler, const Path& InShaderPath, const char* InEntrypoint, VkShaderStageFlags* OutShaderStage)
 {
 	string name, ext, dir;
 	StringUtil::ExtractFilePath(InShaderPath.ToString(), &name, &ext, &dir);
 
 	VkShaderStageFlags shaderStage;
 	if (!GetShaderStage(ext, shaderStage))
-		Engine::Get()->RequireExit(1);
+		return false;
 
 	if (OutShaderStage != nullptr)
 	{
@@ -202,8 +819,8 @@ void LogicalDevice::CreateShaderModule(VkShaderModule* OutShaderModule, const Pa
 		compileInfo.entrypoint = InEntrypoint;
 		compileInfo.includes_count = _count_1;
 		compileInfo.includes = include_dirs;
-		m_pCompiler->CompileShader(shaderStage, InShaderPath, &compileInfo);
-		GLSLCompiler::SPVData* spvData = m_pCompiler->GetLastSPVData();
+		InCompiler->CompileShader(shaderStage, InShaderPath, &compileInfo);
+		GLSLCompiler::SPVData* spvData = InCompiler->GetLastSPVData();
 
 		if (spvData->result)
 		{
@@ -216,23 +833,38 @@ void LogicalDevice::CreateShaderModule(VkShaderModule* OutShaderModule, const Pa
 			_log_error(spvData->debug_log, LogSystem::Category::GLSLCompiler);
 
 			_log_error(StringUtil::Printf("Compiling shader file \"%\" failed!", InShaderPath.ToString()), LogSystem::Category::GLSLCompiler);
-			Engine::Get()->RequireExit(1);
+			return false;
 		}
 	}
 	else
 	{
 		std::vector<uint8> shaderCode;
 		if (!FileUtil::ReadBinary(InShaderPath, shaderCode))
-			Engine::Get()->RequireExit(1);
+			return false;
 		this->CreateShaderModule(OutShaderModule, (uint32*)shaderCode.data(), shaderCode.size());
 	}
-	
-	//return true;
+
+	return true;
 }
 
 void LogicalDevice::CreateComputePipelines(VkPipeline* OutPipeline, const VkComputePipelineCreateInfo* InCreateInfos, uint32 InCreateInfoCount /*= _count_1*/, VkPipelineCache InPipCache /*= VK_NULL_HANDLE*/)
 {
-	_vk_try(vkCreateComputePipelines(m_device, InPipCache, InCreateInfoCount, InCreateInfos, GetVkAllocator(), OutPipeline));
+	if (InPipCache == VK_NULL_HANDLE)
+		InPipCache = m_pPipelineCacheManager->GetPipelineCache();
+
+	if (!m_pPipelineCacheManager->IsFeedbackEnabled())
+	{
+		_vk_try(vkCreateComputePipelines(m_device, InPipCache, InCreateInfoCount, InCreateInfos, GetVkAllocator(), OutPipeline));
+		m_pPipelineCacheManager->RecordFeedback(nullptr, InCreateInfoCount);
+		return;
+	}
+
+	ScratchScope scratch;
+
+	FeedbackChain<VkComputePipelineCreateInfo> feedbackChain(InCreateInfos, InCreateInfoCount);
+
+	_vk_try(vkCreateComputePipelines(m_device, InPipCache, InCreateInfoCount, feedbackChain.CreateInfos.data(), GetVkAllocator(), OutPipeline));
+	m_pPipelineCacheManager->RecordFeedback(feedbackChain.Feedbacks.data(), InCreateInfoCount);
 }
 
 void LogicalDevice::CreateComputePipeline(VkPipeline* OutPipeline, VkPipelineLayout InPipLayout, VkShaderModule InShaderModule, const char* InShaderEntryName /*= "main"*/, const VkSpecializationInfo* InSpecialConstInfo /*= nullptr*/, VkPipelineCache InPipCache /*= VK_NULL_HANDLE*/)
@@ -251,7 +883,7 @@ void LogicalDevice::CreateComputePipeline(VkPipeline* OutPipeline, VkPipelineLay
 	pipCSCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipCSCreateInfo.basePipelineIndex  = -1;
 
-	_vk_try(vkCreateComputePipelines(m_device, InPipCache, _count_1, &pipCSCreateInfo, GetVkAllocator(), OutPipeline));
+	this->CreateComputePipelines(OutPipeline, &pipCSCreateInfo, _count_1, InPipCache);
 }
 
 void LogicalDevice::CreateComputePipelines(VkPipeline* OutPipeline, const PipelineComputeDesc* InDescs, uint32 InDescCount/*= _count_1*/, VkPipelineCache InPipCache /*= VK_NULL_HANDLE*/)
@@ -274,7 +906,7 @@ void LogicalDevice::CreateComputePipelines(VkPipeline* OutPipeline, const Pipeli
 		pPipCSCreateInfos[i].basePipelineIndex  = InDescs[i].BasePipelineIndex;
 	}
 
-	_vk_try(vkCreateComputePipelines(m_device, InPipCache, InDescCount, pPipCSCreateInfos, GetVkAllocator(), OutPipeline));
+	this->CreateComputePipelines(OutPipeline, pPipCSCreateInfos, InDescCount, InPipCache);
 	delete[] pPipCSCreateInfos;
 }
 
@@ -328,8 +960,18 @@ void LogicalDevice::CreatePipelineCacheFromFile(VkPipelineCache* OutPipCache, co
 
 	std::vector<uint8> cacheData;
 
+	// A missing or stale cache only costs the warm start, fall back to an empty one.
 	if (!FileUtil::ReadBinary(InPath, cacheData))
-		Engine::Get()->RequireExit(1);
+	{
+		this->CreateEmptyPipelineCache(OutPipCache);
+		return;
+	}
+
+	if (!cacheData.empty() && cacheData.size() < sizeof(PipelineCacheHeader))
+	{
+		_log_warning(StringUtil::Printf("Truncated cache header in %, size is %", InPath.ToString(), cacheData.size()), LogSystem::Category::LogicalDevice);
+		cacheData.clear();
+	}
 
 	if (!cacheData.empty())
 	{
@@ -375,46 +1017,49 @@ void LogicalDevice::CreatePipelineCacheFromFile(VkPipelineCache* OutPipCache, co
 		// Check each field and report bad values before freeing existing cache.
 		bool badCache = false;
 
-		if (pipCacheHearder.Length <= 0)
+		if (pipCacheHearder.Length < sizeof(PipelineCacheHeader) || pipCacheHearder.Length > cacheData.size())
 		{
 			badCache = true;
-			_log_error(StringUtil::Printf("Bad header length in %, value is %", InPath.ToString(), pipCacheHearder.Length), LogSystem::Category::LogicalDevice);
+			_log_warning(StringUtil::Printf("Bad header length in %, value is %", InPath.ToString(), pipCacheHearder.Length), LogSystem::Category::LogicalDevice);
 		}
 
 		if (pipCacheHearder.Version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
 		{
 			badCache = true;
-			_log_error(StringUtil::Printf("Unsupported cache header version in %, value is %", InPath.ToString(), pipCacheHearder.Version), LogSystem::Category::LogicalDevice);
+			_log_warning(StringUtil::Printf("Unsupported cache header version in %, value is %", InPath.ToString(), pipCacheHearder.Version), LogSystem::Category::LogicalDevice);
 		}
 
 		if (pipCacheHearder.VendorID != m_pBaseLayer->GetMainPDProps().vendorID)
 		{
 			badCache = true;
-			_log_error(StringUtil::Printf("Vendor ID mismatch in %, value is %, Driver expects: %", InPath.ToString(), pipCacheHearder.VendorID, m_pBaseLayer->GetMainPDProps().vendorID), LogSystem::Category::LogicalDevice);
+			_log_warning(StringUtil::Printf("Vendor ID mismatch in %, value is %, Driver expects: %", InPath.ToString(), pipCacheHearder.VendorID, m_pBaseLayer->GetMainPDProps().vendorID), LogSystem::Category::LogicalDevice);
 		}
 
 		if (pipCacheHearder.DeviceID != m_pBaseLayer->GetMainPDProps().deviceID)
 		{
 			badCache = true;
-			_log_error(StringUtil::Printf("Device ID mismatch in %, value is %, Driver expects: %", InPath.ToString(), pipCacheHearder.DeviceID, m_pBaseLayer->GetMainPDProps().deviceID), LogSystem::Category::LogicalDevice);
+			_log_warning(StringUtil::Printf("Device ID mismatch in %, value is %, Driver expects: %", InPath.ToString(), pipCacheHearder.DeviceID, m_pBaseLayer->GetMainPDProps().deviceID), LogSystem::Category::LogicalDevice);
 		}
 
 		if (memcmp(pipCacheHearder.UUID, m_pBaseLayer->GetMainPDProps().pipelineCacheUUID, sizeof(pipCacheHearder.UUID)) != 0)
 		{
 			badCache = true;
-			_log_error(StringUtil::Printf("UUID ID mismatch in %, value is %, Driver expects: %", InPath.ToString(), StringUtil::UUIDToString(pipCacheHearder.UUID), StringUtil::UUIDToString(m_pBaseLayer->GetMainPDProps().pipelineCacheUUID)), LogSystem::Category::LogicalDevice);
+			_log_warning(StringUtil::Printf("UUID ID mismatch in %, value is %, Driver expects: %", InPath.ToString(), StringUtil::UUIDToString(pipCacheHearder.UUID), StringUtil::UUIDToString(m_pBaseLayer->GetMainPDProps().pipelineCacheUUID)), LogSystem::Category::LogicalDevice);
 		}
 
 		if (badCache)
 		{
-			_log_error(StringUtil::Printf("Deleting cache entry % to repopulate.", InPath.ToString()), LogSystem::Category::LogicalDevice);
+			_log_warning(StringUtil::Printf("Deleting cache entry % to repopulate.", InPath.ToString()), LogSystem::Category::LogicalDevice);
 			if (remove(InPath.ToCString()) != 0)
 				_log_error("Deleting error", LogSystem::Category::IO);
-			Engine::Get()->RequireExit(1);
+			cacheData.clear();
 		}
 	}
 
-	this->CreatePipelineCache(OutPipCache, cacheData.data(), cacheData.size());
+	if (cacheData.empty())
+		this->CreateEmptyPipelineCache(OutPipCache);
+	else
+		this->CreatePipelineCache(OutPipCache, cacheData.data(), cacheData.size());
 
 	//return true;
 }
@@ -441,7 +1086,7 @@ void LogicalDevice::SavePipelineCacheToFile(const Path& InPath)
 {
 	_declare_vk_smart_ptr(VkPipelineCache, pMergedPipCache);
 
-	this->CreateEmptyPipelineCache(pMergedPipCache.MakeInstance());
+	this->CreateEmptyPipelineCache(pMergedPipCache.MakeInstance(m_pContext));
 	
 	// Merge old pipeline caches into new one.
 	if (!m_pipelineCaches.empty())
@@ -481,6 +1126,45 @@ void LogicalDevice::CreateDescriptorSetLayout(VkDescriptorSetLayout* OutLayout,
 	_vk_try(vkCreateDescriptorSetLayout(m_device, &descSetLayoutCreateInfo, GetVkAllocator(), OutLayout));
 }
 
+VkDescriptorSetLayout LogicalDevice::FindOrCreateDescriptorSetLayout(const VkDescriptorSetLayoutBinding* InBindings, uint32 InBindingCount)
+{
+	ScratchScope scratch;
+
+	// Bindings are told apart by their number, not their order.
+	ScratchVector<VkDescriptorSetLayoutBinding> bindings(InBindings, InBindings + InBindingCount);
+
+	std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& InA, const VkDescriptorSetLayoutBinding& InB) { return InA.binding < InB.binding; });
+
+	string key;
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		AppendKey(key, binding.binding);
+		AppendKey(key, (uint32)binding.descriptorType);
+		AppendKey(key, binding.descriptorCount);
+		AppendKey(key, (uint32)binding.stageFlags);
+		AppendKey(key, (uint32)(binding.pImmutableSamplers != nullptr));
+
+		for (uint32 i = 0; binding.pImmutableSamplers != nullptr && i < binding.descriptorCount; i++)
+			AppendKey(key, (uint64)binding.pImmutableSamplers[i]);
+	}
+
+	std::unique_lock<std::mutex> lock(m_layoutMutex);
+
+	auto found = m_descSetLayoutKeyPtrMap.find(key);
+	if (found != m_descSetLayoutKeyPtrMap.end())
+	{
+		m_descSetLayoutHitCount++;
+		return *(*found).second;
+	}
+
+	_declare_vk_smart_ptr(VkDescriptorSetLayout, pDescSetLayout);
+	this->CreateDescriptorSetLayout(pDescSetLayout.MakeInstance(m_pContext), bindings.data(), (uint32)bindings.size());
+
+	m_descSetLayoutCreateCount++;
+
+	return *(*m_descSetLayoutKeyPtrMap.emplace(std::move(key), pDescSetLayout).first).second;
+}
+
 void LogicalDevice::CreateSingleDescriptorLayout(VkDescriptorSetLayout* OutLayout, VkDescriptorType InDescType, VkShaderStageFlags InShaderStage, const VkSampler* InImmutableSamplers /*= nullptr*/)
 {
 	VkDescriptorSetLayoutBinding descSetLayoutBinding = {};
@@ -515,9 +1199,51 @@ void LogicalDevice::CreatePipelineLayout(VkPipelineLayout* OutLayout, const VkDe
 	_vk_try(vkCreatePipelineLayout(m_device, &pipLayoutCreateInfo, GetVkAllocator(), OutLayout));
 }
 
+VkPipelineLayout LogicalDevice::FindOrCreatePipelineLayout(const VkDescriptorSetLayout* InDescSetLayouts, uint32 InSetCount, const VkPushConstantRange* InPushConstants, uint32 InConstCount)
+{
+	ScratchScope scratch;
+
+	ScratchVector<VkPushConstantRange> pushConstantRanges(InPushConstants, InPushConstants + (InPushConstants != nullptr ? InConstCount : _count_0));
+
+	std::sort(pushConstantRanges.begin(), pushConstantRanges.end(), [](const VkPushConstantRange& InA, const VkPushConstantRange& InB)
+	{
+		return InA.offset != InB.offset ? InA.offset < InB.offset : (InA.size != InB.size ? InA.size < InB.size : InA.stageFlags < InB.stageFlags);
+	});
+
+	// Set layouts are shared, equal handles are equal bindings.
+	string key;
+	AppendKey(key, InSetCount);
+
+	for (uint32 i = 0; i < InSetCount; i++)
+		AppendKey(key, (uint64)InDescSetLayouts[i]);
+
+	for (const VkPushConstantRange& range : pushConstantRanges)
+	{
+		AppendKey(key, (uint32)range.stageFlags);
+		AppendKey(key, range.offset);
+		AppendKey(key, range.size);
+	}
+
+	std::unique_lock<std::mutex> lock(m_layoutMutex);
+
+	auto found = m_pipelineLayoutKeyPtrMap.find(key);
+	if (found != m_pipelineLayoutKeyPtrMap.end())
+	{
+		m_pipelineLayoutHitCount++;
+		return *(*found).second;
+	}
+
+	_declare_vk_smart_ptr(VkPipelineLayout, pPipelineLayout);
+	this->CreatePipelineLayout(pPipelineLayout.MakeInstance(m_pContext), InDescSetLayouts, InSetCount, pushConstantRanges.data(), (uint32)pushConstantRanges.size());
+
+	m_pipelineLayoutCreateCount++;
+
+	return *(*m_pipelineLayoutKeyPtrMap.emplace(std::move(key), pPipelineLayout).first).second;
+}
+
 void LogicalDevice::CreateDescriptorPool(const VkDescriptorPoolCreateInfo& InCreateInfo)
 {
-	_vk_try(vkCreateDescriptorPool(m_device, &InCreateInfo, GetVkAllocator(), m_pDescPool.MakeInstance()));
+	_vk_try(vkCreateDescriptorPool(m_device, &InCreateInfo, GetVkAllocator(), m_pDescPool.MakeInstance(m_pContext)));
 }
 
 void LogicalDevice::CreateDescriptorPool(uint32 InMaxSets, const VkDescriptorPoolSize* InPerDescTypeCounts, uint32 InDescTypeCount)
@@ -528,7 +1254,7 @@ void LogicalDevice::CreateDescriptorPool(uint32 InMaxSets, const VkDescriptorPoo
 	descPoolCreateInfo.poolSizeCount = InDescTypeCount;
 	descPoolCreateInfo.pPoolSizes    = InPerDescTypeCounts;
 
-	_vk_try(vkCreateDescriptorPool(m_device, &descPoolCreateInfo, GetVkAllocator(), m_pDescPool.MakeInstance()));
+	_vk_try(vkCreateDescriptorPool(m_device, &descPoolCreateInfo, GetVkAllocator(), m_pDescPool.MakeInstance(m_pContext)));
 }
 
 void LogicalDevice::AllocatorDescriptorSets(VkDescriptorSet* OutDescSet, const VkDescriptorSetAllocateInfo& InAllocateInfo)
@@ -670,251 +1396,155 @@ void LogicalDevice::CreateSampler(VkSampler* OutSampler, const VkSamplerCreateIn
 
 void LogicalDevice::CreatePointWrapSampler(VkSampler* OutSampler)
 {
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_NEAREST;
-	samplerCreateInfo.minFilter               = VK_FILTER_NEAREST;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_FALSE;
-	samplerCreateInfo.maxAnisotropy           = 1.0f;
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+	this->CreateSampler(OutSampler, Render::Sampler::PointWrap);
 }
 
 void LogicalDevice::CreatePointClampSampler(VkSampler* OutSampler)
 {
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_NEAREST;
-	samplerCreateInfo.minFilter               = VK_FILTER_NEAREST;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_FALSE;
-	samplerCreateInfo.maxAnisotropy           = 1.0f;
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+	this->CreateSampler(OutSampler, Render::Sampler::PointClamp);
 }
 
 void LogicalDevice::CreateLinearWrapSampler(VkSampler* OutSampler)
 {
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.minFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_FALSE;
-	samplerCreateInfo.maxAnisotropy           = 1.0f;
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+	this->CreateSampler(OutSampler, Render::Sampler::LinearWrap);
 }
 
 void LogicalDevice::CreateLinearClampSampler(VkSampler* OutSampler)
 {
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.minFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_FALSE;
-	samplerCreateInfo.maxAnisotropy           = 1.0f;
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+	this->CreateSampler(OutSampler, Render::Sampler::LinearClamp);
 }
 
 void LogicalDevice::CreateAnisotropicWrapSampler(VkSampler* OutSampler)
 {
-	if (m_pBaseLayer == nullptr)
-	{
-		OutSampler = VK_NULL_HANDLE;
-
-		_log_error("Func: " + _str_name_of(CreateAnisotropicWrapSampler) + " expect to Query Physical Device Limits!", LogSystem::Category::LogicalDevice);
-		Engine::Get()->RequireExit(1);
-	}
+	this->CreateSampler(OutSampler, Render::Sampler::AnisotropicWrap);
+}
 
-	float maxAnisotropy = std::min(RenderBaseConfig::Sampler::MaxAnisotropy, m_pBaseLayer->GetMainPDLimits().maxSamplerAnisotropy);
-
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.minFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_TRUE;                                 // Anisotropic Filtering.
-	samplerCreateInfo.maxAnisotropy           = maxAnisotropy;                           // Anisotropic Filtering.
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+void LogicalDevice::CreateAnisotropicClampSampler(VkSampler* OutSampler)
+{
+	this->CreateSampler(OutSampler, Render::Sampler::AnisotropicClamp);
+}
 
-	//return true;
+void LogicalDevice::CreatePCFSampler(VkSampler* OutSampler)
+{
+	this->CreateSampler(OutSampler, Render::Sampler::PCF);
 }
 
-void LogicalDevice::CreateAnisotropicClampSampler(VkSampler* OutSampler)
+void LogicalDevice::CreateSampler(VkSampler* OutSampler, Render::Sampler InSamplerType)
 {
 	if (m_pBaseLayer == nullptr)
 	{
-		OutSampler = VK_NULL_HANDLE;
+		*OutSampler = VK_NULL_HANDLE;
 
-		_log_error("Func: " + _str_name_of(CreateAnisotropicClampSampler) + " expect to Query Physical Device Limits!", LogSystem::Category::LogicalDevice);
+		_log_error("Func: " + _str_name_of(CreateSampler) + " expect to Query Physical Device Limits!", LogSystem::Category::LogicalDevice);
 		Engine::Get()->RequireExit(1);
-	}	
-
-	float maxAnisotropy = std::min(RenderBaseConfig::Sampler::MaxAnisotropy, m_pBaseLayer->GetMainPDLimits().maxSamplerAnisotropy);
-
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.minFilter               = VK_FILTER_LINEAR;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_TRUE;                                 // Anisotropic Filtering.
-	samplerCreateInfo.maxAnisotropy           = maxAnisotropy;                           // Anisotropic Filtering.
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+	}
 
-	//return true;
+	// The presets are defined once, by the sampler cache, an unknown type is PointWrap there too.
+	this->CreateSampler(OutSampler, m_pSamplerCache->GetPresetCreateInfo(InSamplerType));
 }
 
-void LogicalDevice::CreatePCFSampler(VkSampler* OutSampler)
+void LogicalDevice::CreateRenderPass(VkRenderPass* OutRenderPass, const VkRenderPassCreateInfo& InCreateInfo)
 {
-	VkSamplerCreateInfo samplerCreateInfo     = {};
-	samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerCreateInfo.magFilter               = VK_FILTER_NEAREST;
-	samplerCreateInfo.minFilter               = VK_FILTER_NEAREST;
-	samplerCreateInfo.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-	samplerCreateInfo.addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-	samplerCreateInfo.addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-	samplerCreateInfo.addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
-	samplerCreateInfo.mipLodBias              = 0;
-	samplerCreateInfo.anisotropyEnable        = VK_FALSE;
-	samplerCreateInfo.maxAnisotropy           = 1.0f; // 16.0f ?
-	samplerCreateInfo.compareEnable           = VK_FALSE;
-	samplerCreateInfo.compareOp               = VK_COMPARE_OP_LESS_OR_EQUAL;
-	samplerCreateInfo.minLod                  = 0.0f;
-	samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
-	samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
-	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
-
-	_vk_try(vkCreateSampler(m_device, &samplerCreateInfo, GetVkAllocator(), OutSampler));
+	_vk_try(vkCreateRenderPass(m_device, &InCreateInfo, GetVkAllocator(), OutRenderPass));
 }
 
-void LogicalDevice::CreateSampler(VkSampler* OutSampler, Render::Sampler InSamplerType)
+VkSmartPtr<VkRenderPass> LogicalDevice::FindOrCreateRenderPass(const VkRenderPassCreateInfo& InCreateInfo)
 {
-	switch (InSamplerType)
+	string key;
+
+	if (InCreateInfo.pNext == nullptr)
 	{
-	case Render::Sampler::PointWrap:
-		this->CreatePointWrapSampler(OutSampler);
-		break;
-	case Render::Sampler::PointClamp:
-		this->CreatePointClampSampler(OutSampler);
-		break;
-	case Render::Sampler::LinearWrap:
-		this->CreateLinearWrapSampler(OutSampler);
-		break;
-	case Render::Sampler::LinearClamp:
-		this->CreateLinearClampSampler(OutSampler);
-		break;
-	case Render::Sampler::AnisotropicWrap:
-		this->CreateAnisotropicWrapSampler(OutSampler);
-		break;
-	case Render::Sampler::AnisotropicClamp:
-		this->CreateAnisotropicClampSampler(OutSampler);
-		break;
-	case Render::Sampler::PCF:
-		this->CreatePCFSampler(OutSampler);
-		break;
-	default:
-		this->CreatePointWrapSampler(OutSampler);
-		break;
+		key = MakeRenderPassKey(InCreateInfo);
+
+		auto found = m_renderPassKeyPtrMap.find(key);
+		if (found != m_renderPassKeyPtrMap.end())
+		{
+			m_renderPassStructureHitCount++;
+			return (*found).second;
+		}
 	}
+
+	_declare_vk_smart_ptr(VkRenderPass, pRenderPass);
+	this->CreateRenderPass(pRenderPass.MakeInstance(m_pContext), InCreateInfo);
+
+	m_renderPassCreateCount++;
+
+	if (InCreateInfo.pNext == nullptr)
+		m_renderPassKeyPtrMap.emplace(std::move(key), pRenderPass);
+
+	return pRenderPass;
 }
 
-void LogicalDevice::CreateRenderPass(VkRenderPass* OutRenderPass, const VkRenderPassCreateInfo& InCreateInfo)
+void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 {
-	_vk_try(vkCreateRenderPass(m_device, &InCreateInfo, GetVkAllocator(), OutRenderPass));
+	if (!this->LoadRenderPass(InJsonPath))
+		Engine::Get()->RequireExit(1);
 }
 
-void LogicalDevice::CreateRenderPass(const string& InJsonPath)
+bool LogicalDevice::LoadRenderPass(const string& InJsonPath)
 {
+	std::error_code error;
+
+	string canonicalPath = std::filesystem::weakly_canonical(InJsonPath, error).generic_string();
+	if (error)
+		canonicalPath = InJsonPath;
+
+	string renderPassText;
+	{
+		std::ifstream ifs(InJsonPath, std::ios::binary);
+		if (!ifs.is_open())
+		{
+			_log_error("JsonParser failed at file: " + InJsonPath, LogSystem::Category::LogicalDevice);
+			return false;
+		}
+
+		renderPassText.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	}
+
+	// Pipelines of a json mostly share one pass, only the first of them parses it.
+	const uint64 textHash = Math::HashText(renderPassText);
+
+	bool bIsChanged;
+	{
+		std::unique_lock<std::mutex> lock(m_renderPassMutex);
+
+		auto foundFile = m_renderPassPathMap.find(canonicalPath);
+		if (foundFile != m_renderPassPathMap.end() && (*foundFile).second.TextHash == textHash)
+		{
+			m_renderPassPathHitCount++;
+			return true;
+		}
+
+		bIsChanged = foundFile != m_renderPassPathMap.end();
+	}
+
 	_log_common("Begin creating renderpass with " + InJsonPath, LogSystem::Category::RenderPass);
 
 	// RenderPass.
 	{
-		std::vector<VkAttachmentDescription>             renderPassAttachmentDescs;
-		std::vector<VkSubpassDescription>                renderPassSubpassDescs;
-		std::vector<std::vector<VkAttachmentReference>>  renderPassSubpassInputAttachments;
-		std::vector<std::vector<VkAttachmentReference>>  renderPassSubpassColorAttachments;
-		std::vector<std::vector<VkAttachmentReference>>  renderPassSubpassResolveAttachments;
-		std::vector<std::vector<uint32>>                 renderPassSubpassPreserveAttachments;
-		std::vector<VkAttachmentReference>               renderPassSubpassDepthAttachments;
-		std::vector<VkSubpassDependency>                 renderPassSubpassDependency;
+		// Create infos only live for this call, keep them off the heap.
+		ScratchScope scratch;
+
+		ScratchVector<VkAttachmentDescription>               renderPassAttachmentDescs;
+		ScratchVector<VkSubpassDescription>                  renderPassSubpassDescs;
+		ScratchVector<ScratchVector<VkAttachmentReference>>  renderPassSubpassInputAttachments;
+		ScratchVector<ScratchVector<VkAttachmentReference>>  renderPassSubpassColorAttachments;
+		ScratchVector<ScratchVector<VkAttachmentReference>>  renderPassSubpassResolveAttachments;
+		ScratchVector<ScratchVector<uint32>>                 renderPassSubpassPreserveAttachments;
+		ScratchVector<VkAttachmentReference>                 renderPassSubpassDepthAttachments;
+		ScratchVector<VkSubpassDependency>                   renderPassSubpassDependency;
 
-		std::unordered_map<string, uint32>               attachmentNameIDMap;
+		ScratchUnorderedMap<string, uint32>                  attachmentNameIDMap;
 
 		VkRenderPassCreateInfo renderPassCreateInfo = {};
 
 		Json::Value renderPassRoot;
 		bool        bIsArray;
 
-		if (!JsonParser::Parse(InJsonPath, renderPassRoot))
+		if (!JsonParser::ParseText(renderPassText, renderPassRoot))
 		{
 			_log_error("JsonParser failed at file: " + InJsonPath, LogSystem::Category::LogicalDevice);
-			Engine::Get()->RequireExit(1);
+			return false;
 		}
 
 		auto& renderPassInfo = renderPassRoot[_text_mapper(vk_renderpass_info)];
@@ -922,7 +1552,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 		if (renderPassInfo == Json::nullValue)
 		{
 			_log_error("json file: [renderpass_info] can not be null!", LogSystem::Category::JsonParser);
-			Engine::Get()->RequireExit(1);
+			return false;
 		}
 
 		renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -1008,7 +1638,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 					else
 					{
 						_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 				}
 			}
@@ -1046,7 +1676,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 					else
 					{
 						_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 				}
 			}
@@ -1083,7 +1713,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 					else
 					{
 						_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 				}
 			}
@@ -1111,7 +1741,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 					else
 					{
 						_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 				}
 			}
@@ -1139,7 +1769,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 				else
 				{
 					_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-					Engine::Get()->RequireExit(1);
+					return false;
 				}
 			}
 			else
@@ -1150,8 +1780,6 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 			}
 		}
 
-		m_renderPassNameMapsubpassNameIDMap.emplace(renderPassName, subpassNameIDMap);
-
 		// Dependency.
 		bIsArray = renderPassInfo[_text_mapper(vk_subpass_dependencies)].isArray();
 		uint32 numDependency = bIsArray ? renderPassInfo[_text_mapper(vk_subpass_dependencies)].size() : _count_1;
@@ -1175,7 +1803,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 				else
 				{
 					_log_error(StringUtil::Printf("Specified subpass name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-					Engine::Get()->RequireExit(1);
+					return false;
 				}
 			}
 			else
@@ -1193,7 +1821,7 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 				else
 				{
 					_log_error(StringUtil::Printf("Specified subpass name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-					Engine::Get()->RequireExit(1);
+					return false;
 				}
 			}
 			else
@@ -1233,15 +1861,35 @@ void LogicalDevice::CreateRenderPass(const string& InJsonPath)
 			renderPassSubpassDependency[j].dependencyFlags = GetVkDependencyFlags(JsonParser::GetString(dependency[_text_mapper(vk_dependency_flags)]));
 		}
 
-		_declare_vk_smart_ptr(VkRenderPass, pRenderPass);
-		this->CreateRenderPass(pRenderPass.MakeInstance(), renderPassCreateInfo);
-	
-		m_renderPassNamePtrMap.emplace(renderPassName, pRenderPass);
+		// Parsed outside the lock, workers loading the same new file may both get here.
+		std::unique_lock<std::mutex> lock(m_renderPassMutex);
+
+		m_renderPassParseCount++;
+
+		auto foundFile = m_renderPassPathMap.find(canonicalPath);
+		if (foundFile != m_renderPassPathMap.end() && (*foundFile).second.TextHash == textHash)
+			return true;
+
+		VkSmartPtr<VkRenderPass> pRenderPass = this->FindOrCreateRenderPass(renderPassCreateInfo);
+
+		// The first file of a name keeps it, unless that file itself changed.
+		if (bIsChanged)
+		{
+			m_renderPassNamePtrMap[renderPassName]              = pRenderPass;
+			m_renderPassNameMapsubpassNameIDMap[renderPassName] = subpassNameIDMap;
+		}
+		else
+		{
+			m_renderPassNamePtrMap.emplace(renderPassName, pRenderPass);
+			m_renderPassNameMapsubpassNameIDMap.emplace(renderPassName, subpassNameIDMap);
+		}
+
+		m_renderPassPathMap[canonicalPath] = { textHash, renderPassName };
 	}
 
 	_log_common("End creating renderpass with " + InJsonPath, LogSystem::Category::RenderPass);
 
-	//return true;
+	return true;
 }
 
 void LogicalDevice::CreateSingleRenderPass(VkRenderPass* OutRenderPass, VkFormat InColorFormat, VkFormat InDepthFormat)
@@ -1375,7 +2023,22 @@ void LogicalDevice::CreateFrameBuffer(VkFramebuffer* OutFrameBuffer, VkRenderPas
 
 void LogicalDevice::CreateGraphicPipelines(VkPipeline* OutPipeline, const VkGraphicsPipelineCreateInfo* InCreateInfos, uint32 InCreateInfoCount /*= _count_1*/, VkPipelineCache InPipCache /*= VK_NULL_HANDLE*/)
 {
-	_vk_try(vkCreateGraphicsPipelines(m_device, InPipCache, InCreateInfoCount, InCreateInfos, GetVkAllocator(), OutPipeline));
+	if (InPipCache == VK_NULL_HANDLE)
+		InPipCache = m_pPipelineCacheManager->GetPipelineCache();
+
+	if (!m_pPipelineCacheManager->IsFeedbackEnabled())
+	{
+		_vk_try(vkCreateGraphicsPipelines(m_device, InPipCache, InCreateInfoCount, InCreateInfos, GetVkAllocator(), OutPipeline));
+		m_pPipelineCacheManager->RecordFeedback(nullptr, InCreateInfoCount);
+		return;
+	}
+
+	ScratchScope scratch;
+
+	FeedbackChain<VkGraphicsPipelineCreateInfo> feedbackChain(InCreateInfos, InCreateInfoCount);
+
+	_vk_try(vkCreateGraphicsPipelines(m_device, InPipCache, InCreateInfoCount, feedbackChain.CreateInfos.data(), GetVkAllocator(), OutPipeline));
+	m_pPipelineCacheManager->RecordFeedback(feedbackChain.Feedbacks.data(), InCreateInfoCount);
 }
 
 void LogicalDevice::CreateGraphicPipelines(VkPipeline* OutPipeline, const PipelineGraphicDesc* InDescs, uint32 InDescCount /*= _count_1*/, VkPipelineCache InPipCache /*= VK_NULL_HANDLE*/)
@@ -1477,15 +2140,17 @@ void LogicalDevice::CreateGraphicPipelines(VkPipeline* OutPipeline, const Pipeli
 		InDesc.BasePipelineIndex                         // basePipelineIndex
 	};
 
-	_vk_try(vkCreateGraphicsPipelines(m_device, InPipCache, _count_1, &graphicsPipelineCreateInfo, GetVkAllocator(), OutPipeline));
+	this->CreateGraphicPipelines(OutPipeline, &graphicsPipelineCreateInfo, _count_1, InPipCache);
 }
 
-void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineCache InPipCache)
+void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineCache InPipCache, uint32 InWorkerCount)
 {
 	{
 		_log_common("Begin creating graphic pipeline with " + InJsonPath, LogSystem::Category::LogicalDevice);
 
-		TimerUtil::PerformanceScope scope(_name_of(CreateGraphicPipelines));
+		const uint32 maxWorkerCount = InWorkerCount != _count_0 ? InWorkerCount : std::max(std::thread::hardware_concurrency(), (uint32)_count_1);
+
+		TimerUtil::PerformanceScope scope(StringUtil::Printf("%(% workers)", _name_of(CreateGraphicPipelines), maxWorkerCount));
 
 		if (m_pBaseLayer == nullptr)
 		{
@@ -1493,6 +2158,9 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 			Engine::Get()->RequireExit(1);
 		}
 
+		if (InPipCache == VK_NULL_HANDLE)
+			InPipCache = m_pPipelineCacheManager->GetPipelineCache();
+
 		Json::Value root;
 
 		if (!JsonParser::Parse(InJsonPath, root))
@@ -1507,60 +2175,229 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 			Engine::Get()->RequireExit(1);
 		}
 
-		bool   bIsArray = root[_text_mapper(vk_graphic_pipeline_infos)].isArray();
-		uint32 numGInfo = bIsArray ? root[_text_mapper(vk_graphic_pipeline_infos)].size() : _count_1;
+		// Workers only read the infos, non const access would insert missing keys.
+		const Json::Value& pipelineInfos = root[_text_mapper(vk_graphic_pipeline_infos)];
 
-		WindowDesc windowDesc = Engine::Get()->GetWindowDesc();
+		bool   bIsArray = pipelineInfos.isArray();
+		uint32 numGInfo = bIsArray ? pipelineInfos.size() : _count_1;
 
-		VkViewport currentViewport = {};
-		VkRect2D   currentScissor  = {};
-		this->SetViewport(currentViewport, currentScissor, windowDesc.Width, windowDesc.Height);
+		ScratchScope scratch;
 
-		LocalResourcePool localResPool;
+		ScratchVector<VkPipeline> pipelines(numGInfo);
+
+		// A derivative names its base by index in the same vkCreateGraphicsPipelines call,
+		// a chain stays on one worker. Bases are looked up the way the builder does it,
+		// by the names seen so far, the first pipeline of a name wins.
+		ScratchVector<uint32>              chainIDs(numGInfo);
+		ScratchVector<uint32>              chainSizes(numGInfo);
+		ScratchUnorderedMap<string, int32> basePipelineNameIDMap;
+
+		uint32 numChain = _count_0;
+
+		for (uint32 i = 0; i < numGInfo; i++)
+		{
+			auto& graphicInfo = bIsArray ? pipelineInfos[i] : pipelineInfos;
+
+			basePipelineNameIDMap.emplace(JsonParser::GetString(graphicInfo[_text_mapper(vk_name)]), i);
+
+			auto found = basePipelineNameIDMap.find(JsonParser::GetString(graphicInfo[_text_mapper(vk_base_pipeline)]));
+			if (found != basePipelineNameIDMap.end() && (uint32)(*found).second != i)
+			{
+				chainIDs[i] = chainIDs[(*found).second];
+			}
+			else
+			{
+				chainIDs[i] = i;
+				numChain++;
+			}
+
+			chainSizes[chainIDs[i]]++;
+		}
+
+		const uint32 workerCount = std::min(maxWorkerCount, numChain);
+
+		if (workerCount <= _count_1)
+		{
+			ScratchVector<uint32> indices(numGInfo);
+			for (uint32 i = 0; i < numGInfo; i++)
+				indices[i] = i;
+
+			if (!this->BuildGraphicPipelines(pipelineInfos, bIsArray, indices.data(), numGInfo, m_pCompiler, InPipCache, pipelines.data()))
+				Engine::Get()->RequireExit(1);
+		}
+		else
+		{
+			// Biggest chains first, each to the worker with the fewest pipelines so far.
+			ScratchVector<uint32> chains;
+			for (uint32 i = 0; i < numGInfo; i++)
+			{
+				if (chainIDs[i] == i)
+					chains.push_back(i);
+			}
+
+			std::stable_sort(chains.begin(), chains.end(), [&chainSizes](uint32 InA, uint32 InB) { return chainSizes[InA] > chainSizes[InB]; });
+
+			ScratchVector<uint32> workerLoads(workerCount);
+			ScratchVector<uint32> chainWorkers(numGInfo);
+
+			for (uint32 chainID : chains)
+			{
+				const uint32 workerIndex = (uint32)(std::min_element(workerLoads.begin(), workerLoads.end()) - workerLoads.begin());
+
+				chainWorkers[chainID]     = workerIndex;
+				workerLoads[workerIndex] += chainSizes[chainID];
+			}
+
+			// Ascending indices per worker, bases come before their derivatives.
+			ScratchVector<ScratchVector<uint32>> workerIndices(workerCount);
+			for (uint32 i = 0; i < numGInfo; i++)
+				workerIndices[chainWorkers[chainIDs[i]]].push_back(i);
+
+			// A GLSLCompiler holds the reflection of the shaders it compiled last, one per worker.
+			while ((uint32)m_workerCompilers.size() + _count_1 < workerCount)
+				m_workerCompilers.push_back(GLSLCompiler::Create(this));
+
+			// Workers fill their own cache, no lock on a shared one while creating.
+			std::vector<uint8> seedData;
+			if (InPipCache != VK_NULL_HANDLE)
+				this->GetPipelineCacheData(InPipCache, seedData);
+
+			std::vector<VkSmartPtr<VkPipelineCache>> workerCachePtrs(workerCount);
+			ScratchVector<VkPipelineCache>           workerCaches(workerCount);
+
+			for (uint32 workerIndex = 0; workerIndex < workerCount; workerIndex++)
+			{
+				if (seedData.empty())
+					this->CreateEmptyPipelineCache(workerCachePtrs[workerIndex].MakeInstance(m_pContext));
+				else
+					this->CreatePipelineCache(workerCachePtrs[workerIndex].MakeInstance(m_pContext), seedData.data(), seedData.size());
+
+				workerCaches[workerIndex] = *workerCachePtrs[workerIndex];
+			}
+
+			std::vector<std::thread> workers;
+			workers.reserve(workerCount);
+
+			// Workers report, the exit is left to this thread.
+			std::atomic<bool> bFailed(false);
+
+			for (uint32 workerIndex = 0; workerIndex < workerCount; workerIndex++)
+			{
+				GLSLCompiler* pCompiler = workerIndex == _index_0 ? m_pCompiler : m_workerCompilers[workerIndex - 1];
+
+				const ScratchVector<uint32>& indices = workerIndices[workerIndex];
+
+				workers.emplace_back([this, &pipelineInfos, bIsArray, &indices, pCompiler, &workerCaches, workerIndex, &pipelines, &bFailed]()
+				{
+					if (!this->BuildGraphicPipelines(pipelineInfos, bIsArray, indices.data(), (uint32)indices.size(), pCompiler, workerCaches[workerIndex], pipelines.data()))
+						bFailed = true;
+				});
+			}
+
+			for (auto& worker : workers)
+				worker.join();
+
+			if (bFailed)
+				Engine::Get()->RequireExit(1);
+
+			// Merge into the given cache, or into a new one SavePipelineCacheToFile() picks up.
+			VkPipelineCache mergedPipCache = InPipCache;
+
+			if (mergedPipCache == VK_NULL_HANDLE)
+			{
+				_declare_vk_smart_ptr(VkPipelineCache, pMergedPipCache);
+
+				this->CreateEmptyPipelineCache(pMergedPipCache.MakeInstance(m_pContext));
 
-		std::vector<VkGraphicsPipelineCreateInfo>                     graphicInfos;
-		std::vector<std::vector<VkPipelineShaderStageCreateInfo>>     shaderInfos;
-		std::vector<string>                                           shaderEntrypoints;
-		std::vector<std::vector<VkSpecializationMapEntry>>            specMaps;
-		std::vector<std::vector<uint32>>                              specData;
-		std::vector<VkSpecializationInfo>                             specInfos;
-		std::vector<std::vector<VkSampleMask>>                        sampleMasks;
-		std::vector<VkPipelineVertexInputStateCreateInfo>             vertexInputStateInfos;
-		std::vector<std::vector<VkVertexInputBindingDescription>>     vertexInputBindings;
-		std::vector<std::vector<VkVertexInputAttributeDescription>>   vertexInputAttributes;
-		std::vector<VkPipelineInputAssemblyStateCreateInfo>           pipelineIAStateInfos;
-		std::vector<VkPipelineTessellationStateCreateInfo>            pipelineTessStateInfos;
-		std::vector<VkPipelineViewportStateCreateInfo>                pipelineViewportStateInfos;
-		std::vector<VkPipelineRasterizationStateCreateInfo>           pipelineRSStateInfos;
-		std::vector<VkPipelineMultisampleStateCreateInfo>             pipelineMultisampleStateInfos;
-		std::vector<VkPipelineDepthStencilStateCreateInfo>            pipelineDepthStencilStateInfos;
-		std::vector<VkPipelineColorBlendStateCreateInfo>              pipelineColorBlendStateInfos;
-		std::vector<VkPipelineDynamicStateCreateInfo>                 pipelineDynamicStateInfos;
-		std::vector<std::vector<VkPipelineColorBlendAttachmentState>> colorBlendAttachmentStates;
-		std::vector<std::vector<VkDynamicState>>                      dynamicStates;
-		std::unordered_map<string, int32>                             basePipelineNameIDMap;
-
-		graphicInfos.resize(numGInfo);
-		shaderInfos.resize(numGInfo);
-		specMaps.resize(numGInfo);
-		specData.resize(numGInfo);
-		specInfos.resize(numGInfo);
-		sampleMasks.resize(numGInfo);
-		vertexInputStateInfos.resize(numGInfo);
-		vertexInputBindings.resize(numGInfo);
-		vertexInputAttributes.resize(numGInfo);
-		pipelineIAStateInfos.resize(numGInfo);
-		pipelineTessStateInfos.resize(numGInfo);
-		pipelineViewportStateInfos.resize(numGInfo);
-		pipelineRSStateInfos.resize(numGInfo);
-		pipelineMultisampleStateInfos.resize(numGInfo);
-		pipelineDepthStencilStateInfos.resize(numGInfo);
-		pipelineColorBlendStateInfos.resize(numGInfo);
-		pipelineDynamicStateInfos.resize(numGInfo);
-		colorBlendAttachmentStates.resize(numGInfo);
-		dynamicStates.resize(numGInfo);
+				m_pipelineCaches.push_back(*pMergedPipCache);
+				m_pipelineCachePtrs.push_back(pMergedPipCache);
 
+				mergedPipCache = *pMergedPipCache;
+			}
+
+			this->MergePipelineCaches(mergedPipCache, workerCaches.data(), workerCount);
+		}
+
+		// The smart pointers hold copies of the handles, in creation order the first pipeline of a name wins.
 		for (uint32 i = 0; i < numGInfo; i++)
+		{
+			auto& graphicInfo = bIsArray ? pipelineInfos[i] : pipelineInfos;
+
+			this->RegisterPipeline(JsonParser::GetString(graphicInfo[_text_mapper(vk_name)]), pipelines[i]);
+		}
+
+		_log_common("End creating graphic pipeline with " + InJsonPath, LogSystem::Category::LogicalDevice);
+	}
+
+	// test...
+	// Engine::Get()->RequireExit(1);
+
+	//return true;
+}
+
+bool LogicalDevice::BuildGraphicPipelines(const Json::Value& InGraphicInfos, bool InIsArray, const uint32* InIndices, uint32 InCount, GLSLCompiler* InCompiler, VkPipelineCache InPipCache, VkPipeline* OutPipelines)
+{
+	{
+		bool bIsArray;
+
+		WindowDesc windowDesc = Engine::Get()->GetWindowDesc();
+
+		// Create infos and local resources only live for this call, keep them off the heap.
+		// The arena belongs to the calling thread, each worker has its own.
+		ScratchScope scratch;
+
+		LocalResourcePool localResPool;
+
+		ScratchVector<VkGraphicsPipelineCreateInfo>                           graphicInfos;
+		ScratchVector<ScratchVector<VkPipelineShaderStageCreateInfo>>         shaderInfos;
+		ScratchVector<ScratchVector<string>>                                  shaderEntrypoints;
+		ScratchVector<ScratchVector<ScratchVector<VkSpecializationMapEntry>>> specMaps;
+		ScratchVector<ScratchVector<ScratchVector<uint32>>>                   specData;
+		ScratchVector<ScratchVector<VkSpecializationInfo>>                    specInfos;
+		ScratchVector<ScratchVector<VkSampleMask>>                            sampleMasks;
+		ScratchVector<VkPipelineVertexInputStateCreateInfo>                   vertexInputStateInfos;
+		ScratchVector<ScratchVector<VkVertexInputBindingDescription>>         vertexInputBindings;
+		ScratchVector<ScratchVector<VkVertexInputAttributeDescription>>       vertexInputAttributes;
+		ScratchVector<VkPipelineInputAssemblyStateCreateInfo>                 pipelineIAStateInfos;
+		ScratchVector<VkPipelineTessellationStateCreateInfo>                  pipelineTessStateInfos;
+		ScratchVector<VkPipelineViewportStateCreateInfo>                      pipelineViewportStateInfos;
+		ScratchVector<ScratchVector<VkViewport>>                              viewports;
+		ScratchVector<ScratchVector<VkRect2D>>                                scissors;
+		ScratchVector<VkPipelineRasterizationStateCreateInfo>                 pipelineRSStateInfos;
+		ScratchVector<VkPipelineMultisampleStateCreateInfo>                   pipelineMultisampleStateInfos;
+		ScratchVector<VkPipelineDepthStencilStateCreateInfo>                  pipelineDepthStencilStateInfos;
+		ScratchVector<VkPipelineColorBlendStateCreateInfo>                    pipelineColorBlendStateInfos;
+		ScratchVector<VkPipelineDynamicStateCreateInfo>                       pipelineDynamicStateInfos;
+		ScratchVector<ScratchVector<VkPipelineColorBlendAttachmentState>>     colorBlendAttachmentStates;
+		ScratchVector<ScratchVector<VkDynamicState>>                          dynamicStates;
+		ScratchVector<ScratchVector<VkSmartPtr<VkShaderModule>>>              variantShaderModules;
+		ScratchUnorderedMap<string, int32>                                    basePipelineNameIDMap;
+
+		graphicInfos.resize(InCount);
+		shaderInfos.resize(InCount);
+		shaderEntrypoints.resize(InCount);
+		specMaps.resize(InCount);
+		specData.resize(InCount);
+		specInfos.resize(InCount);
+		sampleMasks.resize(InCount);
+		vertexInputStateInfos.resize(InCount);
+		vertexInputBindings.resize(InCount);
+		vertexInputAttributes.resize(InCount);
+		pipelineIAStateInfos.resize(InCount);
+		pipelineTessStateInfos.resize(InCount);
+		pipelineViewportStateInfos.resize(InCount);
+		viewports.resize(InCount);
+		scissors.resize(InCount);
+		pipelineRSStateInfos.resize(InCount);
+		pipelineMultisampleStateInfos.resize(InCount);
+		pipelineDepthStencilStateInfos.resize(InCount);
+		pipelineColorBlendStateInfos.resize(InCount);
+		pipelineDynamicStateInfos.resize(InCount);
+		colorBlendAttachmentStates.resize(InCount);
+		dynamicStates.resize(InCount);
+		variantShaderModules.resize(InCount);
+
+		for (uint32 i = 0; i < InCount; i++)
 		{
 			pipelineIAStateInfos[i] = RenderBaseConfig::Pipeline::DefaultInputAssemblyStateInfo;
 			pipelineTessStateInfos[i] = RenderBaseConfig::Pipeline::DefaultTessellationStateInfo;
@@ -1571,8 +2408,7 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 			pipelineColorBlendStateInfos[i] = RenderBaseConfig::Pipeline::DefaultColorBlendStateInfo;
 			pipelineDynamicStateInfos[i] = RenderBaseConfig::Pipeline::DefaultDynamicStateInfo;
 
-			bIsArray = root[_text_mapper(vk_graphic_pipeline_infos)].isArray();
-			auto& graphicInfo = bIsArray ? root[_text_mapper(vk_graphic_pipeline_infos)][i] : root[_text_mapper(vk_graphic_pipeline_infos)];
+			auto& graphicInfo = InIsArray ? InGraphicInfos[InIndices[i]] : InGraphicInfos;
 
 			basePipelineNameIDMap.emplace(JsonParser::GetString(graphicInfo[_text_mapper(vk_name)]), i);
 
@@ -1580,18 +2416,27 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 			graphicInfos[i].pNext = nullptr;
 			graphicInfos[i].flags = JsonParser::GetUInt32(graphicInfo[_text_mapper(vk_flags)]);
 
+			// Variants derive from it, see GetPipeline(name, constants).
+			const bool bHasVariants = graphicInfo[_text_mapper(vk_variable_specialization_constants)] != Json::nullValue;
+			if (bHasVariants)
+				graphicInfos[i].flags |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+
 			// Pipeline Stage.
 			if (graphicInfo[_text_mapper(vk_pipeline_stages_infos)] == Json::nullValue)
 			{
 				_log_error("json file: [pipeline_stages_infos] can not be null!", LogSystem::Category::JsonParser);
-				Engine::Get()->RequireExit(1);
+				return false;
 			}
 
 			bIsArray = graphicInfo[_text_mapper(vk_pipeline_stages_infos)].isArray();
 			uint32 numStageInfo = bIsArray ? graphicInfo[_text_mapper(vk_pipeline_stages_infos)].size() : _count_1;
 
+			// Sized once, the entry point strings and the spec infos are pointed to.
 			shaderInfos[i].resize(numStageInfo);
-			shaderEntrypoints.resize(numGInfo * numStageInfo);
+			shaderEntrypoints[i].resize(numStageInfo);
+			specMaps[i].resize(numStageInfo);
+			specData[i].resize(numStageInfo);
+			specInfos[i].resize(numStageInfo);
 
 			graphicInfos[i].stageCount = numStageInfo;
 			graphicInfos[i].pStages = shaderInfos[i].data();
@@ -1605,58 +2450,64 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				if (shaderPath == _str_null)
 				{
 					_log_error("json file: [stage_code_path] can not be null!", LogSystem::Category::JsonParser);
-					Engine::Get()->RequireExit(1);
+					return false;
 				}
 
-				shaderEntrypoints[i * numStageInfo + j] = JsonParser::GetString(shaderInfo[_text_mapper(vk_entrypoint)], "main");
+				shaderEntrypoints[i][j] = JsonParser::GetString(shaderInfo[_text_mapper(vk_entrypoint)], DefaultShaderEntryPoint);
 
 				_declare_vk_smart_ptr(VkShaderModule, pShaderModule);
 				VkShaderStageFlags currentShaderStage, userDefinedShaderStage;
-				this->CreateShaderModule(pShaderModule.MakeInstance(), Path(shaderPath), shaderEntrypoints[i * numStageInfo + j].c_str(), &currentShaderStage);
+				if (!this->CreateShaderModule(pShaderModule.MakeInstance(m_pContext), InCompiler, Path(shaderPath), shaderEntrypoints[i][j].c_str(), &currentShaderStage))
+					return false;
 
-				localResPool.Push(VkCast<VkShaderModule>(pShaderModule));
+				// Variants are created from the modules of their base, they stay with its variant info.
+				if (bHasVariants)
+					variantShaderModules[i].push_back(pShaderModule);
+				else
+					localResPool.Push(pShaderModule);
 
 				shaderInfos[i][j].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 				shaderInfos[i][j].pNext = nullptr;
 				shaderInfos[i][j].flags = JsonParser::GetUInt32(shaderInfo[_text_mapper(vk_flags)]);
-				shaderInfos[i][j].stage = (VkShaderStageFlagBits)((shaderInfo[_text_mapper(vk_stage_type)] != Json::nullValue) ? (GetShaderStage(JsonParser::GetString(shaderInfo[_text_mapper(vk_stage_type)]), userDefinedShaderStage) ? userDefinedShaderStage : currentShaderStage) : currentShaderStage);
+				shaderInfos[i][j].stage = (VkShaderStageFlagBits)((shaderInfo[_text_mapper(vk_stage_type)] != Json::nullValue) ? (GetShaderStage(JsonParser::GetString(shaderInfo[_text_mapper(vk_stage_type)]), userDefinedShaderStage) && userDefinedShaderStage != VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM ? userDefinedShaderStage : currentShaderStage) : currentShaderStage);
 				shaderInfos[i][j].module = *pShaderModule;
-				shaderInfos[i][j].pName = shaderEntrypoints[i * numStageInfo + j].c_str();
-				shaderInfos[i][j].pSpecializationInfo = &specInfos[i];
+				shaderInfos[i][j].pName = shaderEntrypoints[i][j].c_str();
+				shaderInfos[i][j].pSpecializationInfo = &specInfos[i][j];
 
+				// Each stage has constants of its own, like PipelinePack::Bake() records them.
 				if (shaderInfo[_text_mapper(vk_specialization_constants)] != Json::nullValue)
 				{
 					bIsArray = shaderInfo[_text_mapper(vk_specialization_constants)].isArray();
 					uint32 numSpecConst = bIsArray ? shaderInfo[_text_mapper(vk_specialization_constants)].size() : _count_1;
 
-					specMaps[i].resize(numSpecConst);
-					specData[i].resize(numSpecConst);
+					specMaps[i][j].resize(numSpecConst);
+					specData[i][j].resize(numSpecConst);
 
-					specInfos[i].mapEntryCount = numSpecConst;
-					specInfos[i].pMapEntries = specMaps[i].data();
-					specInfos[i].dataSize = numSpecConst * 4; // 4 byte per const, 32 bit value.
-					specInfos[i].pData = specData[i].data();
+					specInfos[i][j].mapEntryCount = numSpecConst;
+					specInfos[i][j].pMapEntries = specMaps[i][j].data();
+					specInfos[i][j].dataSize = numSpecConst * 4; // 4 byte per const, 32 bit value.
+					specInfos[i][j].pData = specData[i][j].data();
 
 					for (uint32 k = 0; k < numSpecConst; k++)
 					{
 						auto& value = bIsArray ? shaderInfo[_text_mapper(vk_specialization_constants)][k] : shaderInfo[_text_mapper(vk_specialization_constants)];
 
-						specMaps[i][k].constantID = k;
-						specMaps[i][k].offset = k * 4; // 4 byte per const, 32 bit value.
-						specMaps[i][k].size = 4;     // 4 byte per const, 32 bit value.
+						specMaps[i][j][k].constantID = k;
+						specMaps[i][j][k].offset = k * 4; // 4 byte per const, 32 bit value.
+						specMaps[i][j][k].size = 4;     // 4 byte per const, 32 bit value.
 
 						//////////////////////////////////////////////////////////////
 						// json value reinterpretation.
 						switch (value.type())
 						{
-							case Json::ValueType::intValue:     specMaps[i][k].size = sizeof(int32);    _reinterpret_data(specData[i][k], value.asInt());   break;
-							case Json::ValueType::uintValue:    specMaps[i][k].size = sizeof(uint32);   _reinterpret_data(specData[i][k], value.asUInt());  break;
-							case Json::ValueType::realValue:    specMaps[i][k].size = sizeof(float);    _reinterpret_data(specData[i][k], value.asFloat()); break;
-							case Json::ValueType::booleanValue: specMaps[i][k].size = sizeof(VkBool32); _reinterpret_data(specData[i][k], value.asBool());  break;
+							case Json::ValueType::intValue:     _reinterpret_data(specData[i][j][k], value.asInt());   break;
+							case Json::ValueType::uintValue:    _reinterpret_data(specData[i][j][k], value.asUInt());  break;
+							case Json::ValueType::realValue:    _reinterpret_data(specData[i][j][k], value.asFloat()); break;
+							case Json::ValueType::booleanValue: specData[i][j][k] = value.asBool() ? VK_TRUE : VK_FALSE; break;
 							default:
 							{
 								_log_error("json file: not support [specialization_constants] value type!", LogSystem::Category::JsonParser);
-								Engine::Get()->RequireExit(1);
+								return false;
 							}
 						}
 						//////////////////////////////////////////////////////////////
@@ -1669,27 +2520,24 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 			}
 
 			// Pipeline Layout.
-			std::vector<VkPushConstantRange> pushConstantRanges;
-			std::vector<std::vector<VkDescriptorSetLayoutBinding>> descSets;
-
-			if (!m_pCompiler->CheckAndParseSPVData(m_pBaseLayer->GetMainPDLimits().maxBoundDescriptorSets, pushConstantRanges, descSets))
-				Engine::Get()->RequireExit(1);
-
-			m_pCompiler->FlushSPVData();
+			graphicInfos[i].layout = this->CreateReflectedPipelineLayout(InCompiler);
+			if (graphicInfos[i].layout == VK_NULL_HANDLE)
+				return false;
 
 			// Vertex Input State.
 			graphicInfos[i].pVertexInputState = &vertexInputStateInfos[i];
 			if (graphicInfo[_text_mapper(vk_vertex_input_attributes)] == Json::nullValue)
 			{
 				_log_error("json file: [vertex_input_attributes] can not be null!", LogSystem::Category::JsonParser);
-				Engine::Get()->RequireExit(1);
+				return false;
 			}
 
 			// Bindings.
 			bIsArray = graphicInfo[_text_mapper(vk_vertex_input_attributes)].isArray();
 			uint32 numBinding = bIsArray ? graphicInfo[_text_mapper(vk_vertex_input_attributes)].size() : _count_1;
 
-			vertexInputBindings[i].resize(numBinding);
+			// Locations run on over the bindings, like PipelinePack::Bake() records them.
+			uint32 location = _index_0;
 
 			for (uint32 j = 0; j < numBinding; j++)
 			{
@@ -1714,33 +2562,36 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				bIsArray = binding[_text_mapper(vk_attributes)].isArray();
 				uint32 numAttribute = bIsArray ? binding[_text_mapper(vk_attributes)].size() : _count_1;
 
-				vertexInputAttributes[i].resize(numAttribute);
-
-				uint32  attributeOffset = 0;
-				uint32& allAttributeSize = attributeOffset;
+				uint32 attributeOffset = 0;
 				for (uint32 k = 0; k < numAttribute; k++)
 				{
 					string attribute = bIsArray ? binding[_text_mapper(vk_attributes)][k].asString() : binding[_text_mapper(vk_attributes)].asString();
 
-					vertexInputAttributes[i][k].binding = _index_0;
-					vertexInputAttributes[i][k].location = k;
-					vertexInputAttributes[i][k].format = GetVertexAttributeVkFormat(attribute);
-					vertexInputAttributes[i][k].offset = attributeOffset;
+					VkVertexInputAttributeDescription attributeDesc = {};
+					attributeDesc.binding = bindingID;
+					attributeDesc.location = location++;
+					attributeDesc.format = GetVertexAttributeVkFormat(attribute);
+					attributeDesc.offset = attributeOffset;
+
+					vertexInputAttributes[i].push_back(attributeDesc);
 
 					attributeOffset += GetVertexAttributeSize(attribute);
 				}
 
-				vertexInputBindings[i][j].binding = bindingID;
-				vertexInputBindings[i][j].stride = allAttributeSize;
-				vertexInputBindings[i][j].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+				VkVertexInputBindingDescription bindingDesc = {};
+				bindingDesc.binding = bindingID;
+				bindingDesc.stride = attributeOffset;
+				bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-				vertexInputStateInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-				vertexInputStateInfos[i].vertexBindingDescriptionCount = numBinding;
-				vertexInputStateInfos[i].pVertexBindingDescriptions = vertexInputBindings[i].data();
-				vertexInputStateInfos[i].vertexAttributeDescriptionCount = numAttribute;
-				vertexInputStateInfos[i].pVertexAttributeDescriptions = vertexInputAttributes[i].data();
+				vertexInputBindings[i].push_back(bindingDesc);
 			}
 
+			vertexInputStateInfos[i].sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputStateInfos[i].vertexBindingDescriptionCount = (uint32)vertexInputBindings[i].size();
+			vertexInputStateInfos[i].pVertexBindingDescriptions = vertexInputBindings[i].data();
+			vertexInputStateInfos[i].vertexAttributeDescriptionCount = (uint32)vertexInputAttributes[i].size();
+			vertexInputStateInfos[i].pVertexAttributeDescriptions = vertexInputAttributes[i].data();
+
 			// IA State.
 			graphicInfos[i].pInputAssemblyState = &pipelineIAStateInfos[i];
 			auto& inputAssemblyInfo = graphicInfo[_text_mapper(vk_pipeline_input_assembly)];
@@ -1773,11 +2624,15 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				bIsArray = viewportInfo[_text_mapper(vk_viewports)].isArray();
 				uint32 numViewport = bIsArray ? viewportInfo[_text_mapper(vk_viewports)].size() : _count_1;
 
+				// Every viewport is kept, like PipelinePack::Bake() records them.
+				viewports[i].resize(numViewport);
+				scissors[i].resize(numViewport);
+
 				pipelineViewportStateInfos[i].flags = JsonParser::GetUInt32(viewportInfo[_text_mapper(vk_flags)]);
 				pipelineViewportStateInfos[i].viewportCount = numViewport;
 				pipelineViewportStateInfos[i].scissorCount = numViewport;
-				pipelineViewportStateInfos[i].pViewports = &currentViewport;
-				pipelineViewportStateInfos[i].pScissors = &currentScissor;
+				pipelineViewportStateInfos[i].pViewports = viewports[i].data();
+				pipelineViewportStateInfos[i].pScissors = scissors[i].data();
 
 				for (uint32 j = 0; j < numViewport; j++)
 				{
@@ -1787,40 +2642,40 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 					if (!viewport[_text_mapper(vk_position)].isArray())
 					{
 						_log_error("json file: viewport [position] must be an array [ first, second ]!", LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 					if (!viewport[_text_mapper(vk_size)].isArray())
 					{
 						_log_error("json file: viewport [size] must be an array [ first, second ]!", LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 					if (!viewport[_text_mapper(vk_depth_range)].isArray())
 					{
 						_log_error("json file: viewport [depth_range] must be an array [ first, second ]!", LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 					if (!scissor[_text_mapper(vk_offset)].isArray())
 					{
 						_log_error("json file: scissor [offset] must be an array [ first, second ]!", LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 					if (!scissor[_text_mapper(vk_size)].isArray())
 					{
 						_log_error("json file: scissor [size] must be an array [ first, second ]!", LogSystem::Category::JsonParser);
-						Engine::Get()->RequireExit(1);
+						return false;
 					}
 
-					currentViewport.x = JsonParser::GetFloat(viewport[_text_mapper(vk_position)][0]);
-					currentViewport.y = JsonParser::GetFloat(viewport[_text_mapper(vk_position)][1]);
-					currentViewport.width = JsonParser::GetString(viewport[_text_mapper(vk_size)][0]) == "auto" ? (float)windowDesc.Width : JsonParser::GetFloat(viewport[_text_mapper(vk_size)][0]);
-					currentViewport.height = JsonParser::GetString(viewport[_text_mapper(vk_size)][1]) == "auto" ? (float)windowDesc.Height : JsonParser::GetFloat(viewport[_text_mapper(vk_size)][1]);
-					currentViewport.minDepth = JsonParser::GetFloat(viewport[_text_mapper(vk_depth_range)][0]);
-					currentViewport.maxDepth = JsonParser::GetFloat(viewport[_text_mapper(vk_depth_range)][1]);
-
-					currentScissor.offset.x = JsonParser::GetInt32(scissor[_text_mapper(vk_offset)][0]);
-					currentScissor.offset.y = JsonParser::GetInt32(scissor[_text_mapper(vk_offset)][1]);
-					currentScissor.extent.width = JsonParser::GetString(scissor[_text_mapper(vk_size)][0]) == "auto" ? windowDesc.Width : JsonParser::GetUInt32(scissor[_text_mapper(vk_size)][0]);
-					currentScissor.extent.height = JsonParser::GetString(scissor[_text_mapper(vk_size)][1]) == "auto" ? windowDesc.Height : JsonParser::GetUInt32(scissor[_text_mapper(vk_size)][1]);
+					viewports[i][j].x = JsonParser::GetFloat(viewport[_text_mapper(vk_position)][0]);
+					viewports[i][j].y = JsonParser::GetFloat(viewport[_text_mapper(vk_position)][1]);
+					viewports[i][j].width = JsonParser::GetString(viewport[_text_mapper(vk_size)][0]) == "auto" ? (float)windowDesc.Width : JsonParser::GetFloat(viewport[_text_mapper(vk_size)][0]);
+					viewports[i][j].height = JsonParser::GetString(viewport[_text_mapper(vk_size)][1]) == "auto" ? (float)windowDesc.Height : JsonParser::GetFloat(viewport[_text_mapper(vk_size)][1]);
+					viewports[i][j].minDepth = JsonParser::GetFloat(viewport[_text_mapper(vk_depth_range)][0]);
+					viewports[i][j].maxDepth = JsonParser::GetFloat(viewport[_text_mapper(vk_depth_range)][1]);
+
+					scissors[i][j].offset.x = JsonParser::GetInt32(scissor[_text_mapper(vk_offset)][0]);
+					scissors[i][j].offset.y = JsonParser::GetInt32(scissor[_text_mapper(vk_offset)][1]);
+					scissors[i][j].extent.width = JsonParser::GetString(scissor[_text_mapper(vk_size)][0]) == "auto" ? windowDesc.Width : JsonParser::GetUInt32(scissor[_text_mapper(vk_size)][0]);
+					scissors[i][j].extent.height = JsonParser::GetString(scissor[_text_mapper(vk_size)][1]) == "auto" ? windowDesc.Height : JsonParser::GetUInt32(scissor[_text_mapper(vk_size)][1]);
 				}
 			}
 
@@ -1967,25 +2822,6 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				pipelineDynamicStateInfos[i].pDynamicStates = dynamicStates[i].data();
 			}
 
-			// Pipeline Layout.
-			std::vector<VkDescriptorSetLayout> descSetLayouts;
-
-			for (auto& bindings : descSets)
-			{
-				_declare_vk_smart_ptr(VkDescriptorSetLayout, pDescSetLayout);
-
-				this->CreateDescriptorSetLayout(pDescSetLayout.MakeInstance(), bindings.data(), (uint32)bindings.size());
-				descSetLayouts.push_back(*pDescSetLayout);
-				localResPool.Push(VkCast<VkDescriptorSetLayout>(pDescSetLayout));
-			}
-
-			_declare_vk_smart_ptr(VkPipelineLayout, pPipelineLayout);
-
-			this->CreatePipelineLayout(pPipelineLayout.MakeInstance(), descSetLayouts.data(), (uint32)descSetLayouts.size(), pushConstantRanges.data(), (uint32)pushConstantRanges.size());
-			localResPool.Push(VkCast<VkPipelineLayout>(pPipelineLayout));
-
-			graphicInfos[i].layout = *pPipelineLayout;
-
 			/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 			// RenderPass.
 			{
@@ -1993,15 +2829,28 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				if (renderPassPath == _str_null)
 				{
 					_log_error("json file: [renderpass_path] can not be null!", LogSystem::Category::JsonParser);
-					Engine::Get()->RequireExit(1);
+					return false;
 				}
 
+				// Locks only around the maps, the file is read and parsed outside.
 				string renderPassJson = PathParser::Parse(renderPassPath);
-				this->CreateRenderPass(renderPassJson);
+				if (!this->LoadRenderPass(renderPassJson))
+					return false;
+
+				// Workers share the render pass maps.
+				std::unique_lock<std::mutex> lock(m_renderPassMutex);
 
 				string renderPassName = JsonParser::GetString(graphicInfo[_text_mapper(vk_renderpass)]);
 
-				graphicInfos[i].renderPass = this->GetRenderPass(renderPassName);
+				// GetRenderPass() would take the lock again.
+				auto foundRenderPass = m_renderPassNamePtrMap.find(renderPassName);
+				if (foundRenderPass != m_renderPassNamePtrMap.end())
+					graphicInfos[i].renderPass = *((*foundRenderPass).second);
+				else
+				{
+					_log_warning(StringUtil::Printf("%: Specified renderpass name(%) is not exit!", _name_of(BuildGraphicPipelines), renderPassName), LogSystem::Category::LogicalDevice);
+					graphicInfos[i].renderPass = VK_NULL_HANDLE;
+				}
 
 				// Subpass ID.
 				string name = JsonParser::GetString(graphicInfo[_text_mapper(vk_subpass)]);
@@ -2014,7 +2863,7 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				else
 				{
 					_log_error(StringUtil::Printf("Specified subpass name \"%\" was not found!", name), LogSystem::Category::JsonParser);
-					Engine::Get()->RequireExit(1);
+					return false;
 				}
 			}
 			/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2031,31 +2880,366 @@ void LogicalDevice::CreateGraphicPipelines(const string& InJsonPath, VkPipelineC
 				}
 				else
 				{
-					_log_warning(StringUtil::Printf("Specified base_pipeline name \"%\" was not found in previous created pipeline, current pipeline will try to find a such named pipeline as the base pipeline in memory!", name), LogSystem::Category::JsonParser);
-
-					graphicInfos[i].basePipelineHandle = this->GetPipeline(name);
+					// Bases of earlier calls, requested pipelines and the bases of variants are in memory.
+					graphicInfos[i].basePipelineHandle = this->FindPipeline(name);
 					graphicInfos[i].basePipelineIndex = -1;
+
+					if (graphicInfos[i].basePipelineHandle == VK_NULL_HANDLE)
+						_log_warning(StringUtil::Printf("Specified base_pipeline name \"%\" was not found in previous created pipeline nor in memory!", name), LogSystem::Category::JsonParser);
 				}
 			}
 		}
 
-		VkPipeline* pPipelines = new VkPipeline[numGInfo];
-		this->CreateGraphicPipelines(pPipelines, graphicInfos.data(), (uint32)graphicInfos.size(), InPipCache);
+		ScratchVector<VkPipeline> pipelines(InCount);
+		this->CreateGraphicPipelines(pipelines.data(), graphicInfos.data(), InCount, InPipCache);
 
-		for (auto& pipeline : basePipelineNameIDMap)
+		for (uint32 i = 0; i < InCount; i++)
 		{
-			_declare_vk_smart_ptr(VkPipeline, pPipeline);
-			pPipeline = pPipelines + pipeline.second;
-			m_pipelineNamePtrMap.emplace(pipeline.first, pPipeline);
+			OutPipelines[InIndices[i]] = pipelines[i];
+
+			auto& graphicInfo = InIsArray ? InGraphicInfos[InIndices[i]] : InGraphicInfos;
+
+			if (!variantShaderModules[i].empty())
+				this->RegisterPipelineVariantInfo(JsonParser::GetString(graphicInfo[_text_mapper(vk_name)]), graphicInfo, graphicInfos[i], variantShaderModules[i].data());
 		}
+	}
 
-		_log_common("End creating graphic pipeline with " + InJsonPath, LogSystem::Category::LogicalDevice);
+	return true;
+}
+
+bool LogicalDevice::CreateGraphicPipelinesFromInfos(const Json::Value& InGraphicInfos, const uint32* InIndices, uint32 InCount, GLSLCompiler* InCompiler, VkPipelineCache InPipCache)
+{
+	if (InPipCache == VK_NULL_HANDLE)
+		InPipCache = m_pPipelineCacheManager->GetPipelineCache();
+
+	const bool bIsArray = InGraphicInfos.isArray();
+
+	ScratchScope scratch;
+
+	ScratchVector<VkPipeline> pipelines(bIsArray ? InGraphicInfos.size() : _count_1);
+	if (!this->BuildGraphicPipelines(InGraphicInfos, bIsArray, InIndices, InCount, InCompiler, InPipCache, pipelines.data()))
+		return false;
+
+	for (uint32 i = 0; i < InCount; i++)
+	{
+		auto& graphicInfo = bIsArray ? InGraphicInfos[InIndices[i]] : InGraphicInfos;
+
+		this->RegisterPipeline(JsonParser::GetString(graphicInfo[_text_mapper(vk_name)]), pipelines[InIndices[i]]);
 	}
 
-	// test...
-	// Engine::Get()->RequireExit(1);
+	return true;
+}
 
-	//return true;
+VkPipelineLayout LogicalDevice::CreateReflectedPipelineLayout(GLSLCompiler* InCompiler)
+{
+	std::vector<VkPushConstantRange> pushConstantRanges;
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> descSets;
+
+	if (!InCompiler->CheckAndParseSPVData(m_pBaseLayer->GetMainPDLimits().maxBoundDescriptorSets, pushConstantRanges, descSets))
+		return VK_NULL_HANDLE;
+
+	InCompiler->FlushSPVData();
+
+	ScratchVector<VkDescriptorSetLayout> descSetLayouts;
+
+	for (auto& bindings : descSets)
+		descSetLayouts.push_back(this->FindOrCreateDescriptorSetLayout(bindings.data(), (uint32)bindings.size()));
+
+	return this->FindOrCreatePipelineLayout(descSetLayouts.data(), (uint32)descSetLayouts.size(), pushConstantRanges.data(), (uint32)pushConstantRanges.size());
+}
+
+bool LogicalDevice::CreateGraphicPipelinesFromPack(const string& InPackPath, VkPipelineCache InPipCache)
+{
+	_log_common("Begin creating graphic pipeline with " + InPackPath, LogSystem::Category::LogicalDevice);
+
+	TimerUtil::PerformanceScope scope(_str_name_of(CreateGraphicPipelinesFromPack));
+
+	if (m_pBaseLayer == nullptr)
+	{
+		_log_error("Func: " + _str_name_of(CreateGraphicPipelinesFromPack) + " expect to Query Physical Device Limits!", LogSystem::Category::LogicalDevice);
+		Engine::Get()->RequireExit(1);
+	}
+
+	PipelinePack pack;
+
+	if (!pack.Open(InPackPath))
+	{
+		_log_warning(StringUtil::Printf("Pipeline pack % is missing or invalid!", InPackPath), LogSystem::Category::LogicalDevice);
+		return false;
+	}
+
+	if (!pack.IsUpToDate())
+	{
+		_log_warning(StringUtil::Printf("Pipeline pack % is older than its json!", InPackPath), LogSystem::Category::LogicalDevice);
+		return false;
+	}
+
+	if (InPipCache == VK_NULL_HANDLE)
+		InPipCache = m_pPipelineCacheManager->GetPipelineCache();
+
+	using Section = PipelinePack::Section;
+
+	WindowDesc windowDesc = Engine::Get()->GetWindowDesc();
+
+	// Create infos only live for this call, the arrays they point to are the mapped file.
+	ScratchScope scratch;
+
+	LocalResourcePool localResPool;
+
+	// RenderPass.
+	const PipelinePack::RenderPassRecord* pRenderPassRecords = pack.Get<PipelinePack::RenderPassRecord>(Section::RenderPasses);
+	const uint32                          numRenderPass      = pack.GetCount(Section::RenderPasses);
+
+	ScratchVector<VkRenderPass> renderPasses(numRenderPass);
+
+	// Named once every pipeline is built, a pack that falls back to json leaves no names behind.
+	std::vector<VkSmartPtr<VkRenderPass>>           newRenderPasses(numRenderPass);
+	std::vector<std::unordered_map<string, uint32>> newSubpassNameIDMaps(numRenderPass);
+
+	{
+		std::unique_lock<std::mutex> lock(m_renderPassMutex);
+
+		for (uint32 i = 0; i < numRenderPass; i++)
+		{
+			const PipelinePack::RenderPassRecord& renderPassRecord = pRenderPassRecords[i];
+			const PipelinePack::SubpassRecord*    pSubpassRecords  = pack.Get<PipelinePack::SubpassRecord>(Section::Subpasses, renderPassRecord.Subpasses);
+
+			ScratchVector<VkSubpassDescription> subpassDescs(renderPassRecord.Subpasses.Count);
+
+			std::unordered_map<string, uint32>& subpassNameIDMap = newSubpassNameIDMaps[i];
+
+			for (uint32 j = 0; j < renderPassRecord.Subpasses.Count; j++)
+			{
+				const PipelinePack::SubpassRecord& subpassRecord = pSubpassRecords[j];
+
+				subpassDescs[j].flags                   = subpassRecord.Flags;
+				subpassDescs[j].pipelineBindPoint       = subpassRecord.BindPoint;
+				subpassDescs[j].inputAttachmentCount    = subpassRecord.InputRefs.Count;
+				subpassDescs[j].pInputAttachments       = pack.Get<VkAttachmentReference>(Section::AttachmentRefs, subpassRecord.InputRefs);
+				subpassDescs[j].colorAttachmentCount    = subpassRecord.ColorRefs.Count;
+				subpassDescs[j].pColorAttachments       = pack.Get<VkAttachmentReference>(Section::AttachmentRefs, subpassRecord.ColorRefs);
+				subpassDescs[j].pResolveAttachments     = pack.Get<VkAttachmentReference>(Section::AttachmentRefs, subpassRecord.ResolveRefs);
+				subpassDescs[j].pDepthStencilAttachment = subpassRecord.DepthRef != PipelinePack::kNone ? pack.Get<VkAttachmentReference>(Section::AttachmentRefs) + subpassRecord.DepthRef : nullptr;
+				subpassDescs[j].preserveAttachmentCount = subpassRecord.Preserves.Count;
+				subpassDescs[j].pPreserveAttachments    = pack.Get<uint32>(Section::Words, subpassRecord.Preserves);
+
+				subpassNameIDMap.emplace(pack.GetString(subpassRecord.Name), j);
+			}
+
+			VkRenderPassCreateInfo renderPassCreateInfo = {};
+			renderPassCreateInfo.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+			renderPassCreateInfo.flags           = renderPassRecord.Flags;
+			renderPassCreateInfo.attachmentCount = renderPassRecord.Attachments.Count;
+			renderPassCreateInfo.pAttachments    = pack.Get<VkAttachmentDescription>(Section::Attachments, renderPassRecord.Attachments);
+			renderPassCreateInfo.subpassCount    = renderPassRecord.Subpasses.Count;
+			renderPassCreateInfo.pSubpasses      = subpassDescs.data();
+			renderPassCreateInfo.dependencyCount = renderPassRecord.Dependencies.Count;
+			renderPassCreateInfo.pDependencies   = pack.Get<VkSubpassDependency>(Section::Dependencies, renderPassRecord.Dependencies);
+
+			newRenderPasses[i] = this->FindOrCreateRenderPass(renderPassCreateInfo);
+
+			// Like the json ones, the first render pass of a name stays and the pipelines use it.
+			auto found = m_renderPassNamePtrMap.find(pack.GetString(renderPassRecord.Name));
+
+			renderPasses[i] = found != m_renderPassNamePtrMap.end() ? *(*found).second : *newRenderPasses[i];
+		}
+	}
+
+	// Pipeline.
+	const PipelinePack::PipelineRecord* pPipelineRecords = pack.Get<PipelinePack::PipelineRecord>(Section::Pipelines);
+	const uint32                        numPipeline      = pack.GetCount(Section::Pipelines);
+
+	ScratchVector<VkGraphicsPipelineCreateInfo>                   graphicInfos(numPipeline);
+	ScratchVector<ScratchVector<VkPipelineShaderStageCreateInfo>> shaderInfos(numPipeline);
+	ScratchVector<ScratchVector<VkSpecializationInfo>>            specInfos(numPipeline);
+	ScratchVector<VkPipelineVertexInputStateCreateInfo>           vertexInputStateInfos(numPipeline);
+	ScratchVector<VkPipelineInputAssemblyStateCreateInfo>         pipelineIAStateInfos(numPipeline);
+	ScratchVector<VkPipelineTessellationStateCreateInfo>          pipelineTessStateInfos(numPipeline);
+	ScratchVector<VkPipelineViewportStateCreateInfo>              pipelineViewportStateInfos(numPipeline);
+	ScratchVector<ScratchVector<VkViewport>>                      viewports(numPipeline);
+	ScratchVector<ScratchVector<VkRect2D>>                        scissors(numPipeline);
+	ScratchVector<VkPipelineRasterizationStateCreateInfo>         pipelineRSStateInfos(numPipeline);
+	ScratchVector<VkPipelineMultisampleStateCreateInfo>           pipelineMultisampleStateInfos(numPipeline);
+	ScratchVector<VkPipelineDepthStencilStateCreateInfo>          pipelineDepthStencilStateInfos(numPipeline);
+	ScratchVector<VkPipelineColorBlendStateCreateInfo>            pipelineColorBlendStateInfos(numPipeline);
+	ScratchVector<VkPipelineDynamicStateCreateInfo>               pipelineDynamicStateInfos(numPipeline);
+	ScratchVector<ScratchVector<VkSmartPtr<VkShaderModule>>>      variantShaderModules(numPipeline);
+
+	for (uint32 i = 0; i < numPipeline; i++)
+	{
+		const PipelinePack::PipelineRecord& pipelineRecord = pPipelineRecords[i];
+
+		graphicInfos[i].sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		graphicInfos[i].pNext = nullptr;
+		graphicInfos[i].flags = pipelineRecord.Flags;
+
+		// Pipeline Stage.
+		const PipelinePack::StageRecord* pStageRecords = pack.Get<PipelinePack::StageRecord>(Section::Stages, pipelineRecord.Stages);
+
+		shaderInfos[i].resize(pipelineRecord.Stages.Count);
+		specInfos[i].resize(pipelineRecord.Stages.Count);
+
+		for (uint32 j = 0; j < pipelineRecord.Stages.Count; j++)
+		{
+			const PipelinePack::StageRecord& stageRecord = pStageRecords[j];
+
+			const char* pEntrypoint = pack.GetString(stageRecord.Entrypoint);
+
+			_declare_vk_smart_ptr(VkShaderModule, pShaderModule);
+			VkShaderStageFlags currentShaderStage;
+			if (!this->CreateShaderModule(pShaderModule.MakeInstance(m_pContext), m_pCompiler, Path(pack.GetString(stageRecord.CodePath)), pEntrypoint, &currentShaderStage))
+			{
+				// The modules built so far go with localResPool, the json path builds them again.
+				_log_warning(StringUtil::Printf("Pipeline pack % could not build shader %!", InPackPath, pack.GetString(stageRecord.CodePath)), LogSystem::Category::LogicalDevice);
+				m_pCompiler->FlushSPVData();
+				return false;
+			}
+
+			shaderInfos[i][j].sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderInfos[i][j].pNext               = nullptr;
+			shaderInfos[i][j].flags               = stageRecord.Flags;
+			shaderInfos[i][j].stage               = (VkShaderStageFlagBits)(stageRecord.Stage != _flag_none ? stageRecord.Stage : currentShaderStage);
+			shaderInfos[i][j].module              = *pShaderModule;
+			shaderInfos[i][j].pName               = pEntrypoint;
+			shaderInfos[i][j].pSpecializationInfo = nullptr;
+
+			// Variants are created from the modules of their base, they stay with its variant info.
+			if (pipelineRecord.VariantInfo != PipelinePack::kNone)
+				variantShaderModules[i].push_back(pShaderModule);
+			else
+				localResPool.Push(pShaderModule);
+
+			if (stageRecord.SpecEntries.Count != _count_0)
+			{
+				specInfos[i][j].mapEntryCount = stageRecord.SpecEntries.Count;
+				specInfos[i][j].pMapEntries   = pack.Get<VkSpecializationMapEntry>(Section::SpecEntries, stageRecord.SpecEntries);
+				specInfos[i][j].dataSize      = stageRecord.SpecData.Count * sizeof(uint32);
+				specInfos[i][j].pData         = pack.Get<uint32>(Section::Words, stageRecord.SpecData);
+
+				shaderInfos[i][j].pSpecializationInfo = &specInfos[i][j];
+			}
+		}
+
+		graphicInfos[i].stageCount = pipelineRecord.Stages.Count;
+		graphicInfos[i].pStages    = shaderInfos[i].data();
+
+		// Pipeline Layout.
+		graphicInfos[i].layout = this->CreateReflectedPipelineLayout(m_pCompiler);
+		if (graphicInfos[i].layout == VK_NULL_HANDLE)
+		{
+			_log_warning(StringUtil::Printf("Pipeline pack % could not reflect the layout of pipeline %!", InPackPath, pack.GetString(pipelineRecord.Name)), LogSystem::Category::LogicalDevice);
+			m_pCompiler->FlushSPVData();
+			return false;
+		}
+
+		// Vertex Input State.
+		vertexInputStateInfos[i].sType                           = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		vertexInputStateInfos[i].vertexBindingDescriptionCount   = pipelineRecord.VertexBindings.Count;
+		vertexInputStateInfos[i].pVertexBindingDescriptions      = pack.Get<VkVertexInputBindingDescription>(Section::VertexBindings, pipelineRecord.VertexBindings);
+		vertexInputStateInfos[i].vertexAttributeDescriptionCount = pipelineRecord.VertexAttributes.Count;
+		vertexInputStateInfos[i].pVertexAttributeDescriptions    = pack.Get<VkVertexInputAttributeDescription>(Section::VertexAttributes, pipelineRecord.VertexAttributes);
+
+		graphicInfos[i].pVertexInputState = &vertexInputStateInfos[i];
+
+		// IA and Tessellation State.
+		pipelineIAStateInfos[i]   = pipelineRecord.InputAssembly;
+		pipelineTessStateInfos[i] = pipelineRecord.Tessellation;
+
+		graphicInfos[i].pInputAssemblyState = &pipelineIAStateInfos[i];
+		graphicInfos[i].pTessellationState  = pipelineRecord.HasTessellation ? &pipelineTessStateInfos[i] : nullptr;
+
+		// Viewport State, "auto" sizes follow the window.
+		const PipelinePack::ViewportRecord* pViewportRecords = pack.Get<PipelinePack::ViewportRecord>(Section::Viewports, pipelineRecord.Viewports);
+
+		viewports[i].resize(pipelineRecord.Viewports.Count);
+		scissors[i].resize(pipelineRecord.Viewports.Count);
+
+		for (uint32 j = 0; j < pipelineRecord.Viewports.Count; j++)
+		{
+			const PipelinePack::ViewportRecord& viewportRecord = pViewportRecords[j];
+
+			viewports[i][j] = viewportRecord.Viewport;
+			scissors[i][j]  = viewportRecord.Scissor;
+
+			if (viewportRecord.AutoSize & PipelinePack::AutoViewportWidth)  viewports[i][j].width        = (float)windowDesc.Width;
+			if (viewportRecord.AutoSize & PipelinePack::AutoViewportHeight) viewports[i][j].height       = (float)windowDesc.Height;
+			if (viewportRecord.AutoSize & PipelinePack::AutoScissorWidth)   scissors[i][j].extent.width  = windowDesc.Width;
+			if (viewportRecord.AutoSize & PipelinePack::AutoScissorHeight)  scissors[i][j].extent.height = windowDesc.Height;
+		}
+
+		pipelineViewportStateInfos[i] = RenderBaseConfig::Pipeline::DefaultViewportStateInfo;
+		pipelineViewportStateInfos[i].flags         = pipelineRecord.ViewportFlags;
+		pipelineViewportStateInfos[i].viewportCount = pipelineRecord.Viewports.Count;
+		pipelineViewportStateInfos[i].pViewports    = viewports[i].data();
+		pipelineViewportStateInfos[i].scissorCount  = pipelineRecord.Viewports.Count;
+		pipelineViewportStateInfos[i].pScissors     = scissors[i].data();
+
+		graphicInfos[i].pViewportState = &pipelineViewportStateInfos[i];
+
+		// RS, Multisample and Depth Stencil State.
+		pipelineRSStateInfos[i]                      = pipelineRecord.Rasterization;
+		pipelineMultisampleStateInfos[i]             = pipelineRecord.Multisample;
+		pipelineMultisampleStateInfos[i].pSampleMask = pack.Get<VkSampleMask>(Section::Words, pipelineRecord.SampleMasks);
+		pipelineDepthStencilStateInfos[i]            = pipelineRecord.DepthStencil;
+
+		graphicInfos[i].pRasterizationState = &pipelineRSStateInfos[i];
+		graphicInfos[i].pMultisampleState   = &pipelineMultisampleStateInfos[i];
+		graphicInfos[i].pDepthStencilState  = &pipelineDepthStencilStateInfos[i];
+
+		// Color Blend State.
+		pipelineColorBlendStateInfos[i]                 = pipelineRecord.ColorBlend;
+		pipelineColorBlendStateInfos[i].attachmentCount = pipelineRecord.BlendAttachments.Count;
+		pipelineColorBlendStateInfos[i].pAttachments    = pack.Get<VkPipelineColorBlendAttachmentState>(Section::BlendAttachments, pipelineRecord.BlendAttachments);
+
+		graphicInfos[i].pColorBlendState = &pipelineColorBlendStateInfos[i];
+
+		// Dynamic State.
+		pipelineDynamicStateInfos[i] = RenderBaseConfig::Pipeline::DefaultDynamicStateInfo;
+		pipelineDynamicStateInfos[i].flags             = pipelineRecord.DynamicFlags;
+		pipelineDynamicStateInfos[i].dynamicStateCount = pipelineRecord.DynamicStates.Count;
+		pipelineDynamicStateInfos[i].pDynamicStates    = pack.Get<VkDynamicState>(Section::DynamicStates, pipelineRecord.DynamicStates);
+
+		graphicInfos[i].pDynamicState = &pipelineDynamicStateInfos[i];
+
+		// RenderPass.
+		graphicInfos[i].renderPass = renderPasses[pipelineRecord.RenderPass];
+		graphicInfos[i].subpass    = pipelineRecord.Subpass;
+
+		// Pipeline Derivative, a base outside the pack is the only name looked up.
+		graphicInfos[i].basePipelineIndex  = pipelineRecord.BasePipelineIndex;
+		graphicInfos[i].basePipelineHandle = pipelineRecord.BasePipelineName != PipelinePack::kNone ? this->GetPipeline(pack.GetString(pipelineRecord.BasePipelineName)) : VK_NULL_HANDLE;
+	}
+
+	ScratchVector<VkPipeline> pipelines(numPipeline);
+	this->CreateGraphicPipelines(pipelines.data(), graphicInfos.data(), numPipeline, InPipCache);
+
+	{
+		std::unique_lock<std::mutex> lock(m_renderPassMutex);
+
+		for (uint32 i = 0; i < numRenderPass; i++)
+		{
+			const char* pRenderPassName = pack.GetString(pRenderPassRecords[i].Name);
+
+			m_renderPassNamePtrMap.emplace(pRenderPassName, newRenderPasses[i]);
+			m_renderPassNameMapsubpassNameIDMap.emplace(pRenderPassName, std::move(newSubpassNameIDMaps[i]));
+		}
+	}
+
+	for (uint32 i = 0; i < numPipeline; i++)
+	{
+		const char* pName = pack.GetString(pPipelineRecords[i].Name);
+
+		this->RegisterPipeline(pName, pipelines[i]);
+
+		// Same as BuildGraphicPipelines() does for a json info with variable constants.
+		Json::Value variantInfo;
+		if (pPipelineRecords[i].VariantInfo != PipelinePack::kNone && JsonParser::ParseText(pack.GetString(pPipelineRecords[i].VariantInfo), variantInfo))
+			this->RegisterPipelineVariantInfo(pName, variantInfo, graphicInfos[i], variantShaderModules[i].data());
+	}
+
+	_log_common("End creating graphic pipeline with " + InPackPath, LogSystem::Category::LogicalDevice);
+
+	return true;
 }
 
 void LogicalDevice::FlushAllQueue()
@@ -9,12 +9,20 @@
 
 #include "Core/Common.h"
 #include "RenderEnum.h"
+#include <mutex>
+#include <list>
+#include <memory>
 
 class BaseLayer;
 class BaseAllocator;
 class CommandQueue;
 class Window;
 class GLSLCompiler;
+class DeviceMemoryAllocator;
+class UploadManager;
+class PipelineCacheManager;
+class SamplerCache;
+class PipelineRequestQueue;
 
 class LogicalDevice : public IResourceHandler
 {
@@ -22,11 +30,18 @@ class LogicalDevice : public IResourceHandler
 
 protected:
 
-	VkDevice        m_device;
-	BaseLayer*      m_pBaseLayer;
-	BaseAllocator*  m_pAllocator;
-	GLSLCompiler*   m_pCompiler;
-	CommandQueue*   m_pCmdQueue;
+	VkDevice               m_device;
+	BaseLayer*             m_pBaseLayer;
+	BaseAllocator*         m_pAllocator;
+	GLSLCompiler*          m_pCompiler;
+	CommandQueue*          m_pCmdQueue;
+	DeviceMemoryAllocator* m_pMemAllocator;
+	UploadManager*         m_pUploadManager;
+	PipelineCacheManager*  m_pPipelineCacheManager;
+	SamplerCache*          m_pSamplerCache;
+	PipelineRequestQueue*  m_pPipelineRequestQueue;
+
+	SmartPtr<VkDeviceContext> m_pContext;   ///< Owns every vulkan object created on m_device.
 
 	_declare_vk_smart_ptr(VkCommandPool,     m_pCmdPool);
 	_declare_vk_smart_ptr(VkDescriptorPool,  m_pDescPool);
@@ -37,12 +52,152 @@ protected:
 	std::unordered_map<string, VkSmartPtr<VkRenderPass>> m_renderPassNamePtrMap;
 	std::unordered_map<string, VkSmartPtr<VkPipeline>>   m_pipelineNamePtrMap;
 
+	std::mutex                 m_pipelineMutex;      ///< Guards the pipeline names, request workers register while the frame loop looks up.
+
+	/**
+	 *  Create info of a pipeline that declares variable_specialization_constants, resolved when the pipeline
+	 *  was built and holding copies of all it points to, its shader modules included. A variant patches the
+	 *  specialization data of a copy, the json, the render pass file and the compiler are not read again.
+	 *  pNext chains are not kept, neither the json nor a pack has them.
+	 */
+	struct PipelineVariantInfo
+	{
+		std::vector<uint32>                                 ConstantIDs;
+
+		VkGraphicsPipelineCreateInfo                        CreateInfo;
+		std::vector<VkPipelineShaderStageCreateInfo>        Stages;
+		std::vector<VkSmartPtr<VkShaderModule>>             ShaderModules;
+		std::vector<string>                                 Entrypoints;
+		std::vector<VkSpecializationInfo>                   SpecInfos;
+		std::vector<std::vector<VkSpecializationMapEntry>>  SpecMaps;
+		std::vector<std::vector<uint8>>                     SpecData;
+		VkPipelineVertexInputStateCreateInfo                VertexInputState;
+		std::vector<VkVertexInputBindingDescription>        VertexBindings;
+		std::vector<VkVertexInputAttributeDescription>      VertexAttributes;
+		VkPipelineInputAssemblyStateCreateInfo              InputAssemblyState;
+		VkPipelineTessellationStateCreateInfo               TessellationState;
+		VkPipelineViewportStateCreateInfo                   ViewportState;
+		std::vector<VkViewport>                             Viewports;
+		std::vector<VkRect2D>                               Scissors;
+		VkPipelineRasterizationStateCreateInfo              RasterizationState;
+		VkPipelineMultisampleStateCreateInfo                MultisampleState;
+		std::vector<VkSampleMask>                           SampleMasks;
+		VkPipelineDepthStencilStateCreateInfo               DepthStencilState;
+		VkPipelineColorBlendStateCreateInfo                 ColorBlendState;
+		std::vector<VkPipelineColorBlendAttachmentState>    BlendAttachments;
+		VkPipelineDynamicStateCreateInfo                    DynamicState;
+		std::vector<VkDynamicState>                         DynamicStates;
+
+		/**
+		 *  Copy InCreateInfo and what it points to, InShaderModules keep the modules of its stages alive.
+		 */
+		void Assign(const VkGraphicsPipelineCreateInfo& InCreateInfo, const VkSmartPtr<VkShaderModule>* InShaderModules);
+	};
+
+	struct PipelineVariant
+	{
+		string                 Key;
+		VkSmartPtr<VkPipeline> Pipeline;
+	};
+
+	std::mutex                                                       m_variantMutex;              ///< Guards the variant maps and counts, workers register infos.
+	std::unordered_map<string, std::unique_ptr<PipelineVariantInfo>> m_pipelineVariantInfoMap;    ///< By base pipeline name, never erased, the infos are read outside the lock.
+	std::list<PipelineVariant>                                       m_pipelineVariants;          ///< Most recently used first.
+	std::unordered_map<string, std::list<PipelineVariant>::iterator> m_pipelineVariantKeyMap;     ///< By the base name and the constant values.
+
+	uint32                     m_maxPipelineVariantCount;
+	uint64                     m_pipelineVariantCreateCount;
+	uint64                     m_pipelineVariantHitCount;
+	uint64                     m_pipelineVariantEvictCount;
+
 	std::unordered_map<string, std::unordered_map<string, uint32>>  m_renderPassNameMapsubpassNameIDMap;
 
+	/**
+	 *  A render pass json already resolved, the hash of its text tells whether it changed since.
+	 */
+	struct RenderPassFile
+	{
+		uint64 TextHash;
+		string Name;
+	};
+
+	std::unordered_map<string, RenderPassFile>            m_renderPassPathMap;       ///< By canonical path.
+	std::unordered_map<string, VkSmartPtr<VkRenderPass>> m_renderPassKeyPtrMap;     ///< By the bytes of the create info, equal passes of other files share one.
+
+	uint64                     m_renderPassParseCount;
+	uint64                     m_renderPassCreateCount;
+	uint64                     m_renderPassPathHitCount;
+	uint64                     m_renderPassStructureHitCount;
+
+	std::mutex                 m_layoutMutex;        ///< Guards the layout maps and counts, pipeline workers share them.
+
+	std::unordered_map<string, VkSmartPtr<VkDescriptorSetLayout>> m_descSetLayoutKeyPtrMap;     ///< By the bindings sorted by binding number.
+	std::unordered_map<string, VkSmartPtr<VkPipelineLayout>>      m_pipelineLayoutKeyPtrMap;    ///< By the set layouts and the sorted push constant ranges.
+
+	uint64                     m_descSetLayoutCreateCount;
+	uint64                     m_descSetLayoutHitCount;
+	uint64                     m_pipelineLayoutCreateCount;
+	uint64                     m_pipelineLayoutHitCount;
+
+	mutable std::mutex         m_renderPassMutex;    ///< Guards the render pass maps and counts while pipelines are built in parallel.
+	std::vector<GLSLCompiler*> m_workerCompilers;    ///< Compilers of the pipeline workers after the first, which uses m_pCompiler.
+
 	LogicalDevice();
 
 	VkAllocationCallbacks* GetVkAllocator() const;
 
+	/**
+	 *  @return false if the shader fails to compile or load, logged.
+	 */
+	bool CreateShaderModule(VkShaderModule* OutShaderModule, GLSLCompiler* InCompiler, const Path& InShaderPath, const char* InEntrypoint, VkShaderStageFlags* OutShaderStage);
+
+	/**
+	 *  Create the pipelines of the json infos at InIndices in one vkCreateGraphicsPipelines call,
+	 *  safe to run on several threads as long as each has its own compiler. Never exits, the caller
+	 *  decides what a failure means.
+	 * 
+	 *  @param  OutPipelines  indexed like the json infos, only the entries at InIndices are written.
+	 * 
+	 *  @return false if an info is malformed or a shader fails, logged, no pipeline is created then.
+	 */
+	bool BuildGraphicPipelines(const Json::Value& InGraphicInfos, bool InIsArray, const uint32* InIndices, uint32 InCount, GLSLCompiler* InCompiler, VkPipelineCache InPipCache, VkPipeline* OutPipelines);
+
+	/**
+	 *  Layout of the shaders InCompiler created modules of last, from their reflection, shared with every pipeline of the same interface.
+	 *  VK_NULL_HANDLE if the reflection does not fit the device, logged.
+	 */
+	VkPipelineLayout CreateReflectedPipelineLayout(GLSLCompiler* InCompiler);
+
+	/**
+	 *  The render pass created earlier from an equal create info, a new one otherwise.
+	 *  Create infos with a pNext chain are never shared.
+	 */
+	VkSmartPtr<VkRenderPass> FindOrCreateRenderPass(const VkRenderPassCreateInfo& InCreateInfo);
+
+	/**
+	 *  CreateRenderPass() of a json. The file is read, hashed and parsed outside the render pass mutex,
+	 *  which is only taken around the map lookup and insert.
+	 * 
+	 *  @return false if the file is missing or malformed, logged.
+	 */
+	bool LoadRenderPass(const string& InJsonPath);
+
+	/**
+	 *  The first pipeline of a name wins, a later one goes to the destroy queue.
+	 */
+	void RegisterPipeline(const string& InName, VkPipeline InPipeline);
+
+	/**
+	 *  Keep the resolved create info of a built pipeline that declares variable constants, the first info of
+	 *  a name wins. InGraphicInfo only gives the variable constant IDs, they have to be in a stage's constants.
+	 */
+	void RegisterPipelineVariantInfo(const string& InName, const Json::Value& InGraphicInfo, const VkGraphicsPipelineCreateInfo& InCreateInfo, const VkSmartPtr<VkShaderModule>* InShaderModules);
+
+	/**
+	 *  Drop the least recently used variants above the cap, the caller holds the variant mutex.
+	 */
+	void TrimPipelineVariants();
+
 public:
 
 	virtual ~LogicalDevice();
@@ -65,8 +220,65 @@ public:
 	VkCommandPool GetCmdPool();
 	CommandQueue* GetCommandQueue();
 
+	DeviceMemoryAllocator* GetMemAllocator();
+	UploadManager*         GetUploadManager();
+	PipelineCacheManager*  GetPipelineCacheManager();
+	SamplerCache*          GetSamplerCache();
+	PipelineRequestQueue*  GetPipelineRequestQueue();
+	VkDeviceContext*       GetDeviceContext() const;
+
 	void SetViewport(VkViewport& OutViewport, VkRect2D& OutScissor, uint32 InWidth, uint32 InHeight);
 
+public:
+
+	struct RenderPassStats
+	{
+		uint64 ParseCount;           ///< Render pass json files parsed.
+		uint64 CreateCount;          ///< VkRenderPass objects created from json or a pack.
+		uint64 PathHitCount;         ///< Json lookups answered by path and text hash, nothing parsed.
+		uint64 StructureHitCount;    ///< Render passes equal to one created earlier, shared instead of created.
+	};
+
+	RenderPassStats GetRenderPassStats() const;
+
+	struct LayoutStats
+	{
+		uint64 SetLayoutCreateCount;
+		uint64 SetLayoutHitCount;         ///< Requests answered with a set layout created earlier.
+		uint64 PipelineLayoutCreateCount;
+		uint64 PipelineLayoutHitCount;    ///< Requests answered with a pipeline layout created earlier.
+	};
+
+	LayoutStats GetLayoutStats();
+
+	struct PipelineVariantStats
+	{
+		uint32 LiveCount;
+		uint32 MaxCount;
+		uint64 CreateCount;
+		uint64 HitCount;        ///< Lookups answered with a live variant.
+		uint64 EvictCount;      ///< Variants dropped as least recently used, built again on their next lookup.
+	};
+
+	PipelineVariantStats GetPipelineVariantStats();
+
+	/**
+	 *  Cap of the live variants of all pipelines, lowering it evicts at once.
+	 */
+	void SetMaxPipelineVariantCount(uint32 InCount);
+
+	/**
+	 *  Set layouts of the same bindings, in any order, are one object, descriptor sets allocated
+	 *  with it fit every pipeline that uses it. Owned by the device, never destroy it.
+	 */
+	VkDescriptorSetLayout FindOrCreateDescriptorSetLayout(const VkDescriptorSetLayoutBinding* InBindings, uint32 InBindingCount);
+
+	/**
+	 *  Pipeline layouts of the same set layouts, in the same set order, and the same push constant
+	 *  ranges, in any order, are one object. Owned by the device, never destroy it.
+	 */
+	VkPipelineLayout      FindOrCreatePipelineLayout(const VkDescriptorSetLayout* InDescSetLayouts, uint32 InSetCount, const VkPushConstantRange* InPushConstants, uint32 InConstCount);
+
 public:
 
 	struct PipelineComputeDesc
@@ -150,6 +362,7 @@ public:
 	};
 
 	// TODO: Remove Pipeline Cache param from API.
+	// A VK_NULL_HANDLE pipeline cache stands for the one of the PipelineCacheManager.
 
 	VkQueue        GetVkQueue                    (uint32 InQueueFamilyIndex, uint32 InQueueIndex = _index_0);
 	void           GetSwapchainImagesKHR         (VkSwapchainKHR InSwapchain, uint32* InOutImageCount, VkImage* OutImages);
@@ -158,6 +371,24 @@ public:
 	VkRenderPass   GetRenderPass                 (const string& InName);
 	VkPipeline     GetPipeline                   (const string& InName);
 
+	/**
+	 *  GetPipeline() without the warning, VK_NULL_HANDLE for a name not built yet.
+	 */
+	VkPipeline     FindPipeline                  (const string& InName);
+
+	/**
+	 *  Variant of a pipeline that declares [variable_specialization_constants], the IDs of the constants its
+	 *  [specialization_constants] may take other values for. A variant is created the first time its values
+	 *  are asked for, as a derivative of the named pipeline, and kept until it is the least recently used one
+	 *  above the cap. Safe on any thread, a variant is created outside the lock from the create info resolved
+	 *  with the named pipeline, only its specialization data differs.
+	 * 
+	 *  @param  InConstants  32 bit values in the order of the declared IDs, floats by their bits.
+	 * 
+	 *  @return the named pipeline itself if it declares no variable constants or the count differs.
+	 */
+	VkPipeline     GetPipeline                   (const string& InName, const std::vector<uint32>& InConstants);
+
 	usize          GetPipelineCacheDataSize      (VkPipelineCache  InPipCache);
 	void           GetPipelineCacheData          (VkPipelineCache  InPipCache, usize InDataSize, void* OutData);
 	void           GetPipelineCacheData          (VkPipelineCache  InPipCache, std::vector<uint8>& OutData);
@@ -207,6 +438,9 @@ public:
 	void           CopyDescriptorSet             (VkDescriptorSet InSrcSet, uint32 InSrcBindingIndex, VkDescriptorSet InDstSet, uint32 InDstBindingIndex, uint32 InCopyDescCount, uint32 InSrcSetOffset = _offset_0, uint32 InDstSetOffset = _offset_0);
 
 	// TODO: Replace Sampler API with Sampler Enum.
+	// Each call creates a sampler the caller owns, GetSamplerCache()->Acquire() shares one instead.
+	// The preset calls are deprecated, they build from SamplerCache::GetPresetCreateInfo() and new
+	// code uses GetSamplerCache()->Acquire(Render::Sampler) and Release() instead.
 
 	void           CreateSampler                 (VkSampler* OutSampler, const VkSamplerCreateInfo& InCreateInfo);
 	void           CreatePointWrapSampler        (VkSampler* OutSampler);
@@ -219,7 +453,13 @@ public:
 	void           CreateSampler                 (VkSampler* OutSampler, Render::Sampler InSamplerType);
 
 	void           CreateRenderPass              (VkRenderPass* OutRenderPass, const VkRenderPassCreateInfo& InCreateInfo);
+
+	/**
+	 *  A json seen before with the same text is not parsed again, and a render pass equal to one
+	 *  created earlier, from any file or a pack, is shared. A changed file takes over its name.
+	 */
 	void           CreateRenderPass              (const string& InJsonPath);
+
 	void           CreateSingleRenderPass        (VkRenderPass* OutRenderPass, VkFormat InColorFormat, VkFormat InDepthFormat);
 
 	void           CreateFrameBuffer             (VkFramebuffer* OutFrameBuffer, const VkFramebufferCreateInfo& InCreateInfo);
@@ -227,7 +467,30 @@ public:
 
 	void           CreateGraphicPipelines        (VkPipeline* OutPipeline, const VkGraphicsPipelineCreateInfo* InCreateInfos, uint32 InCreateInfoCount = _count_1, VkPipelineCache InPipCache = VK_NULL_HANDLE);
 	void           CreateGraphicPipelines        (VkPipeline* OutPipeline, const PipelineGraphicDesc* InDescs, uint32 InDescCount = _count_1, VkPipelineCache InPipCache = VK_NULL_HANDLE);
-	void           CreateGraphicPipelines        (const string& InJsonPath, VkPipelineCache InPipCache = VK_NULL_HANDLE);
+
+	/**
+	 *  Shader compiles and create infos are spread over InWorkerCount threads, 0 for one per hardware thread.
+	 *  Derivative chains stay on one worker. Each worker fills its own pipeline cache, they are merged into
+	 *  InPipCache afterwards, the managed cache if none is given.
+	 */
+	void           CreateGraphicPipelines        (const string& InJsonPath, VkPipelineCache InPipCache = VK_NULL_HANDLE, uint32 InWorkerCount = _count_1);
+
+	/**
+	 *  Render passes and pipelines of a pack PipelinePack::Bake() wrote, registered by name like the json ones.
+	 *  Create infos point into the mapped pack, only the shaders are still loaded and reflected.
+	 * 
+	 *  @return false if the pack is missing, invalid, older than its json or one of its shaders fails,
+	 *          nothing is registered then and the caller falls back to the json.
+	 */
+	bool           CreateGraphicPipelinesFromPack(const string& InPackPath, VkPipelineCache InPipCache = VK_NULL_HANDLE);
+
+	/**
+	 *  The infos at InIndices of a parsed [graphic_pipeline_infos], built in one call and registered by name.
+	 *  Safe on any thread that brings its own compiler, bases come before their derivatives in InIndices.
+	 * 
+	 *  @return false if an info is malformed or a shader fails, logged, nothing is registered then.
+	 */
+	bool           CreateGraphicPipelinesFromInfos(const Json::Value& InGraphicInfos, const uint32* InIndices, uint32 InCount, GLSLCompiler* InCompiler, VkPipelineCache InPipCache = VK_NULL_HANDLE);
 
 	// TODO: Image and buffer creators should not put here.
 
@@ -0,0 +1,274 @@
+﻿/*********************************************************************
+ *  PipelineCacheManager.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "PipelineCacheManager.h"
+#include "LogicalDevice.h"
+#include "RenderBaseConfig.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Utilities/Math/Hash.h"
+#include <filesystem>
+
+_impl_create_interface(PipelineCacheManager)
+
+namespace
+{
+	const uint32 kFileMagic       = 0x43504C4Au;   // "JLPC"
+	const uint32 kFileVersion     = 1;
+
+	const uint32 kDriverHeaderLength = 16 + VK_UUID_SIZE;
+
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 DriverVersion;
+		uint32 Reserved;
+		uint64 DataSize;
+		uint64 DataHash;
+	};
+
+	/**
+	 *  @return true if the header the driver put in front of its data matches the device.
+	 */
+	bool IsDriverHeaderValid(const uint8* InData, usize InSize, const VkPhysicalDeviceProperties& InPDProps)
+	{
+		if (InSize < kDriverHeaderLength)
+			return false;
+
+		LogicalDevice::PipelineCacheHeader header;
+
+		memcpy(&header.Length,   InData + 0,  4);
+		memcpy(&header.Version,  InData + 4,  4);
+		memcpy(&header.VendorID, InData + 8,  4);
+		memcpy(&header.DeviceID, InData + 12, 4);
+		memcpy( header.UUID,     InData + 16, VK_UUID_SIZE);
+
+		return header.Length >= kDriverHeaderLength && header.Length <= InSize &&
+			header.Version  == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+			header.VendorID == InPDProps.vendorID &&
+			header.DeviceID == InPDProps.deviceID &&
+			memcmp(header.UUID, InPDProps.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+}
+
+PipelineCacheManager::PipelineCacheManager() :
+	m_pBaseLayer       (nullptr),
+	m_bFeedbackEnabled (false),
+	m_diskSize         (_count_0),
+	m_diskHash         (_count_0),
+	m_loadedBytes      (_count_0),
+	m_savedBytes       (_count_0),
+	m_pipelineCount    (_count_0),
+	m_hitCount         (_count_0),
+	m_untrackedCount   (_count_0)
+{
+
+}
+
+PipelineCacheManager::~PipelineCacheManager()
+{
+
+}
+
+void PipelineCacheManager::Init(BaseLayer* InBaseLayer)
+{
+	m_pBaseLayer       = InBaseLayer;
+	m_bFeedbackEnabled = InBaseLayer->IsPDExtensionEnabled(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+	const VkPhysicalDeviceProperties& pdProps = InBaseLayer->GetMainPDProps();
+
+	m_path = PathParser::Parse(RenderBaseConfig::PipelineCache::CacheDirectory) + "/" + GetFileName(pdProps);
+
+	LogicalDevice* pDevice = InBaseLayer->GetLogicalDevice();
+
+	std::vector<uint8> cacheData;
+
+	// Anything wrong with the file only costs the warm start, never the run.
+	if (ReadCacheFile(m_path, pdProps, cacheData))
+	{
+		pDevice->CreatePipelineCache(m_pPipelineCache.MakeInstance(pDevice->GetDeviceContext()), cacheData.data(), cacheData.size());
+
+		m_diskSize    = cacheData.size();
+		m_diskHash    = HashData(cacheData);
+		m_loadedBytes = cacheData.size();
+
+		_log_common(StringUtil::Printf("%: loaded % KB from %", _name_of(PipelineCacheManager), cacheData.size() / 1024, m_path), LogSystem::Category::LogicalDevice);
+	}
+	else
+	{
+		pDevice->CreateEmptyPipelineCache(m_pPipelineCache.MakeInstance(pDevice->GetDeviceContext()));
+
+		_log_common(StringUtil::Printf("%: no usable cache at %, starting empty.", _name_of(PipelineCacheManager), m_path), LogSystem::Category::LogicalDevice);
+	}
+}
+
+VkPipelineCache PipelineCacheManager::GetPipelineCache()
+{
+	return m_pPipelineCache.IsValid() ? *m_pPipelineCache : VK_NULL_HANDLE;
+}
+
+bool PipelineCacheManager::Save()
+{
+	if (!m_pPipelineCache.IsValid())
+		return false;
+
+	std::vector<uint8> cacheData;
+	m_pBaseLayer->GetLogicalDevice()->GetPipelineCacheData(*m_pPipelineCache, cacheData);
+
+	const uint64 hash = HashData(cacheData);
+
+	if (cacheData.size() == m_diskSize && hash == m_diskHash)
+		return false;
+
+	if (!WriteCacheFile(m_path, m_pBaseLayer->GetMainPDProps(), cacheData))
+	{
+		_log_warning(StringUtil::Printf("%: writing % failed!", _name_of(PipelineCacheManager), m_path), LogSystem::Category::LogicalDevice);
+		return false;
+	}
+
+	m_diskSize   = cacheData.size();
+	m_diskHash   = hash;
+	m_savedBytes = cacheData.size();
+
+	return true;
+}
+
+bool PipelineCacheManager::IsFeedbackEnabled() const
+{
+	return m_bFeedbackEnabled;
+}
+
+void PipelineCacheManager::RecordFeedback(const VkPipelineCreationFeedbackEXT* InFeedbacks, uint32 InCount)
+{
+	m_pipelineCount += InCount;
+
+	if (InFeedbacks == nullptr)
+	{
+		m_untrackedCount += InCount;
+		return;
+	}
+
+	uint64 hitCount       = _count_0;
+	uint64 untrackedCount = _count_0;
+
+	for (uint32 i = 0; i < InCount; ++i)
+	{
+		if ((InFeedbacks[i].flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT) == 0)
+			untrackedCount++;
+		else if ((InFeedbacks[i].flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0)
+			hitCount++;
+	}
+
+	m_hitCount       += hitCount;
+	m_untrackedCount += untrackedCount;
+}
+
+PipelineCacheManager::Stats PipelineCacheManager::GetStats() const
+{
+	Stats stats;
+	stats.PipelineCount  = m_pipelineCount.load();
+	stats.HitCount       = m_hitCount.load();
+	stats.UntrackedCount = m_untrackedCount.load();
+	stats.LoadedBytes    = m_loadedBytes;
+	stats.SavedBytes     = m_savedBytes;
+
+	return stats;
+}
+
+string PipelineCacheManager::GetFileName(const VkPhysicalDeviceProperties& InPDProps)
+{
+	char ids[32];
+	snprintf(ids, sizeof(ids), "%08x_%08x_%08x_", InPDProps.vendorID, InPDProps.deviceID, InPDProps.driverVersion);
+
+	string name = ids;
+
+	for (uint32 i = 0; i < VK_UUID_SIZE; ++i)
+	{
+		char byte[3];
+		snprintf(byte, sizeof(byte), "%02x", (uint32)InPDProps.pipelineCacheUUID[i]);
+		name += byte;
+	}
+
+	return name + ".bin";
+}
+
+bool PipelineCacheManager::ReadCacheFile(const string& InPath, const VkPhysicalDeviceProperties& InPDProps, std::vector<uint8>& OutData)
+{
+	OutData.clear();
+
+	std::ifstream ifs(InPath, std::ios::binary | std::ios::ate);
+	if (!ifs.is_open())
+		return false;
+
+	const std::streamoff fileSize = ifs.tellg();
+	if (fileSize < (std::streamoff)sizeof(FileHeader))
+		return false;
+
+	ifs.seekg(0, ifs.beg);
+
+	FileHeader header;
+	if (!ifs.read((char*)&header, sizeof(FileHeader)))
+		return false;
+
+	if (header.Magic != kFileMagic || header.Version != kFileVersion || header.DriverVersion != InPDProps.driverVersion ||
+		header.DataSize != (uint64)(fileSize - (std::streamoff)sizeof(FileHeader)))
+		return false;
+
+	OutData.resize((usize)header.DataSize);
+
+	if (!ifs.read((char*)OutData.data(), OutData.size()) || HashData(OutData) != header.DataHash ||
+		!IsDriverHeaderValid(OutData.data(), OutData.size(), InPDProps))
+	{
+		OutData.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool PipelineCacheManager::WriteCacheFile(const string& InPath, const VkPhysicalDeviceProperties& InPDProps, const std::vector<uint8>& InData)
+{
+	FileHeader header = {};
+	header.Magic         = kFileMagic;
+	header.Version       = kFileVersion;
+	header.DriverVersion = InPDProps.driverVersion;
+	header.DataSize      = InData.size();
+	header.DataHash      = HashData(InData);
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(InPath).parent_path(), error);
+
+	const string tempPath = InPath + ".tmp";
+
+	{
+		std::ofstream ofs(tempPath, std::ofstream::binary | std::ofstream::trunc);
+		if (!ofs.is_open())
+			return false;
+
+		ofs.write((const char*)&header, sizeof(FileHeader));
+		ofs.write((const char*)InData.data(), InData.size());
+		ofs.close();
+
+		if (!ofs.good())
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(tempPath, InPath, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return false;
+	}
+
+	return true;
+}
+
+uint64 PipelineCacheManager::HashData(const std::vector<uint8>& InData)
+{
+	return Math::HashBytes(InData.data(), InData.size());
+}
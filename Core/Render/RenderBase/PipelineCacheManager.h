@@ -0,0 +1,107 @@
+﻿/*********************************************************************
+ *  PipelineCacheManager.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Pipeline cache loaded at device init and written back at shutdown.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include <atomic>
+
+class BaseLayer;
+
+/**
+ *  One cache file per driver, its name holds the vendor ID, device ID,
+ *  driver version and pipeline cache UUID, a driver update starts from an
+ *  empty cache instead of handing the driver data it may reject. The file
+ *  wraps the driver data with its size and hash, a missing, torn or foreign
+ *  file is skipped and the cache starts empty. Save() writes aside and
+ *  renames, and does nothing while the data matches what is on disk. With
+ *  VK_EXT_pipeline_creation_feedback every pipeline the LogicalDevice
+ *  creates is counted as a hit or a miss of the cache it was given.
+ */
+class PipelineCacheManager : public IResourceHandler
+{
+	_declare_create_interface(PipelineCacheManager)
+
+protected:
+
+	PipelineCacheManager();
+
+public:
+
+	virtual ~PipelineCacheManager();
+
+	/**
+	 *  Create the cache from the file of the main physical device, the VkDevice has to exist.
+	 */
+	void Init(BaseLayer* InBaseLayer);
+
+public:
+
+	struct Stats
+	{
+		uint64 PipelineCount;
+		uint64 HitCount;          ///< Pipelines the driver found in their cache.
+		uint64 UntrackedCount;    ///< Pipelines created without valid feedback.
+		uint64 LoadedBytes;       ///< Driver data read at Init(), 0 if the cache started empty.
+		uint64 SavedBytes;        ///< Driver data written by the last Save() that wrote.
+	};
+
+	/**
+	 *  @return the cache pipelines are created with when no other is given, VK_NULL_HANDLE before Init().
+	 */
+	VkPipelineCache GetPipelineCache();
+
+	/**
+	 *  Write the cache file if the size or the hash of the data changed since it was read or written.
+	 * 
+	 *  @return true if the file was written.
+	 */
+	bool Save();
+
+	bool IsFeedbackEnabled() const;
+
+	/**
+	 *  @param  InFeedbacks  per pipeline feedback of one creation call, nullptr if it was created without.
+	 */
+	void RecordFeedback(const VkPipelineCreationFeedbackEXT* InFeedbacks, uint32 InCount);
+
+	Stats GetStats() const;
+
+	/**
+	 *  @return name of the cache file of a driver, inside RenderBaseConfig::PipelineCache::CacheDirectory.
+	 */
+	static string GetFileName(const VkPhysicalDeviceProperties& InPDProps);
+
+	/**
+	 *  @return false if the file is missing, torn or was written for another driver, OutData is empty then.
+	 */
+	static bool ReadCacheFile(const string& InPath, const VkPhysicalDeviceProperties& InPDProps, std::vector<uint8>& OutData);
+
+	/**
+	 *  Written to a temp file next to InPath and renamed over it, a crash never leaves half a file.
+	 */
+	static bool WriteCacheFile(const string& InPath, const VkPhysicalDeviceProperties& InPDProps, const std::vector<uint8>& InData);
+
+	static uint64 HashData(const std::vector<uint8>& InData);
+
+private:
+
+	BaseLayer*                 m_pBaseLayer;
+	bool                       m_bFeedbackEnabled;
+	string                     m_path;
+
+	_declare_vk_smart_ptr(VkPipelineCache, m_pPipelineCache);
+
+	usize                      m_diskSize;          ///< Size and hash of the data in the file.
+	uint64                     m_diskHash;
+	uint64                     m_loadedBytes;
+	uint64                     m_savedBytes;
+
+	std::atomic<uint64>        m_pipelineCount;
+	std::atomic<uint64>        m_hitCount;
+	std::atomic<uint64>        m_untrackedCount;
+};
@@ -0,0 +1,1247 @@
+﻿/*********************************************************************
+ *  PipelinePack.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "PipelinePack.h"
+#include "RenderBaseConfig.h"
+#include <filesystem>
+
+#include "LogicalDevice.inl"
+
+namespace
+{
+	using Section = PipelinePack::Section;
+	using Range   = PipelinePack::Range;
+
+	const usize kSectionAlignment = 8;
+
+	// In Section order.
+	const usize kElementSizes[(usize)Section::Count] =
+	{
+		sizeof(char),
+		sizeof(PipelinePack::SourceRecord),
+		sizeof(PipelinePack::RenderPassRecord),
+		sizeof(VkAttachmentDescription),
+		sizeof(PipelinePack::SubpassRecord),
+		sizeof(VkAttachmentReference),
+		sizeof(VkSubpassDependency),
+		sizeof(PipelinePack::PipelineRecord),
+		sizeof(PipelinePack::StageRecord),
+		sizeof(VkSpecializationMapEntry),
+		sizeof(uint32),
+		sizeof(VkVertexInputBindingDescription),
+		sizeof(VkVertexInputAttributeDescription),
+		sizeof(PipelinePack::ViewportRecord),
+		sizeof(VkPipelineColorBlendAttachmentState),
+		sizeof(VkDynamicState)
+	};
+
+	/**
+	 *  Padding is zeroed too, the same json always bakes the same bytes.
+	 */
+	template<typename T>
+	T ZeroRecord()
+	{
+		T record;
+		memset(&record, 0, sizeof(T));
+		return record;
+	}
+
+	template<typename T>
+	Range BeginRange(const std::vector<T>& InSection)
+	{
+		return { (uint32)InSection.size(), _count_0 };
+	}
+
+	template<typename T>
+	void EndRange(const std::vector<T>& InSection, Range& OutRange)
+	{
+		OutRange.Count = (uint32)InSection.size() - OutRange.Offset;
+	}
+
+	bool IsInSection(const PipelinePack::Header& InHeader, Section InSection, const Range& InRange)
+	{
+		return (uint64)InRange.Offset + InRange.Count <= InHeader.Sections[(usize)InSection].Count;
+	}
+
+	int64 GetWriteTime(const string& InPath, std::error_code& OutError)
+	{
+		return (int64)std::filesystem::last_write_time(InPath, OutError).time_since_epoch().count();
+	}
+
+	/**
+	 *  Sections of a pack while it is baked.
+	 */
+	struct PackWriter
+	{
+		std::vector<char>                                  Strings;
+		std::vector<PipelinePack::SourceRecord>            Sources;
+		std::vector<PipelinePack::RenderPassRecord>        RenderPasses;
+		std::vector<VkAttachmentDescription>               Attachments;
+		std::vector<PipelinePack::SubpassRecord>           Subpasses;
+		std::vector<VkAttachmentReference>                 AttachmentRefs;
+		std::vector<VkSubpassDependency>                   Dependencies;
+		std::vector<PipelinePack::PipelineRecord>          Pipelines;
+		std::vector<PipelinePack::StageRecord>             Stages;
+		std::vector<VkSpecializationMapEntry>              SpecEntries;
+		std::vector<uint32>                                Words;
+		std::vector<VkVertexInputBindingDescription>       VertexBindings;
+		std::vector<VkVertexInputAttributeDescription>     VertexAttributes;
+		std::vector<PipelinePack::ViewportRecord>          Viewports;
+		std::vector<VkPipelineColorBlendAttachmentState>   BlendAttachments;
+		std::vector<VkDynamicState>                        DynamicStates;
+
+		std::unordered_map<string, uint32>                 StringOffsets;
+		std::unordered_map<string, uint32>                 RenderPassPathIDMap;
+		std::unordered_map<string, uint32>                 RenderPassNameIDMap;
+		std::unordered_map<string, uint32>                 PipelineNameIDMap;
+
+		uint32 AddString(const string& InString)
+		{
+			auto found = StringOffsets.find(InString);
+			if (found != StringOffsets.end())
+				return (*found).second;
+
+			const uint32 offset = (uint32)Strings.size();
+
+			Strings.insert(Strings.end(), InString.begin(), InString.end());
+			Strings.push_back('\0');
+
+			StringOffsets.emplace(InString, offset);
+
+			return offset;
+		}
+
+		bool AddSource(const string& InPath)
+		{
+			std::error_code error;
+
+			PipelinePack::SourceRecord source = ZeroRecord<PipelinePack::SourceRecord>();
+			source.Path      = AddString(InPath);
+			source.Size      = (uint64)std::filesystem::file_size(InPath, error);
+			source.WriteTime = GetWriteTime(InPath, error);
+
+			Sources.push_back(source);
+
+			return !error;
+		}
+
+		bool Write(const string& InPath) const
+		{
+			PipelinePack::Header header = ZeroRecord<PipelinePack::Header>();
+			header.Magic              = PipelinePack::kMagic;
+			header.Version            = PipelinePack::kVersion;
+			header.PipelineRecordSize = sizeof(PipelinePack::PipelineRecord);
+
+			std::vector<uint8> data(sizeof(PipelinePack::Header));
+
+			auto appendSection = [&data, &header](Section InSection, const void* InElements, usize InCount)
+			{
+				data.resize((data.size() + kSectionAlignment - 1) & ~(kSectionAlignment - 1));
+
+				header.Sections[(usize)InSection] = { (uint32)data.size(), (uint32)InCount };
+
+				const uint8* pBytes = (const uint8*)InElements;
+				data.insert(data.end(), pBytes, pBytes + InCount * kElementSizes[(usize)InSection]);
+			};
+
+			appendSection(Section::Strings,          Strings.data(),          Strings.size());
+			appendSection(Section::Sources,          Sources.data(),          Sources.size());
+			appendSection(Section::RenderPasses,     RenderPasses.data(),     RenderPasses.size());
+			appendSection(Section::Attachments,      Attachments.data(),      Attachments.size());
+			appendSection(Section::Subpasses,        Subpasses.data(),        Subpasses.size());
+			appendSection(Section::AttachmentRefs,   AttachmentRefs.data(),   AttachmentRefs.size());
+			appendSection(Section::Dependencies,     Dependencies.data(),     Dependencies.size());
+			appendSection(Section::Pipelines,        Pipelines.data(),        Pipelines.size());
+			appendSection(Section::Stages,           Stages.data(),           Stages.size());
+			appendSection(Section::SpecEntries,      SpecEntries.data(),      SpecEntries.size());
+			appendSection(Section::Words,            Words.data(),            Words.size());
+			appendSection(Section::VertexBindings,   VertexBindings.data(),   VertexBindings.size());
+			appendSection(Section::VertexAttributes, VertexAttributes.data(), VertexAttributes.size());
+			appendSection(Section::Viewports,        Viewports.data(),        Viewports.size());
+			appendSection(Section::BlendAttachments, BlendAttachments.data(), BlendAttachments.size());
+			appendSection(Section::DynamicStates,    DynamicStates.data(),    DynamicStates.size());
+
+			header.FileSize = (uint32)data.size();
+			memcpy(data.data(), &header, sizeof(PipelinePack::Header));
+
+			std::error_code error;
+			std::filesystem::create_directories(std::filesystem::path(InPath).parent_path(), error);
+
+			const string tempPath = InPath + ".tmp";
+
+			{
+				std::ofstream ofs(tempPath, std::ofstream::binary | std::ofstream::trunc);
+				if (!ofs.is_open())
+					return false;
+
+				ofs.write((const char*)data.data(), data.size());
+				ofs.close();
+
+				if (!ofs.good())
+				{
+					std::filesystem::remove(tempPath, error);
+					return false;
+				}
+			}
+
+			std::filesystem::rename(tempPath, InPath, error);
+			if (error)
+			{
+				std::filesystem::remove(tempPath, error);
+				return false;
+			}
+
+			return true;
+		}
+	};
+
+	bool FindID(const std::unordered_map<string, uint32>& InNameIDMap, const string& InName, uint32& OutID)
+	{
+		auto found = InNameIDMap.find(InName);
+		if (found == InNameIDMap.end())
+			return false;
+
+		OutID = (*found).second;
+		return true;
+	}
+
+	bool BakeAttachmentRefs(const Json::Value& InRefs, const std::unordered_map<string, uint32>& InAttachmentNameIDMap, PackWriter& OutWriter, Range& OutRange)
+	{
+		OutRange = BeginRange(OutWriter.AttachmentRefs);
+
+		if (InRefs == Json::nullValue)
+			return true;
+
+		const bool   bIsArray = InRefs.isArray();
+		const uint32 numRef   = bIsArray ? InRefs.size() : _count_1;
+
+		for (uint32 i = 0; i < numRef; i++)
+		{
+			const Json::Value& ref = bIsArray ? InRefs[i] : InRefs;
+
+			string name = JsonParser::GetString(ref[_text_mapper(vk_attachment_name)]);
+
+			VkAttachmentReference attachmentRef = ZeroRecord<VkAttachmentReference>();
+			if (!FindID(InAttachmentNameIDMap, name, attachmentRef.attachment))
+			{
+				_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
+				return false;
+			}
+
+			attachmentRef.layout = GetVkImageLayout(JsonParser::GetString(ref[_text_mapper(vk_state)]));
+
+			OutWriter.AttachmentRefs.push_back(attachmentRef);
+		}
+
+		EndRange(OutWriter.AttachmentRefs, OutRange);
+		return true;
+	}
+
+	VkAccessFlags BakeAccessMask(const Json::Value& InMask)
+	{
+		const bool   bIsArray = InMask.isArray();
+		const uint32 numMask  = bIsArray ? InMask.size() : _count_1;
+
+		VkAccessFlags accessMask = 0;
+		for (uint32 i = 0; i < numMask; i++)
+			accessMask |= GetVkAccessFlags(JsonParser::GetString(bIsArray ? InMask[i] : InMask));
+
+		return accessMask;
+	}
+
+	/**
+	 *  Resolved like LogicalDevice::CreateRenderPass(const string&), a path is baked once.
+	 */
+	bool BakeRenderPass(const string& InJsonPath, PackWriter& OutWriter)
+	{
+		if (OutWriter.RenderPassPathIDMap.count(InJsonPath) != 0)
+			return true;
+
+		Json::Value root;
+
+		if (!JsonParser::Parse(InJsonPath, root))
+		{
+			_log_error("JsonParser failed at file: " + InJsonPath, LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		const Json::Value& renderPassInfo = root[_text_mapper(vk_renderpass_info)];
+
+		if (renderPassInfo == Json::nullValue)
+		{
+			_log_error("json file: [renderpass_info] can not be null!", LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		if (!OutWriter.AddSource(InJsonPath))
+			return false;
+
+		string renderPassName = JsonParser::GetString(renderPassInfo[_text_mapper(vk_name)]);
+
+		PipelinePack::RenderPassRecord renderPass = ZeroRecord<PipelinePack::RenderPassRecord>();
+		renderPass.Name  = OutWriter.AddString(renderPassName);
+		renderPass.Flags = JsonParser::GetUInt32(renderPassInfo[_text_mapper(vk_flags)]);
+
+		// Attachment.
+		std::unordered_map<string, uint32> attachmentNameIDMap;
+
+		const Json::Value& attachments = renderPassInfo[_text_mapper(vk_attachment_descriptions)];
+
+		bool   bIsArray      = attachments.isArray();
+		uint32 numAttachDesc = bIsArray ? attachments.size() : _count_1;
+
+		renderPass.Attachments = BeginRange(OutWriter.Attachments);
+
+		for (uint32 j = 0; j < numAttachDesc; j++)
+		{
+			const Json::Value& attachment = bIsArray ? attachments[j] : attachments;
+
+			attachmentNameIDMap.emplace(JsonParser::GetString(attachment[_text_mapper(vk_name)]), j);
+
+			VkAttachmentDescription attachmentDesc = ZeroRecord<VkAttachmentDescription>();
+			attachmentDesc.flags          = JsonParser::GetUInt32(attachment[_text_mapper(vk_flags)]);
+			attachmentDesc.format         = GetVkFormat(JsonParser::GetString(attachment[_text_mapper(vk_format)]));
+			attachmentDesc.samples        = (VkSampleCountFlagBits)GetMultisampleCount(JsonParser::GetUInt32(attachment[_text_mapper(vk_sample_count)]));
+			attachmentDesc.loadOp         = GetVkAttachmentLoadOp(JsonParser::GetString(attachment[_text_mapper(vk_load_op)]));
+			attachmentDesc.storeOp        = GetVkAttachmentStoreOp(JsonParser::GetString(attachment[_text_mapper(vk_store_op)]));
+			attachmentDesc.stencilLoadOp  = GetVkAttachmentLoadOp(JsonParser::GetString(attachment[_text_mapper(vk_stencil_load_op)]));
+			attachmentDesc.stencilStoreOp = GetVkAttachmentStoreOp(JsonParser::GetString(attachment[_text_mapper(vk_stencil_store_op)]));
+			attachmentDesc.initialLayout  = GetVkImageLayout(JsonParser::GetString(attachment[_text_mapper(vk_in_state)]));
+			attachmentDesc.finalLayout    = GetVkImageLayout(JsonParser::GetString(attachment[_text_mapper(vk_out_state)]));
+
+			OutWriter.Attachments.push_back(attachmentDesc);
+		}
+
+		EndRange(OutWriter.Attachments, renderPass.Attachments);
+
+		// Subpass.
+		std::unordered_map<string, uint32> subpassNameIDMap;
+
+		const Json::Value& subpasses = renderPassInfo[_text_mapper(vk_subpass_descriptions)];
+
+		bIsArray = subpasses.isArray();
+		uint32 numSubpassDesc = bIsArray ? subpasses.size() : _count_1;
+
+		// References are appended while the subpasses are, the records go in afterwards.
+		std::vector<PipelinePack::SubpassRecord> subpassRecords(numSubpassDesc);
+
+		for (uint32 j = 0; j < numSubpassDesc; j++)
+		{
+			const Json::Value& subpass = bIsArray ? subpasses[j] : subpasses;
+
+			string subpassName = JsonParser::GetString(subpass[_text_mapper(vk_name)]);
+
+			subpassNameIDMap.emplace(subpassName, j);
+
+			PipelinePack::SubpassRecord& subpassRecord = subpassRecords[j];
+			subpassRecord           = ZeroRecord<PipelinePack::SubpassRecord>();
+			subpassRecord.Name      = OutWriter.AddString(subpassName);
+			subpassRecord.Flags     = JsonParser::GetUInt32(subpass[_text_mapper(vk_flags)]);
+			subpassRecord.BindPoint = GetVkPipelineBindPoint(JsonParser::GetString(subpass[_text_mapper(vk_pipeline_bind_point)]));
+			subpassRecord.DepthRef  = PipelinePack::kNone;
+
+			if (!BakeAttachmentRefs(subpass[_text_mapper(vk_input_attachments)],   attachmentNameIDMap, OutWriter, subpassRecord.InputRefs) ||
+				!BakeAttachmentRefs(subpass[_text_mapper(vk_color_attachments)],   attachmentNameIDMap, OutWriter, subpassRecord.ColorRefs) ||
+				!BakeAttachmentRefs(subpass[_text_mapper(vk_resolve_attachments)], attachmentNameIDMap, OutWriter, subpassRecord.ResolveRefs))
+				return false;
+
+			if (subpassRecord.ResolveRefs.Count != _count_0 && subpassRecord.ResolveRefs.Count != subpassRecord.ColorRefs.Count)
+			{
+				_log_error(StringUtil::Printf("Subpass \"%\" needs one resolve attachment per color attachment!", subpassName), LogSystem::Category::JsonParser);
+				return false;
+			}
+
+			// Preserve Attachment ID.
+			const Json::Value& preserves = subpass[_text_mapper(vk_preserve_attachment_names)];
+
+			subpassRecord.Preserves = BeginRange(OutWriter.Words);
+
+			if (preserves != Json::nullValue)
+			{
+				const bool   bIsPreserveArray  = preserves.isArray();
+				const uint32 numPreserveAttach = bIsPreserveArray ? preserves.size() : _count_1;
+
+				for (uint32 k = 0; k < numPreserveAttach; k++)
+				{
+					string name = JsonParser::GetString(bIsPreserveArray ? preserves[k] : preserves);
+
+					uint32 attachmentID;
+					if (!FindID(attachmentNameIDMap, name, attachmentID))
+					{
+						_log_error(StringUtil::Printf("Specified attachment name \"%\" was not found!", name), LogSystem::Category::JsonParser);
+						return false;
+					}
+
+					OutWriter.Words.push_back(attachmentID);
+				}
+			}
+
+			EndRange(OutWriter.Words, subpassRecord.Preserves);
+
+			// Depth Attachment Reference.
+			const Json::Value& depthAttach = subpass[_text_mapper(vk_depth_attachment)];
+
+			if (depthAttach != Json::nullValue)
+			{
+				Range depthRange;
+				if (!BakeAttachmentRefs(depthAttach, attachmentNameIDMap, OutWriter, depthRange))
+					return false;
+
+				subpassRecord.DepthRef = depthRange.Offset;
+			}
+		}
+
+		renderPass.Subpasses = BeginRange(OutWriter.Subpasses);
+		OutWriter.Subpasses.insert(OutWriter.Subpasses.end(), subpassRecords.begin(), subpassRecords.end());
+		EndRange(OutWriter.Subpasses, renderPass.Subpasses);
+
+		// Dependency.
+		const Json::Value& dependencies = renderPassInfo[_text_mapper(vk_subpass_dependencies)];
+
+		bIsArray = dependencies.isArray();
+		uint32 numDependency = bIsArray ? dependencies.size() : _count_1;
+
+		renderPass.Dependencies = BeginRange(OutWriter.Dependencies);
+
+		for (uint32 j = 0; j < numDependency; j++)
+		{
+			const Json::Value& dependency = bIsArray ? dependencies[j] : dependencies;
+
+			VkSubpassDependency subpassDependency = ZeroRecord<VkSubpassDependency>();
+
+			string srcName = JsonParser::GetString(dependency[_text_mapper(vk_src_subpass_name)]);
+			string dstName = JsonParser::GetString(dependency[_text_mapper(vk_dst_subpass_name)]);
+
+			subpassDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+			subpassDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+
+			if ((srcName != _str_null && !FindID(subpassNameIDMap, srcName, subpassDependency.srcSubpass)) ||
+				(dstName != _str_null && !FindID(subpassNameIDMap, dstName, subpassDependency.dstSubpass)))
+			{
+				_log_error(StringUtil::Printf("Specified subpass name \"%\" or \"%\" was not found!", srcName, dstName), LogSystem::Category::JsonParser);
+				return false;
+			}
+
+			subpassDependency.srcStageMask    = GetVkPipelineStageFlags(JsonParser::GetString(dependency[_text_mapper(vk_src_stage_mask)]));
+			subpassDependency.dstStageMask    = GetVkPipelineStageFlags(JsonParser::GetString(dependency[_text_mapper(vk_dst_stage_mask)]));
+			subpassDependency.srcAccessMask   = BakeAccessMask(dependency[_text_mapper(vk_src_access_mask)]);
+			subpassDependency.dstAccessMask   = BakeAccessMask(dependency[_text_mapper(vk_dst_access_mask)]);
+			subpassDependency.dependencyFlags = GetVkDependencyFlags(JsonParser::GetString(dependency[_text_mapper(vk_dependency_flags)]));
+
+			OutWriter.Dependencies.push_back(subpassDependency);
+		}
+
+		EndRange(OutWriter.Dependencies, renderPass.Dependencies);
+
+		// The first render pass of a name wins, like in the maps of the LogicalDevice.
+		OutWriter.RenderPassPathIDMap.emplace(InJsonPath, (uint32)OutWriter.RenderPasses.size());
+		OutWriter.RenderPassNameIDMap.emplace(renderPassName, (uint32)OutWriter.RenderPasses.size());
+		OutWriter.RenderPasses.push_back(renderPass);
+
+		return true;
+	}
+
+	bool BakeStages(const Json::Value& InGraphicInfo, PackWriter& OutWriter, Range& OutRange)
+	{
+		const Json::Value& stages = InGraphicInfo[_text_mapper(vk_pipeline_stages_infos)];
+
+		if (stages == Json::nullValue)
+		{
+			_log_error("json file: [pipeline_stages_infos] can not be null!", LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		const bool   bIsArray     = stages.isArray();
+		const uint32 numStageInfo = bIsArray ? stages.size() : _count_1;
+
+		OutRange = BeginRange(OutWriter.Stages);
+
+		for (uint32 j = 0; j < numStageInfo; j++)
+		{
+			const Json::Value& shaderInfo = bIsArray ? stages[j] : stages;
+
+			string shaderPath = JsonParser::GetString(shaderInfo[_text_mapper(vk_stage_code_path)]);
+			if (shaderPath == _str_null)
+			{
+				_log_error("json file: [stage_code_path] can not be null!", LogSystem::Category::JsonParser);
+				return false;
+			}
+
+			PipelinePack::StageRecord stage = ZeroRecord<PipelinePack::StageRecord>();
+			stage.CodePath   = OutWriter.AddString(shaderPath);
+			stage.Entrypoint = OutWriter.AddString(JsonParser::GetString(shaderInfo[_text_mapper(vk_entrypoint)], DefaultShaderEntryPoint));
+			stage.Flags      = JsonParser::GetUInt32(shaderInfo[_text_mapper(vk_flags)]);
+
+			// A stage_type naming no stage leaves it to the compiler, like a missing one.
+			VkShaderStageFlags userDefinedShaderStage;
+			if (shaderInfo[_text_mapper(vk_stage_type)] != Json::nullValue &&
+				GetShaderStage(JsonParser::GetString(shaderInfo[_text_mapper(vk_stage_type)]), userDefinedShaderStage) &&
+				userDefinedShaderStage != VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM)
+				stage.Stage = userDefinedShaderStage;
+
+			// Specialization constants, 4 byte per const, 32 bit value.
+			const Json::Value& specConsts = shaderInfo[_text_mapper(vk_specialization_constants)];
+
+			stage.SpecEntries = BeginRange(OutWriter.SpecEntries);
+			stage.SpecData    = BeginRange(OutWriter.Words);
+
+			if (specConsts != Json::nullValue)
+			{
+				const bool   bIsSpecArray = specConsts.isArray();
+				const uint32 numSpecConst = bIsSpecArray ? specConsts.size() : _count_1;
+
+				for (uint32 k = 0; k < numSpecConst; k++)
+				{
+					const Json::Value& value = bIsSpecArray ? specConsts[k] : specConsts;
+
+					VkSpecializationMapEntry specEntry = ZeroRecord<VkSpecializationMapEntry>();
+					specEntry.constantID = k;
+					specEntry.offset     = k * 4;
+					specEntry.size       = 4;
+
+					uint32 specWord = 0;
+
+					switch (value.type())
+					{
+						case Json::ValueType::intValue:     _reinterpret_data(specWord, value.asInt());   break;
+						case Json::ValueType::uintValue:    _reinterpret_data(specWord, value.asUInt());  break;
+						case Json::ValueType::realValue:    _reinterpret_data(specWord, value.asFloat()); break;
+						case Json::ValueType::booleanValue: specWord = value.asBool() ? VK_TRUE : VK_FALSE; break;
+						default:
+						{
+							_log_error("json file: not support [specialization_constants] value type!", LogSystem::Category::JsonParser);
+							return false;
+						}
+					}
+
+					OutWriter.SpecEntries.push_back(specEntry);
+					OutWriter.Words.push_back(specWord);
+				}
+			}
+
+			EndRange(OutWriter.SpecEntries, stage.SpecEntries);
+			EndRange(OutWriter.Words, stage.SpecData);
+
+			OutWriter.Stages.push_back(stage);
+		}
+
+		EndRange(OutWriter.Stages, OutRange);
+		return true;
+	}
+
+	bool BakeVertexInput(const Json::Value& InGraphicInfo, PackWriter& OutWriter, PipelinePack::PipelineRecord& OutPipeline)
+	{
+		const Json::Value& bindings = InGraphicInfo[_text_mapper(vk_vertex_input_attributes)];
+
+		if (bindings == Json::nullValue)
+		{
+			_log_error("json file: [vertex_input_attributes] can not be null!", LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		const bool   bIsArray   = bindings.isArray();
+		const uint32 numBinding = bIsArray ? bindings.size() : _count_1;
+
+		OutPipeline.VertexBindings   = BeginRange(OutWriter.VertexBindings);
+		OutPipeline.VertexAttributes = BeginRange(OutWriter.VertexAttributes);
+
+		// Locations run on over the bindings.
+		uint32 location = _index_0;
+
+		for (uint32 j = 0; j < numBinding; j++)
+		{
+			const Json::Value& binding = bIsArray ? bindings[j] : bindings;
+
+			uint32 bindingID = binding[_text_mapper(vk_binding_id)] != Json::nullValue ? binding[_text_mapper(vk_binding_id)].asUInt() : j;
+
+			if (j >= 16u)
+			{
+				_log_warning("current app vertex input binding number is limit to 16!", LogSystem::Category::JsonParser);
+				break;
+			}
+
+			if (bindingID >= 16u)
+			{
+				_log_warning("Current app vertex input binding number is limit to 16!", LogSystem::Category::JsonParser);
+				continue;
+			}
+
+			const Json::Value& attributes = binding[_text_mapper(vk_attributes)];
+
+			const bool   bIsAttributeArray = attributes.isArray();
+			const uint32 numAttribute      = bIsAttributeArray ? attributes.size() : _count_1;
+
+			uint32 attributeOffset = 0;
+			for (uint32 k = 0; k < numAttribute; k++)
+			{
+				string attribute = bIsAttributeArray ? attributes[k].asString() : attributes.asString();
+
+				VkVertexInputAttributeDescription attributeDesc = ZeroRecord<VkVertexInputAttributeDescription>();
+				attributeDesc.location = location++;
+				attributeDesc.binding  = bindingID;
+				attributeDesc.format   = GetVertexAttributeVkFormat(attribute);
+				attributeDesc.offset   = attributeOffset;
+
+				OutWriter.VertexAttributes.push_back(attributeDesc);
+
+				attributeOffset += GetVertexAttributeSize(attribute);
+			}
+
+			VkVertexInputBindingDescription bindingDesc = ZeroRecord<VkVertexInputBindingDescription>();
+			bindingDesc.binding   = bindingID;
+			bindingDesc.stride    = attributeOffset;
+			bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+			OutWriter.VertexBindings.push_back(bindingDesc);
+		}
+
+		EndRange(OutWriter.VertexBindings, OutPipeline.VertexBindings);
+		EndRange(OutWriter.VertexAttributes, OutPipeline.VertexAttributes);
+
+		return true;
+	}
+
+	bool BakeViewports(const Json::Value& InViewportInfo, PackWriter& OutWriter, PipelinePack::PipelineRecord& OutPipeline)
+	{
+		OutPipeline.Viewports = BeginRange(OutWriter.Viewports);
+
+		if (InViewportInfo == Json::nullValue)
+		{
+			PipelinePack::ViewportRecord viewportRecord = ZeroRecord<PipelinePack::ViewportRecord>();
+			viewportRecord.Viewport = RenderBaseConfig::Pipeline::DefaultViewport;
+			viewportRecord.Scissor  = RenderBaseConfig::Pipeline::DefaultScissor;
+
+			OutWriter.Viewports.push_back(viewportRecord);
+			EndRange(OutWriter.Viewports, OutPipeline.Viewports);
+
+			OutPipeline.ViewportFlags = RenderBaseConfig::Pipeline::DefaultViewportStateInfo.flags;
+			return true;
+		}
+
+		OutPipeline.ViewportFlags = JsonParser::GetUInt32(InViewportInfo[_text_mapper(vk_flags)]);
+
+		const Json::Value& viewports = InViewportInfo[_text_mapper(vk_viewports)];
+		const Json::Value& scissors  = InViewportInfo[_text_mapper(vk_scissor_rectangles)];
+
+		const bool   bIsArray    = viewports.isArray();
+		const uint32 numViewport = bIsArray ? viewports.size() : _count_1;
+
+		for (uint32 j = 0; j < numViewport; j++)
+		{
+			const Json::Value& viewport = bIsArray ? viewports[j] : viewports;
+			const Json::Value& scissor  = scissors.isArray() ? scissors[j] : scissors;
+
+			if (!viewport[_text_mapper(vk_position)].isArray() || !viewport[_text_mapper(vk_size)].isArray() || !viewport[_text_mapper(vk_depth_range)].isArray() ||
+				!scissor[_text_mapper(vk_offset)].isArray() || !scissor[_text_mapper(vk_size)].isArray())
+			{
+				_log_error("json file: viewport [position], [size], [depth_range] and scissor [offset], [size] must be arrays [ first, second ]!", LogSystem::Category::JsonParser);
+				return false;
+			}
+
+			const Json::Value& viewportSize = viewport[_text_mapper(vk_size)];
+			const Json::Value& scissorSize  = scissor[_text_mapper(vk_size)];
+
+			// "auto" stands for the window size, only known at load.
+			PipelinePack::ViewportRecord viewportRecord = ZeroRecord<PipelinePack::ViewportRecord>();
+
+			if (JsonParser::GetString(viewportSize[0]) == "auto") viewportRecord.AutoSize |= PipelinePack::AutoViewportWidth;
+			if (JsonParser::GetString(viewportSize[1]) == "auto") viewportRecord.AutoSize |= PipelinePack::AutoViewportHeight;
+			if (JsonParser::GetString(scissorSize[0])  == "auto") viewportRecord.AutoSize |= PipelinePack::AutoScissorWidth;
+			if (JsonParser::GetString(scissorSize[1])  == "auto") viewportRecord.AutoSize |= PipelinePack::AutoScissorHeight;
+
+			viewportRecord.Viewport.x        = JsonParser::GetFloat(viewport[_text_mapper(vk_position)][0]);
+			viewportRecord.Viewport.y        = JsonParser::GetFloat(viewport[_text_mapper(vk_position)][1]);
+			viewportRecord.Viewport.width    = (viewportRecord.AutoSize & PipelinePack::AutoViewportWidth)  ? 0.0f : JsonParser::GetFloat(viewportSize[0]);
+			viewportRecord.Viewport.height   = (viewportRecord.AutoSize & PipelinePack::AutoViewportHeight) ? 0.0f : JsonParser::GetFloat(viewportSize[1]);
+			viewportRecord.Viewport.minDepth = JsonParser::GetFloat(viewport[_text_mapper(vk_depth_range)][0]);
+			viewportRecord.Viewport.maxDepth = JsonParser::GetFloat(viewport[_text_mapper(vk_depth_range)][1]);
+
+			viewportRecord.Scissor.offset.x      = JsonParser::GetInt32(scissor[_text_mapper(vk_offset)][0]);
+			viewportRecord.Scissor.offset.y      = JsonParser::GetInt32(scissor[_text_mapper(vk_offset)][1]);
+			viewportRecord.Scissor.extent.width  = (viewportRecord.AutoSize & PipelinePack::AutoScissorWidth)  ? 0u : JsonParser::GetUInt32(scissorSize[0]);
+			viewportRecord.Scissor.extent.height = (viewportRecord.AutoSize & PipelinePack::AutoScissorHeight) ? 0u : JsonParser::GetUInt32(scissorSize[1]);
+
+			OutWriter.Viewports.push_back(viewportRecord);
+		}
+
+		EndRange(OutWriter.Viewports, OutPipeline.Viewports);
+		return true;
+	}
+
+	void BakeStencilOpState(const Json::Value& InStencilOp, VkStencilOpState& OutState)
+	{
+		OutState.failOp      = GetVkStencilOp(JsonParser::GetString(InStencilOp[_text_mapper(vk_fail_op)]));
+		OutState.passOp      = GetVkStencilOp(JsonParser::GetString(InStencilOp[_text_mapper(vk_pass_op)]));
+		OutState.depthFailOp = GetVkStencilOp(JsonParser::GetString(InStencilOp[_text_mapper(vk_depth_fail_op)]));
+		OutState.compareOp   = GetVkCompareOp(JsonParser::GetString(InStencilOp[_text_mapper(vk_compare_op)]));
+		OutState.compareMask = StringUtil::StrHexToNumeric(JsonParser::GetString(InStencilOp[_text_mapper(vk_compare_mask)], "0x00"));
+		OutState.writeMask   = StringUtil::StrHexToNumeric(JsonParser::GetString(InStencilOp[_text_mapper(vk_write_mask)], "0x00"));
+		OutState.reference   = JsonParser::GetUInt32(InStencilOp[_text_mapper(vk_reference)]);
+	}
+
+	VkBlendFactor BakeBlendFactor(const Json::Value& InFactor)
+	{
+		return InFactor.isUInt() ? static_cast<VkBlendFactor>(JsonParser::GetUInt32(InFactor)) : GetVkBlendFactor(JsonParser::GetString(InFactor));
+	}
+
+	/**
+	 *  States start from the RenderBaseConfig::Pipeline defaults and take what the json sets, like LogicalDevice::BuildGraphicPipelines().
+	 */
+	bool BakeFixedFunctionStates(const Json::Value& InGraphicInfo, PackWriter& OutWriter, PipelinePack::PipelineRecord& OutPipeline)
+	{
+		bool bIsArray;
+
+		OutPipeline.InputAssembly = RenderBaseConfig::Pipeline::DefaultInputAssemblyStateInfo;
+		OutPipeline.Tessellation  = RenderBaseConfig::Pipeline::DefaultTessellationStateInfo;
+		OutPipeline.Rasterization = RenderBaseConfig::Pipeline::DefaultRasterizationStateInfo;
+		OutPipeline.Multisample   = RenderBaseConfig::Pipeline::DefaultMultisampleStateInfo;
+		OutPipeline.DepthStencil  = RenderBaseConfig::Pipeline::DefaultDepthStencilStateInfo;
+		OutPipeline.ColorBlend    = RenderBaseConfig::Pipeline::DefaultColorBlendStateInfo;
+
+		// IA State.
+		const Json::Value& inputAssemblyInfo = InGraphicInfo[_text_mapper(vk_pipeline_input_assembly)];
+		if (inputAssemblyInfo != Json::nullValue)
+		{
+			OutPipeline.InputAssembly.flags                  = JsonParser::GetUInt32(inputAssemblyInfo[_text_mapper(vk_flags)]);
+			OutPipeline.InputAssembly.topology               = GetVkPrimitiveTopology(JsonParser::GetString(inputAssemblyInfo[_text_mapper(vk_primitive_topology)]));
+			OutPipeline.InputAssembly.primitiveRestartEnable = JsonParser::GetUInt32(inputAssemblyInfo[_text_mapper(vk_primitive_restart_enable)]);
+		}
+
+		// Tessellation State.
+		const Json::Value& tessellationInfo = InGraphicInfo[_text_mapper(vk_tessellation_state)];
+		if (tessellationInfo != Json::nullValue)
+		{
+			OutPipeline.HasTessellation                 = VK_TRUE;
+			OutPipeline.Tessellation.flags              = JsonParser::GetUInt32(tessellationInfo[_text_mapper(vk_flags)]);
+			OutPipeline.Tessellation.patchControlPoints = JsonParser::GetUInt32(tessellationInfo[_text_mapper(vk_patch_control_points_count)]);
+		}
+
+		// Viewport State.
+		if (!BakeViewports(InGraphicInfo[_text_mapper(vk_viewport_state)], OutWriter, OutPipeline))
+			return false;
+
+		// RS State.
+		const Json::Value& rasterizationInfo = InGraphicInfo[_text_mapper(vk_rasterization_state)];
+		if (rasterizationInfo != Json::nullValue)
+		{
+			OutPipeline.Rasterization.flags                   = JsonParser::GetUInt32(rasterizationInfo[_text_mapper(vk_flags)]);
+			OutPipeline.Rasterization.depthClampEnable        = JsonParser::GetUInt32(rasterizationInfo[_text_mapper(vk_depth_clamp_enable)]);
+			OutPipeline.Rasterization.rasterizerDiscardEnable = JsonParser::GetUInt32(rasterizationInfo[_text_mapper(vk_rasterizer_discard_enable)]);
+			OutPipeline.Rasterization.polygonMode             = GetVkPolygonMode(JsonParser::GetString(rasterizationInfo[_text_mapper(vk_polygon_mode)]));
+			OutPipeline.Rasterization.cullMode                = GetVkCullModeFlags(JsonParser::GetString(rasterizationInfo[_text_mapper(vk_cull_mode)]));
+			OutPipeline.Rasterization.frontFace               = GetVkFrontFace(JsonParser::GetString(rasterizationInfo[_text_mapper(vk_front_face)]));
+			OutPipeline.Rasterization.depthBiasEnable         = JsonParser::GetUInt32(rasterizationInfo[_text_mapper(vk_depth_bias_enable)]);
+			OutPipeline.Rasterization.depthBiasConstantFactor = JsonParser::GetFloat(rasterizationInfo[_text_mapper(vk_depth_bias_constant_factor)]);
+			OutPipeline.Rasterization.depthBiasClamp          = JsonParser::GetFloat(rasterizationInfo[_text_mapper(vk_depth_bias_clamp)]);
+			OutPipeline.Rasterization.depthBiasSlopeFactor    = JsonParser::GetFloat(rasterizationInfo[_text_mapper(vk_depth_bias_slope_factor)]);
+			OutPipeline.Rasterization.lineWidth               = JsonParser::GetFloat(rasterizationInfo[_text_mapper(vk_line_width)]);
+		}
+
+		// Multisample State.
+		OutPipeline.SampleMasks = BeginRange(OutWriter.Words);
+
+		const Json::Value& multisampleInfo = InGraphicInfo[_text_mapper(vk_multisample_state)];
+		if (multisampleInfo != Json::nullValue)
+		{
+			const Json::Value& sampleMasks = multisampleInfo[_text_mapper(vk_sample_masks)];
+
+			bIsArray = sampleMasks.isArray();
+			uint32 numSampleMask = bIsArray ? sampleMasks.size() : _count_1;
+
+			for (uint32 j = 0; j < numSampleMask; j++)
+				OutWriter.Words.push_back(bIsArray ? sampleMasks[j].asUInt() : sampleMasks.asUInt());
+
+			OutPipeline.Multisample.flags                 = JsonParser::GetUInt32(multisampleInfo[_text_mapper(vk_flags)]);
+			OutPipeline.Multisample.rasterizationSamples  = (VkSampleCountFlagBits)GetMultisampleCount(JsonParser::GetUInt32(multisampleInfo[_text_mapper(vk_multisample_count)]));
+			OutPipeline.Multisample.sampleShadingEnable   = JsonParser::GetUInt32(multisampleInfo[_text_mapper(vk_sample_shading_enable)]);
+			OutPipeline.Multisample.minSampleShading      = JsonParser::GetFloat(multisampleInfo[_text_mapper(vk_min_sample_shading_factor)]);
+			OutPipeline.Multisample.alphaToCoverageEnable = JsonParser::GetUInt32(multisampleInfo[_text_mapper(vk_alpha_to_coverage_enable)]);
+			OutPipeline.Multisample.alphaToOneEnable      = JsonParser::GetUInt32(multisampleInfo[_text_mapper(vk_alpha_to_one_enable)]);
+		}
+
+		EndRange(OutWriter.Words, OutPipeline.SampleMasks);
+
+		// Depth Stencil State.
+		const Json::Value& depthStencilInfo = InGraphicInfo[_text_mapper(vk_depth_stencil_state)];
+		if (depthStencilInfo != Json::nullValue)
+		{
+			OutPipeline.DepthStencil.flags                 = JsonParser::GetUInt32(depthStencilInfo[_text_mapper(vk_flags)]);
+			OutPipeline.DepthStencil.depthTestEnable       = JsonParser::GetUInt32(depthStencilInfo[_text_mapper(vk_depth_test_enable)]);
+			OutPipeline.DepthStencil.depthWriteEnable      = JsonParser::GetUInt32(depthStencilInfo[_text_mapper(vk_depth_write_enable)]);
+			OutPipeline.DepthStencil.depthCompareOp        = GetVkCompareOp(JsonParser::GetString(depthStencilInfo[_text_mapper(vk_depth_compare_op)]));
+			OutPipeline.DepthStencil.depthBoundsTestEnable = JsonParser::GetUInt32(depthStencilInfo[_text_mapper(vk_depth_bounds_test_enable)]);
+			OutPipeline.DepthStencil.stencilTestEnable     = JsonParser::GetUInt32(depthStencilInfo[_text_mapper(vk_stencil_test_enable)]);
+			OutPipeline.DepthStencil.minDepthBounds        = JsonParser::GetFloat(depthStencilInfo[_text_mapper(vk_min_depth_bounds)]);
+			OutPipeline.DepthStencil.maxDepthBounds        = JsonParser::GetFloat(depthStencilInfo[_text_mapper(vk_max_depth_bounds)]);
+
+			const Json::Value& stencilInfo = depthStencilInfo[_text_mapper(vk_stencil_test_state)];
+			if (stencilInfo != Json::nullValue)
+			{
+				const bool bIsFrontAuto = JsonParser::GetString(stencilInfo[_text_mapper(vk_front)]) == "auto";
+				const bool bIsBackAuto  = JsonParser::GetString(stencilInfo[_text_mapper(vk_back)])  == "auto";
+
+				if (!bIsFrontAuto)
+					BakeStencilOpState(stencilInfo[_text_mapper(vk_front)], OutPipeline.DepthStencil.front);
+				if (!bIsBackAuto)
+					BakeStencilOpState(stencilInfo[_text_mapper(vk_back)], OutPipeline.DepthStencil.back);
+
+				if (bIsFrontAuto)
+					OutPipeline.DepthStencil.front = OutPipeline.DepthStencil.back;
+				if (bIsBackAuto)
+					OutPipeline.DepthStencil.back = OutPipeline.DepthStencil.front;
+			}
+		}
+
+		// Color Blend State.
+		OutPipeline.BlendAttachments = BeginRange(OutWriter.BlendAttachments);
+
+		const Json::Value& colorBlendInfo = InGraphicInfo[_text_mapper(vk_color_blend_state)];
+		if (colorBlendInfo != Json::nullValue && colorBlendInfo[_text_mapper(vk_attachments)] != Json::nullValue)
+		{
+			const Json::Value& attachments = colorBlendInfo[_text_mapper(vk_attachments)];
+
+			bIsArray = attachments.isArray();
+			uint32 numAttachment = bIsArray ? attachments.size() : _count_1;
+
+			for (uint32 j = 0; j < numAttachment; j++)
+			{
+				const Json::Value& attachment = bIsArray ? attachments[j] : attachments;
+
+				VkPipelineColorBlendAttachmentState attachmentState = ZeroRecord<VkPipelineColorBlendAttachmentState>();
+				attachmentState.blendEnable         = JsonParser::GetUInt32(attachment[_text_mapper(vk_blend_enable)]);
+				attachmentState.srcColorBlendFactor = BakeBlendFactor(attachment[_text_mapper(vk_src_color_factor)]);
+				attachmentState.dstColorBlendFactor = BakeBlendFactor(attachment[_text_mapper(vk_dst_color_factor)]);
+				attachmentState.colorBlendOp        = GetVkBlendOp(JsonParser::GetString(attachment[_text_mapper(vk_color_blend_op)]));
+				attachmentState.srcAlphaBlendFactor = BakeBlendFactor(attachment[_text_mapper(vk_src_alpha_factor)]);
+				attachmentState.dstAlphaBlendFactor = BakeBlendFactor(attachment[_text_mapper(vk_dst_alpha_factor)]);
+				attachmentState.alphaBlendOp        = GetVkBlendOp(JsonParser::GetString(attachment[_text_mapper(vk_alpha_blend_op)]));
+				attachmentState.colorWriteMask      = GetColorComponentMask(JsonParser::GetString(attachment[_text_mapper(vk_component_mask)]));
+
+				OutWriter.BlendAttachments.push_back(attachmentState);
+			}
+
+			OutPipeline.ColorBlend.flags         = JsonParser::GetUInt32(colorBlendInfo[_text_mapper(vk_flags)]);
+			OutPipeline.ColorBlend.logicOpEnable = JsonParser::GetUInt32(colorBlendInfo[_text_mapper(vk_logic_op_enable)]);
+			OutPipeline.ColorBlend.logicOp       = GetVkLogicOp(JsonParser::GetString(colorBlendInfo[_text_mapper(vk_logic_op)]));
+
+			const Json::Value& blendConstants = colorBlendInfo[_text_mapper(vk_blend_constants)];
+
+			bIsArray = blendConstants.isArray();
+			uint32 numConstant = bIsArray ? blendConstants.size() : _count_1;
+			for (uint32 j = 0; j < numConstant && j < 4; j++)
+				OutPipeline.ColorBlend.blendConstants[j] = JsonParser::GetFloat(bIsArray ? blendConstants[j] : blendConstants);
+		}
+		else
+		{
+			OutWriter.BlendAttachments.push_back(RenderBaseConfig::Pipeline::DefaultColorBlendAttachmentState);
+		}
+
+		EndRange(OutWriter.BlendAttachments, OutPipeline.BlendAttachments);
+
+		// Dynamic State.
+		OutPipeline.DynamicStates = BeginRange(OutWriter.DynamicStates);
+
+		const Json::Value& dynamicStateInfo = InGraphicInfo[_text_mapper(vk_dynamic_state)];
+		if (dynamicStateInfo != Json::nullValue && dynamicStateInfo[_text_mapper(vk_state)] != Json::nullValue)
+		{
+			const Json::Value& states = dynamicStateInfo[_text_mapper(vk_state)];
+
+			bIsArray = states.isArray();
+			uint32 numDynamicState = bIsArray ? states.size() : _count_1;
+
+			for (uint32 j = 0; j < numDynamicState; j++)
+				OutWriter.DynamicStates.push_back(GetVkDynamicState(JsonParser::GetString(bIsArray ? states[j] : states)));
+
+			OutPipeline.DynamicFlags = JsonParser::GetUInt32(dynamicStateInfo[_text_mapper(vk_flags)]);
+		}
+		else
+		{
+			OutWriter.DynamicStates.insert(OutWriter.DynamicStates.end(), RenderBaseConfig::Pipeline::DefaultVkDynamicState.begin(), RenderBaseConfig::Pipeline::DefaultVkDynamicState.end());
+
+			OutPipeline.DynamicFlags = RenderBaseConfig::Pipeline::DefaultDynamicStateInfo.flags;
+		}
+
+		EndRange(OutWriter.DynamicStates, OutPipeline.DynamicStates);
+
+		// Pointers come from the ranges at load.
+		OutPipeline.ColorBlend.attachmentCount = _count_0;
+		OutPipeline.ColorBlend.pAttachments    = nullptr;
+		OutPipeline.Multisample.pSampleMask    = nullptr;
+
+		return true;
+	}
+
+	bool BakeGraphicPipeline(const Json::Value& InGraphicInfo, PackWriter& OutWriter)
+	{
+		const uint32 pipelineIndex = (uint32)OutWriter.Pipelines.size();
+
+		string pipelineName = JsonParser::GetString(InGraphicInfo[_text_mapper(vk_name)]);
+
+		PipelinePack::PipelineRecord pipeline = ZeroRecord<PipelinePack::PipelineRecord>();
+		pipeline.Name             = OutWriter.AddString(pipelineName);
+		pipeline.Flags            = JsonParser::GetUInt32(InGraphicInfo[_text_mapper(vk_flags)]);
+		pipeline.BasePipelineName = PipelinePack::kNone;
+		pipeline.VariantInfo      = PipelinePack::kNone;
+
+		// Like the builder, a pipeline with variable constants is a base, its variants are built from the json info.
+		if (InGraphicInfo[_text_mapper(vk_variable_specialization_constants)] != Json::nullValue)
+		{
+			pipeline.Flags       |= VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+			pipeline.VariantInfo  = OutWriter.AddString(JsonParser::WriteText(InGraphicInfo));
+		}
+
+		if (!BakeStages(InGraphicInfo, OutWriter, pipeline.Stages) ||
+			!BakeVertexInput(InGraphicInfo, OutWriter, pipeline) ||
+			!BakeFixedFunctionStates(InGraphicInfo, OutWriter, pipeline))
+			return false;
+
+		// RenderPass.
+		string renderPassPath = JsonParser::GetString(InGraphicInfo[_text_mapper(vk_renderpass_path)]);
+		if (renderPassPath == _str_null)
+		{
+			_log_error("json file: [renderpass_path] can not be null!", LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		if (!BakeRenderPass(PathParser::Parse(renderPassPath), OutWriter))
+			return false;
+
+		string renderPassName = JsonParser::GetString(InGraphicInfo[_text_mapper(vk_renderpass)]);
+
+		if (!FindID(OutWriter.RenderPassNameIDMap, renderPassName, pipeline.RenderPass))
+		{
+			_log_error(StringUtil::Printf("Specified renderpass name \"%\" was not found!", renderPassName), LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		// Subpass ID.
+		string subpassName = JsonParser::GetString(InGraphicInfo[_text_mapper(vk_subpass)]);
+
+		const PipelinePack::RenderPassRecord& renderPass = OutWriter.RenderPasses[pipeline.RenderPass];
+
+		pipeline.Subpass = PipelinePack::kNone;
+		for (uint32 i = 0; i < renderPass.Subpasses.Count; i++)
+		{
+			if (subpassName == &OutWriter.Strings[OutWriter.Subpasses[renderPass.Subpasses.Offset + i].Name])
+			{
+				pipeline.Subpass = i;
+				break;
+			}
+		}
+
+		if (pipeline.Subpass == PipelinePack::kNone)
+		{
+			_log_error(StringUtil::Printf("Specified subpass name \"%\" was not found!", subpassName), LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		// Pipeline Derivative, an earlier pipeline of the pack by index, any other by name at load.
+		string baseName = JsonParser::GetString(InGraphicInfo[_text_mapper(vk_base_pipeline)]);
+
+		uint32 baseIndex;
+		if (FindID(OutWriter.PipelineNameIDMap, baseName, baseIndex))
+		{
+			pipeline.BasePipelineIndex = (int32)baseIndex;
+		}
+		else
+		{
+			pipeline.BasePipelineIndex = -1;
+
+			if (baseName != _str_null)
+				pipeline.BasePipelineName = OutWriter.AddString(baseName);
+		}
+
+		OutWriter.PipelineNameIDMap.emplace(pipelineName, pipelineIndex);
+		OutWriter.Pipelines.push_back(pipeline);
+
+		return true;
+	}
+}
+
+PipelinePack::PipelinePack() :
+	m_pData    (nullptr),
+	m_size     (_count_0)
+#if PLATFORM_WINDOW
+	,
+	m_hFile    (INVALID_HANDLE_VALUE),
+	m_hMapping (nullptr)
+#endif
+{
+
+}
+
+PipelinePack::~PipelinePack()
+{
+	Close();
+}
+
+bool PipelinePack::Open(const string& InPath)
+{
+	Close();
+
+#if PLATFORM_WINDOW
+	m_hFile = CreateFileA(InPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (m_hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_hMapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = (const uint8*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+	m_size  = (usize)fileSize.QuadPart;
+#else
+	std::ifstream ifs(InPath, std::ios::binary | std::ios::ate);
+	if (!ifs.is_open())
+		return false;
+
+	m_fileData.resize((usize)ifs.tellg());
+	ifs.seekg(0, ifs.beg);
+
+	if (!ifs.read((char*)m_fileData.data(), m_fileData.size()))
+	{
+		Close();
+		return false;
+	}
+
+	m_pData = m_fileData.data();
+	m_size  = m_fileData.size();
+#endif
+
+	if (m_pData == nullptr || !Validate())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void PipelinePack::Close()
+{
+#if PLATFORM_WINDOW
+	if (m_pData != nullptr)
+		UnmapViewOfFile(m_pData);
+
+	if (m_hMapping != nullptr)
+		CloseHandle(m_hMapping);
+
+	if (m_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(m_hFile);
+
+	m_hFile    = INVALID_HANDLE_VALUE;
+	m_hMapping = nullptr;
+#else
+	m_fileData.clear();
+	m_fileData.shrink_to_fit();
+#endif
+
+	m_pData = nullptr;
+	m_size  = _count_0;
+}
+
+bool PipelinePack::IsOpen() const
+{
+	return m_pData != nullptr;
+}
+
+bool PipelinePack::IsUpToDate() const
+{
+	const SourceRecord* pSources = Get<SourceRecord>(Section::Sources);
+
+	for (uint32 i = 0; i < GetCount(Section::Sources); i++)
+	{
+		const char* pPath = GetString(pSources[i].Path);
+
+		std::error_code error;
+		if (!std::filesystem::exists(pPath, error))
+			continue;
+
+		if ((uint64)std::filesystem::file_size(pPath, error) != pSources[i].Size || GetWriteTime(pPath, error) != pSources[i].WriteTime || error)
+			return false;
+	}
+
+	return true;
+}
+
+const PipelinePack::Header& PipelinePack::GetHeader() const
+{
+	return *reinterpret_cast<const Header*>(m_pData);
+}
+
+uint32 PipelinePack::GetCount(Section InSection) const
+{
+	return GetHeader().Sections[(usize)InSection].Count;
+}
+
+const char* PipelinePack::GetString(uint32 InOffset) const
+{
+	return Get<char>(Section::Strings) + InOffset;
+}
+
+bool PipelinePack::Validate() const
+{
+	if (m_size < sizeof(Header))
+		return false;
+
+	const Header& header = GetHeader();
+
+	if (header.Magic != kMagic || header.Version != kVersion || header.FileSize != m_size || header.PipelineRecordSize != sizeof(PipelineRecord))
+		return false;
+
+	for (usize i = 0; i < (usize)Section::Count; i++)
+	{
+		const Range& section = header.Sections[i];
+
+		if (section.Offset % kSectionAlignment != 0 || section.Offset < sizeof(Header) ||
+			(uint64)section.Offset + (uint64)section.Count * kElementSizes[i] > m_size)
+			return false;
+	}
+
+	// Every string ends inside the section.
+	const uint32 stringCount = GetCount(Section::Strings);
+	if (stringCount != _count_0 && GetString(stringCount - 1)[0] != '\0')
+		return false;
+
+	auto isString = [stringCount](uint32 InOffset) { return InOffset < stringCount; };
+
+	for (uint32 i = 0; i < GetCount(Section::Sources); i++)
+	{
+		if (!isString(Get<SourceRecord>(Section::Sources)[i].Path))
+			return false;
+	}
+
+	const RenderPassRecord* pRenderPasses = Get<RenderPassRecord>(Section::RenderPasses);
+
+	for (uint32 i = 0; i < GetCount(Section::RenderPasses); i++)
+	{
+		const RenderPassRecord& renderPass = pRenderPasses[i];
+
+		if (!isString(renderPass.Name) ||
+			!IsInSection(header, Section::Attachments, renderPass.Attachments) ||
+			!IsInSection(header, Section::Subpasses, renderPass.Subpasses) ||
+			!IsInSection(header, Section::Dependencies, renderPass.Dependencies))
+			return false;
+	}
+
+	const SubpassRecord* pSubpasses = Get<SubpassRecord>(Section::Subpasses);
+
+	for (uint32 i = 0; i < GetCount(Section::Subpasses); i++)
+	{
+		const SubpassRecord& subpass = pSubpasses[i];
+
+		if (!isString(subpass.Name) ||
+			(subpass.DepthRef != kNone && subpass.DepthRef >= GetCount(Section::AttachmentRefs)) ||
+			(subpass.ResolveRefs.Count != _count_0 && subpass.ResolveRefs.Count != subpass.ColorRefs.Count) ||
+			!IsInSection(header, Section::AttachmentRefs, subpass.InputRefs) ||
+			!IsInSection(header, Section::AttachmentRefs, subpass.ColorRefs) ||
+			!IsInSection(header, Section::AttachmentRefs, subpass.ResolveRefs) ||
+			!IsInSection(header, Section::Words, subpass.Preserves))
+			return false;
+	}
+
+	const StageRecord* pStages = Get<StageRecord>(Section::Stages);
+
+	for (uint32 i = 0; i < GetCount(Section::Stages); i++)
+	{
+		const StageRecord& stage = pStages[i];
+
+		if (!isString(stage.CodePath) || !isString(stage.Entrypoint) ||
+			!IsInSection(header, Section::SpecEntries, stage.SpecEntries) ||
+			!IsInSection(header, Section::Words, stage.SpecData))
+			return false;
+
+		const VkSpecializationMapEntry* pSpecEntries = Get<VkSpecializationMapEntry>(Section::SpecEntries, stage.SpecEntries);
+
+		for (uint32 j = 0; j < stage.SpecEntries.Count; j++)
+		{
+			if ((uint64)pSpecEntries[j].offset + pSpecEntries[j].size > (uint64)stage.SpecData.Count * sizeof(uint32))
+				return false;
+		}
+	}
+
+	const PipelineRecord* pPipelines = Get<PipelineRecord>(Section::Pipelines);
+
+	for (uint32 i = 0; i < GetCount(Section::Pipelines); i++)
+	{
+		const PipelineRecord& pipeline = pPipelines[i];
+
+		if (!isString(pipeline.Name) ||
+			(pipeline.BasePipelineName != kNone && !isString(pipeline.BasePipelineName)) ||
+			(pipeline.VariantInfo != kNone && !isString(pipeline.VariantInfo)) ||
+			pipeline.BasePipelineIndex < -1 || pipeline.BasePipelineIndex >= (int32)i ||
+			pipeline.RenderPass >= GetCount(Section::RenderPasses) ||
+			pipeline.Subpass >= pRenderPasses[pipeline.RenderPass].Subpasses.Count ||
+			!IsInSection(header, Section::Stages, pipeline.Stages) ||
+			!IsInSection(header, Section::VertexBindings, pipeline.VertexBindings) ||
+			!IsInSection(header, Section::VertexAttributes, pipeline.VertexAttributes) ||
+			!IsInSection(header, Section::Viewports, pipeline.Viewports) ||
+			!IsInSection(header, Section::Words, pipeline.SampleMasks) ||
+			!IsInSection(header, Section::BlendAttachments, pipeline.BlendAttachments) ||
+			!IsInSection(header, Section::DynamicStates, pipeline.DynamicStates))
+			return false;
+	}
+
+	return true;
+}
+
+bool PipelinePack::Bake(const std::vector<string>& InJsonPaths, const string& OutPackPath)
+{
+	PackWriter writer;
+
+	for (const string& jsonPath : InJsonPaths)
+	{
+		Json::Value root;
+
+		if (!JsonParser::Parse(jsonPath, root))
+		{
+			_log_error("JsonParser failed at file: " + jsonPath, LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		const Json::Value& pipelineInfos = root[_text_mapper(vk_graphic_pipeline_infos)];
+
+		if (pipelineInfos == Json::nullValue)
+		{
+			_log_error("json file: [graphic_pipeline_infos] can not be null!", LogSystem::Category::JsonParser);
+			return false;
+		}
+
+		if (!writer.AddSource(jsonPath))
+			return false;
+
+		const bool   bIsArray = pipelineInfos.isArray();
+		const uint32 numGInfo = bIsArray ? pipelineInfos.size() : _count_1;
+
+		for (uint32 i = 0; i < numGInfo; i++)
+		{
+			if (!BakeGraphicPipeline(bIsArray ? pipelineInfos[i] : pipelineInfos, writer))
+			{
+				_log_error(StringUtil::Printf("Baking pipeline % of % failed!", i, jsonPath), LogSystem::Category::JsonParser);
+				return false;
+			}
+		}
+	}
+
+	if (!writer.Write(OutPackPath))
+	{
+		_log_error("Writing pipeline pack " + OutPackPath + " failed!", LogSystem::Category::IO);
+		return false;
+	}
+
+	_log_common(StringUtil::Printf("Baked % pipelines and % render passes into %", (uint32)writer.Pipelines.size(), (uint32)writer.RenderPasses.size(), OutPackPath), LogSystem::Category::JsonParser);
+
+	return true;
+}
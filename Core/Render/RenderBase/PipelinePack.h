@@ -0,0 +1,242 @@
+﻿/*********************************************************************
+ *  PipelinePack.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Baked binary form of the json pipeline and render pass descriptions.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+
+/**
+ *  A pack holds the graphic pipelines of some json files and the render
+ *  passes they name, every key of the json already resolved to its vulkan
+ *  value. Records are plain structs in typed sections and refer to each
+ *  other by index, the file is used the way it is mapped and nothing in it
+ *  is parsed. Fixed function states are stored as their create infos with
+ *  the pointers cleared, a loader only points them at the arrays the record
+ *  names. Shaders stay references, their modules and layouts still come
+ *  from the compiler and its cache.
+ * 
+ *  The layout is the one of the compiler and vulkan headers that baked it,
+ *  the header holds the version and the record sizes and Open() rejects a
+ *  pack baked for anything else. Open() checks every index and range once,
+ *  readers use them unchecked afterwards.
+ */
+class PipelinePack
+{
+
+public:
+
+	static const uint32 kMagic   = 0x50504C4Au;   // "JLPP"
+	static const uint32 kVersion = 2;
+	static const uint32 kNone    = 0xFFFFFFFFu;
+
+	/**
+	 *  Elements [Offset, Offset + Count) of a section.
+	 */
+	struct Range
+	{
+		uint32 Offset;
+		uint32 Count;
+	};
+
+	enum class Section : uint32
+	{
+		Strings,             ///< char, zero terminated, records hold the offset of the first char.
+		Sources,             ///< SourceRecord
+		RenderPasses,        ///< RenderPassRecord
+		Attachments,         ///< VkAttachmentDescription
+		Subpasses,           ///< SubpassRecord
+		AttachmentRefs,      ///< VkAttachmentReference
+		Dependencies,        ///< VkSubpassDependency
+		Pipelines,           ///< PipelineRecord
+		Stages,              ///< StageRecord
+		SpecEntries,         ///< VkSpecializationMapEntry
+		Words,               ///< uint32, specialization data, preserve attachments and sample masks.
+		VertexBindings,      ///< VkVertexInputBindingDescription
+		VertexAttributes,    ///< VkVertexInputAttributeDescription
+		Viewports,           ///< ViewportRecord
+		BlendAttachments,    ///< VkPipelineColorBlendAttachmentState
+		DynamicStates,       ///< VkDynamicState
+
+		Count
+	};
+
+	struct Header
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 FileSize;
+		uint32 PipelineRecordSize;                     ///< Differs between compilers and vulkan headers.
+		Range  Sections[(usize)Section::Count];        ///< Offset in bytes from the file start.
+	};
+
+	/**
+	 *  A json file the pack was baked from, a newer one makes the pack stale.
+	 */
+	struct SourceRecord
+	{
+		uint32 Path;
+		uint32 Reserved;
+		uint64 Size;
+		int64  WriteTime;
+	};
+
+	struct RenderPassRecord
+	{
+		uint32 Name;
+		uint32 Flags;
+		Range  Attachments;
+		Range  Subpasses;
+		Range  Dependencies;
+	};
+
+	struct SubpassRecord
+	{
+		uint32              Name;
+		uint32              Flags;
+		VkPipelineBindPoint BindPoint;
+		uint32              DepthRef;        ///< Into AttachmentRefs, kNone without depth.
+		Range               InputRefs;
+		Range               ColorRefs;
+		Range               ResolveRefs;     ///< Empty, or one per color reference.
+		Range               Preserves;       ///< Words.
+	};
+
+	struct StageRecord
+	{
+		uint32             CodePath;        ///< Relative to the module path, like the json one.
+		uint32             Entrypoint;
+		uint32             Flags;
+		VkShaderStageFlags Stage;           ///< 0 takes the stage the compiler reports.
+		Range              SpecEntries;
+		Range              SpecData;        ///< Words.
+	};
+
+	enum AutoSize : uint32
+	{
+		AutoViewportWidth  = 1u << 0,
+		AutoViewportHeight = 1u << 1,
+		AutoScissorWidth   = 1u << 2,
+		AutoScissorHeight  = 1u << 3
+	};
+
+	/**
+	 *  Sizes flagged in AutoSize are replaced with the window size at load.
+	 */
+	struct ViewportRecord
+	{
+		VkViewport Viewport;
+		VkRect2D   Scissor;
+		uint32     AutoSize;
+	};
+
+	struct PipelineRecord
+	{
+		uint32                                 Name;
+		uint32                                 Flags;
+		uint32                                 RenderPass;          ///< Into RenderPasses.
+		uint32                                 Subpass;             ///< Of that render pass.
+		int32                                  BasePipelineIndex;   ///< An earlier pipeline of the pack, -1 if none.
+		uint32                                 BasePipelineName;    ///< Looked up in memory at load, kNone if none.
+		uint32                                 VariantInfo;         ///< Json text of the info its variants are built from, kNone if it declares no variable constants.
+
+		Range                                  Stages;
+		Range                                  VertexBindings;
+		Range                                  VertexAttributes;
+		Range                                  Viewports;
+		Range                                  SampleMasks;         ///< Words, empty for a null pSampleMask.
+		Range                                  BlendAttachments;
+		Range                                  DynamicStates;
+
+		VkBool32                               HasTessellation;
+		VkPipelineViewportStateCreateFlags     ViewportFlags;
+		VkPipelineDynamicStateCreateFlags      DynamicFlags;
+
+		// Pointers are cleared, the ranges above fill them.
+		VkPipelineInputAssemblyStateCreateInfo InputAssembly;
+		VkPipelineTessellationStateCreateInfo  Tessellation;
+		VkPipelineRasterizationStateCreateInfo Rasterization;
+		VkPipelineMultisampleStateCreateInfo   Multisample;
+		VkPipelineDepthStencilStateCreateInfo  DepthStencil;
+		VkPipelineColorBlendStateCreateInfo    ColorBlend;
+	};
+
+public:
+
+	PipelinePack();
+	~PipelinePack();
+
+	PipelinePack(const PipelinePack&) = delete;
+	PipelinePack& operator=(const PipelinePack&) = delete;
+
+	/**
+	 *  Map a pack and check its header and every index and range in it.
+	 * 
+	 *  @return false if the file is missing, of another version or layout, or broken.
+	 */
+	bool Open(const string& InPath);
+
+	void Close();
+
+	bool IsOpen() const;
+
+	/**
+	 *  Sources that no longer exist count as unchanged, a shipped pack does not need its json.
+	 * 
+	 *  @return false if a source the pack was baked from has another size or write time now.
+	 */
+	bool IsUpToDate() const;
+
+	const Header& GetHeader() const;
+
+	uint32 GetCount(Section InSection) const;
+
+	const char* GetString(uint32 InOffset) const;
+
+	/**
+	 *  @return first element of the section.
+	 */
+	template<typename T>
+	const T* Get(Section InSection) const
+	{
+		return reinterpret_cast<const T*>(m_pData + GetHeader().Sections[(usize)InSection].Offset);
+	}
+
+	/**
+	 *  @return first element of InRange, nullptr if it is empty.
+	 */
+	template<typename T>
+	const T* Get(Section InSection, const Range& InRange) const
+	{
+		return InRange.Count != _count_0 ? Get<T>(InSection) + InRange.Offset : nullptr;
+	}
+
+	/**
+	 *  Bake the graphic pipelines of json files like the ones CreateGraphicPipelines() takes,
+	 *  with the render passes their renderpass_path names. Written aside and renamed over OutPackPath.
+	 * 
+	 *  @param  InJsonPaths  absolute paths, pipelines keep the order of the files and of their infos.
+	 * 
+	 *  @return false if a json is missing or invalid, nothing is written then.
+	 */
+	static bool Bake(const std::vector<string>& InJsonPaths, const string& OutPackPath);
+
+private:
+
+	bool Validate() const;
+
+private:
+
+	const uint8* m_pData;
+	usize        m_size;
+
+#if PLATFORM_WINDOW
+	HANDLE       m_hFile;
+	HANDLE       m_hMapping;
+#else
+	std::vector<uint8> m_fileData;
+#endif
+};
@@ -0,0 +1,364 @@
+﻿/*********************************************************************
+ *  PipelineRequestQueue.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "PipelineRequestQueue.h"
+#include "LogicalDevice.h"
+#include "RenderBaseConfig.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Base/ScratchArena.h"
+#include "Core/Render/GLSLCompiler.h"
+
+_impl_create_interface(PipelineRequestQueue)
+
+namespace
+{
+	/**
+	 *  Indices of the info named InName and of the bases it derives from that the device does not hold yet, bases first.
+	 *  A base outside the file is left to the builder, which looks it up in memory.
+	 */
+	void CollectChain(const Json::Value& InGraphicInfos, const string& InName, LogicalDevice* InDevice, ScratchVector<uint32>& OutIndices)
+	{
+		const bool   bIsArray = InGraphicInfos.isArray();
+		const uint32 numGInfo = bIsArray ? InGraphicInfos.size() : _count_1;
+
+		string name = InName;
+
+		while (true)
+		{
+			uint32 index = _index_0;
+			while (index < numGInfo && JsonParser::GetString((bIsArray ? InGraphicInfos[index] : InGraphicInfos)[_text_mapper(vk_name)]) != name)
+				index++;
+
+			// Not in the file, or a loop of bases.
+			if (index == numGInfo || std::find(OutIndices.begin(), OutIndices.end(), index) != OutIndices.end())
+				break;
+
+			OutIndices.push_back(index);
+
+			name = JsonParser::GetString((bIsArray ? InGraphicInfos[index] : InGraphicInfos)[_text_mapper(vk_base_pipeline)]);
+
+			if (name == _str_null || InDevice->FindPipeline(name) != VK_NULL_HANDLE)
+				break;
+		}
+
+		std::reverse(OutIndices.begin(), OutIndices.end());
+	}
+}
+
+PipelineRequest::PipelineRequest(const string& InJsonPath, const string& InName, uint32 InPriority, VkPipeline InFallback) :
+	m_jsonPath (InJsonPath),
+	m_name     (InName),
+	m_priority (InPriority),
+	m_pipeline (VK_NULL_HANDLE),
+	m_fallback (InFallback),
+	m_state    (State::Queued)
+{
+
+}
+
+const string& PipelineRequest::GetName() const
+{
+	return m_name;
+}
+
+PipelineRequest::State PipelineRequest::GetState() const
+{
+	return m_state.load(std::memory_order_acquire);
+}
+
+bool PipelineRequest::IsReady() const
+{
+	return GetState() == State::Ready;
+}
+
+VkPipeline PipelineRequest::GetPipeline() const
+{
+	// Acquire pairs with the release of the worker, m_pipeline is written before.
+	return IsReady() ? m_pipeline : m_fallback.load(std::memory_order_relaxed);
+}
+
+void PipelineRequest::SetFallback(VkPipeline InFallback)
+{
+	m_fallback.store(InFallback, std::memory_order_relaxed);
+}
+
+PipelineRequestQueue::PipelineRequestQueue() :
+	m_pBaseLayer      (nullptr),
+	m_defaultFallback (VK_NULL_HANDLE),
+	m_queuedCount     (_count_0),
+	m_busyCount       (_count_0),
+	m_sequence        (_count_0),
+	m_bStopping       (false),
+	m_requestCount    (_count_0),
+	m_promoteCount    (_count_0),
+	m_buildCount      (_count_0),
+	m_failCount       (_count_0)
+{
+
+}
+
+PipelineRequestQueue::~PipelineRequestQueue()
+{
+	Shutdown();
+}
+
+void PipelineRequestQueue::Init(BaseLayer* InBaseLayer)
+{
+	m_pBaseLayer = InBaseLayer;
+}
+
+void PipelineRequestQueue::Shutdown()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bStopping = true;
+	}
+
+	m_wakeUp.notify_all();
+
+	for (auto& worker : m_workers)
+		worker.join();
+
+	m_workers.clear();
+
+	// Whoever waits for idle would wait for dropped requests.
+	m_idle.notify_all();
+}
+
+SmartPtr<PipelineRequest> PipelineRequestQueue::Request(const string& InJsonPath, const string& InName, Priority InPriority, VkPipeline InFallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_requestCount++;
+
+	auto found = m_nameRequestMap.find(InName);
+	if (found != m_nameRequestMap.end())
+	{
+		SmartPtr<PipelineRequest> pRequest = (*found).second;
+
+		// Pushed again in front, the old entry is skipped once the request left Queued.
+		if (pRequest->GetState() == PipelineRequest::State::Queued && (uint32)InPriority < pRequest->m_priority)
+		{
+			pRequest->m_priority = (uint32)InPriority;
+			m_queue.push({ (uint32)InPriority, m_sequence++, pRequest });
+			m_promoteCount++;
+
+			lock.unlock();
+			m_wakeUp.notify_one();
+		}
+
+		return pRequest;
+	}
+
+	SmartPtr<PipelineRequest> pRequest = new PipelineRequest(InJsonPath, InName, (uint32)InPriority, InFallback != VK_NULL_HANDLE ? InFallback : m_defaultFallback);
+	m_nameRequestMap.emplace(InName, pRequest);
+
+	const VkPipeline pipeline = m_pBaseLayer->GetLogicalDevice()->FindPipeline(InName);
+	if (pipeline != VK_NULL_HANDLE)
+	{
+		pRequest->m_pipeline = pipeline;
+		pRequest->m_state.store(PipelineRequest::State::Ready, std::memory_order_release);
+
+		return pRequest;
+	}
+
+	if (m_bStopping)
+		return pRequest;
+
+	if (m_workers.empty())
+		StartWorkers();
+
+	m_queue.push({ (uint32)InPriority, m_sequence++, pRequest });
+	m_queuedCount++;
+
+	lock.unlock();
+	m_wakeUp.notify_one();
+
+	return pRequest;
+}
+
+void PipelineRequestQueue::SetDefaultFallback(VkPipeline InFallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_defaultFallback = InFallback;
+}
+
+void PipelineRequestQueue::WaitIdle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_bStopping || (m_queuedCount == _count_0 && m_busyCount == _count_0); });
+}
+
+PipelineRequestQueue::Stats PipelineRequestQueue::GetStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Stats stats;
+	stats.RequestCount = m_requestCount;
+	stats.PromoteCount = m_promoteCount;
+	stats.BuildCount   = m_buildCount.load();
+	stats.FailCount    = m_failCount.load();
+	stats.QueuedCount  = m_queuedCount;
+	stats.WorkerCount  = (uint32)m_workers.size();
+
+	return stats;
+}
+
+void PipelineRequestQueue::StartWorkers()
+{
+	// The main thread keeps a core for the frame loop.
+	uint32 workerCount = RenderBaseConfig::Pipeline::RequestWorkerCount;
+	if (workerCount == _count_0)
+		workerCount = std::max(std::thread::hardware_concurrency(), (uint32)2) - _count_1;
+
+	while ((uint32)m_compilers.size() < workerCount)
+		m_compilers.push_back(GLSLCompiler::Create(this));
+
+	m_workers.reserve(workerCount);
+
+	for (uint32 i = 0; i < workerCount; i++)
+		m_workers.emplace_back(&PipelineRequestQueue::WorkerMain, this, m_compilers[i]);
+
+	_log_common(StringUtil::Printf("%: started % workers.", _name_of(PipelineRequestQueue), workerCount), LogSystem::Category::LogicalDevice);
+}
+
+void PipelineRequestQueue::WorkerMain(GLSLCompiler* InCompiler)
+{
+	while (true)
+	{
+		SmartPtr<PipelineRequest> pRequest;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [this]() { return m_bStopping || !m_queue.empty(); });
+
+			if (m_bStopping)
+				return;
+
+			pRequest = m_queue.top().Request;
+			m_queue.pop();
+
+			if (pRequest->GetState() != PipelineRequest::State::Queued)
+				continue;
+
+			pRequest->m_state.store(PipelineRequest::State::Building, std::memory_order_relaxed);
+
+			m_queuedCount--;
+			m_busyCount++;
+		}
+
+		Build(pRequest.Get(), InCompiler);
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+
+			m_busyCount--;
+
+			if (m_queuedCount == _count_0 && m_busyCount == _count_0)
+				m_idle.notify_all();
+		}
+	}
+}
+
+void PipelineRequestQueue::Build(PipelineRequest* InRequest, GLSLCompiler* InCompiler)
+{
+	LogicalDevice* pDevice = m_pBaseLayer->GetLogicalDevice();
+
+	// Built meanwhile by CreateGraphicPipelines() or as the base of another request.
+	VkPipeline pipeline = pDevice->FindPipeline(InRequest->m_name);
+
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		const Json::Value* pGraphicInfos = FindGraphicInfos(InRequest->m_jsonPath);
+
+		if (pGraphicInfos != nullptr)
+		{
+			ScratchScope scratch;
+
+			const bool bIsArray = pGraphicInfos->isArray();
+
+			ScratchVector<uint32> indices;
+			ScratchVector<string> names;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				// The chain is claimed as a whole, a member another worker builds is waited for and then found built.
+				while (true)
+				{
+					indices.clear();
+					names.clear();
+
+					if (pDevice->FindPipeline(InRequest->m_name) != VK_NULL_HANDLE)
+						break;
+
+					CollectChain(*pGraphicInfos, InRequest->m_name, pDevice, indices);
+
+					for (uint32 index : indices)
+						names.push_back(JsonParser::GetString((bIsArray ? (*pGraphicInfos)[index] : *pGraphicInfos)[_text_mapper(vk_name)]));
+
+					if (std::none_of(names.begin(), names.end(), [this](const string& InName) { return m_buildingNames.count(InName) != _count_0; }))
+						break;
+
+					m_chainBuilt.wait(lock);
+				}
+
+				m_buildingNames.insert(names.begin(), names.end());
+			}
+
+			// A malformed info fails the request, it never takes the engine down.
+			if (!indices.empty())
+				pDevice->CreateGraphicPipelinesFromInfos(*pGraphicInfos, indices.data(), (uint32)indices.size(), InCompiler);
+
+			if (!names.empty())
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+
+					for (const string& name : names)
+						m_buildingNames.erase(name);
+				}
+
+				m_chainBuilt.notify_all();
+			}
+
+			pipeline = pDevice->FindPipeline(InRequest->m_name);
+		}
+	}
+
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		_log_warning(StringUtil::Printf("%: no pipeline named % built from %, the fallback stays.", _name_of(PipelineRequestQueue), InRequest->m_name, InRequest->m_jsonPath), LogSystem::Category::LogicalDevice);
+
+		m_failCount++;
+		InRequest->m_state.store(PipelineRequest::State::Failed, std::memory_order_release);
+		return;
+	}
+
+	m_buildCount++;
+
+	InRequest->m_pipeline = pipeline;
+	InRequest->m_state.store(PipelineRequest::State::Ready, std::memory_order_release);
+}
+
+const Json::Value* PipelineRequestQueue::FindGraphicInfos(const string& InJsonPath)
+{
+	// Parsed under the lock, the other workers want the same file more often than not.
+	std::unique_lock<std::mutex> lock(m_jsonMutex);
+
+	auto found = m_pathInfosMap.find(InJsonPath);
+	if (found != m_pathInfosMap.end())
+		return (*found).second.get();
+
+	std::unique_ptr<Json::Value> pGraphicInfos;
+
+	Json::Value root;
+	if (JsonParser::Parse(InJsonPath, root) && root[_text_mapper(vk_graphic_pipeline_infos)] != Json::nullValue)
+		pGraphicInfos.reset(new Json::Value(root[_text_mapper(vk_graphic_pipeline_infos)]));
+	else
+		_log_warning(StringUtil::Printf("%: % is not a valid pipeline json!", _name_of(PipelineRequestQueue), InJsonPath), LogSystem::Category::JsonParser);
+
+	// A broken file is remembered as nullptr, it is not read again.
+	return (*m_pathInfosMap.emplace(InJsonPath, std::move(pGraphicInfos)).first).second.get();
+}
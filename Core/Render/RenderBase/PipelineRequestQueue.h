@@ -0,0 +1,198 @@
+﻿/*********************************************************************
+ *  PipelineRequestQueue.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Graphic pipelines built on background threads ahead of their first draw.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <unordered_set>
+
+class BaseLayer;
+class GLSLCompiler;
+
+/**
+ *  Ticket of one requested pipeline, shared by everyone who asked for the
+ *  name. The state only moves forward, Ready and Failed are final.
+ */
+class PipelineRequest : public RefCounted<PipelineRequest>
+{
+	friend class RefCounted<PipelineRequest>;
+	friend class PipelineRequestQueue;
+
+public:
+
+	enum class State : uint32
+	{
+		Queued,
+		Building,
+		Ready,
+		Failed      ///< No info of that name in the json or it did not build, the fallback stays.
+	};
+
+	const string& GetName() const;
+
+	State GetState() const;
+
+	bool IsReady() const;
+
+	/**
+	 *  @return the pipeline once it is ready, the fallback before that or if it failed.
+	 */
+	VkPipeline GetPipeline() const;
+
+	/**
+	 *  Replace the pipeline drawn with until this one is ready.
+	 */
+	void SetFallback(VkPipeline InFallback);
+
+private:
+
+	PipelineRequest(const string& InJsonPath, const string& InName, uint32 InPriority, VkPipeline InFallback);
+
+	~PipelineRequest() = default;
+
+private:
+
+	string                   m_jsonPath;
+	string                   m_name;
+	uint32                   m_priority;      ///< Most urgent one asked for, guarded by the queue mutex.
+
+	VkPipeline               m_pipeline;      ///< Written once before the state turns Ready.
+	std::atomic<VkPipeline>  m_fallback;
+	std::atomic<State>       m_state;
+};
+
+/**
+ *  Request() hands out a ticket at once and a worker builds the pipeline
+ *  from its json info with a compiler of its own, the frame loop draws with
+ *  the fallback until IsReady(). Workers take the most urgent requests
+ *  first, in request order within a priority, and asking again for a queued
+ *  name with a more urgent priority moves it up. A derivative brings the
+ *  bases of its json it derives from along, a base two workers need is
+ *  built by one while the other waits. Built pipelines are registered by
+ *  name like the ones of CreateGraphicPipelines(), in the cache of the
+ *  PipelineCacheManager. Workers start with the first request.
+ */
+class PipelineRequestQueue : public IResourceHandler
+{
+	_declare_create_interface(PipelineRequestQueue)
+
+protected:
+
+	PipelineRequestQueue();
+
+public:
+
+	virtual ~PipelineRequestQueue();
+
+	void Init(BaseLayer* InBaseLayer);
+
+	/**
+	 *  Stop and join the workers, requests still queued are dropped and keep their fallback.
+	 *  The LogicalDevice calls it before it goes down, the workers use its resources.
+	 */
+	void Shutdown();
+
+public:
+
+	enum class Priority : uint32
+	{
+		Frame,          ///< Needed for this frame, drawn with the fallback until ready.
+		Prefetch        ///< Expected soon, built when no frame request waits.
+	};
+
+	struct Stats
+	{
+		uint64 RequestCount;
+		uint64 PromoteCount;     ///< Queued requests asked for again with a more urgent priority.
+		uint64 BuildCount;       ///< Requests a worker built, bases brought along not counted.
+		uint64 FailCount;
+		uint32 QueuedCount;      ///< Requests waiting for a worker now.
+		uint32 WorkerCount;
+	};
+
+	/**
+	 *  A name asked for before returns the ticket it got then, InJsonPath is not looked at again.
+	 *  A pipeline the device already holds is ready at once.
+	 * 
+	 *  @param  InJsonPath  a file like the ones CreateGraphicPipelines() takes.
+	 *  @param  InFallback  VK_NULL_HANDLE takes the one of SetDefaultFallback().
+	 */
+	SmartPtr<PipelineRequest> Request(const string& InJsonPath, const string& InName, Priority InPriority = Priority::Prefetch, VkPipeline InFallback = VK_NULL_HANDLE);
+
+	/**
+	 *  Fallback of the requests made without one from now on.
+	 */
+	void SetDefaultFallback(VkPipeline InFallback);
+
+	/**
+	 *  Block until nothing is queued or building, for loading screens.
+	 */
+	void WaitIdle();
+
+	Stats GetStats();
+
+private:
+
+	struct QueueEntry
+	{
+		uint32                    Priority;
+		uint64                    Sequence;
+		SmartPtr<PipelineRequest> Request;
+	};
+
+	struct QueueOrder
+	{
+		bool operator()(const QueueEntry& InA, const QueueEntry& InB) const
+		{
+			return InA.Priority != InB.Priority ? InA.Priority > InB.Priority : InA.Sequence > InB.Sequence;
+		}
+	};
+
+	void StartWorkers();
+
+	void WorkerMain(GLSLCompiler* InCompiler);
+
+	void Build(PipelineRequest* InRequest, GLSLCompiler* InCompiler);
+
+	/**
+	 *  @return [graphic_pipeline_infos] of the file, parsed once, nullptr if it is missing or invalid.
+	 */
+	const Json::Value* FindGraphicInfos(const string& InJsonPath);
+
+private:
+
+	BaseLayer*                                                               m_pBaseLayer;
+	VkPipeline                                                               m_defaultFallback;
+
+	std::mutex                                                               m_mutex;
+	std::condition_variable                                                  m_wakeUp;
+	std::condition_variable                                                  m_idle;
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, QueueOrder>     m_queue;      ///< Stale entries of promoted requests are skipped.
+	std::unordered_map<string, SmartPtr<PipelineRequest>>                    m_nameRequestMap;
+	std::unordered_set<string>                                               m_buildingNames;  ///< Infos of the chains workers build now, bases included.
+	std::condition_variable                                                  m_chainBuilt;
+	uint32                                                                   m_queuedCount;
+	uint32                                                                   m_busyCount;
+	uint64                                                                   m_sequence;
+	bool                                                                     m_bStopping;
+
+	std::vector<std::thread>                                                 m_workers;
+	std::vector<GLSLCompiler*>                                               m_compilers;  ///< One per worker, a compiler keeps the reflection of its last shaders.
+
+	std::mutex                                                               m_jsonMutex;
+	std::unordered_map<string, std::unique_ptr<Json::Value>>                 m_pathInfosMap;
+
+	uint64                                                                   m_requestCount;
+	uint64                                                                   m_promoteCount;
+	std::atomic<uint64>                                                      m_buildCount;
+	std::atomic<uint64>                                                      m_failCount;
+};
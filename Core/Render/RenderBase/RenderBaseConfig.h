@@ -15,6 +15,38 @@ namespace RenderBaseConfig
 	{
 		static float SamplerMaxLod = 16.0f;
 		static float MaxAnisotropy = 8.0f;
+
+		static const float LimitWatermark = 0.9f;   // Part of maxSamplerAllocationCount that logs a warning, see SamplerCache.
+	}
+
+	namespace Memory
+	{
+		static const VkDeviceSize PersistentBlockSize = 64ull * 1024 * 1024;  // Power of two, buddy blocks.
+		static const VkDeviceSize TransientBlockSize  = 16ull * 1024 * 1024;
+		static const VkDeviceSize MinBlockSize        = 1ull  * 1024 * 1024;  // Block size floor on small heaps.
+		static const VkDeviceSize MinBuddyRangeSize   = 256;
+		static const uint32       HeapBlockFraction   = 8;                     // A block never exceeds heap size / fraction.
+		static const float        FallbackBudgetRatio = 0.8f;                  // Heap budget without VK_EXT_memory_budget.
+		static const float        BudgetWatermark     = 0.9f;                  // Part of the budget that triggers eviction.
+	}
+
+	namespace Upload
+	{
+		static const VkDeviceSize StagingRingSize     = 32ull * 1024 * 1024;
+		static const VkDeviceSize FrameBudget         = 8ull  * 1024 * 1024;  // Bytes staged per Flush(), bigger uploads span frames.
+		static const VkDeviceSize MinChunkSize        = 64ull * 1024;         // Smaller leftovers wait for the next frame instead.
+		static const VkDeviceSize CopyAlignment       = 16;                    // Staging offsets, covers 4 bytes and common texel blocks.
+	}
+
+	namespace Shader
+	{
+		static const char* const CacheDirectory       = "Saved/ShaderCache";   // Relative to the module path.
+		static const uint64      CacheMaxBytes        = 64ull * 1024 * 1024;  // Oldest entries are evicted above it.
+	}
+
+	namespace PipelineCache
+	{
+		static const char* const CacheDirectory       = "Saved/PipelineCache"; // Relative to the module path, one file per driver.
 	}
 
 	namespace Subresource
@@ -41,6 +73,10 @@ namespace RenderBaseConfig
 
 	namespace Pipeline
 	{
+		static const char* const PackPath = "Saved/Pipelines.pack";   // Relative to the module path, see PipelinePack.
+		static const uint32      RequestWorkerCount = 0;              // Threads of the PipelineRequestQueue, 0 leaves one hardware thread to the frame loop.
+		static const uint32      MaxVariantCount    = 256;            // Specialization constant variants kept alive, least recently used go first.
+
 		static const VkPipelineInputAssemblyStateCreateInfo DefaultInputAssemblyStateInfo =
 		{
 			VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO, // sType
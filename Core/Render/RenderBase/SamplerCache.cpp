@@ -0,0 +1,214 @@
+﻿/*********************************************************************
+ *  SamplerCache.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "SamplerCache.h"
+#include "LogicalDevice.h"
+#include "RenderBaseConfig.h"
+#include "Core/Base/BaseLayer.h"
+
+_impl_create_interface(SamplerCache)
+
+namespace
+{
+	const char kSharedKey = 'S';
+	const char kUniqueKey = 'U';
+
+	template<typename T>
+	void AppendKey(string& OutKey, T InValue)
+	{
+		OutKey.append((const char*)&InValue, sizeof(T));
+	}
+
+	/**
+	 *  Every value of the create info field by field, padding left out. Floats go in by their bits.
+	 */
+	string MakeSamplerKey(const VkSamplerCreateInfo& InCreateInfo)
+	{
+		string key(1, kSharedKey);
+
+		AppendKey(key, (uint32)InCreateInfo.flags);
+		AppendKey(key, (uint32)InCreateInfo.magFilter);
+		AppendKey(key, (uint32)InCreateInfo.minFilter);
+		AppendKey(key, (uint32)InCreateInfo.mipmapMode);
+		AppendKey(key, (uint32)InCreateInfo.addressModeU);
+		AppendKey(key, (uint32)InCreateInfo.addressModeV);
+		AppendKey(key, (uint32)InCreateInfo.addressModeW);
+		AppendKey(key, InCreateInfo.mipLodBias);
+		AppendKey(key, (uint32)InCreateInfo.anisotropyEnable);
+		AppendKey(key, InCreateInfo.maxAnisotropy);
+		AppendKey(key, (uint32)InCreateInfo.compareEnable);
+		AppendKey(key, (uint32)InCreateInfo.compareOp);
+		AppendKey(key, InCreateInfo.minLod);
+		AppendKey(key, InCreateInfo.maxLod);
+		AppendKey(key, (uint32)InCreateInfo.borderColor);
+		AppendKey(key, (uint32)InCreateInfo.unnormalizedCoordinates);
+
+		return key;
+	}
+
+	VkSamplerCreateInfo MakePresetCreateInfo(VkFilter InFilter, VkSamplerAddressMode InAddressMode, float InMaxAnisotropy)
+	{
+		VkSamplerCreateInfo samplerCreateInfo     = {};
+		samplerCreateInfo.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerCreateInfo.magFilter               = InFilter;
+		samplerCreateInfo.minFilter               = InFilter;
+		samplerCreateInfo.mipmapMode              = InFilter == VK_FILTER_LINEAR ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerCreateInfo.addressModeU            = InAddressMode;
+		samplerCreateInfo.addressModeV            = InAddressMode;
+		samplerCreateInfo.addressModeW            = InAddressMode;
+		samplerCreateInfo.mipLodBias              = 0;
+		samplerCreateInfo.anisotropyEnable        = InMaxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+		samplerCreateInfo.maxAnisotropy           = InMaxAnisotropy;
+		samplerCreateInfo.compareEnable           = VK_FALSE;
+		samplerCreateInfo.compareOp               = VK_COMPARE_OP_NEVER;                     // It does not matter.
+		samplerCreateInfo.minLod                  = 0.0f;
+		samplerCreateInfo.maxLod                  = RenderBaseConfig::Sampler::SamplerMaxLod;
+		samplerCreateInfo.borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK; // It does not matter.
+		samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+		return samplerCreateInfo;
+	}
+}
+
+SamplerCache::SamplerCache() :
+	m_pBaseLayer    (nullptr),
+	m_maxCount      (_count_0),
+	m_createCount   (_count_0),
+	m_hitCount      (_count_0),
+	m_uniqueCount   (_count_0),
+	m_bLimitWarned  (false)
+{
+
+}
+
+SamplerCache::~SamplerCache()
+{
+
+}
+
+void SamplerCache::Init(BaseLayer* InBaseLayer)
+{
+	m_pBaseLayer = InBaseLayer;
+	m_maxCount   = InBaseLayer->GetMainPDLimits().maxSamplerAllocationCount;
+
+	// The only definition of the presets, the LogicalDevice::Create*Sampler() family copies them.
+	const float maxAnisotropy = std::min(RenderBaseConfig::Sampler::MaxAnisotropy, InBaseLayer->GetMainPDLimits().maxSamplerAnisotropy);
+
+	m_presetCreateInfos[GetPresetIndex(Render::Sampler::PointWrap)]        = MakePresetCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_REPEAT,        1.0f);
+	m_presetCreateInfos[GetPresetIndex(Render::Sampler::PointClamp)]       = MakePresetCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1.0f);
+	m_presetCreateInfos[GetPresetIndex(Render::Sampler::LinearWrap)]       = MakePresetCreateInfo(VK_FILTER_LINEAR,  VK_SAMPLER_ADDRESS_MODE_REPEAT,        1.0f);
+	m_presetCreateInfos[GetPresetIndex(Render::Sampler::LinearClamp)]      = MakePresetCreateInfo(VK_FILTER_LINEAR,  VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1.0f);
+	m_presetCreateInfos[GetPresetIndex(Render::Sampler::AnisotropicWrap)]  = MakePresetCreateInfo(VK_FILTER_LINEAR,  VK_SAMPLER_ADDRESS_MODE_REPEAT,        maxAnisotropy);
+	m_presetCreateInfos[GetPresetIndex(Render::Sampler::AnisotropicClamp)] = MakePresetCreateInfo(VK_FILTER_LINEAR,  VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, maxAnisotropy);
+
+	VkSamplerCreateInfo& pcfCreateInfo = m_presetCreateInfos[GetPresetIndex(Render::Sampler::PCF)];
+	pcfCreateInfo             = MakePresetCreateInfo(VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER, 1.0f);
+	pcfCreateInfo.compareOp   = VK_COMPARE_OP_LESS_OR_EQUAL;
+	pcfCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+
+	// The first reference of a preset is the cache's own, it is never released.
+	for (uint32 i = 0; i < kPresetCount; ++i)
+		Acquire(m_presetCreateInfos[i]);
+
+	_log_common(StringUtil::Printf("%: % presets, device limit % samplers.", _name_of(SamplerCache), kPresetCount, m_maxCount), LogSystem::Category::LogicalDevice);
+}
+
+VkSampler SamplerCache::Acquire(const VkSamplerCreateInfo& InCreateInfo)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	string key;
+
+	if (InCreateInfo.pNext == nullptr)
+	{
+		key = MakeSamplerKey(InCreateInfo);
+
+		auto found = m_keyEntryMap.find(key);
+		if (found != m_keyEntryMap.end())
+		{
+			m_hitCount++;
+			(*found).second.RefCount++;
+
+			return *(*found).second.Sampler;
+		}
+	}
+	else
+	{
+		key = string(1, kUniqueKey);
+		AppendKey(key, m_uniqueCount++);
+	}
+
+	const uint32 liveCount = (uint32)m_keyEntryMap.size();
+
+	if (!m_bLimitWarned && liveCount >= (uint32)(m_maxCount * RenderBaseConfig::Sampler::LimitWatermark))
+	{
+		m_bLimitWarned = true;
+		_log_warning(StringUtil::Printf("%: % live samplers, the device allows %!", _name_of(SamplerCache), liveCount, m_maxCount), LogSystem::Category::LogicalDevice);
+	}
+
+	LogicalDevice* pDevice = m_pBaseLayer->GetLogicalDevice();
+
+	Entry entry;
+	entry.RefCount = _count_1;
+	pDevice->CreateSampler(entry.Sampler.MakeInstance(pDevice->GetDeviceContext()), InCreateInfo);
+
+	m_createCount++;
+
+	VkSampler sampler = *entry.Sampler;
+
+	m_samplerKeyMap.emplace(sampler, key);
+	m_keyEntryMap.emplace(std::move(key), std::move(entry));
+
+	return sampler;
+}
+
+VkSampler SamplerCache::Acquire(Render::Sampler InSamplerType)
+{
+	return Acquire(m_presetCreateInfos[GetPresetIndex(InSamplerType)]);
+}
+
+void SamplerCache::Release(VkSampler InSampler)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto foundKey = m_samplerKeyMap.find(InSampler);
+	if (foundKey == m_samplerKeyMap.end())
+	{
+		_log_warning(StringUtil::Printf("%: released a sampler it did not hand out!", _name_of(SamplerCache)), LogSystem::Category::LogicalDevice);
+		return;
+	}
+
+	auto found = m_keyEntryMap.find((*foundKey).second);
+
+	if (--(*found).second.RefCount == _count_0)
+	{
+		// The smart pointer queues the sampler until the frames using it are done.
+		m_keyEntryMap.erase(found);
+		m_samplerKeyMap.erase(foundKey);
+	}
+}
+
+const VkSamplerCreateInfo& SamplerCache::GetPresetCreateInfo(Render::Sampler InSamplerType) const
+{
+	return m_presetCreateInfos[GetPresetIndex(InSamplerType)];
+}
+
+SamplerCache::Stats SamplerCache::GetStats()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	Stats stats;
+	stats.LiveCount   = (uint32)m_keyEntryMap.size();
+	stats.MaxCount    = m_maxCount;
+	stats.CreateCount = m_createCount;
+	stats.HitCount    = m_hitCount;
+
+	return stats;
+}
+
+uint32 SamplerCache::GetPresetIndex(Render::Sampler InSamplerType)
+{
+	return (uint32)InSamplerType < kPresetCount ? (uint32)InSamplerType : (uint32)Render::Sampler::PointWrap;
+}
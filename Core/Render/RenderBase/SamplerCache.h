@@ -0,0 +1,96 @@
+﻿/*********************************************************************
+ *  SamplerCache.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Samplers shared by their create info.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Common.h"
+#include "RenderEnum.h"
+#include <mutex>
+
+class BaseLayer;
+
+/**
+ *  Every field of a VkSamplerCreateInfo is the key, equal create infos get
+ *  the same VkSampler. Acquire() counts a reference and Release() drops it,
+ *  the last one sends the sampler to the destroy queue of the device. The
+ *  Render::Sampler presets are built once at Init() and live as long as the
+ *  cache. Drivers cap the live samplers at maxSamplerAllocationCount, often
+ *  4000, GetStats() tells how close the device is.
+ */
+class SamplerCache : public IResourceHandler
+{
+	_declare_create_interface(SamplerCache)
+
+protected:
+
+	SamplerCache();
+
+public:
+
+	virtual ~SamplerCache();
+
+	/**
+	 *  Build the preset create infos and their samplers, the VkDevice has to exist.
+	 */
+	void Init(BaseLayer* InBaseLayer);
+
+public:
+
+	static const uint32 kPresetCount = (uint32)Render::Sampler::PCF + 1;
+
+	struct Stats
+	{
+		uint32 LiveCount;      ///< Samplers alive in the cache, presets included.
+		uint32 MaxCount;       ///< maxSamplerAllocationCount of the device.
+		uint64 CreateCount;
+		uint64 HitCount;       ///< Acquires answered with a live sampler.
+	};
+
+	/**
+	 *  Create infos with a pNext chain are never shared, each gets its own sampler.
+	 * 
+	 *  @return a sampler of InCreateInfo, call Release() once per Acquire().
+	 */
+	VkSampler Acquire(const VkSamplerCreateInfo& InCreateInfo);
+
+	/**
+	 *  An unknown type is served as Render::Sampler::PointWrap.
+	 */
+	VkSampler Acquire(Render::Sampler InSamplerType);
+
+	void Release(VkSampler InSampler);
+
+	const VkSamplerCreateInfo& GetPresetCreateInfo(Render::Sampler InSamplerType) const;
+
+	Stats GetStats();
+
+private:
+
+	struct Entry
+	{
+		VkSmartPtr<VkSampler> Sampler;
+		uint32                RefCount;
+	};
+
+	static uint32 GetPresetIndex(Render::Sampler InSamplerType);
+
+private:
+
+	BaseLayer*                             m_pBaseLayer;
+	uint32                                 m_maxCount;
+
+	std::mutex                             m_mutex;
+	std::unordered_map<string, Entry>      m_keyEntryMap;
+	std::unordered_map<VkSampler, string>  m_samplerKeyMap;
+
+	VkSamplerCreateInfo                    m_presetCreateInfos[kPresetCount];
+
+	uint64                                 m_createCount;
+	uint64                                 m_hitCount;
+	uint64                                 m_uniqueCount;    ///< Names the keys of samplers that are never shared.
+	bool                                   m_bLimitWarned;
+};
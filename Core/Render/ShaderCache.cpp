@@ -0,0 +1,430 @@
+﻿/*********************************************************************
+ *  ShaderCache.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "ShaderCache.h"
+#include "Core/Render/RenderBase/RenderBaseConfig.h"
+#include "Core/Utilities/Math/Hash.h"
+#include <filesystem>
+#include <thread>
+#include <unordered_set>
+
+namespace
+{
+	const uint32 kEntryMagic   = 0x5650534Au;   // "JSPV"
+	const uint32 kEntryVersion = 1;
+
+	const char*  const kEntryExt = ".spvc";
+
+	char         kEmptyLog[1]  = "";
+
+	struct EntryHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint64 Key;
+		uint32 ShaderStage;
+		uint32 SpvLength;        ///< Bytes.
+		uint32 InputCount;
+		uint32 OutputCount;
+		uint32 ResourceCounts[GLSLCompiler::NumDescriptorType];
+	};
+
+	uint64 HashString(uint64 InHash, const string& InString)
+	{
+		// The terminator keeps "ab" + "c" apart from "a" + "bc".
+		return Math::HashBytes(InString.c_str(), InString.size() + 1, InHash);
+	}
+
+	// Paths here are absolute, FileUtil takes paths relative to the module.
+	bool ReadFile(const string& InPath, std::vector<uint8>& OutData)
+	{
+		std::ifstream ifs(InPath, std::ios::binary | std::ios::ate);
+		if (!ifs.is_open())
+			return false;
+
+		const std::streamoff size = ifs.tellg();
+		if (size < 0)
+			return false;
+
+		OutData.resize((usize)size);
+
+		ifs.seekg(0, ifs.beg);
+		ifs.read((char*)OutData.data(), size);
+
+		return ifs.good() || ifs.eof();
+	}
+
+	bool WriteFile(const string& InPath, const std::vector<uint8>& InData)
+	{
+		std::ofstream ofs(InPath, std::ofstream::binary | std::ofstream::trunc);
+		if (!ofs.is_open())
+			return false;
+
+		ofs.write((const char*)InData.data(), InData.size());
+		ofs.close();
+
+		return ofs.good();
+	}
+
+	/**
+	 *  @return names of the #include directives of a source, quoted or bracketed.
+	 */
+	std::vector<string> ParseIncludes(const std::vector<uint8>& InSource)
+	{
+		std::vector<string> includes;
+
+		const char* pCursor = (const char*)InSource.data();
+		const char* pEnd    = pCursor + InSource.size();
+
+		while (pCursor < pEnd)
+		{
+			const char* pLineEnd = std::find(pCursor, pEnd, '\n');
+
+			while (pCursor < pLineEnd && (*pCursor == ' ' || *pCursor == '\t'))
+				pCursor++;
+
+			if (pCursor < pLineEnd && *pCursor == '#')
+			{
+				pCursor++;
+
+				while (pCursor < pLineEnd && (*pCursor == ' ' || *pCursor == '\t'))
+					pCursor++;
+
+				const usize directiveLength = sizeof("include") - 1;
+
+				if ((usize)(pLineEnd - pCursor) > directiveLength && strncmp(pCursor, "include", directiveLength) == 0)
+				{
+					pCursor += directiveLength;
+
+					while (pCursor < pLineEnd && (*pCursor == ' ' || *pCursor == '\t'))
+						pCursor++;
+
+					if (pCursor < pLineEnd && (*pCursor == '"' || *pCursor == '<'))
+					{
+						const char  closing = *pCursor == '"' ? '"' : '>';
+						const char* pName   = pCursor + 1;
+						const char* pClose  = std::find(pName, pLineEnd, closing);
+
+						if (pClose != pLineEnd)
+							includes.emplace_back(pName, pClose);
+					}
+				}
+			}
+
+			pCursor = pLineEnd + 1;
+		}
+
+		return includes;
+	}
+
+	/**
+	 *  Hash a source and, depth first, every file it includes, each file once.
+	 * 
+	 *  @return false if InPath can not be read.
+	 */
+	bool HashSource(const string& InPath, const std::vector<string>& InIncludeDirs, std::unordered_set<string>& InOutVisited, uint64& InOutHash)
+	{
+		std::vector<uint8> source;
+		if (!ReadFile(InPath, source))
+			return false;
+
+		InOutHash = Math::HashBytes(source.data(), source.size(), InOutHash);
+
+		string dir;
+		const string::size_type found = InPath.find_last_of("/\\");
+		if (found != string::npos)
+			dir = InPath.substr(0, found);
+
+		for (auto& include : ParseIncludes(source))
+		{
+			InOutHash = HashString(InOutHash, include);
+
+			std::vector<string> candidates;
+			candidates.push_back(dir + "/" + include);
+			for (auto& includeDir : InIncludeDirs)
+				candidates.push_back(includeDir + "/" + include);
+
+			std::error_code error;
+
+			for (auto& candidate : candidates)
+			{
+				if (!std::filesystem::is_regular_file(candidate, error))
+					continue;
+
+				const string resolved = std::filesystem::weakly_canonical(candidate, error).string();
+
+				// Unresolved includes only count by name, the compiler reports them.
+				if (InOutVisited.insert(resolved).second)
+					HashSource(resolved, InIncludeDirs, InOutVisited, InOutHash);
+
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	bool ParseEntry(uint64 InKey, ShaderCacheEntry& OutEntry)
+	{
+		std::vector<uint8>& blob = OutEntry.Blob;
+
+		if (blob.size() < sizeof(EntryHeader))
+			return false;
+
+		EntryHeader header;
+		memcpy(&header, blob.data(), sizeof(EntryHeader));
+
+		if (header.Magic != kEntryMagic || header.Version != kEntryVersion || header.Key != InKey)
+			return false;
+
+		usize expectedSize = sizeof(EntryHeader) + header.SpvLength + ((usize)header.InputCount + header.OutputCount) * sizeof(GLSLCompiler::ShaderStage);
+		for (uint32 descType = 0; descType < GLSLCompiler::NumDescriptorType; descType++)
+			expectedSize += (usize)header.ResourceCounts[descType] * sizeof(GLSLCompiler::ShaderResource);
+
+		if (expectedSize != blob.size())
+			return false;
+
+		uint8* pCursor = blob.data() + sizeof(EntryHeader);
+
+		auto take = [&pCursor](uint32 InCount, usize InStride) -> uint8*
+		{
+			uint8* pItems = InCount > 0 ? pCursor : nullptr;
+			pCursor += InCount * InStride;
+			return pItems;
+		};
+
+		GLSLCompiler::SPVData& data = OutEntry.Data;
+		data = {};
+
+		data.result       = true;
+		data.log          = kEmptyLog;
+		data.debug_log    = kEmptyLog;
+		data.spv_length   = header.SpvLength;
+		data.spv_data     = (uint32*)take(header.SpvLength, sizeof(uint8));
+		data.shader_stage = header.ShaderStage;
+
+		data.input.count  = header.InputCount;
+		data.input.items  = (GLSLCompiler::ShaderStage*)take(header.InputCount, sizeof(GLSLCompiler::ShaderStage));
+		data.output.count = header.OutputCount;
+		data.output.items = (GLSLCompiler::ShaderStage*)take(header.OutputCount, sizeof(GLSLCompiler::ShaderStage));
+
+		for (uint32 descType = 0; descType < GLSLCompiler::NumDescriptorType; descType++)
+		{
+			data.resource[descType].count = header.ResourceCounts[descType];
+			data.resource[descType].items = (GLSLCompiler::ShaderResource*)take(header.ResourceCounts[descType], sizeof(GLSLCompiler::ShaderResource));
+		}
+
+		return true;
+	}
+
+	void AppendBytes(std::vector<uint8>& OutBlob, const void* InData, usize InSize)
+	{
+		if (InSize > 0)
+			OutBlob.insert(OutBlob.end(), (const uint8*)InData, (const uint8*)InData + InSize);
+	}
+}
+
+ShaderCache::ShaderCache(const string& InDirectory, uint64 InMaxBytes) :
+	m_directory     (InDirectory),
+	m_maxBytes      (InMaxBytes),
+	m_bScanned      (false),
+	m_totalBytes    (_count_0),
+	m_hitCount      (_count_0),
+	m_missCount     (_count_0),
+	m_storeCount    (_count_0),
+	m_evictionCount (_count_0)
+{}
+
+ShaderCache& ShaderCache::Get()
+{
+	static ShaderCache s_cache(PathParser::Parse(RenderBaseConfig::Shader::CacheDirectory), RenderBaseConfig::Shader::CacheMaxBytes);
+
+	return s_cache;
+}
+
+uint64 ShaderCache::ComputeKey(VkShaderStageFlags InStage, const Path& InShaderPath, const GLSLCompiler::CompileInfo& InCompileInfo) const
+{
+	uint64 hash = Math::kFnvOffset;
+
+	hash = Math::HashBytes(&kEntryVersion, sizeof(kEntryVersion), hash);
+	hash = Math::HashBytes(&InStage, sizeof(InStage), hash);
+	hash = Math::HashBytes(&InCompileInfo.shader_type, sizeof(InCompileInfo.shader_type), hash);
+	hash = HashString(hash, InCompileInfo.entrypoint != nullptr ? InCompileInfo.entrypoint : _str_null);
+
+	std::vector<string> includeDirs;
+	for (uint32 i = 0; i < InCompileInfo.includes_count; i++)
+		includeDirs.push_back(InCompileInfo.includes[i]);
+
+	std::unordered_set<string> visited;
+	if (!HashSource(InShaderPath.ToString(), includeDirs, visited, hash))
+		return 0;
+
+	// 0 means not cached.
+	return hash != 0 ? hash : 1;
+}
+
+bool ShaderCache::Load(uint64 InKey, ShaderCacheEntry& OutEntry)
+{
+	ScanDirectory();
+
+	const string path = GetEntryPath(InKey);
+
+	// A torn or foreign file is a miss, the next Store() replaces it.
+	if (!ReadFile(path, OutEntry.Blob) || !ParseEntry(InKey, OutEntry))
+	{
+		OutEntry.Blob.clear();
+		m_missCount++;
+		return false;
+	}
+
+	// Recently used entries are the last to be evicted.
+	std::error_code error;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+	m_hitCount++;
+	return true;
+}
+
+void ShaderCache::Store(uint64 InKey, const GLSLCompiler::SPVData& InData)
+{
+	if (!InData.result || InKey == 0)
+		return;
+
+	ScanDirectory();
+
+	EntryHeader header = {};
+	header.Magic       = kEntryMagic;
+	header.Version     = kEntryVersion;
+	header.Key         = InKey;
+	header.ShaderStage = InData.shader_stage;
+	header.SpvLength   = InData.spv_length;
+	header.InputCount  = InData.input.count;
+	header.OutputCount = InData.output.count;
+
+	for (uint32 descType = 0; descType < GLSLCompiler::NumDescriptorType; descType++)
+		header.ResourceCounts[descType] = InData.resource[descType].count;
+
+	std::vector<uint8> blob;
+	AppendBytes(blob, &header, sizeof(EntryHeader));
+	AppendBytes(blob, InData.spv_data, InData.spv_length);
+	AppendBytes(blob, InData.input.items, InData.input.count * sizeof(GLSLCompiler::ShaderStage));
+	AppendBytes(blob, InData.output.items, InData.output.count * sizeof(GLSLCompiler::ShaderStage));
+
+	for (uint32 descType = 0; descType < GLSLCompiler::NumDescriptorType; descType++)
+		AppendBytes(blob, InData.resource[descType].items, InData.resource[descType].count * sizeof(GLSLCompiler::ShaderResource));
+
+	// Written aside and renamed, a reader never sees half an entry and two
+	// threads storing the same key do not interleave.
+	const string path     = GetEntryPath(InKey);
+	const string tempPath = StringUtil::Printf("%.%.tmp", path, std::hash<std::thread::id>()(std::this_thread::get_id()));
+
+	if (!WriteFile(tempPath, blob))
+	{
+		_log_warning(StringUtil::Printf("%: writing \"%\" failed!", _name_of(ShaderCache), tempPath), LogSystem::Category::GLSLCompiler);
+		return;
+	}
+
+	std::error_code error;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	const uint64 replacedBytes = std::filesystem::exists(path, error) ? (uint64)std::filesystem::file_size(path, error) : _count_0;
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		return;
+	}
+
+	m_totalBytes = m_totalBytes + blob.size() - std::min(replacedBytes, m_totalBytes + blob.size());
+	m_storeCount++;
+
+	if (m_totalBytes > m_maxBytes)
+		Evict();
+}
+
+ShaderCache::Stats ShaderCache::GetStats() const
+{
+	Stats stats;
+	stats.HitCount      = m_hitCount.load();
+	stats.MissCount     = m_missCount.load();
+	stats.StoreCount    = m_storeCount.load();
+	stats.EvictionCount = m_evictionCount.load();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	stats.TotalBytes    = m_totalBytes;
+
+	return stats;
+}
+
+string ShaderCache::GetEntryPath(uint64 InKey) const
+{
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)InKey);
+
+	return m_directory + "/" + name + kEntryExt;
+}
+
+void ShaderCache::ScanDirectory()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_bScanned)
+		return;
+
+	m_bScanned = true;
+
+	std::error_code error;
+	std::filesystem::create_directories(m_directory, error);
+
+	for (auto& file : std::filesystem::directory_iterator(m_directory, error))
+	{
+		if (file.is_regular_file(error) && file.path().extension() == kEntryExt)
+			m_totalBytes += file.file_size(error);
+	}
+
+	if (m_totalBytes > m_maxBytes)
+		Evict();
+}
+
+void ShaderCache::Evict()
+{
+	struct EntryFile
+	{
+		std::filesystem::file_time_type Time;
+		uint64                          Size;
+		std::filesystem::path           Path;
+	};
+
+	std::vector<EntryFile> files;
+	std::error_code        error;
+
+	// The directory is the truth, other processes may share it.
+	m_totalBytes = _count_0;
+
+	for (auto& file : std::filesystem::directory_iterator(m_directory, error))
+	{
+		if (!file.is_regular_file(error) || file.path().extension() != kEntryExt)
+			continue;
+
+		files.push_back({ file.last_write_time(error), file.file_size(error), file.path() });
+		m_totalBytes += files.back().Size;
+	}
+
+	std::sort(files.begin(), files.end(), [](const EntryFile& InA, const EntryFile& InB) { return InA.Time < InB.Time; });
+
+	for (auto& file : files)
+	{
+		if (m_totalBytes <= m_maxBytes)
+			break;
+
+		if (std::filesystem::remove(file.Path, error))
+		{
+			m_totalBytes -= file.Size;
+			m_evictionCount++;
+		}
+	}
+}
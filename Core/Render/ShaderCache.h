@@ -0,0 +1,103 @@
+﻿/*********************************************************************
+ *  ShaderCache.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  On-disk cache of compiled SPIR-V and its reflection.
+ *********************************************************************/
+
+#pragma once
+
+#include "GLSLCompiler.h"
+#include <atomic>
+#include <mutex>
+
+/**
+ *  SPVData of a cache hit, its arrays point into Blob.
+ */
+struct ShaderCacheEntry
+{
+	GLSLCompiler::SPVData Data;
+	std::vector<uint8>    Blob;
+};
+
+/**
+ *  An entry is found by a hash of everything the compiler output depends
+ *  on: the source text, the text of every include it pulls in, the entry
+ *  point, the shader type and the stage. It holds the SPIR-V and the
+ *  reflection CheckAndParseSPVData() reads, a hit never goes through the
+ *  compiler DLL. Entries are one file each, a hit refreshes the file time
+ *  and the oldest files go once the directory is over the size cap.
+ */
+class ShaderCache
+{
+
+public:
+
+	struct Stats
+	{
+		uint64 HitCount;
+		uint64 MissCount;
+		uint64 StoreCount;
+		uint64 EvictionCount;
+		uint64 TotalBytes;      ///< Size of the entries on disk.
+	};
+
+	/**
+	 *  @param  InDirectory  where the entry files live, created if missing.
+	 *  @param  InMaxBytes   size cap of the directory.
+	 */
+	ShaderCache(const string& InDirectory, uint64 InMaxBytes);
+
+	ShaderCache(const ShaderCache&) = delete;
+	ShaderCache& operator=(const ShaderCache&) = delete;
+
+	/**
+	 *  @return the cache shared by every GLSLCompiler, set up with RenderBaseConfig::Shader.
+	 */
+	static ShaderCache& Get();
+
+	/**
+	 *  Hash the inputs of a compile, includes are resolved next to the including
+	 *  file first, then in the include directories of InCompileInfo.
+	 * 
+	 *  @return 0 if the source can not be read, nothing is cached for it.
+	 */
+	uint64 ComputeKey(VkShaderStageFlags InStage, const Path& InShaderPath, const GLSLCompiler::CompileInfo& InCompileInfo) const;
+
+	/**
+	 *  @return true on a hit, counts a miss otherwise.
+	 */
+	bool Load(uint64 InKey, ShaderCacheEntry& OutEntry);
+
+	/**
+	 *  Write a successful compile, evicting the oldest entries if the cap is passed.
+	 */
+	void Store(uint64 InKey, const GLSLCompiler::SPVData& InData);
+
+	Stats GetStats() const;
+
+private:
+
+	string GetEntryPath(uint64 InKey) const;
+
+	/**
+	 *  Sum the entry sizes once, the first time the directory is touched.
+	 */
+	void ScanDirectory();
+
+	void Evict();
+
+private:
+
+	string                m_directory;
+	uint64                m_maxBytes;
+
+	mutable std::mutex    m_mutex;           ///< Guards the directory scan, eviction and m_totalBytes.
+	bool                  m_bScanned;
+	uint64                m_totalBytes;
+
+	std::atomic<uint64>   m_hitCount;
+	std::atomic<uint64>   m_missCount;
+	std::atomic<uint64>   m_storeCount;
+	std::atomic<uint64>   m_evictionCount;
+};
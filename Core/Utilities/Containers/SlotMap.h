@@ -0,0 +1,201 @@
+﻿/*********************************************************************
+ *  SlotMap.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Dense storage addressed by generational handles.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Base/BaseType.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**
+ *  Slot index and generation of an element. The generation of a slot changes
+ *  every time its element is removed, a handle to a removed element never
+ *  finds the element that reuses the slot. Generations start at 1, a zero
+ *  handle is null.
+ */
+template<typename T>
+struct SlotHandle
+{
+    uint32 Index      = 0;
+    uint32 Generation = 0;
+
+    bool IsNull() const
+    {
+        return Generation == 0;
+    }
+
+    bool operator==(const SlotHandle& other) const
+    {
+        return Index == other.Index && Generation == other.Generation;
+    }
+
+    bool operator!=(const SlotHandle& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/**
+ *  Elements live in one dense array, a removal moves the last element into
+ *  the hole. Insert, Get and Remove are O(1) and nothing is allocated per
+ *  element. Iteration walks the dense array, in insertion order as long as
+ *  nothing was removed. Pointers from Get() are valid until the next Insert()
+ *  or Remove(). TAllocator is rebound for the three arrays.
+ */
+template<typename T, template<typename> class TAllocator = std::allocator>
+class SlotMap
+{
+public:
+
+    using Handle = SlotHandle<T>;
+
+    SlotMap() :
+        m_freeHead(kNoSlot)
+    {}
+
+public:
+
+    Handle Insert(T InValue)
+    {
+        uint32 slotIndex;
+
+        if (m_freeHead != kNoSlot)
+        {
+            slotIndex  = m_freeHead;
+            m_freeHead = m_slots[slotIndex].DenseIndex;
+        }
+        else
+        {
+            slotIndex = (uint32)m_slots.size();
+            m_slots.push_back({ kNoSlot, 1 });
+        }
+
+        Slot& slot = m_slots[slotIndex];
+        slot.DenseIndex = (uint32)m_values.size();
+
+        m_values.push_back(std::move(InValue));
+        m_denseToSlot.push_back(slotIndex);
+
+        return { slotIndex, slot.Generation };
+    }
+
+    /**
+     *  @return the element, nullptr if the handle is null or stale.
+     */
+    T* Get(Handle InHandle)
+    {
+        return Contains(InHandle) ? &m_values[m_slots[InHandle.Index].DenseIndex] : nullptr;
+    }
+
+    const T* Get(Handle InHandle) const
+    {
+        return Contains(InHandle) ? &m_values[m_slots[InHandle.Index].DenseIndex] : nullptr;
+    }
+
+    bool Contains(Handle InHandle) const
+    {
+        return InHandle.Index < m_slots.size() && m_slots[InHandle.Index].Generation == InHandle.Generation && !InHandle.IsNull();
+    }
+
+    /**
+     *  @return false if the handle is null or stale.
+     */
+    bool Remove(Handle InHandle)
+    {
+        if (!Contains(InHandle))
+            return false;
+
+        Slot& slot = m_slots[InHandle.Index];
+
+        const uint32 denseIndex = slot.DenseIndex;
+        const uint32 lastIndex  = (uint32)m_values.size() - 1;
+
+        if (denseIndex != lastIndex)
+        {
+            m_values[denseIndex]      = std::move(m_values[lastIndex]);
+            m_denseToSlot[denseIndex] = m_denseToSlot[lastIndex];
+
+            m_slots[m_denseToSlot[denseIndex]].DenseIndex = denseIndex;
+        }
+
+        m_values.pop_back();
+        m_denseToSlot.pop_back();
+
+        // Skip 0 on wrap around, it marks null handles.
+        if (++slot.Generation == 0)
+            slot.Generation = 1;
+
+        slot.DenseIndex = m_freeHead;
+        m_freeHead      = InHandle.Index;
+
+        return true;
+    }
+
+    /**
+     *  @return handle of the element at InDenseIndex, for removals while iterating.
+     */
+    Handle GetHandle(uint32 InDenseIndex) const
+    {
+        const uint32 slotIndex = m_denseToSlot[InDenseIndex];
+
+        return { slotIndex, m_slots[slotIndex].Generation };
+    }
+
+    void Reserve(uint32 InCount)
+    {
+        m_values.reserve(InCount);
+        m_denseToSlot.reserve(InCount);
+        m_slots.reserve(InCount);
+    }
+
+    /**
+     *  Remove every element, handles given out before all become stale.
+     */
+    void Clear()
+    {
+        while (!m_values.empty())
+            Remove(GetHandle((uint32)m_values.size() - 1));
+    }
+
+    uint32 Size() const
+    {
+        return (uint32)m_values.size();
+    }
+
+    bool IsEmpty() const
+    {
+        return m_values.empty();
+    }
+
+public:
+
+    T& operator[](uint32 InDenseIndex)
+    {
+        return m_values[InDenseIndex];
+    }
+
+    typename std::vector<T, TAllocator<T>>::iterator       begin()       { return m_values.begin(); }
+    typename std::vector<T, TAllocator<T>>::iterator       end()         { return m_values.end();   }
+    typename std::vector<T, TAllocator<T>>::const_iterator begin() const { return m_values.begin(); }
+    typename std::vector<T, TAllocator<T>>::const_iterator end()   const { return m_values.end();   }
+
+private:
+
+    static const uint32 kNoSlot = 0xFFFFFFFFu;
+
+    struct Slot
+    {
+        uint32 DenseIndex;   ///< Next free slot while the slot is free.
+        uint32 Generation;
+    };
+
+    std::vector<T, TAllocator<T>>           m_values;
+    std::vector<uint32, TAllocator<uint32>> m_denseToSlot;
+    std::vector<Slot, TAllocator<Slot>>     m_slots;
+    uint32                                  m_freeHead;
+};
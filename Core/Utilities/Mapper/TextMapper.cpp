@@ -102,6 +102,7 @@ string TextMapper::Map[usize(TextMapper::ID::RANGE_SIZE)] =
 	"renderpass",
 	"subpass",
 	"base_pipeline",
+	"variable_specialization_constants",
 
 	// End graphic_pipeline_infos.
 
@@ -111,6 +111,7 @@ public:
 		vk_renderpass,
 		vk_subpass,
 		vk_base_pipeline,
+		vk_variable_specialization_constants,
 
 		// End graphic_pipeline_infos.
 
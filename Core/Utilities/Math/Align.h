@@ -0,0 +1,28 @@
+﻿/*********************************************************************
+ *  Align.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Alignment of sizes and offsets.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Base/BaseType.h"
+#include <type_traits>
+
+namespace Math
+{
+	/**
+	 *  Round a size or offset up to a multiple of an alignment.
+	 * 
+	 *  @param  InValue      the size or offset to round up.
+	 *  @param  InAlignment  a power of two, taken in the type of InValue.
+	 * 
+	 *  @return the smallest multiple of InAlignment not below InValue.
+	 */
+	template<typename T>
+	inline T AlignUp(T InValue, typename std::common_type<T>::type InAlignment)
+	{
+		return (InValue + (InAlignment - 1)) & ~(T)(InAlignment - 1);
+	}
+}
@@ -0,0 +1,46 @@
+﻿/*********************************************************************
+ *  Hash.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  FNV-1a hashing of bytes and text.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/Base/BaseType.h"
+
+namespace Math
+{
+	const uint64 kFnvOffset = 14695981039346656037ull;
+	const uint64 kFnvPrime  = 1099511628211ull;
+
+	/**
+	 *  Fold bytes into a running FNV-1a hash.
+	 * 
+	 *  @param  InData  the bytes to hash.
+	 *  @param  InSize  byte count.
+	 *  @param  InHash  the hash so far, kFnvOffset to start a new one.
+	 * 
+	 *  @return the hash with InData folded in.
+	 */
+	inline uint64 HashBytes(const void* InData, usize InSize, uint64 InHash = kFnvOffset)
+	{
+		const uint8* pBytes = static_cast<const uint8*>(InData);
+
+		for (usize i = 0; i < InSize; ++i)
+		{
+			InHash ^= pBytes[i];
+			InHash *= kFnvPrime;
+		}
+
+		return InHash;
+	}
+
+	/**
+	 *  The characters of InText, the terminator left out.
+	 */
+	inline uint64 HashText(const string& InText, uint64 InHash = kFnvOffset)
+	{
+		return HashBytes(InText.data(), InText.size(), InHash);
+	}
+}
@@ -29,3 +29,27 @@ bool JsonParser::Parse(const string& InPath, Json::Value& OutRoot)
 		return false;
 	}
 }
+
+bool JsonParser::ParseText(const string& InText, Json::Value& OutRoot)
+{
+	Json::CharReaderBuilder builder;
+	JSONCPP_STRING errs;
+
+	std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+
+	if (!reader->parse(InText.data(), InText.data() + InText.size(), &OutRoot, &errs))
+	{
+		_log_error(errs, LogSystem::Category::JsonParser);
+		return false;
+	}
+
+	return true;
+}
+
+string JsonParser::WriteText(const Json::Value& InValue)
+{
+	Json::StreamWriterBuilder builder;
+	builder["indentation"] = "";
+
+	return Json::writeString(builder, InValue);
+}
@@ -32,6 +32,25 @@ public:
 	 */
 	static bool Parse(const string& InPath, Json::Value& OutRoot);
 
+	/**
+	 *  Parse json text already read from a file.
+	 * 
+	 *  @param  InText   the json text.
+	 *  @param  OutRoot  output json root object.
+	 * 
+	 *  @return true if success, otherwise false.
+	 */
+	static bool ParseText(const string& InText, Json::Value& OutRoot);
+
+	/**
+	 *  Write a json object as text without indentation, ParseText() reads it back.
+	 * 
+	 *  @param  InValue  json object to write.
+	 * 
+	 *  @return the json text.
+	 */
+	static string WriteText(const Json::Value& InValue);
+
 	/**
 	 *  Resolve data of type int32 from json object with caution.
 	 * 
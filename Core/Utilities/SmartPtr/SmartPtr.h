@@ -2,7 +2,7 @@
  *  SmartPtr.h
  *  Copyright (C) 2020 Jayou. All Rights Reserved.
  * 
- *  .
+ *  Intrusive reference counted pointer.
  *********************************************************************/
 
 #pragma once
@@ -10,114 +10,225 @@
 #pragma region SmartPtr
 
 #include "Core/TypeDef.h"
+#include <atomic>
+#include <type_traits>
+#include <utility>
+
+/**
+ *  Reference count shared across threads.
+ */
+struct AtomicRefCount
+{
+	using Type = std::atomic<uint32>;
 
-template<typename T>
-class Counter;
+	static void Increment(Type& InCount)
+	{
+		InCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/**
+	 *  @return true if the last reference is gone.
+	 */
+	static bool Decrement(Type& InCount)
+	{
+		// Release orders the writes of this owner, acquire lets the deleting owner see the others.
+		return InCount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+	static uint32 Load(const Type& InCount)
+	{
+		return InCount.load(std::memory_order_relaxed);
+	}
+};
+
+/**
+ *  Plain reference count for objects that never leave their thread.
+ */
+struct SingleThreadRefCount
+{
+	using Type = uint32;
+
+	static void Increment(Type& InCount)
+	{
+		++InCount;
+	}
+
+	static bool Decrement(Type& InCount)
+	{
+		return --InCount == 0;
+	}
+
+	static uint32 Load(const Type& InCount)
+	{
+		return InCount;
+	}
+};
+
+/**
+ *  Base of the objects held by SmartPtr, the count lives in the object so
+ *  sharing it never allocates. The object deletes itself with the last
+ *  reference, as the derived type, no virtual destructor needed.
+ */
+template<typename TDerived, typename TPolicy = AtomicRefCount>
+class RefCounted
+{
+
+public:
+
+	void AddRef() const
+	{
+		TPolicy::Increment(m_refCount);
+	}
+
+	void Release() const
+	{
+		if (TPolicy::Decrement(m_refCount))
+			delete static_cast<const TDerived*>(this);
+	}
+
+	uint32 GetRefCount() const
+	{
+		return TPolicy::Load(m_refCount);
+	}
+
+protected:
+
+	RefCounted() : m_refCount(0) {}
+
+	// A copy is a new object, it starts without references.
+	RefCounted(const RefCounted&) : m_refCount(0) {}
+
+	RefCounted& operator=(const RefCounted&) { return *this; }
 
+	~RefCounted() = default;
+
+private:
+
+	mutable typename TPolicy::Type m_refCount;
+};
+
+/**
+ *  T provides AddRef() and Release(), usually through RefCounted. A null
+ *  pointer owns nothing and moves only hand the reference over.
+ */
 template<typename T>
 class SmartPtr
 {
 
 protected:
 
-	Counter<T>* m_counter;
+	T* m_object;
+
+	template<typename U>
+	friend class SmartPtr;
 
 public:
 
-	SmartPtr()
+	SmartPtr() : m_object(nullptr) {}
+
+	SmartPtr(std::nullptr_t) : m_object(nullptr) {}
+
+	SmartPtr(T* ptr) : m_object(ptr)
 	{
-		m_counter = new Counter<T>(nullptr);
+		if (m_object != nullptr)
+			m_object->AddRef();
 	}
 
-	SmartPtr(T *ptr)
+	SmartPtr(const SmartPtr& other) : m_object(other.m_object)
 	{
-		m_counter = new Counter<T>(ptr);
+		if (m_object != nullptr)
+			m_object->AddRef();
 	}
 
-	SmartPtr(const SmartPtr &other)
+	SmartPtr(SmartPtr&& other) noexcept : m_object(other.m_object)
 	{
-		m_counter = other.m_counter;
-		m_counter->m_count++;
+		other.m_object = nullptr;
 	}
 
-	SmartPtr &operator=(const SmartPtr &other)
+	template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+	SmartPtr(const SmartPtr<U>& other) : m_object(other.m_object)
 	{
-		if (this == &other)
-			return *this;
+		if (m_object != nullptr)
+			m_object->AddRef();
+	}
 
-		m_counter->m_count--;
-		if (m_counter->m_count == 0)
-			delete m_counter;
+	template<typename U, typename = typename std::enable_if<std::is_convertible<U*, T*>::value>::type>
+	SmartPtr(SmartPtr<U>&& other) noexcept : m_object(other.m_object)
+	{
+		other.m_object = nullptr;
+	}
 
-		m_counter = other.m_counter;
-		other.m_counter->m_count++;
+	~SmartPtr()
+	{
+		if (m_object != nullptr)
+			m_object->Release();
+	}
 
+	SmartPtr& operator=(const SmartPtr& other)
+	{
+		SmartPtr(other).Swap(*this);
 		return *this;
 	}
 
-	virtual ~SmartPtr()
+	SmartPtr& operator=(SmartPtr&& other) noexcept
 	{
-		m_counter->m_count--;
-		if (m_counter->m_count == 0)
-			delete m_counter;
+		SmartPtr(std::move(other)).Swap(*this);
+		return *this;
 	}
 
-public:
-
-	operator T*()
+	SmartPtr& operator=(T* other)
 	{
-		return m_counter->m_object;
+		SmartPtr(other).Swap(*this);
+		return *this;
 	}
 
-	T &operator*()
+	void Swap(SmartPtr& other) noexcept
 	{
-		return *(m_counter->m_object);
+		std::swap(m_object, other.m_object);
 	}
 
-	T* operator->() const throw() // no exception
+	void Reset()
 	{
-		return m_counter->m_object;
+		SmartPtr().Swap(*this);
 	}
 
-	T** operator&()
+public:
+
+	T* Get() const
 	{
-		return &m_counter->m_object;
+		return m_object;
 	}
 
-	bool operator!=(const T* other_ptr) const
+	operator T*() const
 	{
-		return m_counter->m_object != other_ptr;
+		return m_object;
 	}
 
-	bool operator==(const T* other_ptr) const
+	T& operator*() const
 	{
-		return m_counter->m_object == other_ptr;
+		return *m_object;
 	}
-};
-
-template<typename T>
-class Counter
-{
-private:
-	T*     m_object;
-	uint64 m_count;
 
-	template<typename T>
-	friend class SmartPtr;
+	T* operator->() const
+	{
+		return m_object;
+	}
 
-	Counter(T *ptr)
+	bool operator!=(const T* other_ptr) const
 	{
-		m_object = ptr;
-		m_count  = 1;
+		return m_object != other_ptr;
 	}
 
-	~Counter()
+	bool operator==(const T* other_ptr) const
 	{
-		if (m_object != nullptr)
-		{
-			delete m_object;
-		}		
+		return m_object == other_ptr;
 	}
 };
 
-#pragma endregion
\ No newline at end of file
+template<typename T, typename... TArgs>
+inline SmartPtr<T> MakeSmart(TArgs&&... InArgs)
+{
+	return SmartPtr<T>(new T(std::forward<TArgs>(InArgs)...));
+}
+
+#pragma endregion
@@ -7,70 +7,152 @@
 
 #include "VkSmartPtr.h"
 #include "Core/Base/BaseAllocator.h"
+#include "Core/Base/BaseConfig.h"
 
-namespace
+SmartPtr<VkDeviceContext> VkDeviceContext::CreateInstanceContext(VkInstance InInstance, BaseAllocator* InAllocator)
 {
-	VkInstance        g_instance     = VK_NULL_HANDLE;
-	VkDevice          g_device       = VK_NULL_HANDLE;
-	BaseAllocator*    g_allocator    = nullptr;
-	int32             g_instanceRefs = 0;
+	return SmartPtr<VkDeviceContext>(new VkDeviceContext(nullptr, InInstance, VK_NULL_HANDLE, InAllocator));
 }
 
-void VkSmartPtr_Private::IncInstanceRef()
+SmartPtr<VkDeviceContext> VkDeviceContext::CreateDeviceContext(VkDeviceContext* InInstanceContext, VkDevice InDevice)
 {
-	g_instanceRefs++;
-}
+	if (InInstanceContext == nullptr)
+		return SmartPtr<VkDeviceContext>(new VkDeviceContext(nullptr, VK_NULL_HANDLE, InDevice, nullptr));
 
-void VkSmartPtr_Private::DecInstanceRef()
-{
-	g_instanceRefs--;
+	return SmartPtr<VkDeviceContext>(new VkDeviceContext(InInstanceContext, InInstanceContext->m_instance, InDevice, InInstanceContext->m_pAllocator));
 }
 
-bool VkSmartPtr_Private::IsInstanceRefZero()
+VkDeviceContext::VkDeviceContext(VkDeviceContext* InInstanceContext, VkInstance InInstance, VkDevice InDevice, BaseAllocator* InAllocator) :
+	m_pInstanceContext (InInstanceContext),
+	m_instance         (InInstance),
+	m_device           (InDevice),
+	m_pAllocator       (InAllocator),
+	m_destroyBuckets   (BaseConfig::DefaultSwapchainCreateInfo.frameCount),   // One bucket per frame resource of the swapchain.
+	m_currentBucket    (_count_0),
+	m_pendingCount     (_count_0),
+	m_lastFence        (VK_NULL_HANDLE)
 {
-	return g_instanceRefs == 0;
+	for (auto& bucket : m_destroyBuckets)
+		bucket.Fence = VK_NULL_HANDLE;
 }
 
-void VkSmartPtr_Private::SafeFreeAllocator()
+VkDeviceContext::~VkDeviceContext()
 {
-	if (g_allocator != nullptr)
+	DestroyAll();
+
+#ifndef VK_MANUAL_DESTROY_OBJECT
+
+	// The instance context outlives its devices, m_pInstanceContext goes after this.
+	if (m_device != VK_NULL_HANDLE)
+		vkDestroyDevice(m_device, GetVkAllocator());
+	else if (m_pInstanceContext == nullptr && m_instance != VK_NULL_HANDLE)
+		vkDestroyInstance(m_instance, GetVkAllocator());
+
+#endif // VK_MANUAL_DESTROY_OBJECT
+
+	if (m_pInstanceContext == nullptr && m_pAllocator != nullptr)
 	{
-		delete g_allocator;
-		g_allocator = nullptr;
+		delete m_pAllocator;
+		m_pAllocator = nullptr;
 	}
 }
 
-void VkSmartPtr_Private::SetVkInstance(const VkInstance& InInstance)
+VkInstance VkDeviceContext::GetVkInstance() const
 {
-	g_instance = InInstance;
+	return m_instance;
 }
 
-void VkSmartPtr_Private::SetVkDevice(const VkDevice& InDevice)
+VkDevice VkDeviceContext::GetVkDevice() const
 {
-	g_device = InDevice;
+	return m_device;
 }
 
-void VkSmartPtr_Private::SetBaseAllocator(BaseAllocator* InAllocator)
+BaseAllocator* VkDeviceContext::GetBaseAllocator() const
 {
-	g_allocator = InAllocator;
+	return m_pAllocator;
 }
 
-VkInstance VkSmartPtr_Private::GetVkInstance()
+VkAllocationCallbacks* VkDeviceContext::GetVkAllocator() const
 {
-	return g_instance;
+	return m_pAllocator != nullptr ? m_pAllocator->GetVkAllocator() : nullptr;
 }
 
-VkDevice VkSmartPtr_Private::GetVkDevice()
+void VkDeviceContext::NextFrame(VkFence InFence)
 {
-	return g_device;
+	std::vector<DestroyEntry> entries;
+	{
+		std::unique_lock<std::mutex> lock(m_destroyMutex);
+
+		// A frame without submissions waits for the work submitted before it.
+		if (InFence != VK_NULL_HANDLE)
+			m_lastFence = InFence;
+
+		m_destroyBuckets[m_currentBucket].Fence = m_lastFence;
+		m_currentBucket = (m_currentBucket + 1) % (uint32)m_destroyBuckets.size();
+
+		DestroyBucket& bucket = m_destroyBuckets[m_currentBucket];
+
+		// Fences signal in submission order, a bucket the GPU is not done with
+		// yet stays open and is covered by the fence of the current frame.
+		// Without any fence the GPU may still read anything, nothing goes.
+		if (bucket.Entries.empty() || bucket.Fence == VK_NULL_HANDLE || vkGetFenceStatus(m_device, bucket.Fence) != VK_SUCCESS)
+			return;
+
+		entries.swap(bucket.Entries);
+		bucket.Fence    = VK_NULL_HANDLE;
+		m_pendingCount -= (uint32)entries.size();
+	}
+
+	DestroyEntries(entries);
 }
 
-BaseAllocator* VkSmartPtr_Private::GetBaseAllocator()
+void VkDeviceContext::DestroyAll()
 {
-	return g_allocator;
+	std::vector<DestroyEntry> entries;
+	{
+		std::unique_lock<std::mutex> lock(m_destroyMutex);
+
+		if (m_pendingCount == 0)
+			return;
+
+		const uint32 bucketCount = (uint32)m_destroyBuckets.size();
+
+		// Oldest bucket first, objects go in the order they were released.
+		for (uint32 i = 1; i <= bucketCount; ++i)
+		{
+			DestroyBucket& bucket = m_destroyBuckets[(m_currentBucket + i) % bucketCount];
+
+			entries.insert(entries.end(), bucket.Entries.begin(), bucket.Entries.end());
+			bucket.Entries.clear();
+			bucket.Fence = VK_NULL_HANDLE;
+		}
+
+		m_pendingCount = _count_0;
+	}
+
+	if (m_device != VK_NULL_HANDLE)
+		vkDeviceWaitIdle(m_device);
+
+	DestroyEntries(entries);
+}
+
+uint32 VkDeviceContext::GetPendingDestroyCount() const
+{
+	std::unique_lock<std::mutex> lock(m_destroyMutex);
+
+	return m_pendingCount;
+}
+
+void VkDeviceContext::Push(VkObjectHandler InHandle, VkDestroyFunction InDestroy)
+{
+	std::unique_lock<std::mutex> lock(m_destroyMutex);
+
+	m_destroyBuckets[m_currentBucket].Entries.push_back({ InHandle, InDestroy });
+	++m_pendingCount;
 }
 
-VkAllocationCallbacks* VkSmartPtr_Private::GetVkAllocator()
+void VkDeviceContext::DestroyEntries(const std::vector<DestroyEntry>& InEntries) const
 {
-	return g_allocator != nullptr ? g_allocator->GetVkAllocator() : nullptr;
+	for (auto& entry : InEntries)
+		entry.Destroy(*this, entry.Handle);
 }
@@ -9,252 +9,425 @@
 #pragma once
 
 #include "../Log/LogSystem.h"
+#include "SmartPtr.h"
 #include "vulkan/vulkan.hpp"
+#include <mutex>
+#include <vector>
 
 #pragma region VkSmartPtr
 
 VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkObjectHandler)
 
+// On 32-bit targets every non-dispatchable handle is the same uint64_t, the traits below could not tell them apart.
+static_assert(sizeof(void*) == 8, "VkSmartPtr needs typed vulkan handles, build for a 64-bit target.");
+
+class BaseAllocator;
+class VkDeviceContext;
+
+/**
+ *  Destroys a handle of the type it was created as, through VkObjectHandler.
+ */
+using VkDestroyFunction = void(*)(const VkDeviceContext& InOwner, VkObjectHandler InHandle);
+
+/**
+ *  Specialized for every handle type VkSmartPtr can own, with the type Name
+ *  and a static Destroy(const VkDeviceContext&, VkObjectHandler). The destroy
+ *  function is picked when the handle is made, nothing is looked up when it goes away.
+ */
+template<typename T>
+struct VkHandleTraits;
+
 template<typename T>
 class VkCounter;
 
+/**
+ *  A handle taken out of its VkSmartPtr, for tables that keep many objects
+ *  without a counter each. It can only be moved, the object goes to the
+ *  destroy queue of its owner with Reset() or the destructor.
+ */
+class VkOwnedObject
+{
+
+public:
+
+	VkOwnedObject() : m_handle(VK_NULL_HANDLE), m_pfnDestroy(nullptr)
+	{
+
+	}
+
+	VkOwnedObject(VkOwnedObject&& other) noexcept :
+		m_pOwner     (std::move(other.m_pOwner)),
+		m_handle     (other.m_handle),
+		m_pfnDestroy (other.m_pfnDestroy)
+	{
+		other.m_handle = VK_NULL_HANDLE;
+	}
+
+	VkOwnedObject& operator=(VkOwnedObject&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+
+			m_pOwner       = std::move(other.m_pOwner);
+			m_handle       = other.m_handle;
+			m_pfnDestroy   = other.m_pfnDestroy;
+			other.m_handle = VK_NULL_HANDLE;
+		}
+
+		return *this;
+	}
+
+	VkOwnedObject(const VkOwnedObject&) = delete;
+	VkOwnedObject& operator=(const VkOwnedObject&) = delete;
+
+	~VkOwnedObject()
+	{
+		Reset();
+	}
+
+	void Reset();
+
+	VkObjectHandler Get() const
+	{
+		return m_handle;
+	}
+
+	VkDeviceContext* GetOwner() const
+	{
+		return m_pOwner;
+	}
+
+	bool IsValid() const
+	{
+		return m_handle != VK_NULL_HANDLE;
+	}
+
+private:
+
+	template<typename U>
+	friend class VkSmartPtr;
+
+	VkOwnedObject(VkDeviceContext* InOwner, VkObjectHandler InHandle, VkDestroyFunction InDestroy) :
+		m_pOwner     (InOwner),
+		m_handle     (InHandle),
+		m_pfnDestroy (InDestroy)
+	{
+
+	}
+
+private:
+
+	SmartPtr<VkDeviceContext> m_pOwner;
+	VkObjectHandler           m_handle;
+	VkDestroyFunction         m_pfnDestroy;
+};
+
 template<typename T>
 class VkSmartPtr
 {
 
 protected:
 
-	VkCounter<T>* m_counter;
+	SmartPtr<VkCounter<T>> m_counter;
+
+	template<typename U>
+	friend class VkSmartPtr;
+
+	VkSmartPtr(VkDeviceContext* InOwner, T InHandle, VkDestroyFunction InDestroy, const char* InTypeName) : m_counter(new VkCounter<T>(InOwner, InHandle, InDestroy, InTypeName))
+	{
+
+	}
 
 public: 
 
-	T* MakeInstance()
+	/**
+	 *  @param  InOwner  context of the device the handle is created on, the instance context for instance objects.
+	 * 
+	 *  @return storage for the vkCreate* call to write the new handle to, copies made before keep the previous one.
+	 */
+	T* MakeInstance(VkDeviceContext* InOwner)
 	{
-		m_counter->m_object    = new T;
-		*(m_counter->m_object) = VK_NULL_HANDLE;
+		m_counter = new VkCounter<T>(InOwner, VK_NULL_HANDLE, &VkHandleTraits<T>::Destroy, VkHandleTraits<T>::Name);
 
-		return m_counter->m_object;
+		return &m_counter->m_object;
 	}
 
 	bool IsValid() const
 	{
-		return m_counter != nullptr && m_counter->m_object != nullptr;
+		return m_counter != nullptr && m_counter->m_object != VK_NULL_HANDLE;
 	}
 
-public:
+	VkDeviceContext* GetOwner() const
+	{
+		return m_counter != nullptr ? m_counter->m_pOwner.Get() : nullptr;
+	}
 
-	VkSmartPtr(const char* type)
+	/**
+	 *  Hand the object over, this pointer and its copies keep the handle value but no longer destroy it.
+	 */
+	VkOwnedObject Detach()
 	{
-		m_counter = new VkCounter<T>(nullptr);
-		m_counter->m_type = type;
+		if (m_counter == nullptr || m_counter->m_bReleasedObjectOwnership)
+			return VkOwnedObject();
+
+		m_counter->m_bReleasedObjectOwnership = true;
+
+		return VkOwnedObject(m_counter->m_pOwner, (VkObjectHandler)m_counter->m_object, m_counter->m_pfnDestroy);
 	}
 
-	VkSmartPtr(const char* type, T* ptr)
+public:
+
+	// Nothing is allocated until MakeInstance().
+	VkSmartPtr()
 	{
-		m_counter = new VkCounter<T>(ptr);
-		m_counter->m_type = type;
+
 	}
 
-	VkSmartPtr(const VkSmartPtr &other)
+	VkSmartPtr(const VkSmartPtr &other) : m_counter(other.m_counter)
 	{
-		m_counter = other.m_counter;
-		m_counter->m_count++;
+
 	}
 
-	virtual ~VkSmartPtr()
+	// A moved-from pointer can only be assigned to or destroyed.
+	VkSmartPtr(VkSmartPtr&& other) noexcept : m_counter(std::move(other.m_counter))
 	{
-		m_counter->m_count--;
-		if (m_counter->m_count == 0)
-			delete m_counter;
+
 	}
 
 public:
 
 	operator VkSmartPtr<VkObjectHandler>()
 	{
+		if (m_counter == nullptr)
+			return VkSmartPtr<VkObjectHandler>();
+
 		m_counter->m_bReleasedObjectOwnership = true;
 
-		return VkSmartPtr<VkObjectHandler>(m_counter->m_type.data(), (VkObjectHandler*)m_counter->m_object);
+		return VkSmartPtr<VkObjectHandler>(m_counter->m_pOwner, (VkObjectHandler)m_counter->m_object, m_counter->m_pfnDestroy, m_counter->m_pTypeName);
 	}
 
 	operator T*()
 	{
-		return m_counter->m_object;
+		return m_counter != nullptr ? &m_counter->m_object : nullptr;
 	}
 
 	T &operator*()
 	{
-		return *(m_counter->m_object);
+		return m_counter->m_object;
 	}
 
 	T* operator->() const
 	{
-		return m_counter->m_object;
+		return &m_counter->m_object;
 	}
 
-	T** operator&()
+	VkSmartPtr& operator=(const VkSmartPtr& other)
 	{
-		return &m_counter->m_object;
+		m_counter = other.m_counter;
+		return *this;
 	}
 
-	bool operator!=(const T* other_ptr) const
+	VkSmartPtr& operator=(VkSmartPtr&& other) noexcept
 	{
-		return m_counter->m_object != other_ptr;
+		m_counter = std::move(other.m_counter);
+		return *this;
 	}
+};
+
+/**
+ *  Owner of the vulkan objects created on one VkDevice, or on the VkInstance
+ *  for a context without device. Every object keeps its context alive, the
+ *  device is destroyed with the last reference, after the objects still in
+ *  its destroy queue, and the instance after its last device. Creating and
+ *  releasing objects only touches atomics and the queue lock, any thread can
+ *  do it and each device of the process has its own context.
+ * 
+ *  Released objects wait in the destroy queue until the frames that may still
+ *  use them are done on the GPU. There is one bucket per frame in flight,
+ *  NextFrame() closes the current bucket with the fence of the frame and
+ *  moves to the next one. A bucket is destroyed when it comes round again and
+ *  its fence has signaled, releasing an object never waits for the device.
+ *  A bucket without a fence is never taken as done, before the first fence
+ *  objects stay until DestroyAll().
+ */
+class VkDeviceContext : public RefCounted<VkDeviceContext>
+{
+
+public:
+
+	/**
+	 *  @param  InAllocator  host allocator of the instance, deleted with the context.
+	 */
+	static SmartPtr<VkDeviceContext> CreateInstanceContext(VkInstance InInstance, BaseAllocator* InAllocator);
+
+	/**
+	 *  @param  InInstanceContext  context of the instance the device was created from.
+	 */
+	static SmartPtr<VkDeviceContext> CreateDeviceContext(VkDeviceContext* InInstanceContext, VkDevice InDevice);
+
+	VkInstance             GetVkInstance()    const;
+	VkDevice               GetVkDevice()      const;
+	BaseAllocator*         GetBaseAllocator() const;
+	VkAllocationCallbacks* GetVkAllocator()   const;
 
-	bool operator==(const T* other_ptr) const
+	/**
+	 *  Call once per frame, after the last submission of the frame.
+	 * 
+	 *  @param  InFence  fence signaled once every submission of the frame is done, VK_NULL_HANDLE keeps the last one given.
+	 */
+	void NextFrame(VkFence InFence);
+
+	/**
+	 *  Wait for the device to be idle and destroy every queued object.
+	 */
+	void DestroyAll();
+
+	uint32 GetPendingDestroyCount() const;
+
+private:
+
+	struct DestroyEntry
 	{
-		return m_counter->m_object == other_ptr;
-	}
+		VkObjectHandler            Handle;
+		VkDestroyFunction          Destroy;
+	};
 
-	VkSmartPtr& operator=(const VkSmartPtr& other)
+	struct DestroyBucket
 	{
-		if (this == &other)
-			return *this;
+		std::vector<DestroyEntry>  Entries;
+		VkFence                    Fence;   ///< Signaled once the frame that closed the bucket is done.
+	};
 
-		m_counter->m_count--;
-		if (m_counter->m_count == 0)
-			delete m_counter;
+	friend class RefCounted<VkDeviceContext>;
+	friend class VkOwnedObject;
+	template<typename T> friend class VkCounter;
 
-		m_counter = other.m_counter;
-		other.m_counter->m_count++;
+	VkDeviceContext(VkDeviceContext* InInstanceContext, VkInstance InInstance, VkDevice InDevice, BaseAllocator* InAllocator);
 
-		return *this;
-	}
+	~VkDeviceContext();
 
-	VkSmartPtr& operator=(T* other)
-	{
-		if (this->m_counter->m_object == other)
-			return *this;
+	void Push(VkObjectHandler InHandle, VkDestroyFunction InDestroy);
 
-		string type = m_counter->m_type;
-		m_counter->m_count--;
-		if (m_counter->m_count == 0)
-			delete m_counter;
+	void DestroyEntries(const std::vector<DestroyEntry>& InEntries) const;
 
-		m_counter = new VkCounter<T>(other);
-		m_counter->m_type = type;
+private:
 
-		return *this;
-	}
-};
+	SmartPtr<VkDeviceContext>      m_pInstanceContext;   ///< Null for the instance context itself.
+	VkInstance                     m_instance;
+	VkDevice                       m_device;
+	BaseAllocator*                 m_pAllocator;
 
-class BaseAllocator;
+	mutable std::mutex             m_destroyMutex;
+	std::vector<DestroyBucket>     m_destroyBuckets;
+	uint32                         m_currentBucket;
+	uint32                         m_pendingCount;
+	VkFence                        m_lastFence;
+};
 
-class VkSmartPtr_Private
+inline void VkOwnedObject::Reset()
 {
 
-private:
+#ifndef VK_MANUAL_DESTROY_OBJECT
 
-	template<typename T> friend class VkCounter;
-	friend class BaseLayer;
+	if (m_handle != VK_NULL_HANDLE && m_pOwner != nullptr)
+		m_pOwner->Push(m_handle, m_pfnDestroy);
 
-	static void IncInstanceRef();
-	static void DecInstanceRef();
-	static bool IsInstanceRefZero();
+#endif // VK_MANUAL_DESTROY_OBJECT
 
-	static void SafeFreeAllocator();
+	m_handle = VK_NULL_HANDLE;
+	m_pOwner.Reset();
+}
 
-	static void SetVkInstance    (const VkInstance& InInstance);
-	static void SetVkDevice      (const VkDevice& InDevice);
-	static void SetBaseAllocator (BaseAllocator* nAllocator);
+#define _vk_device_handle_traits(object)                                                              \
+template<>                                                                                            \
+struct VkHandleTraits<Vk##object>                                                                     \
+{                                                                                                     \
+	static constexpr const char* Name = _name_of(Vk##object);                                         \
+                                                                                                      \
+	static void Destroy(const VkDeviceContext& InOwner, VkObjectHandler InHandle)                     \
+	{                                                                                                 \
+		vkDestroy##object(InOwner.GetVkDevice(), (Vk##object)InHandle, InOwner.GetVkAllocator());     \
+		_log_common("_vk_destroy: " + _str_name_of(Vk##object), LogSystem::Category::VkSmartPtr);     \
+	}                                                                                                 \
+}                                                                                                     \
+
+_vk_device_handle_traits(Fence);
+_vk_device_handle_traits(Semaphore);
+_vk_device_handle_traits(Event);
+_vk_device_handle_traits(QueryPool);
+_vk_device_handle_traits(Buffer);
+_vk_device_handle_traits(BufferView);
+_vk_device_handle_traits(Image);
+_vk_device_handle_traits(ImageView);
+_vk_device_handle_traits(ShaderModule);
+_vk_device_handle_traits(PipelineCache);
+_vk_device_handle_traits(Pipeline);
+_vk_device_handle_traits(PipelineLayout);
+_vk_device_handle_traits(Sampler);
+_vk_device_handle_traits(DescriptorSetLayout);
+_vk_device_handle_traits(DescriptorPool);
+_vk_device_handle_traits(Framebuffer);
+_vk_device_handle_traits(RenderPass);
+_vk_device_handle_traits(CommandPool);
+
+// Using Semaphore...
+_vk_device_handle_traits(SwapchainKHR);
+
+// Using VkInstance...
+template<>
+struct VkHandleTraits<VkSurfaceKHR>
+{
+	static constexpr const char* Name = _name_of(VkSurfaceKHR);
 
-	static VkInstance             GetVkInstance();
-	static VkDevice               GetVkDevice();
-	static BaseAllocator*         GetBaseAllocator();
-	static VkAllocationCallbacks* GetVkAllocator();
+	static void Destroy(const VkDeviceContext& InOwner, VkObjectHandler InHandle)
+	{
+		vkDestroySurfaceKHR(InOwner.GetVkInstance(), (VkSurfaceKHR)InHandle, InOwner.GetVkAllocator());
+		_log_common("_vk_destroy: " + _str_name_of(VkSurfaceKHR), LogSystem::Category::VkSmartPtr);
+	}
 };
 
 template<typename T>
-class VkCounter
+class VkCounter : public RefCounted<VkCounter<T>>
 {
 private:
 
-	T*            m_object;
-	uint32        m_count;
-	string        m_type;
-	bool          m_bReleasedObjectOwnership;
+	SmartPtr<VkDeviceContext> m_pOwner;
+	T                         m_object;
+	VkDestroyFunction         m_pfnDestroy;
+	const char*               m_pTypeName;
+	bool                      m_bReleasedObjectOwnership;
 
-	template<typename T>
+	template<typename U>
 	friend class VkSmartPtr;
 
-	VkCounter(T *ptr)
+	friend class RefCounted<VkCounter<T>>;
+
+	VkCounter(VkDeviceContext* InOwner, T InHandle, VkDestroyFunction InDestroy, const char* InTypeName) :
+		m_pOwner                   (InOwner),
+		m_object                   (InHandle),
+		m_pfnDestroy               (InDestroy),
+		m_pTypeName                (InTypeName),
+		m_bReleasedObjectOwnership (false)
 	{
-		m_object = ptr;
-		m_count  = 1;
-		m_bReleasedObjectOwnership = false;
 
-		VkSmartPtr_Private::IncInstanceRef();
 	}
 
 	~VkCounter()
 	{
 
 #ifndef VK_MANUAL_DESTROY_OBJECT
-		
-#ifdef _vk_destroy
-#undef _vk_destroy
-#endif // _vk_destroy
-#define _vk_destroy(object)                                                                                                \
-{                                                                                                                          \
-	if (m_type == _name_of(Vk##object))                                                                                    \
-	{                                                                                                                      \
-		vkDestroy##object(VkSmartPtr_Private::GetVkDevice(), (Vk##object)*m_object, VkSmartPtr_Private::GetVkAllocator()); \
-		_log_common("_vk_destroy: " + _str_name_of(Vk##object), LogSystem::Category::VkSmartPtr);                          \
-	}                                                                                                                      \
-}                                                                                                                          \
-
-		if (m_object != nullptr && *m_object != NULL && !m_bReleasedObjectOwnership)
-		{
-			_vk_destroy(Fence);
-			_vk_destroy(Semaphore); // Should Wait for all reference Object freed...
-			_vk_destroy(Event);
-			_vk_destroy(QueryPool);
-			_vk_destroy(Buffer);
-			_vk_destroy(BufferView);
-			_vk_destroy(Image);
-			_vk_destroy(ImageView);
-			_vk_destroy(ShaderModule);
-			_vk_destroy(PipelineCache);
-			_vk_destroy(Pipeline);
-			_vk_destroy(PipelineLayout);
-			_vk_destroy(Sampler);
-			_vk_destroy(DescriptorSetLayout);
-			_vk_destroy(DescriptorPool);
-			_vk_destroy(Framebuffer);
-			_vk_destroy(RenderPass);
-			_vk_destroy(CommandPool);
-
-			// Using Semaphore...
-			_vk_destroy(SwapchainKHR);
-			
-			// Using VkInstance...
-			if (m_type == _name_of(VkSurfaceKHR))
-			{
-				vkDestroySurfaceKHR(VkSmartPtr_Private::GetVkInstance(), (VkSurfaceKHR)*m_object, VkSmartPtr_Private::GetVkAllocator());
-				_log_common("_vk_destroy: " + _str_name_of(VkSurfaceKHR), LogSystem::Category::VkSmartPtr);
-			}
-
-			VkSmartPtr_Private::DecInstanceRef();
-
-			if (VkSmartPtr_Private::IsInstanceRefZero())
-			{
-				vkDestroyDevice(VkSmartPtr_Private::GetVkDevice(), VkSmartPtr_Private::GetVkAllocator());
-				vkDestroyInstance(VkSmartPtr_Private::GetVkInstance(), VkSmartPtr_Private::GetVkAllocator());
-				VkSmartPtr_Private::SafeFreeAllocator();
-			}
-
-			delete m_object;
-		}
 
-#else
-		delete m_object;
+		// The GPU may still use the object, it goes once the frames in flight are done.
+		// Dropping m_pOwner afterwards may destroy the device, the queue is emptied first.
+		if (m_object != VK_NULL_HANDLE && !m_bReleasedObjectOwnership && m_pOwner != nullptr)
+			m_pOwner->Push((VkObjectHandler)m_object, m_pfnDestroy);
 
 #endif // VK_MANUAL_DESTROY_OBJECT
 	}
 };
 
-#define _declare_vk_smart_ptr(type, var)  VkSmartPtr<type> var = VkSmartPtr<type>(_name_of(type));
+#define _declare_vk_smart_ptr(type, var)  VkSmartPtr<type> var;
 
 template<typename T>
 inline VkSmartPtr<VkObjectHandler> VkCast(VkSmartPtr<T>& InObject)
@@ -0,0 +1,60 @@
+/*********************************************************************
+ *  NameTable.cpp
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ *********************************************************************/
+
+#include "NameTable.h"
+#include <mutex>
+#include <unordered_set>
+
+namespace
+{
+	const uint32 kShardCount = 16;
+
+	struct alignas(64) Shard
+	{
+		std::mutex                  Mutex;
+		std::unordered_set<string>  Names;    ///< Nodes never move, the addresses handed out stay valid.
+	};
+
+	Shard& GetShards(usize InHash)
+	{
+		// Built on first use, names are interned from static initializers too.
+		static Shard shards[kShardCount];
+		return shards[InHash % kShardCount];
+	}
+}
+
+const string* NameTable::Intern(const string& InName)
+{
+	Shard& shard = GetShards(std::hash<string>()(InName));
+
+	std::unique_lock<std::mutex> lock(shard.Mutex);
+
+	return &*shard.Names.insert(InName).first;
+}
+
+const string* NameTable::Find(const string& InName)
+{
+	Shard& shard = GetShards(std::hash<string>()(InName));
+
+	std::unique_lock<std::mutex> lock(shard.Mutex);
+
+	auto name = shard.Names.find(InName);
+	return name != shard.Names.end() ? &*name : nullptr;
+}
+
+uint32 NameTable::GetCount()
+{
+	uint32 count = _count_0;
+
+	for (uint32 shardIndex = 0; shardIndex < kShardCount; ++shardIndex)
+	{
+		Shard& shard = GetShards(shardIndex);
+
+		std::unique_lock<std::mutex> lock(shard.Mutex);
+		count += (uint32)shard.Names.size();
+	}
+
+	return count;
+}
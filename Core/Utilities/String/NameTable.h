@@ -0,0 +1,43 @@
+/*********************************************************************
+ *  NameTable.h
+ *  Copyright (C) 2022 Jayou. All Rights Reserved.
+ * 
+ *  Global table of interned names.
+ *********************************************************************/
+
+#pragma once
+
+#include "Core/TypeDef.h"
+
+/**
+ *  Every name is stored once and its address stays valid until exit, so
+ *  interned names compare and hash by pointer. The table is split in shards
+ *  by the hash of the name, threads interning different names rarely meet.
+ */
+class NameTable
+{
+public:
+
+	/**
+	 *  Add a name to the table if it is not there yet.
+	 * 
+	 *  @param  InName  the name to intern.
+	 * 
+	 *  @return the interned name.
+	 */
+	static const string* Intern(const string& InName);
+
+	/**
+	 *  Look a name up without adding it.
+	 * 
+	 *  @param  InName  the name to find.
+	 * 
+	 *  @return the interned name, nullptr if it was never interned.
+	 */
+	static const string* Find(const string& InName);
+
+	/**
+	 *  @return how many different names were interned.
+	 */
+	static uint32 GetCount();
+};
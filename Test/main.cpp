@@ -352,3 +352,2950 @@ int main() {
 #endif
 
 #pragma endregion
+
+#pragma region ArenaAllocator benchmark
+
+#if 0
+
+// Creates a few thousand samplers, descriptor sets and pipelines on a raw device,
+// once with null allocation callbacks and once with ArenaAllocator, and prints the timings.
+
+#include "Core/Base/ArenaAllocator.h"
+#include <chrono>
+
+static const uint32 kNumSamplers        = 2000;
+static const uint32 kNumDescriptorSets  = 4000;
+static const uint32 kNumPipelines       = 2000;
+
+static std::vector<uint32> LoadSpv(const char* InPath)
+{
+	std::ifstream file(InPath, std::ios::binary | std::ios::ate);
+	std::vector<uint32> code((usize)file.tellg() / sizeof(uint32));
+	file.seekg(0);
+	file.read((char*)code.data(), code.size() * sizeof(uint32));
+	return code;
+}
+
+static double RunBenchmark(VkPhysicalDevice InPD, uint32 InQFIndex, const VkAllocationCallbacks* InCallbacks, BaseAllocator* InAllocator)
+{
+	float priority = 1.0f;
+	VkDeviceQueueCreateInfo queueInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+	queueInfo.queueFamilyIndex = InQFIndex;
+	queueInfo.queueCount       = 1;
+	queueInfo.pQueuePriorities = &priority;
+
+	VkDeviceCreateInfo deviceInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+	deviceInfo.queueCreateInfoCount = 1;
+	deviceInfo.pQueueCreateInfos    = &queueInfo;
+
+	VkDevice device = VK_NULL_HANDLE;
+	vkCreateDevice(InPD, &deviceInfo, InCallbacks, &device);
+
+	auto begin = std::chrono::high_resolution_clock::now();
+
+	// Samplers.
+	std::vector<VkSampler> samplers(kNumSamplers);
+	for (uint32 i = 0; i < kNumSamplers; ++i)
+	{
+		VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+		samplerInfo.magFilter = samplerInfo.minFilter = (i & 1) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+		samplerInfo.maxLod    = (float)(i % 16);
+		vkCreateSampler(device, &samplerInfo, InCallbacks, &samplers[i]);
+	}
+
+	// Descriptor sets.
+	VkDescriptorSetLayoutBinding binding = { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_ALL, nullptr };
+	VkDescriptorSetLayoutCreateInfo dslInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+	dslInfo.bindingCount = 1;
+	dslInfo.pBindings    = &binding;
+
+	VkDescriptorSetLayout dsl = VK_NULL_HANDLE;
+	vkCreateDescriptorSetLayout(device, &dslInfo, InCallbacks, &dsl);
+
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, kNumDescriptorSets };
+	VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	poolInfo.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets       = kNumDescriptorSets;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes    = &poolSize;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	vkCreateDescriptorPool(device, &poolInfo, InCallbacks, &pool);
+
+	std::vector<VkDescriptorSet> sets(kNumDescriptorSets);
+	for (uint32 i = 0; i < kNumDescriptorSets; ++i)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool     = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts        = &dsl;
+		vkAllocateDescriptorSets(device, &allocInfo, &sets[i]);
+	}
+
+	// Pipelines.
+	std::vector<uint32> vertCode = LoadSpv("Core/Shaders/triangle.vert.spv");
+	std::vector<uint32> fragCode = LoadSpv("Core/Shaders/triangle.frag.spv");
+
+	VkShaderModule modules[2] = {};
+	VkShaderModuleCreateInfo moduleInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+	moduleInfo.codeSize = vertCode.size() * sizeof(uint32);
+	moduleInfo.pCode    = vertCode.data();
+	vkCreateShaderModule(device, &moduleInfo, InCallbacks, &modules[0]);
+	moduleInfo.codeSize = fragCode.size() * sizeof(uint32);
+	moduleInfo.pCode    = fragCode.data();
+	vkCreateShaderModule(device, &moduleInfo, InCallbacks, &modules[1]);
+
+	VkAttachmentDescription attachment = {};
+	attachment.format         = VK_FORMAT_B8G8R8A8_UNORM;
+	attachment.samples        = VK_SAMPLE_COUNT_1_BIT;
+	attachment.loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachment.storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+	attachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachment.finalLayout    = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments    = &colorRef;
+
+	VkRenderPassCreateInfo renderPassInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments    = &attachment;
+	renderPassInfo.subpassCount    = 1;
+	renderPassInfo.pSubpasses      = &subpass;
+
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	vkCreateRenderPass(device, &renderPassInfo, InCallbacks, &renderPass);
+
+	VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	vkCreatePipelineLayout(device, &layoutInfo, InCallbacks, &layout);
+
+	VkPipelineShaderStageCreateInfo stages[2] = {};
+	stages[0] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_VERTEX_BIT,   modules[0], "main", nullptr };
+	stages[1] = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_FRAGMENT_BIT, modules[1], "main", nullptr };
+
+	VkPipelineVertexInputStateCreateInfo   vertexInput   = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+	VkRect2D   scissor  = { { 0, 0 }, { 1280, 720 } };
+	VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+	viewportState.viewportCount = 1;
+	viewportState.pViewports    = &viewport;
+	viewportState.scissorCount  = 1;
+	viewportState.pScissors     = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterization = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+	rasterization.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+	multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState blendAttachment = {};
+	blendAttachment.colorWriteMask = 0xf;
+	VkPipelineColorBlendStateCreateInfo colorBlend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+	colorBlend.attachmentCount = 1;
+	colorBlend.pAttachments    = &blendAttachment;
+
+	std::vector<VkPipeline> pipelines(kNumPipelines);
+	for (uint32 i = 0; i < kNumPipelines; ++i)
+	{
+		// Vary a state so that drivers can't return the same pipeline object.
+		rasterization.cullMode = (i & 1) ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+		pipelineInfo.stageCount          = 2;
+		pipelineInfo.pStages             = stages;
+		pipelineInfo.pVertexInputState   = &vertexInput;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState      = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterization;
+		pipelineInfo.pMultisampleState   = &multisample;
+		pipelineInfo.pColorBlendState    = &colorBlend;
+		pipelineInfo.layout              = layout;
+		pipelineInfo.renderPass          = renderPass;
+		vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, InCallbacks, &pipelines[i]);
+
+		if (InAllocator != nullptr && (i % 100) == 0)
+			InAllocator->NextFrame();
+	}
+
+	// Teardown is part of the measurement, the allocator serves the frees too.
+	for (auto& pipeline : pipelines)
+		vkDestroyPipeline(device, pipeline, InCallbacks);
+	vkDestroyPipelineLayout(device, layout, InCallbacks);
+	vkDestroyRenderPass(device, renderPass, InCallbacks);
+	vkDestroyShaderModule(device, modules[0], InCallbacks);
+	vkDestroyShaderModule(device, modules[1], InCallbacks);
+	vkDestroyDescriptorPool(device, pool, InCallbacks);
+	vkDestroyDescriptorSetLayout(device, dsl, InCallbacks);
+	for (auto& sampler : samplers)
+		vkDestroySampler(device, sampler, InCallbacks);
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	vkDestroyDevice(device, InCallbacks);
+
+	return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int main()
+{
+	VkApplicationInfo appInfo = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
+	appInfo.apiVersion = VK_MAKE_VERSION(1, 0, 0);
+
+	VkInstanceCreateInfo instanceInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+	instanceInfo.pApplicationInfo = &appInfo;
+
+	VkInstance instance = VK_NULL_HANDLE;
+	vkCreateInstance(&instanceInfo, nullptr, &instance);
+
+	uint32 pdCount = 1;
+	VkPhysicalDevice pd = VK_NULL_HANDLE;
+	vkEnumeratePhysicalDevices(instance, &pdCount, &pd);
+
+	uint32 qfCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(pd, &qfCount, nullptr);
+	std::vector<VkQueueFamilyProperties> qfProps(qfCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(pd, &qfCount, qfProps.data());
+
+	uint32 qfIndex = 0;
+	while (qfIndex < qfCount && !(qfProps[qfIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+		++qfIndex;
+
+	double nullMs = RunBenchmark(pd, qfIndex, nullptr, nullptr);
+
+	ArenaAllocator* allocator = new ArenaAllocator;
+	double arenaMs = RunBenchmark(pd, qfIndex, allocator->GetVkAllocator(), allocator);
+
+	ArenaAllocator::Stats stats = allocator->GetStats();
+	delete allocator;
+
+	vkDestroyInstance(instance, nullptr);
+
+	printf("%u samplers, %u descriptor sets, %u pipelines\n", kNumSamplers, kNumDescriptorSets, kNumPipelines);
+	printf("null callbacks : %.2f ms\n", nullMs);
+	printf("ArenaAllocator : %.2f ms (arena %llu bytes, pools %llu bytes, %llu frame resets)\n", arenaMs,
+		(unsigned long long)stats.ArenaBytes, (unsigned long long)stats.PoolBytes, (unsigned long long)stats.FrameResetCount);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Host allocator stress
+
+#if 0
+
+// Hammers the three allocation callbacks directly from several threads, no GPU needed.
+// A quarter of the blocks are handed over to another thread before being freed.
+
+#include "Core/Base/ArenaAllocator.h"
+#include "Core/Base/ThreadCacheAllocator.h"
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+
+static const uint32 kNumThreads    = 8;
+static const uint32 kNumIterations = 1000000;
+
+static double StressCallbacks(const VkAllocationCallbacks* InCallbacks)
+{
+	std::mutex                                   exchangeMutex;
+	std::vector<std::pair<void*, usize>>         exchange;
+
+	auto worker = [&](uint32 InSeed)
+	{
+		std::mt19937 rng(InSeed);
+		std::vector<std::pair<void*, usize>> live;
+
+		for (uint32 i = 0; i < kNumIterations; ++i)
+		{
+			const uint32 op = rng() % 8;
+
+			if (op < 3 || live.empty())
+			{
+				// Mostly small driver objects, now and then a big one.
+				const usize size      = (rng() % 64 == 0) ? 1 + rng() % 65536 : 1 + rng() % 512;
+				const usize alignment = (usize)1 << (rng() % 7);
+				const auto  scope     = (VkSystemAllocationScope)(rng() % 5);
+
+				void* memory = InCallbacks->pfnAllocation(InCallbacks->pUserData, size, alignment, scope);
+				assert(memory != nullptr && ((usize)memory & (alignment - 1)) == 0);
+
+				if (scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND)
+					InCallbacks->pfnFree(InCallbacks->pUserData, memory);
+				else live.push_back({ memory, size });
+			}
+			else if (op < 5)
+			{
+				// Realloc-heavy pattern: grow by small steps.
+				auto& block = live[rng() % live.size()];
+				block.second += 1 + rng() % 64;
+				block.first   = InCallbacks->pfnReallocation(InCallbacks->pUserData, block.first, block.second, 16, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+			}
+			else if (op < 7)
+			{
+				const usize index = rng() % live.size();
+				InCallbacks->pfnFree(InCallbacks->pUserData, live[index].first);
+				live[index] = live.back();
+				live.pop_back();
+			}
+			else
+			{
+				// Cross-thread free.
+				std::pair<void*, usize> block = { nullptr, 0 };
+				{
+					std::unique_lock<std::mutex> lock(exchangeMutex);
+					exchange.push_back(live.back());
+					if (exchange.size() > 1)
+					{
+						block = exchange.front();
+						exchange.front() = exchange.back();
+						exchange.pop_back();
+					}
+				}
+				live.pop_back();
+
+				if (block.first != nullptr)
+					InCallbacks->pfnFree(InCallbacks->pUserData, block.first);
+			}
+		}
+
+		for (auto& block : live)
+			InCallbacks->pfnFree(InCallbacks->pUserData, block.first);
+	};
+
+	auto begin = std::chrono::high_resolution_clock::now();
+
+	std::vector<std::thread> threads;
+	for (uint32 i = 0; i < kNumThreads; ++i)
+		threads.emplace_back(worker, i);
+	for (auto& thread : threads)
+		thread.join();
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	for (auto& block : exchange)
+		InCallbacks->pfnFree(InCallbacks->pUserData, block.first);
+
+	return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int main()
+{
+	ArenaAllocator* arena = new ArenaAllocator;
+	double arenaMs = StressCallbacks(arena->GetVkAllocator());
+	delete arena;
+
+	ThreadCacheAllocator* threadCache = new ThreadCacheAllocator;
+	double threadCacheMs = StressCallbacks(threadCache->GetVkAllocator());
+	ThreadCacheAllocator::Stats stats = threadCache->GetStats();
+	delete threadCache;
+
+	printf("%u threads x %u callbacks\n", kNumThreads, kNumIterations);
+	printf("ArenaAllocator       : %.2f ms\n", arenaMs);
+	printf("ThreadCacheAllocator : %.2f ms (%llu thread heaps, %llu page bytes)\n", threadCacheMs,
+		(unsigned long long)stats.ThreadHeapCount, (unsigned long long)stats.PageBytes);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Device memory sub-allocator benchmark
+
+#if 0
+
+// Runs the sub-allocators against a mock heap made of 64MB blocks, no GPU needed.
+// Persistent: random resource sizes come and go around a steady live set.
+// Transient: a burst of per frame allocations released at the end of the frame.
+
+#include "Core/Render/Memory/MemorySubAllocator.h"
+#include <chrono>
+#include <random>
+
+static const VkDeviceSize kBlockSize        = 64ull * 1024 * 1024;
+static const VkDeviceSize kGranularity      = 1024;
+static const uint32       kPersistentOps    = 500000;
+static const uint32       kPersistentLive   = 4000;
+static const uint32       kTransientFrames  = 2000;
+static const uint32       kTransientPerFrame = 300;
+
+struct MockAllocation
+{
+	uint32       Block;
+	VkDeviceSize Offset;
+	VkDeviceSize Size;
+};
+
+struct MockHeap
+{
+	std::vector<MemorySubAllocator*> Blocks;
+	bool                             bLinear;
+
+	~MockHeap()
+	{
+		for (auto& block : Blocks)
+			delete block;
+	}
+
+	MockAllocation Allocate(VkDeviceSize InSize, VkDeviceSize InAlignment, DeviceResourceTiling InTiling)
+	{
+		MockAllocation allocation = { 0, 0, InSize };
+
+		for (; allocation.Block < (uint32)Blocks.size(); ++allocation.Block)
+		{
+			if (Blocks[allocation.Block]->Allocate(InSize, InAlignment, InTiling, allocation.Offset))
+				return allocation;
+		}
+
+		if (bLinear)
+			Blocks.push_back(new LinearSubAllocator(kBlockSize, kGranularity));
+		else
+			Blocks.push_back(new BuddySubAllocator(kBlockSize, 256));
+
+		Blocks.back()->Allocate(InSize, InAlignment, InTiling, allocation.Offset);
+		return allocation;
+	}
+
+	void Free(const MockAllocation& InAllocation)
+	{
+		Blocks[InAllocation.Block]->Free(InAllocation.Offset, InAllocation.Size);
+	}
+
+	void Report(const char* InName, double InMs, uint32 InOps) const
+	{
+		VkDeviceSize used = 0, reserved = 0;
+		float        fragmentation = 0.0f;
+
+		for (auto& block : Blocks)
+		{
+			MemorySubAllocator::Stats stats = block->GetStats();
+			used          += stats.UsedBytes;
+			reserved      += stats.ReservedBytes;
+			fragmentation += MemorySubAllocator::GetFragmentation(stats);
+		}
+
+		printf("%-10s: %8.2f ms, %6.1f ns/op, %u blocks, used %.1f MB, reserved %.1f MB, avg fragmentation %.3f\n", InName, InMs, InMs * 1e6 / InOps,
+			(uint32)Blocks.size(), used / 1048576.0, reserved / 1048576.0, Blocks.empty() ? 0.0f : fragmentation / Blocks.size());
+	}
+};
+
+// Mostly small buffers, now and then a texture of a few MB.
+static VkDeviceSize RandomResourceSize(std::mt19937& InRng)
+{
+	const uint32 log2 = 8 + InRng() % 15;
+	return ((VkDeviceSize)1 << log2) + InRng() % ((VkDeviceSize)1 << log2);
+}
+
+int main()
+{
+	std::mt19937 rng(1234);
+
+	{
+		MockHeap heap;
+		heap.bLinear = false;
+
+		std::vector<MockAllocation> live;
+		auto begin = std::chrono::high_resolution_clock::now();
+
+		for (uint32 i = 0; i < kPersistentOps; ++i)
+		{
+			if (live.size() < kPersistentLive && (live.empty() || rng() % 3 != 0))
+			{
+				live.push_back(heap.Allocate(RandomResourceSize(rng), (VkDeviceSize)256 << (rng() % 5), DeviceResourceTiling::Linear));
+			}
+			else
+			{
+				const size_t index = rng() % live.size();
+				heap.Free(live[index]);
+				live[index] = live.back();
+				live.pop_back();
+			}
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		heap.Report("Buddy", std::chrono::duration<double, std::milli>(end - begin).count(), kPersistentOps);
+		printf("            %u live resources would need %u vkAllocateMemory without sub-allocation\n", (uint32)live.size(), (uint32)live.size());
+	}
+
+	{
+		MockHeap heap;
+		heap.bLinear = true;
+
+		std::vector<MockAllocation> frame;
+		auto begin = std::chrono::high_resolution_clock::now();
+
+		for (uint32 f = 0; f < kTransientFrames; ++f)
+		{
+			for (uint32 i = 0; i < kTransientPerFrame; ++i)
+			{
+				const auto tiling = rng() % 4 == 0 ? DeviceResourceTiling::Optimal : DeviceResourceTiling::Linear;
+				frame.push_back(heap.Allocate(RandomResourceSize(rng) / 16, 256, tiling));
+			}
+
+			for (auto& allocation : frame)
+				heap.Free(allocation);
+			frame.clear();
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		heap.Report("Linear", std::chrono::duration<double, std::milli>(end - begin).count(), kTransientFrames * kTransientPerFrame * 2);
+	}
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Device memory defragmentation simulation
+
+#if 0
+
+// Fragments a simulated heap of buddy blocks, then runs one DefragPlanner pass per
+// frame under a byte budget, retiring the source ranges of a pass one frame later
+// like the GPU copies would be. No GPU needed.
+
+#include "Core/Render/Memory/DefragPlanner.h"
+#include <random>
+
+static const VkDeviceSize kBlockSize     = 64ull * 1024 * 1024;
+static const VkDeviceSize kFrameBudget   = 32ull * 1024 * 1024;
+static const uint32       kMovesPerFrame = 256;
+static const uint32       kResources     = 6000;
+
+struct SimResource
+{
+	uint32       Block;
+	VkDeviceSize Offset;
+	VkDeviceSize Size;
+	VkDeviceSize Alignment;
+	bool         bAlive;
+};
+
+int main()
+{
+	std::mt19937 rng(42);
+
+	std::vector<MemorySubAllocator*> heap;
+	std::vector<SimResource>         resources;
+
+	auto allocate = [&](VkDeviceSize InSize, VkDeviceSize InAlignment)
+	{
+		SimResource resource = { 0, 0, InSize, InAlignment, true };
+		for (; resource.Block < (uint32)heap.size(); ++resource.Block)
+		{
+			if (heap[resource.Block]->Allocate(InSize, InAlignment, DeviceResourceTiling::Linear, resource.Offset))
+				break;
+		}
+
+		if (resource.Block == (uint32)heap.size())
+		{
+			heap.push_back(new BuddySubAllocator(kBlockSize, 256));
+			heap.back()->Allocate(InSize, InAlignment, DeviceResourceTiling::Linear, resource.Offset);
+		}
+
+		resources.push_back(resource);
+	};
+
+	// Streaming in a level, then dropping two thirds of it leaves holes everywhere.
+	for (uint32 i = 0; i < kResources; ++i)
+		allocate(((VkDeviceSize)1 << (10 + rng() % 12)) + rng() % 4096, 256);
+
+	for (auto& resource : resources)
+	{
+		if (rng() % 3 != 0)
+		{
+			heap[resource.Block]->Free(resource.Offset, resource.Size);
+			resource.bAlive = false;
+		}
+	}
+
+	auto buildBlocks = [&]()
+	{
+		std::vector<DefragPlanner::Block> blocks(heap.size());
+		for (uint32 blockIndex = 0; blockIndex < (uint32)heap.size(); ++blockIndex)
+			blocks[blockIndex].pSubAllocator = heap[blockIndex];
+
+		for (uint32 id = 0; id < (uint32)resources.size(); ++id)
+		{
+			const SimResource& resource = resources[id];
+			if (resource.bAlive)
+				blocks[resource.Block].Items.push_back({ id, resource.Offset, resource.Size, resource.Alignment, DeviceResourceTiling::Linear });
+		}
+
+		return blocks;
+	};
+
+	DefragPlanner::Report before = DefragPlanner::Measure(buildBlocks());
+
+	DefragPlanner                    planner(kFrameBudget, kMovesPerFrame);
+	std::vector<DefragPlanner::Move> moves, inFlight;
+	VkDeviceSize                     totalMoved = 0;
+	uint32                           frames     = 0;
+
+	do
+	{
+		// Last frame's copies are done, give their sources back.
+		for (auto& move : inFlight)
+			heap[move.SrcBlock]->Free(move.SrcOffset, move.Size);
+
+		totalMoved += planner.Plan(buildBlocks(), moves);
+
+		for (auto& move : moves)
+		{
+			resources[(uint32)move.Id].Block  = move.DstBlock;
+			resources[(uint32)move.Id].Offset = move.DstOffset;
+		}
+
+		inFlight = moves;
+		++frames;
+	} while (!moves.empty() || !inFlight.empty());
+
+	DefragPlanner::Report after = DefragPlanner::Measure(buildBlocks());
+
+	printf("%u blocks of %llu MB, %.1f MB alive\n", (uint32)heap.size(), (unsigned long long)(kBlockSize >> 20), before.UsedBytes / 1048576.0);
+	printf("before : %u occupied blocks, %.1f MB free inside them, fragmentation %.3f\n", before.OccupiedBlockCount, before.FreeBytes / 1048576.0, before.Fragmentation);
+	printf("after  : %u occupied blocks, %.1f MB free inside them, fragmentation %.3f\n", after.OccupiedBlockCount, after.FreeBytes / 1048576.0, after.Fragmentation);
+	printf("moved  : %.1f MB in %u frames (budget %llu MB per frame)\n", totalMoved / 1048576.0, frames, (unsigned long long)(kFrameBudget >> 20));
+
+	for (auto& block : heap)
+		delete block;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Staging ring tests
+
+#if 0
+
+// CPU side of the upload manager: ring wraparound and retirement, copy coalescing,
+// then a throughput run where tickets retire two frames late like fences would.
+
+#include "Core/Render/Memory/StagingRing.h"
+#include <chrono>
+#include <random>
+
+#define _check(x) do { if (!(x)) { std::cout << "FAILED: " << #x << " (line " << __LINE__ << ")" << std::endl; return 1; } } while (0)
+
+static VkBuffer FakeBuffer(uint64 InId) { return (VkBuffer)InId; }
+
+int main()
+{
+	// Ring: fill, wrap, retire.
+	{
+		StagingRing ring(1024);
+		VkDeviceSize offset = 0;
+
+		_check(ring.Allocate(400, 16, offset) && offset == 0);
+		_check(ring.Allocate(400, 16, offset) && offset == 400);
+		ring.Submit(1);
+
+		_check(!ring.Allocate(400, 16, offset));                // 224 bytes left at the end, nothing retired.
+		_check(ring.GetLargestFreeRange() == 224);
+
+		ring.Retire(0);
+		_check(ring.GetUsedBytes() == 800);
+
+		_check(ring.Allocate(200, 16, offset) && offset == 800);
+		ring.Submit(2);
+		ring.Retire(1);
+		_check(ring.GetUsedBytes() == 200);
+
+		_check(ring.Allocate(100, 16, offset) && offset == 0);   // 24 bytes at the end are skipped.
+		_check(ring.GetUsedBytes() == 324);
+		_check(ring.Allocate(688, 16, offset) && offset == 112);  // Ends right at the tail.
+		_check(ring.GetUsedBytes() == 1024 && !ring.Allocate(1, 1, offset));
+		ring.Submit(3);
+
+		ring.Retire(3);
+		_check(ring.GetUsedBytes() == 0 && ring.GetLargestFreeRange() == 1024);
+		_check(ring.Allocate(1024, 16, offset) && offset == 0);
+		_check(!ring.Allocate(1, 1, offset));
+		_check(ring.GetLargestFreeRange() == 0);
+		ring.Submit(4);
+		ring.Retire(4);
+		_check(!ring.Allocate(2048, 16, offset));
+	}
+
+	// Copy batch: merging, overlap refusal, one destination per buffer.
+	{
+		CopyBatch batch;
+		_check(batch.Add(FakeBuffer(1), 0,   0,   64));
+		_check(batch.Add(FakeBuffer(1), 64,  64,  64));             // Contiguous on both sides, merged.
+		_check(batch.Add(FakeBuffer(1), 128, 512, 64));             // Gap in the destination, new region.
+		_check(batch.Add(FakeBuffer(2), 192, 0,   32));
+		_check(!batch.Add(FakeBuffer(1), 224, 100, 16));            // Inside the merged range.
+		_check(!batch.Add(FakeBuffer(1), 224, 500, 16));            // Crosses into [512, 576).
+		_check(batch.Add(FakeBuffer(1), 224, 128, 384));            // Fills the gap exactly.
+		_check(batch.Add(FakeBuffer(2), 608, 32,  0));
+
+		_check(batch.GetDestinations().size() == 2);
+		_check(batch.GetDestinations()[0].Regions.size() == 3);
+		_check(batch.GetDestinations()[0].Regions[0].size == 128);
+		_check(batch.GetRegionCount() == 4);
+
+		batch.Clear();
+		_check(batch.IsEmpty() && batch.Add(FakeBuffer(1), 0, 0, 64));
+	}
+
+	std::cout << "Staging ring tests passed." << std::endl;
+
+	// Throughput: small writes into a handful of buffers, 2 frames in flight.
+	{
+		const VkDeviceSize kRingSize     = 32ull * 1024 * 1024;
+		const VkDeviceSize kFrameBudget  = 8ull  * 1024 * 1024;
+		const uint32       kFrames       = 2000;
+		const uint32       kBuffers      = 8;
+		const uint32       kFramesInFlight = 2;
+
+		std::vector<uint8> mapped((usize)kRingSize);
+		std::vector<uint8> source(64 * 1024, 0x5a);
+		std::mt19937 rng(7);
+
+		StagingRing  ring(kRingSize);
+		CopyBatch    batch;
+
+		uint64 writeCount = 0, regionCount = 0, commandCount = 0, bytes = 0;
+		std::vector<VkDeviceSize> cursors(kBuffers, 0);
+
+		auto start = std::chrono::high_resolution_clock::now();
+
+		for (uint32 frame = 1; frame <= kFrames; ++frame)
+		{
+			if (frame > kFramesInFlight)
+				ring.Retire(frame - kFramesInFlight);
+
+			VkDeviceSize frameBytes = 0;
+			while (frameBytes < kFrameBudget)
+			{
+				const uint32       buffer = rng() % kBuffers;
+				const VkDeviceSize size   = 64 + (rng() % 64) * 64;
+
+				VkDeviceSize offset = 0;
+				if (!ring.Allocate(size, 16, offset))
+					break;
+
+				memcpy(mapped.data() + offset, source.data(), (usize)size);
+
+				// Streaming writes, mostly sequential per buffer like vertex and constant uploads.
+				if (!batch.Add(FakeBuffer(buffer + 1), offset, cursors[buffer], size))
+					return 1;
+
+				cursors[buffer] += size;
+				frameBytes      += size;
+				writeCount++;
+			}
+
+			for (auto& destination : batch.GetDestinations())
+			{
+				regionCount += destination.Regions.size();
+				commandCount++;
+			}
+
+			bytes += frameBytes;
+			batch.Clear();
+			ring.Submit(frame);
+
+			for (auto& cursor : cursors)
+				cursor = 0;
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+
+		std::cout << "Staged " << bytes / (1024 * 1024) << " MB in " << writeCount << " writes, "
+			<< (double)bytes / (1024.0 * 1024.0) / seconds << " MB/s, "
+			<< (double)writeCount / seconds / 1e6 << " M writes/s" << std::endl;
+		std::cout << "Per frame: " << (double)writeCount / kFrames << " writes -> "
+			<< (double)commandCount / kFrames << " copy commands, "
+			<< (double)regionCount / kFrames << " regions" << std::endl;
+	}
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Memory budget eviction
+
+#if 0
+
+// Fallback budget of a fake 1GB heap, two caches register for eviction and a
+// streaming loop keeps allocating until the watermark asks them to give back.
+
+#include "Core/Render/Memory/MemoryBudget.h"
+
+int main()
+{
+	VkPhysicalDeviceMemoryProperties memProps = {};
+	memProps.memoryHeapCount    = 1;
+	memProps.memoryHeaps[0].size = 1024ull * 1024 * 1024;
+
+	MemoryBudget budget;
+	budget.Init(memProps, VK_NULL_HANDLE, false);
+
+	std::vector<VkDeviceSize> cheapCache(64, 4ull * 1024 * 1024);
+	std::vector<VkDeviceSize> streamedMips(64, 8ull * 1024 * 1024);
+	std::vector<string>       order;
+
+	auto makeEvictor = [&](std::vector<VkDeviceSize>& InEntries, const char* InName)
+	{
+		return [&budget, &InEntries, &order, InName](uint32 InHeapIndex, VkDeviceSize InBytesToFree)
+		{
+			VkDeviceSize freed = 0;
+			while (freed < InBytesToFree && !InEntries.empty())
+			{
+				freed += InEntries.back();
+				budget.RecordFree(InHeapIndex, InEntries.back());
+				InEntries.pop_back();
+			}
+
+			order.push_back(InName);
+			return freed;
+		};
+	};
+
+	budget.AddEvictionCallback(10, makeEvictor(streamedMips, "mips"));
+	budget.AddEvictionCallback(0,  makeEvictor(cheapCache,   "cache"));
+
+	for (auto& size : cheapCache)   budget.RecordAllocation(0, size);
+	for (auto& size : streamedMips) budget.RecordAllocation(0, size);
+
+	// 768MB used of an 819MB budget, watermark at 737MB.
+	std::cout << "Over watermark before: " << budget.IsOverWatermark(0) << std::endl;
+
+	uint32 frames = 0;
+	for (; frames < 100; ++frames)
+	{
+		const VkDeviceSize request = 16ull * 1024 * 1024;
+
+		if (budget.IsOverWatermark(0, request))
+			budget.Evict(0, request);
+
+		if (budget.IsOverWatermark(0, request))
+			break;
+
+		budget.RecordAllocation(0, request);
+	}
+
+	MemoryBudget::HeapBudget heap = budget.GetHeapBudget(0);
+	std::cout << "Frames streamed: " << frames << ", usage " << heap.Usage / (1024 * 1024) << " MB of " << heap.Budget / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "Cache entries left: " << cheapCache.size() << ", mip entries left: " << streamedMips.size() << std::endl;
+	std::cout << "First evicted: " << (order.empty() ? "none" : order.front()) << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region SmartPtr vector benchmark
+
+#if 0
+
+// The heap counted SmartPtr this engine used before, against the intrusive one
+// with both count policies. Null pointers, growth, copies and shuffles of a vector.
+
+#include "Core/Utilities/SmartPtr/SmartPtr.h"
+#include <chrono>
+#include <random>
+
+template<typename T>
+class LegacyCounter
+{
+public:
+	T*     m_object;
+	uint64 m_count;
+
+	LegacyCounter(T* ptr) : m_object(ptr), m_count(1) {}
+	~LegacyCounter() { delete m_object; }
+};
+
+template<typename T>
+class LegacySmartPtr
+{
+	LegacyCounter<T>* m_counter;
+
+public:
+
+	LegacySmartPtr()       { m_counter = new LegacyCounter<T>(nullptr); }
+	LegacySmartPtr(T* ptr) { m_counter = new LegacyCounter<T>(ptr); }
+	LegacySmartPtr(const LegacySmartPtr& other) { m_counter = other.m_counter; m_counter->m_count++; }
+
+	LegacySmartPtr& operator=(const LegacySmartPtr& other)
+	{
+		if (this == &other)
+			return *this;
+
+		if (--m_counter->m_count == 0)
+			delete m_counter;
+
+		m_counter = other.m_counter;
+		m_counter->m_count++;
+		return *this;
+	}
+
+	virtual ~LegacySmartPtr()
+	{
+		if (--m_counter->m_count == 0)
+			delete m_counter;
+	}
+
+	T* operator->() const { return m_counter->m_object; }
+};
+
+struct PlainNode                                        { uint64 Value = 0; };
+struct AtomicNode : public RefCounted<AtomicNode>       { uint64 Value = 0; };
+struct LocalNode  : public RefCounted<LocalNode, SingleThreadRefCount> { uint64 Value = 0; };
+
+static const uint32 kCount = 1000000;
+
+template<typename TPtr, typename TMake>
+void Run(const char* InName, TMake InMake)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	auto t0 = Clock::now();
+	{
+		std::vector<TPtr> nulls(kCount);
+	}
+	auto t1 = Clock::now();
+
+	std::vector<TPtr> items;
+	for (uint32 i = 0; i < kCount; ++i)
+		items.push_back(InMake());
+	auto t2 = Clock::now();
+
+	std::vector<TPtr> copies = items;
+	auto t3 = Clock::now();
+
+	std::mt19937 rng(3);
+	std::shuffle(copies.begin(), copies.end(), rng);
+	auto t4 = Clock::now();
+
+	uint64 sum = 0;
+	for (auto& item : copies)
+		sum += item->Value;
+
+	copies.clear();
+	items.clear();
+	auto t5 = Clock::now();
+
+	std::cout << InName << ": null " << ms(t0, t1) << " ms, push_back " << ms(t1, t2) << " ms, copy " << ms(t2, t3)
+		<< " ms, shuffle " << ms(t3, t4) << " ms, release " << ms(t4, t5) << " ms" << (sum == 0 ? "" : "!") << std::endl;
+}
+
+int main()
+{
+	Run<LegacySmartPtr<PlainNode>>("Legacy counter     ", [] { return LegacySmartPtr<PlainNode>(new PlainNode); });
+	Run<SmartPtr<AtomicNode>>     ("Intrusive, atomic  ", [] { return SmartPtr<AtomicNode>(new AtomicNode); });
+	Run<SmartPtr<LocalNode>>      ("Intrusive, local   ", [] { return MakeSmart<LocalNode>(); });
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region VkSmartPtr create/destroy benchmark
+
+#if 0
+
+// The string matched destroy chain VkCounter used before, against the typed
+// deleters. The handle type is fake, its destroy function only counts calls,
+// so the numbers are the smart pointer overhead alone. Link VkSmartPtr.cpp.
+
+#include "Core/Utilities/SmartPtr/VkSmartPtr.h"
+#include <chrono>
+
+VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkBenchObject)
+
+static uint64 g_destroyCount = 0;
+
+static void DestroyBenchObject(VkBenchObject InObject)
+{
+	if (InObject != VK_NULL_HANDLE)
+		++g_destroyCount;
+}
+
+template<>
+struct VkHandleTraits<VkBenchObject>
+{
+	static constexpr const char* Name = _name_of(VkBenchObject);
+
+	static void Destroy(const VkDeviceContext& InOwner, VkObjectHandler InHandle)
+	{
+		DestroyBenchObject((VkBenchObject)InHandle);
+	}
+};
+
+// Same order as the old chain, a surface went through every comparison.
+static const char* const kLegacyTypes[] =
+{
+	"VkFence", "VkSemaphore", "VkEvent", "VkQueryPool", "VkBuffer", "VkBufferView", "VkImage", "VkImageView",
+	"VkShaderModule", "VkPipelineCache", "VkPipeline", "VkPipelineLayout", "VkSampler", "VkDescriptorSetLayout",
+	"VkDescriptorPool", "VkFramebuffer", "VkRenderPass", "VkCommandPool", "VkSwapchainKHR", "VkBenchObject"
+};
+
+template<typename T>
+class LegacyVkCounter : public RefCounted<LegacyVkCounter<T>>
+{
+public:
+	T*     m_object;
+	string m_type;
+	bool   m_bReleasedObjectOwnership;
+
+	LegacyVkCounter(T* ptr) : m_object(ptr), m_bReleasedObjectOwnership(false) {}
+
+	~LegacyVkCounter()
+	{
+		if (m_object != nullptr && *m_object != VK_NULL_HANDLE && !m_bReleasedObjectOwnership)
+		{
+			for (const char* type : kLegacyTypes)
+			{
+				if (m_type == type)
+					DestroyBenchObject((VkBenchObject)*m_object);
+			}
+		}
+
+		delete m_object;
+	}
+};
+
+template<typename T>
+class LegacyVkSmartPtr
+{
+	SmartPtr<LegacyVkCounter<T>> m_counter;
+
+public:
+
+	LegacyVkSmartPtr(const char* type) : m_counter(new LegacyVkCounter<T>(nullptr)) { m_counter->m_type = type; }
+
+	// The owner is the global device of the old code.
+	T* MakeInstance(VkDeviceContext*)
+	{
+		m_counter->m_object = new T;
+		*(m_counter->m_object) = VK_NULL_HANDLE;
+		return m_counter->m_object;
+	}
+};
+
+static const uint32 kCount = 100000;
+
+// No instance and no device, the context only runs the destroy queue.
+static SmartPtr<VkDeviceContext> g_context = VkDeviceContext::CreateInstanceContext(VK_NULL_HANDLE, nullptr);
+
+template<typename TPtr, typename TMake>
+void Run(const char* InName, TMake InMake)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	g_destroyCount = 0;
+
+	std::vector<TPtr> objects;
+	objects.reserve(kCount);
+
+	auto t0 = Clock::now();
+	for (uint32 i = 0; i < kCount; ++i)
+	{
+		objects.push_back(InMake());
+		*objects.back().MakeInstance(g_context) = (VkBenchObject)(uint64)(i + 1);
+	}
+	auto t1 = Clock::now();
+
+	objects.clear();
+	g_context->DestroyAll();
+	auto t2 = Clock::now();
+
+	std::cout << InName << ": create " << ms(t0, t1) << " ms, destroy " << ms(t1, t2) << " ms, "
+		<< sizeof(TPtr) << " bytes per pointer" << (g_destroyCount == kCount ? "" : ", destroy count mismatch!") << std::endl;
+}
+
+int main()
+{
+	Run<LegacyVkSmartPtr<VkBenchObject>>("String matched destroy", [] { return LegacyVkSmartPtr<VkBenchObject>(_name_of(VkBenchObject)); });
+	Run<VkSmartPtr<VkBenchObject>>      ("Typed deleter         ", [] { return VkSmartPtr<VkBenchObject>(); });
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Deferred destroy queue
+
+#if 0
+
+// Released objects stay alive for the frames in flight. Nothing is submitted
+// here and no fence is given, so nothing goes before DestroyAll(). Link VkSmartPtr.cpp.
+
+#include "Core/Utilities/SmartPtr/VkSmartPtr.h"
+#include "Core/Base/BaseConfig.h"
+#include <cassert>
+
+VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkTestObject)
+
+static std::vector<uint64> g_destroyed;
+
+template<>
+struct VkHandleTraits<VkTestObject>
+{
+	static constexpr const char* Name = _name_of(VkTestObject);
+
+	static void Destroy(const VkDeviceContext& InOwner, VkObjectHandler InHandle)
+	{
+		g_destroyed.push_back((uint64)InHandle);
+	}
+};
+
+// No instance and no device, the context only runs the destroy queue.
+static SmartPtr<VkDeviceContext> g_context = VkDeviceContext::CreateInstanceContext(VK_NULL_HANDLE, nullptr);
+
+VkSmartPtr<VkTestObject> MakeObject(uint64 InValue)
+{
+	VkSmartPtr<VkTestObject> object;
+	*object.MakeInstance(g_context) = (VkTestObject)InValue;
+
+	return object;
+}
+
+int main()
+{
+	const uint32 frameCount = BaseConfig::DefaultSwapchainCreateInfo.frameCount;
+
+	{
+		auto pFirst  = MakeObject(1);
+		auto pSecond = MakeObject(2);
+		auto pCopy   = pFirst;
+	}
+
+	// Released in frame 0, pSecond first.
+	assert(g_context->GetPendingDestroyCount() == 2);
+
+	for (uint32 frame = 1; frame < frameCount; ++frame)
+	{
+		g_context->NextFrame(VK_NULL_HANDLE);
+		MakeObject(10 + frame);
+	}
+
+	// The bucket of frame 0 comes round again, without a fence it is not taken as done.
+	g_context->NextFrame(VK_NULL_HANDLE);
+	assert(g_destroyed.empty());
+
+	// Released handles never reach the queue.
+	{
+		auto pObject = MakeObject(3);
+		auto pErased = VkCast(pObject);
+	}
+
+	assert(g_context->GetPendingDestroyCount() == frameCount + 2);
+
+	// Oldest bucket first, frame 0 got object 3 on its second round.
+	g_context->DestroyAll();
+	assert(g_context->GetPendingDestroyCount() == 0);
+	assert(g_destroyed.size() == frameCount + 2);
+	assert(g_destroyed[0] == 11 && g_destroyed[frameCount - 1] == 2 && g_destroyed[frameCount] == 1 && g_destroyed.back() == 3);
+
+	std::cout << "Deferred destroy queue tests passed." << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Device context threads
+
+#if 0
+
+// Several threads create, share and release objects of two devices at once.
+// Every object has to be destroyed exactly once, by the context it was made
+// for, and a context has to go with its last object. Link VkSmartPtr.cpp.
+
+#include "Core/Utilities/SmartPtr/VkSmartPtr.h"
+#include <cassert>
+#include <thread>
+
+VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkTestObject)
+
+static const uint32 kThreadCount     = 8;
+static const uint32 kObjectsPerThread = 50000;
+
+static std::atomic<uint64> g_destroyCounts[2];
+static std::atomic<uint64> g_wrongOwnerCount;
+
+static VkDeviceContext* g_contexts[2];
+
+template<>
+struct VkHandleTraits<VkTestObject>
+{
+	static constexpr const char* Name = _name_of(VkTestObject);
+
+	// The handle value carries the index of the device it was made for.
+	static void Destroy(const VkDeviceContext& InOwner, VkObjectHandler InHandle)
+	{
+		const uint32 device = (uint32)((uint64)InHandle & 1);
+
+		if (&InOwner != g_contexts[device])
+			++g_wrongOwnerCount;
+
+		++g_destroyCounts[device];
+	}
+};
+
+int main()
+{
+	auto pInstance = VkDeviceContext::CreateInstanceContext(VK_NULL_HANDLE, nullptr);
+
+	SmartPtr<VkDeviceContext> pDevices[2] =
+	{
+		VkDeviceContext::CreateDeviceContext(pInstance, VK_NULL_HANDLE),
+		VkDeviceContext::CreateDeviceContext(pInstance, VK_NULL_HANDLE)
+	};
+
+	g_contexts[0] = pDevices[0];
+	g_contexts[1] = pDevices[1];
+
+	// Objects made by one thread and released by another.
+	std::vector<VkSmartPtr<VkTestObject>> shared(kThreadCount);
+
+	std::vector<std::thread> threads;
+	for (uint32 t = 0; t < kThreadCount; ++t)
+	{
+		threads.emplace_back([&, t]()
+		{
+			std::vector<VkSmartPtr<VkObjectHandler>> erased;
+
+			for (uint32 i = 0; i < kObjectsPerThread; ++i)
+			{
+				const uint64 value  = ((uint64)(t * kObjectsPerThread + i + 1) << 1) | (i & 1);
+				const uint32 device = (uint32)(value & 1);
+
+				VkSmartPtr<VkTestObject> object;
+				*object.MakeInstance(pDevices[device]) = (VkTestObject)value;
+
+				if (i % 3 == 0)
+					erased.push_back(VkCast(object));
+				else if (i % 3 == 1)
+					shared[(t + 1) % kThreadCount] = object;
+
+				if (i % 1000 == 0)
+					pDevices[device]->NextFrame(VK_NULL_HANDLE);
+			}
+		});
+	}
+
+	for (auto& thread : threads)
+		thread.join();
+
+	shared.clear();
+
+	// The devices go with their last object, the instance after them.
+	pDevices[0].Reset();
+	pDevices[1].Reset();
+
+	assert(pInstance->GetRefCount() == 1);
+	pInstance.Reset();
+
+	const uint64 total = (uint64)kThreadCount * kObjectsPerThread;
+
+	assert(g_wrongOwnerCount == 0);
+	assert(g_destroyCounts[0] + g_destroyCounts[1] == total);
+	assert(g_destroyCounts[0] == total / 2 && g_destroyCounts[1] == total / 2);
+
+	std::cout << "Device context thread tests passed." << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Slot map handle benchmark
+
+#if 0
+
+// The vector of erased VkSmartPtr the pools used before, against a slot map
+// of detached objects. Fill, walk, look up and release by handle, where the
+// vector has to scan for the handle value. Link VkSmartPtr.cpp.
+
+#include "Core/Utilities/Containers/SlotMap.h"
+#include "Core/Utilities/SmartPtr/VkSmartPtr.h"
+#include <cassert>
+#include <chrono>
+#include <random>
+
+VK_DEFINE_NON_DISPATCHABLE_HANDLE(VkBenchObject)
+
+static uint64 g_destroyCount = 0;
+
+template<>
+struct VkHandleTraits<VkBenchObject>
+{
+	static constexpr const char* Name = _name_of(VkBenchObject);
+
+	static void Destroy(const VkDeviceContext& InOwner, VkObjectHandler InHandle)
+	{
+		++g_destroyCount;
+	}
+};
+
+static const uint32 kCount   = 100000;
+static const uint32 kRemoved = 2000;
+
+static SmartPtr<VkDeviceContext> g_context = VkDeviceContext::CreateInstanceContext(VK_NULL_HANDLE, nullptr);
+
+VkSmartPtr<VkBenchObject> MakeObject(uint32 InIndex)
+{
+	VkSmartPtr<VkBenchObject> object;
+	*object.MakeInstance(g_context) = (VkBenchObject)(uint64)(InIndex + 1);
+
+	return object;
+}
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	std::mt19937 rng(7);
+	std::vector<uint32> removeOrder(kCount);
+	for (uint32 i = 0; i < kCount; ++i)
+		removeOrder[i] = i;
+	std::shuffle(removeOrder.begin(), removeOrder.end(), rng);
+	removeOrder.resize(kRemoved);
+
+	{
+		auto t0 = Clock::now();
+
+		std::vector<VkSmartPtr<VkObjectHandler>> refs;
+		for (uint32 i = 0; i < kCount; ++i)
+		{
+			auto object = MakeObject(i);
+			refs.push_back(VkCast(object));
+		}
+		auto t1 = Clock::now();
+
+		uint64 sum = 0;
+		for (auto& ref : refs)
+			sum += (uint64)*ref;
+		auto t2 = Clock::now();
+
+		for (uint32 index : removeOrder)
+		{
+			VkObjectHandler value = (VkObjectHandler)(uint64)(index + 1);
+			auto found = std::find_if(refs.begin(), refs.end(), [value](VkSmartPtr<VkObjectHandler>& ref) { return *ref == value; });
+			refs.erase(found);
+		}
+		auto t3 = Clock::now();
+
+		refs.clear();
+		g_context->DestroyAll();
+		auto t4 = Clock::now();
+
+		std::cout << "VkSmartPtr vector: fill " << ms(t0, t1) << " ms, walk " << ms(t1, t2) << " ms, release " << kRemoved
+			<< " " << ms(t2, t3) << " ms, clear " << ms(t3, t4) << " ms" << (sum == 0 ? "!" : "") << std::endl;
+	}
+
+	assert(g_destroyCount == kCount);
+	g_destroyCount = 0;
+
+	{
+		auto t0 = Clock::now();
+
+		SlotMap<VkOwnedObject> objects;
+		std::vector<SlotHandle<VkOwnedObject>> handles;
+		handles.reserve(kCount);
+
+		for (uint32 i = 0; i < kCount; ++i)
+		{
+			auto object = MakeObject(i);
+			handles.push_back(objects.Insert(object.Detach()));
+		}
+		auto t1 = Clock::now();
+
+		uint64 sum = 0;
+		for (auto& object : objects)
+			sum += (uint64)object.Get();
+		auto t2 = Clock::now();
+
+		for (uint32 index : removeOrder)
+			objects.Remove(handles[index]);
+		auto t3 = Clock::now();
+
+		// Released handles are caught by their generation.
+		for (uint32 index : removeOrder)
+			assert(objects.Get(handles[index]) == nullptr);
+
+		objects.Clear();
+		g_context->DestroyAll();
+		auto t4 = Clock::now();
+
+		std::cout << "Slot map         : fill " << ms(t0, t1) << " ms, walk " << ms(t1, t2) << " ms, release " << kRemoved
+			<< " " << ms(t2, t3) << " ms, clear " << ms(t3, t4) << " ms" << (sum == 0 ? "!" : "") << std::endl;
+	}
+
+	assert(g_destroyCount == kCount);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+
+#pragma region ResourcePool contention benchmark
+
+#if 0
+
+// N threads push resources at once, into the single slot map behind two
+// mutexes the pool used before and into the sharded pool, then read them
+// back through Get() and release them. Link ResourcePool.cpp and VkSmartPtr.cpp.
+
+#include "Core/Base/ResourcePool.h"
+#include "Core/Base/Interface/IResourceHandler.h"
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+static std::atomic<uint32> g_deleteCount(0);
+
+class BenchResource : public IResourceHandler
+{
+public:
+
+	~BenchResource() { ++g_deleteCount; }
+};
+
+static const uint32 kThreadCount = 8;
+static const uint32 kPushCount   = 100000;
+
+namespace Legacy
+{
+	std::mutex g_respRead;
+	std::mutex g_respWrite;
+
+	SlotMap<IResourceHandler*> g_commonRefs;
+
+	ResourceHandle Push(IResourceHandler* InRef)
+	{
+		std::unique_lock<std::mutex> lockRead(g_respRead);
+		std::unique_lock<std::mutex> lockWrite(g_respWrite);
+
+		return g_commonRefs.Insert(InRef);
+	}
+
+	IResourceHandler* Get(ResourceHandle InHandle)
+	{
+		std::unique_lock<std::mutex> lock(g_respWrite);
+
+		IResourceHandler* const* ppRef = g_commonRefs.Get(InHandle);
+		return ppRef != nullptr ? *ppRef : nullptr;
+	}
+
+	void ReleaseAll()
+	{
+		for (auto& ref : g_commonRefs)
+			delete ref;
+
+		g_commonRefs.Clear();
+	}
+}
+
+template<typename TPush, typename TGet, typename TReleaseAll>
+void Run(const char* InName, std::vector<std::vector<IResourceHandler*>>& InResources, TPush InPush, TGet InGet, TReleaseAll InReleaseAll)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	std::vector<std::vector<ResourceHandle>> handles(kThreadCount);
+	std::vector<std::thread> threads;
+
+	auto t0 = Clock::now();
+
+	for (uint32 threadIndex = 0; threadIndex < kThreadCount; ++threadIndex)
+		threads.emplace_back([&, threadIndex]()
+		{
+			handles[threadIndex].reserve(kPushCount);
+
+			for (auto& resource : InResources[threadIndex])
+				handles[threadIndex].push_back(InPush(resource));
+		});
+
+	for (auto& thread : threads)
+		thread.join();
+	threads.clear();
+
+	auto t1 = Clock::now();
+
+	// Every thread reads what the next one pushed.
+	std::atomic<uint32> missCount(0);
+
+	for (uint32 threadIndex = 0; threadIndex < kThreadCount; ++threadIndex)
+		threads.emplace_back([&, threadIndex]()
+		{
+			const uint32 otherIndex = (threadIndex + 1) % kThreadCount;
+
+			for (uint32 index = 0; index < kPushCount; ++index)
+				if (InGet(handles[otherIndex][index]) != InResources[otherIndex][index])
+					++missCount;
+		});
+
+	for (auto& thread : threads)
+		thread.join();
+
+	auto t2 = Clock::now();
+
+	InReleaseAll();
+
+	auto t3 = Clock::now();
+
+	std::cout << InName << ": push " << ms(t0, t1) << " ms, get " << ms(t1, t2) << " ms, release all " << ms(t2, t3) << " ms" << std::endl;
+
+	assert(missCount == 0);
+	assert(g_deleteCount == kThreadCount * kPushCount);
+	g_deleteCount = 0;
+}
+
+std::vector<std::vector<IResourceHandler*>> MakeResources()
+{
+	std::vector<std::vector<IResourceHandler*>> resources(kThreadCount);
+
+	for (auto& threadResources : resources)
+		for (uint32 index = 0; index < kPushCount; ++index)
+			threadResources.push_back(new BenchResource);
+
+	return resources;
+}
+
+int main()
+{
+	std::cout << kThreadCount << " threads, " << kPushCount << " resources each" << std::endl;
+
+	auto resources = MakeResources();
+	Run("Two mutexes  ", resources, Legacy::Push, Legacy::Get, Legacy::ReleaseAll);
+
+	resources = MakeResources();
+	Run("Sharded pool ", resources,
+		[](IResourceHandler* InRef) { return ResourcePool::Get()->Push(InRef); },
+		[](ResourceHandle InHandle) { return ResourcePool::Get()->Get(InHandle); },
+		[]() { ResourcePool::Get()->ReleaseAll(); });
+
+	// Stale after the bulk release.
+	ResourceHandle handle = ResourcePool::Get()->Push(new BenchResource);
+	assert(ResourcePool::Get()->Release(handle));
+	assert(!ResourcePool::Get()->Release(handle));
+	assert(ResourcePool::Get()->Get(handle) == nullptr);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+
+#pragma region Resource arena tree benchmark
+
+#if 0
+
+// Build a tree of 100k engine objects through Create(), every node new'ed and
+// deleted by its parent, against the same tree in a resource arena destroyed
+// by Clear(). The arena pages are reused by the second round. Link
+// ResourceArena.cpp.
+
+#include "Core/Base/ResourceArena.h"
+#include <cassert>
+#include <chrono>
+
+static uint32 g_destroyCount = 0;
+
+class TreeNode : public IResourceHandler
+{
+	_declare_create_interface(TreeNode)
+
+public:
+
+	~TreeNode() { ++g_destroyCount; }
+
+	float Transform[16];
+};
+
+class TreeLeaf : public IResourceHandler
+{
+	_declare_create_interface(TreeLeaf)
+
+public:
+
+	~TreeLeaf() { ++g_destroyCount; }
+
+	uint64 Payload[4];
+};
+
+_impl_create_interface(TreeNode)
+_impl_create_interface(TreeLeaf)
+
+static const uint32 kNodeCount = 100000;
+static const uint32 kFanout    = 4;
+
+TreeNode* BuildTree(ResourceArena* InArena)
+{
+	std::vector<IResourceHandler*> nodes;
+	nodes.reserve(kNodeCount);
+	nodes.push_back(TreeNode::Create(nullptr, InArena));
+
+	// Breadth first, the last level is made of leaves.
+	for (uint32 parentIndex = 0; nodes.size() < kNodeCount; ++parentIndex)
+		for (uint32 childIndex = 0; childIndex < kFanout && nodes.size() < kNodeCount; ++childIndex)
+		{
+			if (nodes.size() * kFanout < kNodeCount)
+				nodes.push_back(TreeNode::Create(nodes[parentIndex]));
+			else
+				nodes.push_back(TreeLeaf::Create(nodes[parentIndex]));
+		}
+
+	return (TreeNode*)nodes[0];
+}
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	for (uint32 round = 0; round < 2; ++round)
+	{
+		auto t0 = Clock::now();
+		TreeNode* pRoot = BuildTree(nullptr);
+		auto t1 = Clock::now();
+		delete pRoot;
+		auto t2 = Clock::now();
+
+		assert(g_destroyCount == kNodeCount);
+		g_destroyCount = 0;
+
+		std::cout << "new/delete: create " << ms(t0, t1) << " ms, destroy " << ms(t1, t2) << " ms" << std::endl;
+	}
+
+	ResourceArena arena;
+
+	for (uint32 round = 0; round < 2; ++round)
+	{
+		auto t0 = Clock::now();
+		TreeNode* pRoot = BuildTree(&arena);
+		auto t1 = Clock::now();
+
+		assert(pRoot->GetArena() == &arena);
+		assert(arena.GetObjectCount() == kNodeCount);
+
+		arena.Clear();
+		auto t2 = Clock::now();
+
+		assert(g_destroyCount == kNodeCount);
+		g_destroyCount = 0;
+
+		std::cout << "Arena     : create " << ms(t0, t1) << " ms, destroy " << ms(t1, t2) << " ms, "
+			<< arena.GetReservedBytes() / 1024 << " KB reserved" << std::endl;
+	}
+
+	// A node made with new under an arena parent still goes with the parent.
+	TreeNode* pRoot = TreeNode::Create(nullptr, &arena);
+	pRoot->BindRef(new TreeLeaf);
+	arena.Clear();
+	assert(g_destroyCount == 2);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+
+#pragma region Resource name index
+
+#if 0
+
+// Create() used to format and store "<type>_<index>" for every object, now
+// the name is formatted on first GetName(). Times the creation of 100k
+// objects both ways, then finds pushed resources by name through the pool.
+// Link ResourcePool.cpp, ResourceArena.cpp, NameTable.cpp and VkSmartPtr.cpp.
+
+#include "Core/Base/ResourcePool.h"
+#include <cassert>
+#include <chrono>
+
+class NamedNode : public IResourceHandler
+{
+	_declare_create_interface(NamedNode)
+};
+
+_impl_create_interface(NamedNode)
+
+static const uint32 kCount = 100000;
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	std::vector<NamedNode*> nodes;
+	nodes.reserve(kCount);
+
+	auto t0 = Clock::now();
+
+	{
+		// What every Create() paid before.
+		std::vector<string> names;
+		names.reserve(kCount);
+
+		for (uint32 index = 0; index < kCount; ++index)
+			names.push_back(StringUtil::Printf("%_%", _name_of(NamedNode), index));
+	}
+
+	auto t1 = Clock::now();
+
+	for (uint32 index = 0; index < kCount; ++index)
+		nodes.push_back(NamedNode::Create(nullptr));
+
+	auto t2 = Clock::now();
+
+	for (auto& node : nodes)
+		ResourcePool::Get()->Push(node);
+
+	auto t3 = Clock::now();
+
+	uint32 foundCount = 0;
+	for (uint32 index = 0; index < kCount; index += 10)
+		if (ResourcePool::Get()->Find(StringUtil::Printf("%_%", _name_of(NamedNode), index)) == nodes[index])
+			++foundCount;
+
+	auto t4 = Clock::now();
+
+	std::cout << "Formatted names " << ms(t0, t1) << " ms, lazy Create " << ms(t1, t2) << " ms, push " << ms(t2, t3)
+		<< " ms, find " << kCount / 10 << " " << ms(t3, t4) << " ms" << std::endl;
+
+	assert(foundCount == kCount / 10);
+	assert(nodes[42]->GetName() == "NamedNode_42");
+
+	// Names set before the push are found as they are.
+	NamedNode* pCamera = NamedNode::Create(nullptr);
+	pCamera->SetName("MainCamera");
+	ResourceHandle handle = ResourcePool::Get()->Push(pCamera);
+
+	assert(ResourcePool::Get()->Find("MainCamera") == pCamera);
+	assert(ResourcePool::Get()->Find("NamedNode_99999999999") == nullptr);
+	assert(ResourcePool::Get()->Find("Unknown") == nullptr);
+
+	ResourcePool::Get()->Release(handle);
+	assert(ResourcePool::Get()->Find("MainCamera") == nullptr);
+
+	ResourcePool::Get()->ReleaseAll();
+	assert(ResourcePool::Get()->Find("NamedNode_0") == nullptr);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+
+#pragma region Scratch arena create infos
+
+#if 0
+
+// Fill the per pipeline create info arrays the way CreateGraphicPipelines(json)
+// does, once with std::vector and once with scratch vectors, counting the
+// heap allocations through a replaced operator new. Link ScratchArena.cpp.
+
+#include "Core/Base/ScratchArena.h"
+#include <cassert>
+#include <chrono>
+
+static usize g_heapAllocCount = 0;
+
+void* operator new(size_t InSize)
+{
+	++g_heapAllocCount;
+	return malloc(InSize);
+}
+
+void operator delete(void* InMemory) noexcept
+{
+	free(InMemory);
+}
+
+void operator delete(void* InMemory, size_t) noexcept
+{
+	free(InMemory);
+}
+
+static const uint32 kPipelineCount = 200;
+static const uint32 kStageCount    = 2;
+static const uint32 kRoundCount    = 50;
+
+struct StageInfo      { uint32 Stage; const char* pName; };
+struct AttributeInfo  { uint32 Location; uint32 Format; uint32 Offset; };
+struct BlendInfo      { uint32 Enable; uint32 Factors[4]; };
+
+template<template<typename> class TVector>
+uint64 FillCreateInfos()
+{
+	TVector<uint64>                    graphicInfos;
+	TVector<TVector<StageInfo>>        shaderInfos;
+	TVector<TVector<uint32>>           specData;
+	TVector<TVector<AttributeInfo>>    vertexInputAttributes;
+	TVector<TVector<BlendInfo>>        colorBlendAttachmentStates;
+	TVector<TVector<uint32>>           dynamicStates;
+
+	graphicInfos.resize(kPipelineCount);
+	shaderInfos.resize(kPipelineCount);
+	specData.resize(kPipelineCount);
+	vertexInputAttributes.resize(kPipelineCount);
+	colorBlendAttachmentStates.resize(kPipelineCount);
+	dynamicStates.resize(kPipelineCount);
+
+	uint64 checksum = 0;
+
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		shaderInfos[i].resize(kStageCount);
+		specData[i].resize(4, i);
+		vertexInputAttributes[i].resize(3);
+		colorBlendAttachmentStates[i].resize(1);
+		dynamicStates[i].resize(2);
+
+		// Per iteration temporaries, like the descriptor set layouts.
+		TVector<uint64> descSetLayouts;
+		for (uint32 j = 0; j < 3; ++j)
+			descSetLayouts.push_back(j);
+
+		graphicInfos[i] = descSetLayouts.size() + shaderInfos[i].size();
+		checksum += graphicInfos[i] + specData[i][3];
+	}
+
+	return checksum;
+}
+
+template<typename T>
+using HeapVector = std::vector<T>;
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	uint64 heapChecksum = 0, scratchChecksum = 0;
+
+	g_heapAllocCount = 0;
+	auto t0 = Clock::now();
+	for (uint32 round = 0; round < kRoundCount; ++round)
+		heapChecksum += FillCreateInfos<HeapVector>();
+	auto t1 = Clock::now();
+	const usize heapAllocCount = g_heapAllocCount;
+
+	// Warm the chunks up, later calls must not touch the heap at all.
+	{
+		ScratchScope scratch;
+		FillCreateInfos<ScratchVector>();
+	}
+
+	const usize chunkAllocCount = ScratchArena::Get().GetStats().ChunkAllocCount;
+
+	g_heapAllocCount = 0;
+	auto t2 = Clock::now();
+	for (uint32 round = 0; round < kRoundCount; ++round)
+	{
+		ScratchScope scratch;
+		scratchChecksum += FillCreateInfos<ScratchVector>();
+	}
+	auto t3 = Clock::now();
+
+	std::cout << kPipelineCount << " pipelines x " << kRoundCount << " calls" << std::endl;
+	std::cout << "std::vector  : " << ms(t0, t1) << " ms, " << heapAllocCount / kRoundCount << " heap allocations per call" << std::endl;
+	std::cout << "ScratchVector: " << ms(t2, t3) << " ms, " << g_heapAllocCount / kRoundCount << " heap allocations per call, "
+		<< chunkAllocCount << " chunks of " << ScratchArena::ChunkSize / 1024 << " KB" << std::endl;
+
+	assert(heapChecksum == scratchChecksum);
+	assert(g_heapAllocCount == 0);
+	assert(ScratchArena::Get().GetStats().ChunkAllocCount == chunkAllocCount);
+	assert(ScratchArena::Get().GetStats().UsedBytes == 0);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Parallel pipeline creation
+
+#if 0
+
+// Create 200 pipelines from one json, serial and with a worker per hardware
+// thread, and compare the wall time. The json is made from the triangle
+// sample, every 4th pipeline is a base and the 3 after it derive from it.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include <cassert>
+#include <chrono>
+#include <thread>
+
+static const uint32 kPipelineCount = 200;
+static const uint32 kChainLength   = 4;
+
+static string WritePipelineJson(const string& InPrefix)
+{
+	Json::Value sample;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/graphic_pipeline_info_simplify.json"), sample);
+
+	const char* polygonModes[] = { "fill", "line" };
+	const char* cullModes[]    = { "cull_none", "cull_front", "cull_back" };
+
+	Json::Value root;
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		Json::Value info = sample["graphic_pipeline_infos"];
+
+		info["name"] = InPrefix + std::to_string(i);
+
+		if (i % kChainLength == 0)
+		{
+			info["flags"] = (uint32)VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+		}
+		else
+		{
+			info["flags"]         = (uint32)VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+			info["base_pipeline"] = InPrefix + std::to_string(i - i % kChainLength);
+		}
+
+		// Different states, the driver can not hand out the same pipeline.
+		info["rasterization_state"]["polygon_mode"] = polygonModes[i % 2];
+		info["rasterization_state"]["cull_mode"]    = cullModes[(i / 2) % 3];
+
+		root["graphic_pipeline_infos"].append(info);
+	}
+
+	const string path = PathParser::Parse("Json/Triangle/" + InPrefix + "pipelines.json");
+
+	std::ofstream file(path);
+	file << Json::writeString(Json::StreamWriterBuilder(), root);
+
+	return path;
+}
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	Engine::Get()->Init();
+
+	LogicalDevice* pDevice = Engine::Get()->GetBaseLayer()->GetLogicalDevice();
+
+	const string warmupPath   = WritePipelineJson("warmup_");
+	const string serialPath   = WritePipelineJson("serial_");
+	const string parallelPath = WritePipelineJson("parallel_");
+
+	// Load the compiler and the shader files once, both runs start warm.
+	pDevice->CreateGraphicPipelines(warmupPath, VK_NULL_HANDLE, 0);
+
+	auto t0 = Clock::now();
+	pDevice->CreateGraphicPipelines(serialPath, VK_NULL_HANDLE, 1);
+	auto t1 = Clock::now();
+	pDevice->CreateGraphicPipelines(parallelPath, VK_NULL_HANDLE, 0);
+	auto t2 = Clock::now();
+
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		assert(pDevice->GetPipeline("serial_" + std::to_string(i)) != VK_NULL_HANDLE);
+		assert(pDevice->GetPipeline("parallel_" + std::to_string(i)) != VK_NULL_HANDLE);
+	}
+
+	std::cout << kPipelineCount << " pipelines, chains of " << kChainLength << std::endl;
+	std::cout << "serial           : " << ms(t0, t1) << " ms" << std::endl;
+	std::cout << "parallel (" << std::thread::hardware_concurrency() << " workers): " << ms(t1, t2) << " ms, "
+		<< ms(t0, t1) / ms(t1, t2) << "x" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Shader cache
+
+#if 0
+
+// Key changes with the source, an include, the entry point and the stage,
+// a stored SPVData comes back byte for byte, the directory stays under its
+// cap by dropping the oldest entries. Then times key + load against the
+// compiler DLL on the triangle shaders.
+// Link ShaderCache.cpp, GLSLCompiler.cpp, PathParser.cpp and ModuleLoader.cpp.
+
+#include "Core/Render/ShaderCache.h"
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+
+static void WriteText(const string& InPath, const string& InText)
+{
+	std::ofstream file(InPath, std::ofstream::binary | std::ofstream::trunc);
+	file << InText;
+}
+
+static GLSLCompiler::SPVData MakeSPVData(std::vector<uint32>& OutCode, std::vector<GLSLCompiler::ShaderResource>& OutUniforms, uint32 InWordCount)
+{
+	OutCode.resize(InWordCount);
+	for (uint32 i = 0; i < InWordCount; ++i)
+		OutCode[i] = 0x07230203u + i;
+
+	OutUniforms.resize(2);
+	for (uint32 i = 0; i < 2; ++i)
+	{
+		memset(&OutUniforms[i], 0, sizeof(GLSLCompiler::ShaderResource));
+		snprintf(OutUniforms[i].name, sizeof(OutUniforms[i].name), "ubo_%u", i);
+		OutUniforms[i].set     = 0;
+		OutUniforms[i].binding = (uint8)i;
+	}
+
+	GLSLCompiler::SPVData data = {};
+	data.result       = true;
+	data.spv_data     = OutCode.data();
+	data.spv_length   = InWordCount * sizeof(uint32);
+	data.shader_stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	data.resource[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER].count = 2;
+	data.resource[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER].items = OutUniforms.data();
+
+	return data;
+}
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	const string dir = PathParser::Parse("Saved/ShaderCacheTest");
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir + "/src");
+
+	WriteText(dir + "/src/common.glsl", "vec4 Tint() { return vec4(1.0); }\n");
+	WriteText(dir + "/src/test.frag", "#version 450\n  #  include \"common.glsl\"\nvoid main() {}\n");
+
+	const char* includeDirs[1] = { "" };
+
+	GLSLCompiler::CompileInfo compileInfo;
+	compileInfo.entrypoint     = "main";
+	compileInfo.includes_count = 1;
+	compileInfo.includes       = includeDirs;
+
+	const Path shaderPath("Saved/ShaderCacheTest/src/test.frag");
+
+	// Keys.
+	{
+		ShaderCache cache(dir + "/keys", 1024 * 1024);
+
+		const uint64 key = cache.ComputeKey(VK_SHADER_STAGE_FRAGMENT_BIT, shaderPath, compileInfo);
+		assert(key != 0);
+		assert(key == cache.ComputeKey(VK_SHADER_STAGE_FRAGMENT_BIT, shaderPath, compileInfo));
+		assert(key != cache.ComputeKey(VK_SHADER_STAGE_VERTEX_BIT, shaderPath, compileInfo));
+
+		compileInfo.entrypoint = "frag_main";
+		assert(key != cache.ComputeKey(VK_SHADER_STAGE_FRAGMENT_BIT, shaderPath, compileInfo));
+		compileInfo.entrypoint = "main";
+
+		WriteText(dir + "/src/common.glsl", "vec4 Tint() { return vec4(0.5); }\n");
+		assert(key != cache.ComputeKey(VK_SHADER_STAGE_FRAGMENT_BIT, shaderPath, compileInfo));
+
+		assert(cache.ComputeKey(VK_SHADER_STAGE_FRAGMENT_BIT, Path("Saved/ShaderCacheTest/src/missing.frag"), compileInfo) == 0);
+	}
+
+	// Round trip.
+	{
+		ShaderCache cache(dir + "/entries", 1024 * 1024);
+
+		std::vector<uint32>                       code;
+		std::vector<GLSLCompiler::ShaderResource> uniforms;
+		GLSLCompiler::SPVData data = MakeSPVData(code, uniforms, 256);
+
+		ShaderCacheEntry entry;
+		assert(!cache.Load(42, entry));
+
+		cache.Store(42, data);
+		assert(cache.Load(42, entry));
+		assert(!cache.Load(43, entry));
+
+		assert(entry.Data.result && entry.Data.shader_stage == data.shader_stage);
+		assert(entry.Data.spv_length == data.spv_length);
+		assert(memcmp(entry.Data.spv_data, code.data(), data.spv_length) == 0);
+		assert(entry.Data.resource[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER].count == 2);
+		assert(entry.Data.resource[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER].items[1].binding == 1);
+		assert(strcmp(entry.Data.resource[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER].items[1].name, "ubo_1") == 0);
+		assert(entry.Data.resource[VK_DESCRIPTOR_TYPE_SAMPLER].count == 0);
+
+		// A torn file is a miss.
+		std::filesystem::resize_file(dir + "/entries/000000000000002a.spvc", 100);
+		assert(!cache.Load(42, entry));
+
+		ShaderCache::Stats stats = cache.GetStats();
+		assert(stats.HitCount == 1 && stats.MissCount == 3 && stats.StoreCount == 1);
+	}
+
+	// Eviction, about 4 KB an entry under a 10 KB cap.
+	{
+		ShaderCache cache(dir + "/evict", 10 * 1024);
+
+		std::vector<uint32>                       code;
+		std::vector<GLSLCompiler::ShaderResource> uniforms;
+		GLSLCompiler::SPVData data = MakeSPVData(code, uniforms, 1000);
+
+		ShaderCacheEntry entry;
+
+		cache.Store(1, data);
+		cache.Store(2, data);
+
+		// Entry 1 is used again, 2 is now the oldest.
+		std::filesystem::last_write_time(dir + "/evict/0000000000000002.spvc", std::filesystem::file_time_type::clock::now() - std::chrono::hours(1));
+		assert(cache.Load(1, entry));
+
+		cache.Store(3, data);
+
+		ShaderCache::Stats stats = cache.GetStats();
+		assert(stats.EvictionCount == 1 && stats.TotalBytes <= 10 * 1024);
+		assert(cache.Load(1, entry) && !cache.Load(2, entry) && cache.Load(3, entry));
+	}
+
+	// Compile against hit, through the cache every GLSLCompiler shares.
+	{
+		const Path   vertPath("Core/Shaders/Triangle/triangle.vert");
+		const string vertDir = PathParser::Parse("Core/Shaders/Triangle");
+		const char*  triangleIncludes[1] = { vertDir.c_str() };
+		compileInfo.includes = triangleIncludes;
+
+		GLSLCompiler* pCompiler = GLSLCompiler::Create(nullptr);
+
+		const uint32 kRoundCount = 20;
+
+		const ShaderCache::Stats before = ShaderCache::Get().GetStats();
+
+		auto t0 = Clock::now();
+		pCompiler->CompileShader(VK_SHADER_STAGE_VERTEX_BIT, vertPath, &compileInfo);
+		pCompiler->FlushSPVData();
+		auto t1 = Clock::now();
+
+		for (uint32 round = 1; round < kRoundCount; ++round)
+		{
+			pCompiler->CompileShader(VK_SHADER_STAGE_VERTEX_BIT, vertPath, &compileInfo);
+			assert(pCompiler->GetLastSPVData()->result);
+			pCompiler->FlushSPVData();
+		}
+		auto t2 = Clock::now();
+
+		const ShaderCache::Stats after = ShaderCache::Get().GetStats();
+
+		std::cout << "triangle.vert: first " << ms(t0, t1) << (after.StoreCount > before.StoreCount ? " ms compiled" : " ms already cached")
+			<< ", then " << ms(t1, t2) / (kRoundCount - 1) << " ms per hit" << std::endl;
+		assert(after.HitCount - before.HitCount >= kRoundCount - 1);
+
+		delete pCompiler;
+	}
+
+	std::filesystem::remove_all(dir);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Pipeline cache file
+
+#if 0
+
+// Round trip of the managed pipeline cache file, then every way a file can
+// go stale: torn, flipped byte, another driver version, another UUID. Each
+// read must fail quietly so the device starts from an empty cache.
+// Link PipelineCacheManager.cpp and PathParser.cpp.
+
+#include "Core/Render/RenderBase/PipelineCacheManager.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include <cassert>
+#include <filesystem>
+
+static std::vector<uint8> MakeDriverData(const VkPhysicalDeviceProperties& InPDProps, uint32 InSize)
+{
+	LogicalDevice::PipelineCacheHeader header(InPDProps);
+
+	std::vector<uint8> data((const uint8*)header.GetData(), (const uint8*)header.GetData() + header.GetDataSize());
+	for (uint32 i = (uint32)data.size(); i < InSize; ++i)
+		data.push_back((uint8)(i * 31));
+
+	return data;
+}
+
+int main()
+{
+	VkPhysicalDeviceProperties pdProps = {};
+	pdProps.vendorID      = 0x10DE;
+	pdProps.deviceID      = 0x2204;
+	pdProps.driverVersion = 0x81234000;
+	for (uint32 i = 0; i < VK_UUID_SIZE; ++i)
+		pdProps.pipelineCacheUUID[i] = (uint8)(i + 1);
+
+	const string dir  = PathParser::Parse("Saved/PipelineCacheTest");
+	const string path = dir + "/" + PipelineCacheManager::GetFileName(pdProps);
+
+	std::filesystem::remove_all(dir);
+
+	// The name changes with every field of the key.
+	{
+		VkPhysicalDeviceProperties other = pdProps;
+		other.driverVersion++;
+		assert(PipelineCacheManager::GetFileName(other) != PipelineCacheManager::GetFileName(pdProps));
+
+		other = pdProps;
+		other.pipelineCacheUUID[VK_UUID_SIZE - 1] ^= 1;
+		assert(PipelineCacheManager::GetFileName(other) != PipelineCacheManager::GetFileName(pdProps));
+	}
+
+	const std::vector<uint8> driverData = MakeDriverData(pdProps, 4096);
+
+	std::vector<uint8> readData;
+
+	// Missing file.
+	assert(!PipelineCacheManager::ReadCacheFile(path, pdProps, readData) && readData.empty());
+
+	// Round trip, the directory is created and no temp file is left behind.
+	assert(PipelineCacheManager::WriteCacheFile(path, pdProps, driverData));
+	assert(PipelineCacheManager::ReadCacheFile(path, pdProps, readData) && readData == driverData);
+	assert(!std::filesystem::exists(path + ".tmp"));
+
+	std::vector<uint8> fileData;
+	{
+		std::ifstream ifs(path, std::ios::binary);
+		fileData.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	}
+
+	auto writeRaw = [&](const std::vector<uint8>& InData)
+	{
+		std::ofstream ofs(path, std::ofstream::binary | std::ofstream::trunc);
+		ofs.write((const char*)InData.data(), InData.size());
+	};
+
+	// Torn write.
+	writeRaw(std::vector<uint8>(fileData.begin(), fileData.begin() + fileData.size() / 2));
+	assert(!PipelineCacheManager::ReadCacheFile(path, pdProps, readData) && readData.empty());
+
+	// One flipped byte in the driver data.
+	{
+		std::vector<uint8> corrupted = fileData;
+		corrupted[corrupted.size() - 7] ^= 0x40;
+		writeRaw(corrupted);
+		assert(!PipelineCacheManager::ReadCacheFile(path, pdProps, readData));
+	}
+
+	// Same file after a driver update, or read on another device.
+	writeRaw(fileData);
+	{
+		VkPhysicalDeviceProperties updated = pdProps;
+		updated.driverVersion++;
+		assert(!PipelineCacheManager::ReadCacheFile(path, updated, readData));
+
+		VkPhysicalDeviceProperties otherDevice = pdProps;
+		otherDevice.pipelineCacheUUID[0] ^= 0xFF;
+		assert(!PipelineCacheManager::ReadCacheFile(path, otherDevice, readData));
+	}
+
+	// Driver data with a header of another device, even with a valid hash.
+	{
+		VkPhysicalDeviceProperties otherVendor = pdProps;
+		otherVendor.vendorID = 0x1002;
+
+		assert(PipelineCacheManager::WriteCacheFile(path, pdProps, MakeDriverData(otherVendor, 4096)));
+		assert(!PipelineCacheManager::ReadCacheFile(path, pdProps, readData));
+	}
+
+	// Save() compares size and hash, equal data hashes equal.
+	{
+		std::vector<uint8> grown = driverData;
+		grown.push_back(0);
+		assert(PipelineCacheManager::HashData(driverData) == PipelineCacheManager::HashData(MakeDriverData(pdProps, 4096)));
+		assert(PipelineCacheManager::HashData(driverData) != PipelineCacheManager::HashData(grown));
+	}
+
+	std::filesystem::remove_all(dir);
+
+	std::cout << "Pipeline cache file: ok" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Pipeline pack
+
+#if 0
+
+// Bake 200 pipelines into a pack, check what Open() accepts and rejects, and
+// compare creating them from the json with creating them from the pack. Both
+// runs start with the compiler, the shader cache and the pipeline cache warm.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/PipelinePack.h"
+#include <cassert>
+#include <chrono>
+#include <filesystem>
+
+static const uint32 kPipelineCount = 200;
+static const uint32 kChainLength   = 4;
+
+static string WritePipelineJson(const string& InPrefix)
+{
+	Json::Value sample;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/graphic_pipeline_info_simplify.json"), sample);
+
+	const char* polygonModes[] = { "fill", "line" };
+	const char* cullModes[]    = { "cull_none", "cull_front", "cull_back" };
+
+	Json::Value root;
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		Json::Value info = sample["graphic_pipeline_infos"];
+
+		info["name"] = InPrefix + std::to_string(i);
+
+		if (i % kChainLength == 0)
+		{
+			info["flags"] = (uint32)VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+		}
+		else
+		{
+			info["flags"]         = (uint32)VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+			info["base_pipeline"] = InPrefix + std::to_string(i - i % kChainLength);
+		}
+
+		info["rasterization_state"]["polygon_mode"] = polygonModes[i % 2];
+		info["rasterization_state"]["cull_mode"]    = cullModes[(i / 2) % 3];
+
+		root["graphic_pipeline_infos"].append(info);
+	}
+
+	const string path = PathParser::Parse("Json/Triangle/" + InPrefix + "pipelines.json");
+
+	std::ofstream file(path);
+	file << Json::writeString(Json::StreamWriterBuilder(), root);
+
+	return path;
+}
+
+static void CopyWithByte(const string& InFrom, const string& InTo, usize InOffset, uint8 InByte)
+{
+	std::ifstream ifs(InFrom, std::ios::binary);
+	std::vector<char> data((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+	if (InOffset < data.size())
+		data[InOffset] = (char)InByte;
+
+	std::ofstream ofs(InTo, std::ios::binary | std::ios::trunc);
+	ofs.write(data.data(), data.size());
+}
+
+int main()
+{
+	using Clock = std::chrono::high_resolution_clock;
+	auto ms = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double, std::milli>(b - a).count(); };
+
+	Engine::Get()->Init();
+
+	LogicalDevice* pDevice = Engine::Get()->GetBaseLayer()->GetLogicalDevice();
+
+	const string warmupPath = WritePipelineJson("warmup_");
+	const string jsonPath   = WritePipelineJson("json_");
+	const string packedPath = WritePipelineJson("pack_");
+	const string packPath   = PathParser::Parse("Saved/Test/pipelines.pack");
+	const string brokenPath = packPath + ".broken";
+
+	auto t0 = Clock::now();
+	assert(PipelinePack::Bake({ packedPath }, packPath));
+	auto t1 = Clock::now();
+
+	// Header, counts and references.
+	{
+		PipelinePack pack;
+		assert(pack.Open(packPath) && pack.IsUpToDate());
+		assert(pack.GetCount(PipelinePack::Section::Pipelines) == kPipelineCount);
+		assert(pack.GetCount(PipelinePack::Section::RenderPasses) == 1);
+
+		const PipelinePack::PipelineRecord* pPipelines = pack.Get<PipelinePack::PipelineRecord>(PipelinePack::Section::Pipelines);
+		for (uint32 i = 0; i < kPipelineCount; ++i)
+		{
+			assert(string(pack.GetString(pPipelines[i].Name)) == "pack_" + std::to_string(i));
+			assert(pPipelines[i].BasePipelineIndex == (i % kChainLength == 0 ? -1 : (int32)(i - i % kChainLength)));
+		}
+	}
+
+	// Another version, a cut file and an index out of its section are refused.
+	{
+		PipelinePack pack;
+
+		CopyWithByte(packPath, brokenPath, offsetof(PipelinePack::Header, Version), 0xFF);
+		assert(!pack.Open(brokenPath));
+
+		std::filesystem::copy_file(packPath, brokenPath, std::filesystem::copy_options::overwrite_existing);
+		std::filesystem::resize_file(brokenPath, std::filesystem::file_size(packPath) / 2);
+		assert(!pack.Open(brokenPath));
+
+		assert(pack.Open(packPath));
+		const usize recordOffset = pack.GetHeader().Sections[(usize)PipelinePack::Section::Pipelines].Offset;
+		pack.Close();
+
+		CopyWithByte(packPath, brokenPath, recordOffset + offsetof(PipelinePack::PipelineRecord, RenderPass), 0x7F);
+		assert(!pack.Open(brokenPath));
+	}
+
+	// Load the compiler, the shaders and the pipeline cache once, both runs start warm.
+	pDevice->CreateGraphicPipelines(warmupPath);
+
+	auto t2 = Clock::now();
+	pDevice->CreateGraphicPipelines(jsonPath);
+	auto t3 = Clock::now();
+	assert(pDevice->CreateGraphicPipelinesFromPack(packPath));
+	auto t4 = Clock::now();
+
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		assert(pDevice->GetPipeline("json_" + std::to_string(i)) != VK_NULL_HANDLE);
+		assert(pDevice->GetPipeline("pack_" + std::to_string(i)) != VK_NULL_HANDLE);
+	}
+
+	// A json written after the bake makes the pack stale.
+	WritePipelineJson("pack_");
+	std::filesystem::last_write_time(packedPath, std::filesystem::file_time_type::clock::now() + std::chrono::seconds(2));
+	{
+		PipelinePack pack;
+		assert(pack.Open(packPath) && !pack.IsUpToDate());
+	}
+
+	std::cout << kPipelineCount << " pipelines, " << std::filesystem::file_size(packPath) / 1024 << " KB pack" << std::endl;
+	std::cout << "bake      : " << ms(t0, t1) << " ms" << std::endl;
+	std::cout << "from json : " << ms(t2, t3) << " ms" << std::endl;
+	std::cout << "from pack : " << ms(t3, t4) << " ms, " << ms(t2, t3) / ms(t3, t4) << "x" << std::endl;
+
+	std::filesystem::remove(brokenPath);
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Render pass cache
+
+#if 0
+
+// 200 pipelines, half of them on the triangle render pass and half on a copy
+// of it under another name and file. Before the cache every pipeline parsed
+// its render pass json and created a VkRenderPass, 200 of each. Now the two
+// files are parsed once each and the copy shares the pass of the original.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include <cassert>
+
+static const uint32 kPipelineCount = 200;
+
+int main()
+{
+	Engine::Get()->Init();
+
+	LogicalDevice* pDevice = Engine::Get()->GetBaseLayer()->GetLogicalDevice();
+
+	// The same render pass under another name, in another file.
+	Json::Value renderPass;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/renderpass_info.json"), renderPass);
+	renderPass["renderpass_info"]["name"] = "copied_renderpass";
+	{
+		std::ofstream file(PathParser::Parse("Json/Triangle/copied_renderpass_info.json"));
+		file << Json::writeString(Json::StreamWriterBuilder(), renderPass);
+	}
+
+	Json::Value sample;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/graphic_pipeline_info_simplify.json"), sample);
+
+	const char* cullModes[] = { "cull_none", "cull_front", "cull_back" };
+
+	Json::Value root;
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		Json::Value info = sample["graphic_pipeline_infos"];
+
+		info["name"]                             = "rp_cache_" + std::to_string(i);
+		info["rasterization_state"]["cull_mode"] = cullModes[i % 3];
+
+		if (i % 2 == 1)
+		{
+			info["renderpass_path"] = "Json/Triangle/copied_renderpass_info.json";
+			info["renderpass"]      = "copied_renderpass";
+		}
+
+		root["graphic_pipeline_infos"].append(info);
+	}
+
+	const string jsonPath = PathParser::Parse("Json/Triangle/rp_cache_pipelines.json");
+	{
+		std::ofstream file(jsonPath);
+		file << Json::writeString(Json::StreamWriterBuilder(), root);
+	}
+
+	const LogicalDevice::RenderPassStats before = pDevice->GetRenderPassStats();
+	pDevice->CreateGraphicPipelines(jsonPath);
+	const LogicalDevice::RenderPassStats after = pDevice->GetRenderPassStats();
+
+	const uint64 parseCount  = after.ParseCount  - before.ParseCount;
+	const uint64 createCount = after.CreateCount - before.CreateCount;
+
+	// Engine::Init() may have made the triangle pass already, from the json or a pack.
+	assert(parseCount <= 2 && createCount <= 1);
+	assert(parseCount + after.PathHitCount - before.PathHitCount == kPipelineCount);
+	assert(pDevice->GetRenderPass("triangle_renderpass") == pDevice->GetRenderPass("copied_renderpass"));
+
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+		assert(pDevice->GetPipeline("rp_cache_" + std::to_string(i)) != VK_NULL_HANDLE);
+
+	std::cout << kPipelineCount << " pipelines on 2 render pass files" << std::endl;
+	std::cout << "before the cache: " << kPipelineCount << " parsed, " << kPipelineCount << " created" << std::endl;
+	std::cout << "with the cache  : " << parseCount << " parsed, " << createCount << " created, "
+		<< after.PathHitCount - before.PathHitCount << " path hits, " << after.StructureHitCount - before.StructureHitCount << " shared by structure" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Layout cache
+
+#if 0
+
+// Pipelines of one interface share their set layouts and pipeline layout,
+// whatever order the bindings and push constant ranges come in. 200 pipelines
+// of the triangle shaders used to make 200 pipeline layouts, now they make one.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include <cassert>
+
+static const uint32 kPipelineCount = 200;
+
+int main()
+{
+	Engine::Get()->Init();
+
+	LogicalDevice* pDevice = Engine::Get()->GetBaseLayer()->GetLogicalDevice();
+
+	// Binding order does not matter, contents do.
+	{
+		VkDescriptorSetLayoutBinding bindings[2] = {};
+		bindings[0].binding         = 0;
+		bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags      = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[1].binding         = 1;
+		bindings[1].descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorSetLayoutBinding swapped[2] = { bindings[1], bindings[0] };
+
+		VkDescriptorSetLayout setLayout = pDevice->FindOrCreateDescriptorSetLayout(bindings, 2);
+		assert(setLayout == pDevice->FindOrCreateDescriptorSetLayout(swapped, 2));
+
+		swapped[0].stageFlags |= VK_SHADER_STAGE_VERTEX_BIT;
+		assert(setLayout != pDevice->FindOrCreateDescriptorSetLayout(swapped, 2));
+
+		VkPushConstantRange ranges[2] = { { VK_SHADER_STAGE_VERTEX_BIT, 0, 64 }, { VK_SHADER_STAGE_FRAGMENT_BIT, 64, 16 } };
+		VkPushConstantRange swappedRanges[2] = { ranges[1], ranges[0] };
+
+		VkPipelineLayout pipelineLayout = pDevice->FindOrCreatePipelineLayout(&setLayout, 1, ranges, 2);
+		assert(pipelineLayout == pDevice->FindOrCreatePipelineLayout(&setLayout, 1, swappedRanges, 2));
+		assert(pipelineLayout != pDevice->FindOrCreatePipelineLayout(&setLayout, 1, ranges, 1));
+	}
+
+	Json::Value sample;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/graphic_pipeline_info_simplify.json"), sample);
+
+	const char* cullModes[] = { "cull_none", "cull_front", "cull_back" };
+
+	Json::Value root;
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+	{
+		Json::Value info = sample["graphic_pipeline_infos"];
+
+		info["name"]                             = "layout_cache_" + std::to_string(i);
+		info["rasterization_state"]["cull_mode"] = cullModes[i % 3];
+
+		root["graphic_pipeline_infos"].append(info);
+	}
+
+	const string jsonPath = PathParser::Parse("Json/Triangle/layout_cache_pipelines.json");
+	{
+		std::ofstream file(jsonPath);
+		file << Json::writeString(Json::StreamWriterBuilder(), root);
+	}
+
+	const LogicalDevice::LayoutStats before = pDevice->GetLayoutStats();
+	pDevice->CreateGraphicPipelines(jsonPath, VK_NULL_HANDLE, 0);
+	const LogicalDevice::LayoutStats after = pDevice->GetLayoutStats();
+
+	// Engine::Init() may have made the triangle layout already.
+	assert(after.PipelineLayoutCreateCount - before.PipelineLayoutCreateCount <= 1);
+	assert(after.PipelineLayoutHitCount - before.PipelineLayoutHitCount >= kPipelineCount - 1);
+
+	std::cout << kPipelineCount << " pipelines of one interface" << std::endl;
+	std::cout << "before the cache: " << kPipelineCount << " pipeline layouts" << std::endl;
+	std::cout << "with the cache  : " << after.PipelineLayoutCreateCount - before.PipelineLayoutCreateCount << " pipeline layouts, "
+		<< after.SetLayoutCreateCount - before.SetLayoutCreateCount << " set layouts created, "
+		<< after.SetLayoutHitCount - before.SetLayoutHitCount << " set layout requests shared" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Sampler cache
+
+#if 0
+
+// Equal create infos share one sampler, the last Release() frees it, and the
+// presets come from the table built at Init(). 10000 material slots over a
+// few distinct samplers stay far below maxSamplerAllocationCount.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/SamplerCache.h"
+#include <cassert>
+
+static const uint32 kSlotCount = 10000;
+
+int main()
+{
+	Engine::Get()->Init();
+
+	SamplerCache* pCache = Engine::Get()->GetBaseLayer()->GetLogicalDevice()->GetSamplerCache();
+
+	const SamplerCache::Stats before = pCache->GetStats();
+	assert(before.LiveCount >= SamplerCache::kPresetCount);
+
+	// Presets are the same objects as their create infos.
+	VkSampler linearWrap = pCache->Acquire(Render::Sampler::LinearWrap);
+	assert(linearWrap == pCache->Acquire(pCache->GetPresetCreateInfo(Render::Sampler::LinearWrap)));
+	assert(linearWrap != pCache->Acquire(Render::Sampler::PointWrap));
+	assert(pCache->GetStats().LiveCount == before.LiveCount);
+
+	// Material slots with a handful of distinct lod biases.
+	std::vector<VkSampler> slots(kSlotCount);
+	for (uint32 i = 0; i < kSlotCount; ++i)
+	{
+		VkSamplerCreateInfo createInfo = pCache->GetPresetCreateInfo(Render::Sampler::LinearClamp);
+		createInfo.mipLodBias = (float)(i % 4) * 0.5f;
+
+		slots[i] = pCache->Acquire(createInfo);
+	}
+
+	const SamplerCache::Stats loaded = pCache->GetStats();
+	assert(loaded.LiveCount <= before.LiveCount + 3);
+	assert(loaded.LiveCount < loaded.MaxCount);
+
+	for (VkSampler sampler : slots)
+		pCache->Release(sampler);
+
+	// The biased samplers are gone, the presets stay.
+	const SamplerCache::Stats released = pCache->GetStats();
+	assert(released.LiveCount == before.LiveCount);
+
+	std::cout << kSlotCount << " sampler slots: " << loaded.LiveCount << " of " << loaded.MaxCount << " samplers live, "
+		<< loaded.CreateCount - before.CreateCount << " created, " << loaded.HitCount - before.HitCount << " shared" << std::endl;
+	std::cout << "without the cache: " << kSlotCount << " samplers" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Async pipeline requests
+
+#if 0
+
+// Requests return at once and the frame loop draws with the fallback until
+// the workers are done, a frame request jumps the prefetched ones. Every
+// ticket ends up with the pipeline GetPipeline() finds under its name.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/PipelineRequestQueue.h"
+#include <cassert>
+#include <chrono>
+
+static const uint32 kPipelineCount = 64;
+
+int main()
+{
+	Engine::Get()->Init();
+
+	LogicalDevice*        pDevice = Engine::Get()->GetBaseLayer()->GetLogicalDevice();
+	PipelineRequestQueue* pQueue  = pDevice->GetPipelineRequestQueue();
+
+	Json::Value sample;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/graphic_pipeline_info_simplify.json"), sample);
+
+	const char* cullModes[] = { "cull_none", "cull_front", "cull_back" };
+
+	Json::Value root;
+	for (uint32 i = 0; i <= kPipelineCount; ++i)
+	{
+		Json::Value info = sample["graphic_pipeline_infos"];
+
+		info["name"]                             = i < kPipelineCount ? "async_" + std::to_string(i) : string("async_fallback");
+		info["rasterization_state"]["cull_mode"] = cullModes[i % 3];
+
+		root["graphic_pipeline_infos"].append(info);
+	}
+
+	const string jsonPath = PathParser::Parse("Json/Triangle/async_pipelines.json");
+	{
+		std::ofstream file(jsonPath);
+		file << Json::writeString(Json::StreamWriterBuilder(), root);
+	}
+
+	// The fallback is the only pipeline built up front, like a loading shader.
+	Json::Value fallbackRoot;
+	fallbackRoot["graphic_pipeline_infos"] = root["graphic_pipeline_infos"][kPipelineCount];
+
+	const string fallbackPath = PathParser::Parse("Json/Triangle/async_fallback.json");
+	{
+		std::ofstream file(fallbackPath);
+		file << Json::writeString(Json::StreamWriterBuilder(), fallbackRoot);
+	}
+
+	pDevice->CreateGraphicPipelines(fallbackPath);
+	pQueue->SetDefaultFallback(pDevice->GetPipeline("async_fallback"));
+
+	std::vector<SmartPtr<PipelineRequest>> requests;
+
+	auto begin = std::chrono::steady_clock::now();
+
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+		requests.push_back(pQueue->Request(jsonPath, "async_" + std::to_string(i)));
+
+	// Needed now, asked again with a more urgent priority.
+	SmartPtr<PipelineRequest> pUrgent = pQueue->Request(jsonPath, "async_" + std::to_string(kPipelineCount - 1), PipelineRequestQueue::Priority::Frame);
+	assert(pUrgent.Get() == requests.back().Get());
+
+	const double requestMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+	// Frames draw with whatever each ticket holds, never with a null pipeline.
+	uint32 frameCount    = 0;
+	uint32 fallbackDraws = 0;
+	bool   bAllReady     = false;
+
+	while (!bAllReady)
+	{
+		bAllReady = true;
+
+		for (auto& pRequest : requests)
+		{
+			assert(pRequest->GetPipeline() != VK_NULL_HANDLE);
+
+			if (!pRequest->IsReady())
+			{
+				bAllReady = false;
+				fallbackDraws++;
+			}
+		}
+
+		frameCount++;
+		std::this_thread::sleep_for(std::chrono::milliseconds(16));
+	}
+
+	pQueue->WaitIdle();
+
+	for (uint32 i = 0; i < kPipelineCount; ++i)
+		assert(requests[i]->GetPipeline() == pDevice->GetPipeline("async_" + std::to_string(i)));
+
+	// A name the file does not hold fails and keeps the fallback.
+	SmartPtr<PipelineRequest> pMissing = pQueue->Request(jsonPath, "async_missing", PipelineRequestQueue::Priority::Frame);
+	pQueue->WaitIdle();
+	assert(pMissing->GetState() == PipelineRequest::State::Failed);
+	assert(pMissing->GetPipeline() == pDevice->GetPipeline("async_fallback"));
+
+	const PipelineRequestQueue::Stats stats = pQueue->GetStats();
+	assert(stats.PromoteCount >= 1 && stats.FailCount >= 1);
+
+	std::cout << kPipelineCount << " pipelines requested in " << requestMs << " ms, ready after " << frameCount << " frames, "
+		<< fallbackDraws << " draws with the fallback, " << stats.WorkerCount << " workers" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion
+
+#pragma region Pipeline variants
+
+#if 0
+
+// Variants of one pipeline by the values of its variable specialization
+// constants, created on first use as derivatives of it and dropped least
+// recently used first once the cap is reached.
+// Needs the whole engine and a device, link it like the application.
+
+#include "Core/Engine/Engine.h"
+#include "Core/Base/BaseLayer.h"
+#include "Core/Render/RenderBase/LogicalDevice.h"
+#include "Core/Render/RenderBase/PipelinePack.h"
+#include <cassert>
+
+static const uint32 kVariantCap   = 8;
+static const uint32 kVariantCount = 16;
+
+int main()
+{
+	Engine::Get()->Init();
+
+	LogicalDevice* pDevice = Engine::Get()->GetBaseLayer()->GetLogicalDevice();
+
+	Json::Value root;
+	JsonParser::Parse(PathParser::Parse("Json/Triangle/graphic_pipeline_info_simplify.json"), root);
+
+	Json::Value& info = root["graphic_pipeline_infos"];
+	info["name"] = "variant_base";
+	info["pipeline_stages_infos"][0]["specialization_constants"].append(1.0f);
+	info["pipeline_stages_infos"][0]["specialization_constants"].append(0u);
+	info["variable_specialization_constants"].append(0u);
+	info["variable_specialization_constants"].append(1u);
+
+	const string jsonPath = PathParser::Parse("Json/Triangle/variant_pipelines.json");
+	{
+		std::ofstream file(jsonPath);
+		file << Json::writeString(Json::StreamWriterBuilder(), root);
+	}
+
+	pDevice->CreateGraphicPipelines(jsonPath);
+	pDevice->SetMaxPipelineVariantCount(kVariantCap);
+
+	const VkPipeline basePipeline = pDevice->GetPipeline("variant_base");
+	assert(basePipeline != VK_NULL_HANDLE);
+
+	auto makeConstants = [](uint32 InIndex)
+	{
+		float scale = 1.0f + InIndex * 0.25f;
+
+		uint32 bits;
+		_reinterpret_data(bits, scale);
+
+		return std::vector<uint32>{ bits, InIndex % 2 };
+	};
+
+	std::vector<VkPipeline> variants(kVariantCount);
+	for (uint32 i = 0; i < kVariantCount; ++i)
+	{
+		variants[i] = pDevice->GetPipeline("variant_base", makeConstants(i));
+		assert(variants[i] != VK_NULL_HANDLE && variants[i] != basePipeline);
+	}
+
+	// The last ones are still live, asking again creates nothing.
+	const LogicalDevice::PipelineVariantStats created = pDevice->GetPipelineVariantStats();
+	assert(created.CreateCount == kVariantCount && created.LiveCount == kVariantCap);
+	assert(created.EvictCount == kVariantCount - kVariantCap);
+
+	for (uint32 i = kVariantCount - kVariantCap; i < kVariantCount; ++i)
+		assert(pDevice->GetPipeline("variant_base", makeConstants(i)) == variants[i]);
+
+	assert(pDevice->GetPipelineVariantStats().HitCount == kVariantCap);
+
+	// The first one was evicted and comes back as a new variant.
+	pDevice->GetPipeline("variant_base", makeConstants(0));
+	assert(pDevice->GetPipelineVariantStats().CreateCount == kVariantCount + 1);
+
+	// Without the declared count of values the base is drawn.
+	assert(pDevice->GetPipeline("variant_base", { 0u }) == basePipeline);
+
+	// A pack keeps the info the variants are built from, loading it registers them like the json.
+	const string packPath = PathParser::Parse("Saved/VariantPipelines.pack");
+	assert(PipelinePack::Bake({ jsonPath }, packPath));
+	{
+		PipelinePack pack;
+		assert(pack.Open(packPath));
+
+		const PipelinePack::PipelineRecord& record = pack.Get<PipelinePack::PipelineRecord>(PipelinePack::Section::Pipelines)[0];
+
+		Json::Value variantInfo;
+		assert(record.VariantInfo != PipelinePack::kNone && JsonParser::ParseText(pack.GetString(record.VariantInfo), variantInfo));
+		assert(variantInfo["variable_specialization_constants"].size() == 2);
+	}
+
+	const LogicalDevice::PipelineVariantStats stats = pDevice->GetPipelineVariantStats();
+
+	std::cout << kVariantCount << " variants under a cap of " << kVariantCap << ": " << stats.CreateCount << " created, "
+		<< stats.HitCount << " hits, " << stats.EvictCount << " evicted" << std::endl;
+
+	return 0;
+}
+
+#endif
+
+#pragma endregion